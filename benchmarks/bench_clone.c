@@ -0,0 +1,114 @@
+#include "benchmarks.h"
+
+#include <magic_mem.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define CLONE_HANDLE_COUNT 65535 // largest group a handle index can address
+#define CLONE_RUNS 8
+
+typedef enum CloneHandleType {
+    CLONE_HANDLE_TYPE_INVALID = 0,
+    CLONE_HANDLE_TYPE_BLOCK   = 1,
+} CloneHandleType;
+
+typedef struct CloneBlock {
+    uint64_t words[128]; // 1 KiB, 64 MiB for the whole group
+} CloneBlock;
+
+typedef struct CloneRebuild {
+    MgArena* arena;
+    uint32_t failed;
+} CloneRebuild;
+
+static MgArena* clone_arena_init(void)
+{
+    MgHandleDescriptor handle_descriptors[] = {
+        { .type = CLONE_HANDLE_TYPE_BLOCK, .count = CLONE_HANDLE_COUNT, .stride = sizeof(CloneBlock) },
+    };
+
+    MgArenaDescriptor arena_descriptor = {
+        .arena_name               = "BENCH_CLONE_ARENA",
+        .handle_descriptors       = handle_descriptors,
+        .handle_descriptors_count = 1,
+    };
+
+    return mg_arena_init(&arena_descriptor);
+}
+
+static void clone_rebuild_block(MgHandle handle, void* data, void* ctx)
+{
+    // the fresh arena hands out slots in the same order, so the copies end up behind the same handles
+    CloneRebuild* rebuild = (CloneRebuild*)ctx;
+    MgHandle copy         = mg_handle_create(rebuild->arena, CLONE_HANDLE_TYPE_BLOCK);
+    rebuild->failed += copy.slot_handle != handle.slot_handle;
+    rebuild->failed += mg_handle_write(rebuild->arena, copy, data, sizeof(CloneBlock)) != MG_SUCCESS;
+}
+
+int bench_clone(int argc, char** argv)
+{
+    (void)argc;
+    (void)argv;
+    MgArena* source = clone_arena_init();
+    if (!source)
+    {
+        printf("failed to create the source arena\n");
+        return 1;
+    }
+
+    MgHandle* handles = (MgHandle*)malloc(sizeof(MgHandle) * CLONE_HANDLE_COUNT);
+    CloneBlock block  = { { 0 } };
+
+    for (uint32_t i = 0; i < CLONE_HANDLE_COUNT; i++)
+    {
+        block.words[0] = i;
+        handles[i]     = mg_handle_create(source, CLONE_HANDLE_TYPE_BLOCK);
+        mg_handle_write(source, handles[i], &block, sizeof(CloneBlock));
+    }
+
+    uint64_t clone_ns   = 0;
+    uint64_t rebuild_ns = 0;
+    uint32_t mismatches = 0;
+
+    for (uint32_t run = 0; run < CLONE_RUNS; run++)
+    {
+        uint64_t start = bench_time_ns();
+        MgArena* clone = mg_arena_clone(source);
+        clone_ns += bench_time_ns() - start;
+
+        start                = bench_time_ns();
+        CloneRebuild rebuild = { clone_arena_init(), 0 };
+        mg_group_foreach(source, CLONE_HANDLE_TYPE_BLOCK, clone_rebuild_block, &rebuild);
+        rebuild_ns += bench_time_ns() - start;
+
+        // both copies have to be usable through the source's handles
+        for (uint32_t i = 0; i < CLONE_HANDLE_COUNT; i += 997)
+        {
+            const CloneBlock* cloned  = (const CloneBlock*)mg_handle_read(clone, handles[i]);
+            const CloneBlock* rebuilt = (const CloneBlock*)mg_handle_read(rebuild.arena, handles[i]);
+            mismatches += !cloned || !rebuilt || cloned->words[0] != i || rebuilt->words[0] != i;
+        }
+        mismatches += rebuild.failed;
+
+        mg_arena_destroy(&clone);
+        mg_arena_destroy(&rebuild.arena);
+    }
+
+    double bytes = (double)mg_arena_size(source);
+    printf("arena %.1f MiB, %u handles, %u runs\n", bytes / (1024.0 * 1024.0), CLONE_HANDLE_COUNT, CLONE_RUNS);
+    printf("clone   %8.2f ms   %6.2f GB/s\n", (double)clone_ns / CLONE_RUNS / 1e6,
+    bytes * CLONE_RUNS / (double)clone_ns);
+    printf("rebuild %8.2f ms   %6.2f GB/s\n", (double)rebuild_ns / CLONE_RUNS / 1e6,
+    bytes * CLONE_RUNS / (double)rebuild_ns);
+
+    free(handles);
+    mg_arena_destroy(&source);
+
+    if (mismatches)
+    {
+        printf("%u copies did not match the source\n", mismatches);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,117 @@
+#include "benchmarks.h"
+
+#include <magic_mem.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define NUMA_HANDLE_COUNT 65535 // largest group a handle index can address
+#define NUMA_RANDOM_READS (1u << 24)
+
+typedef enum NumaHandleType {
+    NUMA_HANDLE_TYPE_INVALID = 0,
+    NUMA_HANDLE_TYPE_BLOCK   = 1,
+} NumaHandleType;
+
+typedef struct NumaBlock {
+    uint64_t words[128]; // 1 KiB, so the group is far larger than the last level cache
+} NumaBlock;
+
+typedef struct NumaSum {
+    uint64_t total;
+} NumaSum;
+
+static void numa_sum_block(MgHandle handle, void* data, void* ctx)
+{
+    (void)handle;
+    const NumaBlock* block = (const NumaBlock*)data;
+    NumaSum* sum           = (NumaSum*)ctx;
+
+    for (int i = 0; i < 128; i += 8) // one word per cache line
+    {
+        sum->total += block->words[i];
+    }
+}
+
+static int numa_run_node(uint32_t node, const char* label)
+{
+    MgHandleDescriptor handle_descriptors[] = {
+        { .type        = NUMA_HANDLE_TYPE_BLOCK,
+          .count       = NUMA_HANDLE_COUNT,
+          .stride      = sizeof(NumaBlock),
+          .numa_policy = MG_NUMA_POLICY_BIND,
+          .numa_node   = node },
+    };
+
+    MgArenaDescriptor arena_descriptor = {
+        .arena_name               = "BENCH_NUMA_ARENA",
+        .handle_descriptors       = handle_descriptors,
+        .handle_descriptors_count = 1,
+    };
+
+    MgArena* arena = mg_arena_init(&arena_descriptor);
+    if (!arena)
+    {
+        printf("failed to create an arena on node %u\n", node);
+        return 1;
+    }
+
+    MgHandle* handles = (MgHandle*)malloc(sizeof(MgHandle) * NUMA_HANDLE_COUNT);
+    NumaBlock block   = { { 0 } };
+
+    for (uint32_t i = 0; i < NUMA_HANDLE_COUNT; i++)
+    {
+        block.words[0] = i;
+        handles[i]     = mg_handle_create(arena, NUMA_HANDLE_TYPE_BLOCK);
+        mg_handle_write(arena, handles[i], &block, sizeof(NumaBlock));
+    }
+
+    // sequential: touch every line of every block
+    NumaSum sum    = { 0 };
+    uint64_t start = bench_time_ns();
+    mg_group_foreach(arena, NUMA_HANDLE_TYPE_BLOCK, numa_sum_block, &sum);
+    uint64_t sequential_ns = bench_time_ns() - start;
+    bench_consume(sum.total);
+
+    // random: one dependent read per handle, the index is an lcg so the prefetcher cannot follow
+    uint64_t total = 0;
+    uint32_t index = 1;
+    start          = bench_time_ns();
+    for (uint32_t i = 0; i < NUMA_RANDOM_READS; i++)
+    {
+        index                  = index * 1664525u + 1013904223u + (uint32_t)(total & 1);
+        const NumaBlock* found = (const NumaBlock*)mg_handle_read(arena, handles[index % NUMA_HANDLE_COUNT]);
+        total += found->words[0];
+    }
+    uint64_t random_ns = bench_time_ns() - start;
+    bench_consume(total);
+
+    double bytes = (double)NUMA_HANDLE_COUNT * sizeof(NumaBlock);
+    printf("%-8s node %-3u sequential %8.2f GB/s   random %7.2f ns/read\n", label, node,
+    bytes / (double)sequential_ns, (double)random_ns / NUMA_RANDOM_READS);
+
+    free(handles);
+    mg_arena_destroy(&arena);
+    return 0;
+}
+
+int bench_numa(int argc, char** argv)
+{
+    (void)argc;
+    (void)argv;
+    bench_pin_current_thread();
+
+    uint32_t node_count = mg_numa_node_count();
+    uint32_t local      = mg_numa_node_current();
+    uint32_t remote     = (local + 1) % node_count;
+
+    printf("numa nodes: %u, running on node %u\n", node_count, local);
+    if (node_count == 1)
+    {
+        printf("single node machine, local and remote runs use the same memory\n");
+    }
+
+    int result = numa_run_node(local, "local");
+    result |= numa_run_node(remote, "remote");
+    return result;
+}
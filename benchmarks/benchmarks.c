@@ -0,0 +1,65 @@
+#if defined(__linux__)
+#if !defined(_GNU_SOURCE)
+#define _GNU_SOURCE // sched_getcpu, sched_setaffinity
+#endif
+#include <sched.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#endif
+
+#include "benchmarks.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static const Bench benches[] = {
+    { "numa", "sequential and random reads from a group on the local and on a remote node", bench_numa },
+    { "clone", "mg_arena_clone against rebuilding the same arena with create and write", bench_clone },
+};
+
+volatile uint64_t bench_sink;
+
+void bench_pin_current_thread(void)
+{
+#if defined(__linux__)
+    int cpu = sched_getcpu();
+    if (cpu >= 0)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        sched_setaffinity(0, sizeof(set), &set);
+    }
+#elif defined(_WIN32)
+    SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << GetCurrentProcessorNumber());
+#endif
+}
+
+static void bench_usage(void)
+{
+    printf("usage: benchmarks <name> [args]\n");
+    for (size_t i = 0; i < sizeof(benches) / sizeof(Bench); i++)
+    {
+        printf("  %-12s %s\n", benches[i].name, benches[i].summary);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        bench_usage();
+        return 1;
+    }
+
+    for (size_t i = 0; i < sizeof(benches) / sizeof(Bench); i++)
+    {
+        if (strcmp(argv[1], benches[i].name) == 0)
+        {
+            return benches[i].run(argc - 2, argv + 2);
+        }
+    }
+
+    bench_usage();
+    return 1;
+}
@@ -0,0 +1,36 @@
+#ifndef BENCHMARKS_HEADER
+#define BENCHMARKS_HEADER
+
+#include <stdint.h>
+#include <time.h>
+
+typedef int (*BenchFn)(int argc, char** argv);
+
+typedef struct Bench {
+    const char* name;
+    const char* summary;
+    BenchFn run;
+} Bench;
+
+static inline uint64_t bench_time_ns(void)
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+extern volatile uint64_t bench_sink;
+
+// keeps the optimizer from dropping a loop whose result is otherwise unused
+static inline void bench_consume(uint64_t value)
+{
+    bench_sink = value;
+}
+
+// pins the calling thread to the core it is running on, best effort
+void bench_pin_current_thread(void);
+
+int bench_numa(int argc, char** argv);
+int bench_clone(int argc, char** argv);
+
+#endif // BENCHMARKS_HEADER
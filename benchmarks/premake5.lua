@@ -0,0 +1,20 @@
+project "benchmarks"
+   kind "ConsoleApp"
+   language "C"
+   staticruntime "On"
+
+   targetdir ("%{wks.location}/bin/" .. OutputDir .. "/%{prj.name}")
+   objdir ("%{wks.location}/bin/int/" .. OutputDir .. "/%{prj.name}")
+
+   files { "**.h", "**.c" }
+
+   includedirs
+   {
+      "%{prj.location}",
+      "%{IncludeDir.magic_mem}",
+   }
+
+   links
+   {
+      "magic_mem",
+   }
@@ -0,0 +1,453 @@
+#ifndef MAGIC_ARENA_HEADER
+#define MAGIC_ARENA_HEADER
+
+// internal header, not part of the public api (include magic_mem.h instead).
+// layout of the arena block, shared by every module that works on the block as a whole.
+
+#include "magic_log.h"
+#include "magic_mem.h"
+#include "magic_platform.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#define MG_ENCODE_HANDLE(index, generation) (((generation) << _MG_SLOT_BIT_SHIFT) | ((index) & _MG_SLOT_BIT_MASK))
+
+#define MG_DECODE_INDEX(handle) ((handle) & _MG_SLOT_BIT_MASK)
+
+#define MG_DECODE_GENERATION(handle) ((handle) >> _MG_SLOT_BIT_SHIFT)
+
+enum {
+    _MG_HANDLE_INVALID = 0,
+    _MG_SLOT_BIT_SHIFT = 16,
+    _MG_SLOT_BIT_MASK  = (1 << _MG_SLOT_BIT_SHIFT) - 1,
+};
+
+typedef enum _MgArenaAlloc {
+    _MG_ARENA_ALLOC_HEAP,   // aligned heap block
+    _MG_ARENA_ALLOC_PAGES,  // page reservation, used when a group asks for numa placement
+    _MG_ARENA_ALLOC_MAPPED, // copy on write file mapping made by mg_arena_load_mapped
+    _MG_ARENA_ALLOC_VIEW,   // copy on write view of a memory file, for arenas with in memory snapshots
+    _MG_ARENA_ALLOC_SHARED, // named shared memory, mapped by several processes
+    _MG_ARENA_ALLOC_FILE,   // shared mapping of a file made by mg_arena_open_file, the arena persists in the file
+} _MgArenaAlloc;
+
+typedef enum _MgSlotStatus {
+    _MG_SLOT_STATUS_FREE,
+    _MG_SLOT_STATUS_VALID_ALLOC,
+    _MG_SLOT_STATUS_VALID_WRITE,
+    _MG_SLOT_STATUS_INVALID,
+} _MgSlotStatus;
+
+typedef struct _MgSlot {
+    union {
+        uint32_t handle;          // if allocated, stores generation + index
+        uint32_t next_free_index; // if free, this points to next free slot in group
+    };
+    uint32_t generation;
+    _MgSlotStatus status;
+} _MgSlot;
+
+// a shard owns a contiguous run of a group's slots with its own free list and lock, so creates and erases on
+// different shards never share a cache line. unsharded groups are simply a group with one shard.
+typedef struct _MgShard {
+    _MgLock lock; // only used when the arena has a group sync mode
+    uint32_t free_list_head;
+    uint32_t slot_begin;
+    uint32_t slot_end;
+    volatile uint32_t owner; // thread token of the owning thread, 0 when unowned (thread owned arenas only)
+
+    // slots erased by other threads, pushed lock free and drained by the owner. kept on its own line so
+    // remote erases never invalidate the line the owner allocates from.
+    _MG_ALIGNAS(MG_CACHE_LINE_SIZE) volatile uint32_t remote_free_head;
+} _MgShard;
+
+// everything inside the arena block refers to everything else through self relative offsets, never pointers
+typedef struct _MgGroup {
+    _MgOffset data;      // uint8_t[slot_count * handle_stride]
+    _MgOffset slots;     // _MgSlot[slot_count]
+    _MgOffset shards;    // _MgShard[shard_count]
+    _MgOffset dirty;     // uint64_t[(slot_count + 63) / 64], one bit per slot touched since the last checkpoint
+    _MgOffset blob_refs; // _MgBlobRef[slot_count], groups with a blob region only
+    _MgOffset blobs;     // _MgBlobRegion followed by uint8_t[blob_capacity], groups with a blob region only
+    _MgOffset index;     // _MgIndex, its control bytes and entries, indexed groups only
+    _MgOffset order;     // _MgOrder followed by _MgOrderNode[order_capacity], ordered groups only
+    _MgOffset columns;   // _MgColumn[column_count], columnar groups only
+    _MgOffset live;      // uint64_t[(slot_count + 63) / 64], one bit per written slot, columnar groups only
+    uint32_t slot_count;
+    uint32_t shard_count;
+    uint32_t shard_slot_count; // shard id of a slot is slot index / shard_slot_count
+    uint32_t handle_stride;
+    uint32_t handle_type;
+    MgNumaPolicy numa_policy;
+    uint32_t numa_node;
+    size_t size;
+    uint32_t class_count; // variable size groups: the size class groups right behind this one
+    bool size_class;      // holds payloads for the variable size group in front of it, not a handle type of its own
+    uint32_t blob_capacity;
+    uint32_t index_capacity; // 0 unless the group is indexed
+    uint32_t key_offset;
+    uint32_t order_capacity; // nodes, 0 unless the group is ordered
+    uint32_t order_offset;
+    MgFieldType order_type;
+    uint32_t column_count; // 0 unless the group is columnar, whose data is one column per field instead of records
+    uint32_t hot_size;     // 0 unless the group's columns are the hot and the cold part of its records
+} _MgGroup;
+
+enum {
+    _MG_SIZE_CLASS_MIN = 16, // smallest size class, every next one doubles up to the descriptor's stride
+};
+
+// payload of a variable size group's slot, the bytes themselves live in the size class they fit
+typedef struct _MgVariableRef {
+    uint32_t slot_handle; // in the size class group
+    uint32_t size;
+} _MgVariableRef;
+
+enum {
+    _MG_BLOB_ALIGNMENT = 8, // every blob header, and so every blob, starts on this boundary of the region
+};
+
+// the blob region of a group is bumped from the front. a blob that is replaced or erased leaves a hole behind,
+// compaction slides the live blobs down over the holes in the order they were written.
+typedef struct _MgBlobRegion {
+    _MgLock lock;     // taken after the slot's shard lock, compaction moves blobs of every shard
+    uint32_t head;    // everything from here to the capacity is free
+    uint32_t garbage; // bytes below head held by blobs that were replaced or erased
+} _MgBlobRegion;
+
+typedef struct _MgBlobRef {
+    uint32_t offset; // of the blob's header in the region
+    uint32_t size;   // 0 while the slot has no blob
+} _MgBlobRef;
+
+// in front of every blob in the region, lets compaction walk the region without a second index
+typedef struct _MgBlobHeader {
+    uint32_t slot_index;
+    uint32_t size;
+} _MgBlobHeader;
+
+enum {
+    _MG_INDEX_GROUP_SIZE = 16, // control bytes probed with one vector compare
+};
+
+// open addressing table from the uint64_t key in a payload to its handle. one control byte per entry holds 7 bits
+// of the key's hash (or marks the entry empty or erased), so a probe compares a whole group of entries at once and
+// only touches the entries whose bits match.
+typedef struct _MgIndex {
+    _MgLock lock;        // taken after the slot's shard lock
+    uint32_t size;       // keys in the table
+    uint32_t tombstones; // erased entries probes still walk past, an in place rehash clears them
+} _MgIndex;
+
+typedef struct _MgIndexEntry {
+    uint64_t key; // kept next to the handle, so a probe never has to read the payload
+    uint32_t slot_handle;
+    uint32_t reserved;
+} _MgIndexEntry;
+
+enum {
+    _MG_ORDER_FANOUT    = 32, // entries per leaf, separators per inner node
+    _MG_ORDER_DEPTH_MAX = 16, // levels a tree of 2^32 nodes at half fill stays below
+    _MG_ORDER_BATCH     = 64, // handles a range walk copies out per hold of the tree's lock
+};
+
+// b+ tree over (key, handle) pairs, the key a payload field mapped to a uint64_t that sorts the same way. handles
+// break ties, so equal keys are fine. nodes come from a pool sized for every handle at half fill, and deletes merge
+// nodes back to at least half full, so the pool never runs out. node 0 is null, node n is the pool's n - 1th.
+typedef struct _MgOrder {
+    _MgLock lock;       // taken after the slot's shard lock
+    uint32_t root;      // 0 while the tree is empty
+    uint32_t height;    // inner levels above the leaves
+    uint32_t size;      // entries in the leaves
+    uint32_t used;      // pool nodes handed out so far, those past it were never touched
+    uint32_t free_head; // freed nodes, linked through next
+} _MgOrder;
+
+typedef struct _MgOrderNode {
+    uint32_t count; // entries of a leaf, separators of an inner node
+    uint32_t next;  // leaves: the next leaf in key order. free nodes: the next free one
+    uint64_t keys[_MG_ORDER_FANOUT];
+    uint32_t handles[_MG_ORDER_FANOUT];
+    uint32_t children[_MG_ORDER_FANOUT + 1]; // inner nodes only, child i holds the pairs below separator i
+} _MgOrderNode;
+
+typedef struct _MgColumn {
+    uint32_t offset; // of the field in the group's records
+    uint32_t size;
+    MgFieldType type;
+    size_t start; // of the column in the group's data, on a cache line (a page when placed)
+} _MgColumn;
+
+#define _MG_ARENA_NAME_SIZE 64
+
+struct _MgLog;
+
+typedef struct _MgArena {
+    _MgOffset groups; // _MgGroup[group_count]
+    uint32_t group_count;
+    size_t alloc_size;
+    char name[_MG_ARENA_NAME_SIZE]; // copied in, the descriptor's string does not live in the block
+    MgArenaSyncMode sync_mode;
+    bool lock_timing;
+    bool track_dirty;
+    _MgArenaAlloc alloc_kind;
+    uint64_t checkpoint_base;              // checksum of the snapshot the current delta chain starts from
+    uint32_t checkpoint_sequence;          // deltas written (or applied) on top of that snapshot
+    struct _MgLog* log;                    // process local, cleared whenever the block is mapped or copied
+    struct _MgLog* publisher;              // process local like the log, streams the same records to a follower
+    _MgMemFile backing;                    // process local, the memory file behind a view
+    char shared_name[_MG_ARENA_NAME_SIZE]; // shared arenas: the name, removed again when the creator destroys it
+    uint32_t shared_creator;               // shared arenas: process id of the creator
+    volatile uint32_t shared_ready;        // shared arenas: set once the creator initialized the block
+    _MgFile file;                          // file arenas: the mapped file, process local
+    uint32_t file_open;                    // file arenas: set while mapped, a file left by a crash still has it set
+} _MgArena;
+
+// the status is read without the shard lock (foreach, readers of shared arenas), so a write publishes it with
+// release after the payload and lock free readers load it with acquire
+_MG_INLINE _MgSlotStatus _mg_slot_status(_MgSlot* slot)
+{
+    return (_MgSlotStatus)_mg_atomic_load_u32((volatile uint32_t*)&slot->status);
+}
+
+_MG_INLINE void _mg_slot_publish(_MgSlot* slot, _MgSlotStatus status)
+{
+    _mg_atomic_store_u32((volatile uint32_t*)&slot->status, (uint32_t)status);
+}
+
+_MG_INLINE _MgGroup* _mg_arena_groups(_MgArena* arena_internal)
+{
+    return (_MgGroup*)_mg_offset_get(&arena_internal->groups);
+}
+
+_MG_INLINE uint8_t* _mg_group_data(_MgGroup* group)
+{
+    return (uint8_t*)_mg_offset_get(&group->data);
+}
+
+_MG_INLINE _MgSlot* _mg_group_slots(_MgGroup* group)
+{
+    return (_MgSlot*)_mg_offset_get(&group->slots);
+}
+
+_MG_INLINE _MgShard* _mg_group_shards(_MgGroup* group)
+{
+    return (_MgShard*)_mg_offset_get(&group->shards);
+}
+
+_MG_INLINE uint64_t* _mg_group_dirty(_MgGroup* group)
+{
+    return (uint64_t*)_mg_offset_get(&group->dirty);
+}
+
+_MG_INLINE uint32_t _mg_group_dirty_words(_MgGroup* group)
+{
+    return (group->slot_count + 63) / 64;
+}
+
+_MG_INLINE _MgBlobRef* _mg_group_blob_refs(_MgGroup* group)
+{
+    return (_MgBlobRef*)_mg_offset_get(&group->blob_refs);
+}
+
+_MG_INLINE _MgBlobRegion* _mg_group_blob_region(_MgGroup* group)
+{
+    return (_MgBlobRegion*)_mg_offset_get(&group->blobs);
+}
+
+_MG_INLINE uint8_t* _mg_blob_region_data(_MgBlobRegion* region) // right behind the cache line aligned header
+{
+    return (uint8_t*)(region + 1);
+}
+
+_MG_INLINE _MgIndex* _mg_group_index(_MgGroup* group)
+{
+    return (_MgIndex*)_mg_offset_get(&group->index);
+}
+
+_MG_INLINE uint32_t _mg_index_capacity(size_t count) // a power of two, at most 7/8 full with every handle written
+{
+    uint32_t capacity = _MG_INDEX_GROUP_SIZE;
+    while (capacity - capacity / 8 < count)
+    {
+        capacity *= 2;
+    }
+    return capacity;
+}
+
+_MG_INLINE size_t _mg_index_size(uint32_t index_capacity) // header, control bytes and entries
+{
+    return index_capacity ? sizeof(_MgIndex) + (size_t)index_capacity * (1 + sizeof(_MgIndexEntry)) : 0;
+}
+
+_MG_INLINE _MgOrder* _mg_group_order(_MgGroup* group)
+{
+    return (_MgOrder*)_mg_offset_get(&group->order);
+}
+
+_MG_INLINE uint32_t _mg_order_capacity(size_t count) // leaves at half fill, the inner levels above them and a root
+{
+    size_t leaves = count / (_MG_ORDER_FANOUT / 2) + 1;
+    return (uint32_t)(leaves + leaves / (_MG_ORDER_FANOUT / 2 - 1) + _MG_ORDER_DEPTH_MAX);
+}
+
+_MG_INLINE size_t _mg_order_size(uint32_t order_capacity)
+{
+    return order_capacity ? sizeof(_MgOrder) + (size_t)order_capacity * sizeof(_MgOrderNode) : 0;
+}
+
+_MG_INLINE _MgColumn* _mg_group_columns(_MgGroup* group)
+{
+    return (_MgColumn*)_mg_offset_get(&group->columns);
+}
+
+_MG_INLINE uint64_t* _mg_group_live(_MgGroup* group)
+{
+    return (uint64_t*)_mg_offset_get(&group->live);
+}
+
+_MG_INLINE uint8_t* _mg_column_cell(_MgGroup* group, const _MgColumn* column, uint32_t slot_index)
+{
+    return _mg_group_data(group) + column->start + (size_t)slot_index * column->size;
+}
+
+_MG_INLINE size_t _mg_group_data_size(_MgGroup* group) // from the data offset to the end of the last record or row
+{
+    const _MgColumn* last = group->column_count ? &_mg_group_columns(group)[group->column_count - 1] : NULL;
+    return last ? last->start + (size_t)group->slot_count * last->size
+                : (size_t)group->slot_count * group->handle_stride;
+}
+
+_MG_INLINE size_t _mg_field_size(MgFieldType type)
+{
+    return (type == MG_FIELD_U32 || type == MG_FIELD_I32 || type == MG_FIELD_F32) ? sizeof(uint32_t) : sizeof(uint64_t);
+}
+
+_MG_INLINE bool _mg_group_has_indexes(_MgGroup* group)
+{
+    return group->index_capacity || group->order_capacity;
+}
+
+_MG_INLINE size_t _mg_group_keys_end(_MgGroup* group) // payload bytes a write needs to carry every indexed key
+{
+    size_t key_end   = group->index_capacity ? (size_t)group->key_offset + sizeof(uint64_t) : 0;
+    size_t order_end = group->order_capacity ? (size_t)group->order_offset + _mg_field_size(group->order_type) : 0;
+    return key_end > order_end ? key_end : order_end;
+}
+
+// locks of the group wide structures (blob region, indexes) follow the same rule as the shard locks. hold times
+// are only tracked for shards, mg_group_lock_stats reports those.
+_MG_INLINE void _mg_arena_lock(_MgArena* arena_internal, _MgLock* lock)
+{
+    bool adaptive = (arena_internal->sync_mode == MG_ARENA_SYNC_GROUP_ADAPTIVE);
+    if (adaptive || arena_internal->sync_mode == MG_ARENA_SYNC_GROUP_SPIN)
+    {
+        _mg_lock_acquire(lock, adaptive, false);
+    }
+}
+
+_MG_INLINE void _mg_arena_unlock(_MgArena* arena_internal, _MgLock* lock)
+{
+    bool adaptive = (arena_internal->sync_mode == MG_ARENA_SYNC_GROUP_ADAPTIVE);
+    if (adaptive || arena_internal->sync_mode == MG_ARENA_SYNC_GROUP_SPIN)
+    {
+        _mg_lock_release(lock, false);
+    }
+}
+
+_MG_INLINE bool _mg_arena_has_blobs(_MgArena* arena_internal)
+{
+    for (uint32_t i = 0; i < arena_internal->group_count; i++)
+    {
+        if (_mg_arena_groups(arena_internal)[i].blob_capacity)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+_MG_INLINE uint32_t _mg_group_max_size(_MgGroup* group) // largest payload a handle of the group can hold
+{
+    return group->class_count ? group[group->class_count].handle_stride : group->handle_stride;
+}
+
+_MG_INLINE uint32_t _mg_group_class(_MgGroup* group, size_t size) // smallest size class that fits size
+{
+    uint32_t class_index = 0;
+    while (class_index + 1 < group->class_count && ((size_t)_MG_SIZE_CLASS_MIN << class_index) < size)
+    {
+        class_index++;
+    }
+    return class_index;
+}
+
+// magic_mem.c
+extern _MgGroup* _mg_group_query(_MgArena* arena_internal, uint32_t handle_type);
+// relinks every free slot in ascending order per shard, and recounts the live bits of columnar groups
+extern void _mg_group_rebuild_free_lists(_MgGroup* group);
+extern void _mg_arena_reset_process_state(_MgArena* arena_internal); // for a block copied or mapped from elsewhere
+extern void _mg_group_mark_dirty(_MgArena* arena_internal, _MgGroup* group, uint32_t slot_index); // if track_dirty
+// sets or clears the slot's bit in the live bitmap column scans mask their rows with, columnar groups only
+extern void _mg_group_mark_live(_MgArena* arena_internal, _MgGroup* group, uint32_t slot_index, bool live);
+// the payload of a written slot and its size, resolved through the size class for variable size groups. NULL for
+// columnar groups, load gathers their records and store spreads a record (zero filled past size) over the columns.
+extern uint8_t* _mg_group_payload(_MgGroup* group, uint32_t slot_index, size_t* size);
+extern void _mg_group_load(_MgGroup* group, uint32_t slot_index, uint8_t* record);
+extern void _mg_group_store(_MgGroup* group, uint32_t slot_index, const void* data, size_t size);
+// variable size groups, the caller holds the slot's shard lock. write stores a payload of any size up to the max
+// in the class that fits, moving it there when its class changed. release frees the class slot of a written slot.
+extern MgStatus _mg_variable_write(_MgArena* arena_internal, _MgGroup* group, uint32_t slot_index, const void* data,
+size_t size);
+extern void _mg_variable_release(_MgArena* arena_internal, _MgGroup* group, uint32_t slot_index);
+// erases every handle of the group, its size classes and blobs included, the caller holds no shard lock. a ticket
+// gets the reset record while every shard is still held, NULL when nothing is logged.
+extern void _mg_group_reset(_MgArena* arena_internal, _MgGroup* group, _MgLogTicket* ticket);
+
+// magic_blob.c, the caller holds the slot's shard lock (none for compact). write replaces the slot's blob,
+// compacting the region when the blob does not fit behind the head. payload returns NULL if the slot has none.
+extern MgStatus _mg_blob_write(_MgArena* arena_internal, _MgGroup* group, uint32_t slot_index, const void* data,
+size_t size);
+extern void _mg_blob_release(_MgArena* arena_internal, _MgGroup* group, uint32_t slot_index);
+extern const uint8_t* _mg_blob_payload(_MgArena* arena_internal, _MgGroup* group, uint32_t slot_index, size_t* size);
+extern void _mg_blob_compact(_MgArena* arena_internal, _MgGroup* group);
+extern void _mg_blob_move(_MgArena* arena_internal, _MgGroup* group, uint32_t from, uint32_t to); // to has none
+extern void _mg_blob_reset(_MgArena* arena_internal, _MgGroup* group); // drops every blob of the group
+
+// magic_index.c, the caller holds the slot's shard lock where there is one. insert fails if the key is indexed
+// already, replace moves a handle from one key to another and fails (keeping the old key) if the new one is taken.
+extern bool _mg_index_insert(_MgArena* arena_internal, _MgGroup* group, uint64_t key, uint32_t slot_handle);
+extern bool _mg_index_replace(_MgArena* arena_internal, _MgGroup* group, uint64_t old_key, uint64_t new_key,
+uint32_t slot_handle);
+extern void _mg_index_remove(_MgArena* arena_internal, _MgGroup* group, uint64_t key);
+extern uint32_t _mg_index_find(_MgArena* arena_internal, _MgGroup* group, uint64_t key); // slot handle or 0
+extern void _mg_index_clear(_MgArena* arena_internal, _MgGroup* group);
+extern uint64_t _mg_index_key(_MgGroup* group, uint32_t slot_index); // of a written slot
+// insert fails, leaving the tree as it was, when the node pool has no room for the nodes it may split off.
+// collect copies up to _MG_ORDER_BATCH handles from the pair at *key, *handle on whose key is at most high, and
+// moves the pair past the last one. more is false once the walk reached high or the end of the tree.
+extern bool _mg_order_insert(_MgArena* arena_internal, _MgGroup* group, uint64_t key, uint32_t slot_handle);
+extern void _mg_order_remove(_MgArena* arena_internal, _MgGroup* group, uint64_t key, uint32_t slot_handle);
+extern uint32_t _mg_order_collect(_MgArena* arena_internal, _MgGroup* group, uint64_t* key, uint32_t* handle,
+uint64_t high, uint32_t* handles, bool* more);
+extern void _mg_order_clear(_MgArena* arena_internal, _MgGroup* group);
+extern uint64_t _mg_order_key(_MgGroup* group, uint32_t slot_index); // of a written slot
+extern uint64_t _mg_order_encode(MgFieldType type, const uint8_t* field);
+// both indexes at once: unindex takes a written slot out of them, rebuild refills them from every written slot
+extern void _mg_group_unindex(_MgArena* arena_internal, _MgGroup* group, uint32_t slot_index);
+extern void _mg_group_rebuild_indexes(_MgArena* arena_internal, _MgGroup* group);
+
+// magic_snapshot.c
+extern void _mg_snapshot_unmap(_MgArena* arena_internal);
+extern uint64_t _mg_checksum(const void* data, size_t size);
+
+#if __cplusplus
+} // end extern "C"
+#endif
+
+#endif // MAGIC_ARENA_HEADER
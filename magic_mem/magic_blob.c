@@ -0,0 +1,165 @@
+#include "magic_arena.h"
+#include "magic_mem.h"
+#include "magic_platform.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+static size_t _mg_blob_span(size_t size);
+static void _mg_blob_drop(_MgGroup* group, _MgBlobRegion* region, uint32_t slot_index);
+static void _mg_blob_slide(_MgGroup* group, _MgBlobRegion* region);
+
+MgStatus _mg_blob_write(_MgArena* arena_internal, _MgGroup* group, uint32_t slot_index, const void* data,
+size_t size)
+{
+    _MG_STATUS(group->blob_capacity > 0, MG_ERROR_GROUP_NO_BLOBS);
+    _MG_STATUS(data && size > 0, MG_ERROR_DATA_INVALID);
+
+    _MgBlobRegion* region = _mg_group_blob_region(group);
+    _MgBlobRef* ref       = &_mg_group_blob_refs(group)[slot_index];
+    size_t span           = _mg_blob_span(size);
+
+    _mg_arena_lock(arena_internal, &region->lock);
+
+    // the blob being replaced counts as free, so a rewrite of the same size always fits
+    size_t live = region->head - region->garbage - (ref->size ? _mg_blob_span(ref->size) : 0);
+    bool fits   = span <= group->blob_capacity - live;
+    if (fits)
+    {
+        _mg_blob_drop(group, region, slot_index);
+        if (span > group->blob_capacity - region->head)
+        {
+            _mg_blob_slide(group, region);
+        }
+
+        _MgBlobHeader header = { slot_index, (uint32_t)size };
+        uint8_t* blob        = _mg_blob_region_data(region) + region->head;
+        memcpy(blob, &header, sizeof(header));
+        memcpy(blob + sizeof(header), data, size);
+
+        ref->offset = region->head;
+        ref->size   = (uint32_t)size;
+        region->head += (uint32_t)span;
+    }
+
+    _mg_arena_unlock(arena_internal, &region->lock);
+
+    _MG_STATUS(fits, MG_ERROR_BLOB_REGION_FULL);
+
+    return MG_SUCCESS;
+}
+
+void _mg_blob_release(_MgArena* arena_internal, _MgGroup* group, uint32_t slot_index)
+{
+    _MgBlobRegion* region = _mg_group_blob_region(group);
+
+    _mg_arena_lock(arena_internal, &region->lock);
+    _mg_blob_drop(group, region, slot_index);
+    _mg_arena_unlock(arena_internal, &region->lock);
+}
+
+const uint8_t* _mg_blob_payload(_MgArena* arena_internal, _MgGroup* group, uint32_t slot_index, size_t* size)
+{
+    _MgBlobRegion* region = _mg_group_blob_region(group);
+
+    // other processes may have mapped a shared arena readonly, so its readers never take the lock
+    bool locked = (arena_internal->alloc_kind != _MG_ARENA_ALLOC_SHARED);
+    if (locked)
+    {
+        _mg_arena_lock(arena_internal, &region->lock);
+    }
+    _MgBlobRef ref = _mg_group_blob_refs(group)[slot_index];
+    if (locked)
+    {
+        _mg_arena_unlock(arena_internal, &region->lock);
+    }
+
+    *size = ref.size;
+    return ref.size ? _mg_blob_region_data(region) + ref.offset + sizeof(_MgBlobHeader) : NULL;
+}
+
+void _mg_blob_compact(_MgArena* arena_internal, _MgGroup* group)
+{
+    _MgBlobRegion* region = _mg_group_blob_region(group);
+
+    _mg_arena_lock(arena_internal, &region->lock);
+    _mg_blob_slide(group, region);
+    _mg_arena_unlock(arena_internal, &region->lock);
+}
+
+void _mg_blob_move(_MgArena* arena_internal, _MgGroup* group, uint32_t from, uint32_t to)
+{
+    _MgBlobRegion* region = _mg_group_blob_region(group);
+    _MgBlobRef* refs      = _mg_group_blob_refs(group);
+
+    // the bytes stay where they are, the ref changes slots and the header follows it so compaction still finds it
+    _mg_arena_lock(arena_internal, &region->lock);
+    refs[to]   = refs[from];
+    refs[from] = (_MgBlobRef){ 0, 0 };
+    if (refs[to].size)
+    {
+        _MgBlobHeader header = { to, refs[to].size };
+        memcpy(_mg_blob_region_data(region) + refs[to].offset, &header, sizeof(header));
+    }
+    _mg_arena_unlock(arena_internal, &region->lock);
+}
+
+void _mg_blob_reset(_MgArena* arena_internal, _MgGroup* group)
+{
+    _MgBlobRegion* region = _mg_group_blob_region(group);
+
+    // the region's bytes are left as they are, everything behind the head is overwritten before it is read
+    _mg_arena_lock(arena_internal, &region->lock);
+    memset((void*)_mg_group_blob_refs(group), 0, (size_t)group->slot_count * sizeof(_MgBlobRef));
+    region->head    = 0;
+    region->garbage = 0;
+    _mg_arena_unlock(arena_internal, &region->lock);
+}
+
+static size_t _mg_blob_span(size_t size) // bytes a blob takes up in the region, header included
+{
+    return _MG_ALIGN_UP(sizeof(_MgBlobHeader) + size, _MG_BLOB_ALIGNMENT);
+}
+
+static void _mg_blob_drop(_MgGroup* group, _MgBlobRegion* region, uint32_t slot_index)
+{
+    _MgBlobRef* ref = &_mg_group_blob_refs(group)[slot_index];
+    if (ref->size)
+    {
+        region->garbage += (uint32_t)_mg_blob_span(ref->size); // the bytes stay until the next compaction
+        ref->offset = 0;
+        ref->size   = 0;
+    }
+}
+
+static void _mg_blob_slide(_MgGroup* group, _MgBlobRegion* region)
+{
+    // one pass from the front, every live blob moves down to where the live blobs before it end. a header is live
+    // when its slot still refers to it, a replaced or erased blob's slot refers elsewhere or to nothing.
+    uint8_t* blobs   = _mg_blob_region_data(region);
+    _MgBlobRef* refs = _mg_group_blob_refs(group);
+    uint32_t end     = 0;
+
+    for (uint32_t offset = 0; offset < region->head;)
+    {
+        _MgBlobHeader header;
+        memcpy(&header, blobs + offset, sizeof(header));
+        uint32_t span   = (uint32_t)_mg_blob_span(header.size);
+        _MgBlobRef* ref = &refs[header.slot_index];
+
+        if (ref->size != 0 && ref->offset == offset)
+        {
+            if (end != offset)
+            {
+                memmove(blobs + end, blobs + offset, span);
+                ref->offset = end;
+            }
+            end += span;
+        }
+        offset += span;
+    }
+
+    region->head    = end;
+    region->garbage = 0;
+}
@@ -22,7 +22,28 @@
     CASE(MG_ERROR_HANDLE_WRITE_FAILED, "failed to write handle")            \
     CASE(MG_ERROR_HANDLE_ERASE_FAILED, "failed to erase handle")            \
     CASE(MG_ERROR_HANDLE_INVALID, "handle is invalid")                      \
-    CASE(MG_ERROR_DATA_INVALID, "data is invalid")
+    CASE(MG_ERROR_DATA_INVALID, "data is invalid")                          \
+    CASE(MG_ERROR_THREAD_ATTACH_FAILED, "failed to attach thread")          \
+    CASE(MG_ERROR_THREAD_NOT_ATTACHED, "thread owns no shard")              \
+    CASE(MG_ERROR_SNAPSHOT_IO_FAILED, "failed to access snapshot file")     \
+    CASE(MG_ERROR_SNAPSHOT_INVALID, "snapshot file is invalid")             \
+    CASE(MG_ERROR_LOG_IO_FAILED, "failed to write operation log")           \
+    CASE(MG_ERROR_ARENA_NOT_COW, "arena is not copy on write")              \
+    CASE(MG_ERROR_ARENA_LOGGED, "arena has an open operation log")         \
+    CASE(MG_ERROR_ARENA_SHARED, "not supported on a shared arena")          \
+    CASE(MG_ERROR_ARENA_NOT_FILE, "arena is not file backed")               \
+    CASE(MG_ERROR_FILE_SYNC_FAILED, "failed to sync arena file")            \
+    CASE(MG_ERROR_GROUP_NO_BLOBS, "group has no blob region")               \
+    CASE(MG_ERROR_BLOB_REGION_FULL, "blob region is full")                  \
+    CASE(MG_ERROR_SERIAL_ARENA_FULL, "serial arena is full")                \
+    CASE(MG_ERROR_INDEX_KEY_EXISTS, "key is indexed by another handle")     \
+    CASE(MG_ERROR_GROUP_NOT_INDEXED, "group has no index")                  \
+    CASE(MG_ERROR_GROUP_NOT_ORDERED, "group has no ordered index")          \
+    CASE(MG_ERROR_GROUP_NOT_COLUMNAR, "group has no columns")               \
+    CASE(MG_ERROR_GROUP_COLUMNAR, "group stores its records by column")     \
+    CASE(MG_ERROR_GROUP_NOT_SPLIT, "group has no hot and cold parts")       \
+    CASE(MG_ERROR_ARENA_FILE_BUSY, "arena file is already open")            \
+    CASE(MG_ERROR_ORDER_POOL_FULL, "ordered index has no free node")
 
 void mg_error_print(MgStatus error, const char* location)
 {
@@ -85,6 +85,27 @@ typedef enum MgStatus {
     MG_ERROR_HANDLE_ERASE_FAILED     = -1012,
     MG_ERROR_HANDLE_INVALID          = -1013,
     MG_ERROR_DATA_INVALID            = -1014,
+    MG_ERROR_THREAD_ATTACH_FAILED    = -1015,
+    MG_ERROR_THREAD_NOT_ATTACHED     = -1016,
+    MG_ERROR_SNAPSHOT_IO_FAILED      = -1017,
+    MG_ERROR_SNAPSHOT_INVALID        = -1018,
+    MG_ERROR_LOG_IO_FAILED           = -1019,
+    MG_ERROR_ARENA_NOT_COW           = -1020,
+    MG_ERROR_ARENA_LOGGED            = -1021,
+    MG_ERROR_ARENA_SHARED            = -1022,
+    MG_ERROR_ARENA_NOT_FILE          = -1023,
+    MG_ERROR_FILE_SYNC_FAILED        = -1024,
+    MG_ERROR_GROUP_NO_BLOBS          = -1025,
+    MG_ERROR_BLOB_REGION_FULL        = -1026,
+    MG_ERROR_SERIAL_ARENA_FULL       = -1027,
+    MG_ERROR_INDEX_KEY_EXISTS        = -1028,
+    MG_ERROR_GROUP_NOT_INDEXED       = -1029,
+    MG_ERROR_GROUP_NOT_ORDERED       = -1030,
+    MG_ERROR_GROUP_NOT_COLUMNAR      = -1031,
+    MG_ERROR_GROUP_COLUMNAR          = -1032,
+    MG_ERROR_GROUP_NOT_SPLIT         = -1033,
+    MG_ERROR_ARENA_FILE_BUSY         = -1034,
+    MG_ERROR_ORDER_POOL_FULL         = -1035,
 } MgStatus;
 
 extern void mg_error_print(MgStatus error, const char* location);
@@ -0,0 +1,325 @@
+#include "magic_arena.h"
+#include "magic_log.h"
+#include "magic_mem.h"
+#include "magic_platform.h"
+#include "magic_simd.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+static bool _mg_diff_same_layout(_MgArena* from, _MgArena* to);
+static void _mg_diff_group(_MgGroup* from, _MgGroup* to, MgDiffFn fn, void* ctx, uint8_t* records);
+static void _mg_diff_slot(_MgGroup* from, _MgGroup* to, uint32_t slot_index, MgDiffFn fn, void* ctx,
+uint8_t* records);
+static uint32_t _mg_diff_next(const uint8_t* a, const uint8_t* b, size_t stride, uint32_t begin, uint32_t end);
+static uint32_t _mg_diff_next_live(_MgGroup* from, _MgGroup* to, uint32_t begin, uint32_t end);
+static MgStatus _mg_patch_entry(_MgArena* arena_internal, const MgDiffEntry* entry, bool* relink);
+
+MgStatus mg_arena_diff(MgArena* from, MgArena* to, MgDiffFn fn, void* ctx)
+{
+    _MG_STATUS(from && to, MG_ERROR_ARENA_INVALID);
+    _MG_STATUS(fn, MG_ERROR_DATA_INVALID);
+    _MgArena* from_internal = (_MgArena*)from;
+    _MgArena* to_internal   = (_MgArena*)to;
+    _MG_STATUS(_mg_diff_same_layout(from_internal, to_internal), MG_ERROR_ARENA_DESC_INVALID);
+    _MG_STATUS(!_mg_arena_has_blobs(to_internal), MG_ERROR_ARENA_DESC_INVALID); // blobs only travel in snapshots
+
+    // records of columnar groups are gathered into a pair of buffers, one per side, sized for the widest of them
+    size_t record_size = 0;
+    for (uint32_t i = 0; i < to_internal->group_count; i++)
+    {
+        _MgGroup* group = &_mg_arena_groups(to_internal)[i];
+        record_size     = (group->column_count && group->handle_stride > record_size) ? group->handle_stride
+                                                                                       : record_size;
+    }
+    uint8_t* records = record_size ? (uint8_t*)malloc(2 * record_size) : NULL;
+    _MG_STATUS(!record_size || records, MG_ERROR_ARENA_ALLOC_FAILED);
+
+    // size classes are compared through the handles of their variable size group
+    for (uint32_t i = 0; i < to_internal->group_count; i++)
+    {
+        if (!_mg_arena_groups(to_internal)[i].size_class)
+        {
+            _mg_diff_group(&_mg_arena_groups(from_internal)[i], &_mg_arena_groups(to_internal)[i], fn, ctx, records);
+        }
+    }
+    free(records);
+
+    return MG_SUCCESS;
+}
+
+MgStatus mg_arena_patch(MgArena* arena, const MgDiffEntry* entries, uint32_t entry_count)
+{
+    _MG_STATUS(arena, MG_ERROR_ARENA_INVALID);
+    _MG_STATUS(entries || entry_count == 0, MG_ERROR_DATA_INVALID);
+    _MgArena* arena_internal = (_MgArena*)arena;
+
+    bool* relink = (bool*)calloc(arena_internal->group_count, sizeof(bool));
+    _MG_STATUS(relink, MG_ERROR_ARENA_ALLOC_FAILED);
+
+    // slots are forced to their diffed state like a log replay, free lists of groups that gained or lost
+    // handles are rebuilt once at the end. so are the indexes of touched groups, entries come in slot order and a
+    // key may move to a slot before the one that gives it up.
+    MgStatus status = MG_SUCCESS;
+    for (uint32_t i = 0; i < entry_count && status == MG_SUCCESS; i++)
+    {
+        status = _mg_patch_entry(arena_internal, &entries[i], relink);
+    }
+
+    for (uint32_t i = 0; i < arena_internal->group_count; i++)
+    {
+        if (relink[i])
+        {
+            _mg_group_rebuild_free_lists(&_mg_arena_groups(arena_internal)[i]);
+        }
+        if (relink[i] && _mg_group_has_indexes(&_mg_arena_groups(arena_internal)[i]))
+        {
+            _mg_group_rebuild_indexes(arena_internal, &_mg_arena_groups(arena_internal)[i]);
+        }
+    }
+    free(relink);
+
+    _MG_STATUS(status == MG_SUCCESS, status);
+
+    return MG_SUCCESS;
+}
+
+static bool _mg_diff_same_layout(_MgArena* from, _MgArena* to)
+{
+    bool same = (from->group_count == to->group_count);
+    for (uint32_t i = 0; i < to->group_count && same; i++)
+    {
+        _MgGroup* from_group = &_mg_arena_groups(from)[i];
+        _MgGroup* to_group   = &_mg_arena_groups(to)[i];
+        same = (from_group->handle_type == to_group->handle_type) && (from_group->slot_count == to_group->slot_count) &&
+        (from_group->handle_stride == to_group->handle_stride) && (from_group->column_count == to_group->column_count);
+
+        // the columns are compared cell by cell, so each one has to hold the same field at the same place
+        for (uint32_t j = 0; j < to_group->column_count && same; j++)
+        {
+            const _MgColumn* from_column = &_mg_group_columns(from_group)[j];
+            const _MgColumn* to_column   = &_mg_group_columns(to_group)[j];
+            same = (from_column->offset == to_column->offset) && (from_column->size == to_column->size) &&
+                   (from_column->type == to_column->type) && (from_column->start == to_column->start);
+        }
+    }
+    return same;
+}
+
+static void _mg_diff_group(_MgGroup* from, _MgGroup* to, MgDiffFn fn, void* ctx, uint8_t* records)
+{
+    // the slot records and the payloads are compared as long ranges, the payloads of columnar groups column by
+    // column and the others as one range of records. each cursor holds the next slot where its range differs and
+    // is only searched again once the walk moved past it, so unchanged runs are read once.
+    const uint8_t* from_slots = (const uint8_t*)_mg_group_slots(from);
+    const uint8_t* to_slots   = (const uint8_t*)_mg_group_slots(to);
+    const uint8_t* from_data  = _mg_group_data(from);
+    const uint8_t* to_data    = _mg_group_data(to);
+    uint32_t slot_count       = to->slot_count;
+
+    _MgColumn whole         = { .offset = 0, .size = to->handle_stride };
+    const _MgColumn* ranges = to->column_count ? _mg_group_columns(to) : &whole;
+    uint32_t range_count    = to->column_count ? to->column_count : 1;
+
+    // a variable size record is only its ref, and a rewrite that stays in its class slot leaves the ref as it was.
+    // so every slot live on both sides is visited too, and compared by the bytes in its class slot.
+    bool variable      = (to->class_count > 0);
+    uint32_t next_live = variable ? _mg_diff_next_live(from, to, 0, slot_count) : slot_count;
+
+    uint32_t next_slot = _mg_diff_next(from_slots, to_slots, sizeof(_MgSlot), 0, slot_count);
+    uint32_t next_data[MG_FIELD_COUNT_MAX];
+    for (uint32_t i = 0; i < range_count; i++)
+    {
+        next_data[i] = _mg_diff_next(from_data + ranges[i].start, to_data + ranges[i].start, ranges[i].size, 0,
+        slot_count);
+    }
+
+    for (;;)
+    {
+        uint32_t slot_index = next_slot < next_live ? next_slot : next_live;
+        for (uint32_t i = 0; i < range_count; i++)
+        {
+            slot_index = next_data[i] < slot_index ? next_data[i] : slot_index;
+        }
+        if (slot_index >= slot_count)
+        {
+            break;
+        }
+
+        _mg_diff_slot(from, to, slot_index, fn, ctx, records);
+
+        if (next_slot == slot_index)
+        {
+            next_slot = _mg_diff_next(from_slots, to_slots, sizeof(_MgSlot), slot_index + 1, slot_count);
+        }
+        if (next_live == slot_index)
+        {
+            next_live = _mg_diff_next_live(from, to, slot_index + 1, slot_count);
+        }
+        for (uint32_t i = 0; i < range_count; i++)
+        {
+            if (next_data[i] == slot_index)
+            {
+                next_data[i] = _mg_diff_next(from_data + ranges[i].start, to_data + ranges[i].start, ranges[i].size,
+                slot_index + 1, slot_count);
+            }
+        }
+    }
+}
+
+static void _mg_diff_slot(_MgGroup* from, _MgGroup* to, uint32_t slot_index, MgDiffFn fn, void* ctx,
+uint8_t* records)
+{
+    // only written handles count, the same set mg_group_foreach visits. free slots may differ in their links.
+    _MgSlot* from_slot = &_mg_group_slots(from)[slot_index];
+    _MgSlot* to_slot   = &_mg_group_slots(to)[slot_index];
+    bool was_live      = (from_slot->status == _MG_SLOT_STATUS_VALID_WRITE);
+    bool is_live       = (to_slot->status == _MG_SLOT_STATUS_VALID_WRITE);
+
+    // variable size payloads are compared by content, the same bytes may sit in different class slots
+    size_t from_size         = 0;
+    size_t to_size           = 0;
+    const uint8_t* from_data = was_live ? _mg_group_payload(from, slot_index, &from_size) : NULL;
+    const uint8_t* to_data   = is_live ? _mg_group_payload(to, slot_index, &to_size) : NULL;
+    if (to->column_count)
+    {
+        from_data = was_live ? records : NULL;
+        to_data   = is_live ? records + to->handle_stride : NULL;
+        if (was_live)
+        {
+            _mg_group_load(from, slot_index, records);
+        }
+        if (is_live)
+        {
+            _mg_group_load(to, slot_index, records + to->handle_stride);
+        }
+    }
+
+    if (was_live && is_live && from_slot->generation == to_slot->generation)
+    {
+        if (from_size != to_size || _mg_simd_mismatch(from_data, to_data, to_size) != to_size)
+        {
+            MgDiffEntry entry = { MG_DIFF_MODIFIED, { to_slot->handle, to->handle_type }, to_data, to_size };
+            fn(&entry, ctx);
+        }
+        return;
+    }
+
+    // a slot that was erased and created again in between is both: the old handle is gone, the new one is new
+    if (was_live)
+    {
+        MgDiffEntry entry = { MG_DIFF_ERASED, { from_slot->handle, from->handle_type }, NULL, 0 };
+        fn(&entry, ctx);
+    }
+    if (is_live)
+    {
+        MgDiffEntry entry = { MG_DIFF_CREATED, { to_slot->handle, to->handle_type }, to_data, to_size };
+        fn(&entry, ctx);
+    }
+}
+
+static uint32_t _mg_diff_next(const uint8_t* a, const uint8_t* b, size_t stride, uint32_t begin, uint32_t end)
+{
+    size_t offset = (size_t)begin * stride;
+    size_t same   = _mg_simd_mismatch(a + offset, b + offset, (size_t)(end - begin) * stride);
+    return begin + (uint32_t)(same / stride);
+}
+
+static uint32_t _mg_diff_next_live(_MgGroup* from, _MgGroup* to, uint32_t begin, uint32_t end)
+{
+    _MgSlot* from_slots = _mg_group_slots(from);
+    _MgSlot* to_slots   = _mg_group_slots(to);
+
+    uint32_t slot_index = begin;
+    while (slot_index < end && (from_slots[slot_index].status != _MG_SLOT_STATUS_VALID_WRITE ||
+                                   to_slots[slot_index].status != _MG_SLOT_STATUS_VALID_WRITE))
+    {
+        slot_index++;
+    }
+    return slot_index;
+}
+
+static MgStatus _mg_patch_entry(_MgArena* arena_internal, const MgDiffEntry* entry, bool* relink)
+{
+    _MgGroup* group = _mg_group_query(arena_internal, entry->handle.type);
+    _MG_STATUS(group, MG_ERROR_GROUP_QUERY_FAILED);
+
+    uint32_t handle     = entry->handle.slot_handle;
+    uint32_t slot_index = MG_DECODE_INDEX(handle);
+    _MG_STATUS(slot_index != 0 && slot_index < group->slot_count, MG_ERROR_HANDLE_INVALID);
+
+    bool has_data = (entry->kind == MG_DIFF_CREATED || entry->kind == MG_DIFF_MODIFIED);
+    _MG_STATUS(!has_data || (entry->data && entry->data_size <= _mg_group_max_size(group)), MG_ERROR_DATA_INVALID);
+    _MG_STATUS(!has_data || entry->data_size >= _mg_group_keys_end(group), MG_ERROR_DATA_INVALID);
+
+    _MgSlot* slot        = &_mg_group_slots(group)[slot_index];
+    uint32_t group_index = (uint32_t)(group - _mg_arena_groups(arena_internal));
+    bool live            = (slot->status == _MG_SLOT_STATUS_VALID_WRITE);
+
+    switch (entry->kind)
+    {
+    case MG_DIFF_CREATED:
+        _MG_STATUS(!live, MG_ERROR_HANDLE_INVALID);
+        slot->handle        = handle;
+        slot->generation    = MG_DECODE_GENERATION(handle);
+        relink[group_index] = true;
+        break;
+
+    case MG_DIFF_MODIFIED:
+        _MG_STATUS(live && slot->handle == handle, MG_ERROR_HANDLE_INVALID);
+        relink[group_index] |= _mg_group_has_indexes(group); // its keys may have changed
+        break;
+
+    case MG_DIFF_ERASED:
+        _MG_STATUS(live && slot->handle == handle, MG_ERROR_HANDLE_INVALID);
+        if (group->class_count)
+        {
+            _mg_variable_release(arena_internal, group, slot_index);
+        }
+        if (group->blob_capacity)
+        {
+            _mg_blob_release(arena_internal, group, slot_index);
+        }
+        _mg_group_store(group, slot_index, NULL, 0);
+        slot->handle        = 0;
+        slot->status        = _MG_SLOT_STATUS_FREE;
+        relink[group_index] = true;
+        break;
+
+    default: _MG_STATUS(false, MG_ERROR_DATA_INVALID);
+    }
+
+    if (has_data && group->class_count)
+    {
+        if (entry->kind == MG_DIFF_CREATED)
+        {
+            slot->status = _MG_SLOT_STATUS_VALID_ALLOC;
+        }
+        MgStatus status = _mg_variable_write(arena_internal, group, slot_index, entry->data, entry->data_size);
+        _MG_STATUS(status == MG_SUCCESS, status);
+    }
+    else if (has_data)
+    {
+        _mg_group_store(group, slot_index, entry->data, entry->data_size);
+        _mg_slot_publish(slot, _MG_SLOT_STATUS_VALID_WRITE);
+    }
+    _mg_group_mark_dirty(arena_internal, group, slot_index);
+
+    // a patched standby with a log stays recoverable like any other arena
+    if (arena_internal->log || arena_internal->publisher)
+    {
+        bool logged = true;
+        if (entry->kind == MG_DIFF_CREATED)
+        {
+            logged = _mg_arena_log_append(arena_internal, _MG_LOG_OP_CREATE, entry->handle.type, handle, NULL, 0);
+        }
+        _MgLogOp op = has_data ? _MG_LOG_OP_WRITE : _MG_LOG_OP_ERASE;
+        logged      = logged && _mg_arena_log_append(arena_internal, op, entry->handle.type, handle, entry->data,
+        has_data ? (uint32_t)entry->data_size : 0);
+        _MG_STATUS(logged, MG_ERROR_LOG_IO_FAILED);
+    }
+
+    return MG_SUCCESS;
+}
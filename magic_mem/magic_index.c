@@ -0,0 +1,741 @@
+#include "magic_arena.h"
+#include "magic_mem.h"
+#include "magic_platform.h"
+#include "magic_simd.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+enum {
+    _MG_INDEX_EMPTY   = 0x80, // never held a key, ends every probe that reaches its group
+    _MG_INDEX_DELETED = 0xfe, // held a key, probes walk past it. full entries hold 7 hash bits, the top bit clear
+    _MG_INDEX_NONE    = UINT32_MAX,
+    _MG_ORDER_HALF    = _MG_ORDER_FANOUT / 2, // fewest entries of a leaf other than the root
+};
+
+static uint64_t _mg_index_hash(uint64_t key);
+static uint8_t* _mg_index_ctrl(_MgIndex* index);
+static _MgIndexEntry* _mg_index_entries(_MgIndex* index, uint32_t capacity);
+static uint32_t _mg_index_lookup(_MgGroup* group, _MgIndex* index, uint64_t key);
+static uint32_t _mg_index_free_position(_MgGroup* group, _MgIndex* index, uint64_t hash);
+static void _mg_index_put(_MgGroup* group, _MgIndex* index, uint64_t key, uint32_t slot_handle);
+static void _mg_index_erase(_MgIndex* index, uint32_t position);
+static void _mg_index_rehash(_MgGroup* group, _MgIndex* index);
+static _MgOrderNode* _mg_order_node(_MgOrder* order, uint32_t id);
+static bool _mg_order_less(uint64_t key_a, uint32_t handle_a, uint64_t key_b, uint32_t handle_b);
+static uint32_t _mg_order_child(_MgOrderNode* node, uint64_t key, uint32_t handle);
+static uint32_t _mg_order_position(_MgOrderNode* leaf, uint64_t key, uint32_t handle);
+static bool _mg_order_has_room(_MgOrder* order, uint32_t capacity, uint32_t needed);
+static uint32_t _mg_order_alloc(_MgOrder* order);
+static void _mg_order_free(_MgOrder* order, uint32_t id);
+static bool _mg_order_put(_MgOrder* order, uint32_t capacity, uint64_t key, uint32_t handle);
+static void _mg_order_split(_MgOrder* order, _MgOrderNode* parent, uint32_t child, bool leaf);
+static void _mg_order_erase(_MgOrder* order, uint64_t key, uint32_t handle);
+static void _mg_order_rebalance(_MgOrder* order, _MgOrderNode* parent, uint32_t child, bool leaf);
+static void _mg_order_unlink(_MgOrderNode* node, uint32_t separator);
+
+bool _mg_index_insert(_MgArena* arena_internal, _MgGroup* group, uint64_t key, uint32_t slot_handle)
+{
+    _MgIndex* index = _mg_group_index(group);
+
+    _mg_arena_lock(arena_internal, &index->lock);
+    bool inserted = (_mg_index_lookup(group, index, key) == _MG_INDEX_NONE);
+    if (inserted)
+    {
+        _mg_index_put(group, index, key, slot_handle);
+    }
+    _mg_arena_unlock(arena_internal, &index->lock);
+
+    return inserted;
+}
+
+bool _mg_index_replace(_MgArena* arena_internal, _MgGroup* group, uint64_t old_key, uint64_t new_key,
+uint32_t slot_handle)
+{
+    _MgIndex* index = _mg_group_index(group);
+
+    _mg_arena_lock(arena_internal, &index->lock);
+    bool replaced = (old_key == new_key || _mg_index_lookup(group, index, new_key) == _MG_INDEX_NONE);
+    if (replaced && old_key != new_key)
+    {
+        uint32_t position = _mg_index_lookup(group, index, old_key);
+        if (position != _MG_INDEX_NONE)
+        {
+            _mg_index_erase(index, position);
+        }
+        _mg_index_put(group, index, new_key, slot_handle);
+    }
+    _mg_arena_unlock(arena_internal, &index->lock);
+
+    return replaced;
+}
+
+void _mg_index_remove(_MgArena* arena_internal, _MgGroup* group, uint64_t key)
+{
+    _MgIndex* index = _mg_group_index(group);
+
+    _mg_arena_lock(arena_internal, &index->lock);
+    uint32_t position = _mg_index_lookup(group, index, key);
+    if (position != _MG_INDEX_NONE)
+    {
+        _mg_index_erase(index, position);
+    }
+    _mg_arena_unlock(arena_internal, &index->lock);
+}
+
+uint32_t _mg_index_find(_MgArena* arena_internal, _MgGroup* group, uint64_t key)
+{
+    _MgIndex* index = _mg_group_index(group);
+
+    // shared arenas have no indexes, their readers could not take the lock
+    _mg_arena_lock(arena_internal, &index->lock);
+    uint32_t position    = _mg_index_lookup(group, index, key);
+    uint32_t slot_handle = 0;
+    if (position != _MG_INDEX_NONE)
+    {
+        slot_handle = _mg_index_entries(index, group->index_capacity)[position].slot_handle;
+    }
+    _mg_arena_unlock(arena_internal, &index->lock);
+
+    return slot_handle;
+}
+
+void _mg_index_clear(_MgArena* arena_internal, _MgGroup* group)
+{
+    _MgIndex* index = _mg_group_index(group);
+
+    // stale entries are never read, the control bytes decide what is in the table
+    _mg_arena_lock(arena_internal, &index->lock);
+    memset(_mg_index_ctrl(index), _MG_INDEX_EMPTY, group->index_capacity);
+    index->size       = 0;
+    index->tombstones = 0;
+    _mg_arena_unlock(arena_internal, &index->lock);
+}
+
+uint64_t _mg_index_key(_MgGroup* group, uint32_t slot_index)
+{
+    uint64_t key;
+    memcpy(&key, _mg_group_payload(group, slot_index, NULL) + group->key_offset, sizeof(key));
+    return key;
+}
+
+bool _mg_order_insert(_MgArena* arena_internal, _MgGroup* group, uint64_t key, uint32_t slot_handle)
+{
+    _MgOrder* order = _mg_group_order(group);
+
+    _mg_arena_lock(arena_internal, &order->lock);
+    bool inserted = _mg_order_put(order, group->order_capacity, key, slot_handle);
+    _mg_arena_unlock(arena_internal, &order->lock);
+
+    return inserted;
+}
+
+void _mg_order_remove(_MgArena* arena_internal, _MgGroup* group, uint64_t key, uint32_t slot_handle)
+{
+    _MgOrder* order = _mg_group_order(group);
+
+    _mg_arena_lock(arena_internal, &order->lock);
+    _mg_order_erase(order, key, slot_handle);
+    _mg_arena_unlock(arena_internal, &order->lock);
+}
+
+uint32_t _mg_order_collect(_MgArena* arena_internal, _MgGroup* group, uint64_t* key, uint32_t* handle,
+uint64_t high, uint32_t* handles, bool* more)
+{
+    _MgOrder* order = _mg_group_order(group);
+    uint32_t count  = 0;
+
+    // shared arenas have no ordered indexes, their readers could not take the lock
+    _mg_arena_lock(arena_internal, &order->lock);
+
+    // down to the leaf that holds the first pair at or after the start, then along the leaf chain
+    uint32_t id = order->root;
+    for (uint32_t level = order->height; id && level > 0; level--)
+    {
+        _MgOrderNode* node = _mg_order_node(order, id);
+        id                 = node->children[_mg_order_child(node, *key, *handle)];
+    }
+
+    uint32_t position = id ? _mg_order_position(_mg_order_node(order, id), *key, *handle) : 0;
+    *more             = false;
+    while (id && count < _MG_ORDER_BATCH)
+    {
+        _MgOrderNode* leaf = _mg_order_node(order, id);
+        if (position == leaf->count)
+        {
+            id       = leaf->next;
+            position = 0;
+            continue;
+        }
+        if (leaf->keys[position] > high)
+        {
+            break;
+        }
+
+        *key             = leaf->keys[position];
+        *handle          = leaf->handles[position];
+        handles[count++] = leaf->handles[position];
+        *more            = (count == _MG_ORDER_BATCH);
+        position++;
+    }
+
+    _mg_arena_unlock(arena_internal, &order->lock);
+
+    // the next walk starts right after the last pair handed out
+    if (*more)
+    {
+        *more   = (*handle != UINT32_MAX || *key != UINT64_MAX);
+        *key    = *handle == UINT32_MAX ? *key + 1 : *key;
+        *handle = *handle + 1;
+    }
+    return count;
+}
+
+void _mg_order_clear(_MgArena* arena_internal, _MgGroup* group)
+{
+    _MgOrder* order = _mg_group_order(group);
+
+    // the pool is handed out from the start again, nodes are cleared as they are taken
+    _mg_arena_lock(arena_internal, &order->lock);
+    order->root      = 0;
+    order->height    = 0;
+    order->size      = 0;
+    order->used      = 0;
+    order->free_head = 0;
+    _mg_arena_unlock(arena_internal, &order->lock);
+}
+
+uint64_t _mg_order_key(_MgGroup* group, uint32_t slot_index)
+{
+    return _mg_order_encode(group->order_type, _mg_group_payload(group, slot_index, NULL) + group->order_offset);
+}
+
+uint64_t _mg_order_encode(MgFieldType type, const uint8_t* field)
+{
+    // signed values get their sign bit flipped, negative floats all their bits, so unsigned order is value order
+    uint32_t bits32 = 0;
+    uint64_t bits64 = 0;
+    if (_mg_field_size(type) == sizeof(bits32))
+    {
+        memcpy(&bits32, field, sizeof(bits32));
+    }
+    else
+    {
+        memcpy(&bits64, field, sizeof(bits64));
+    }
+
+    switch (type)
+    {
+    case MG_FIELD_U32: return bits32;
+    case MG_FIELD_I32: return bits32 ^ 0x80000000u;
+    case MG_FIELD_I64: return bits64 ^ 0x8000000000000000ull;
+    case MG_FIELD_F32: return (bits32 & 0x80000000u) ? (uint32_t)~bits32 : bits32 | 0x80000000u;
+    case MG_FIELD_F64: return (bits64 & 0x8000000000000000ull) ? ~bits64 : bits64 | 0x8000000000000000ull;
+    default: return bits64;
+    }
+}
+
+void _mg_group_unindex(_MgArena* arena_internal, _MgGroup* group, uint32_t slot_index)
+{
+    if (group->index_capacity)
+    {
+        _mg_index_remove(arena_internal, group, _mg_index_key(group, slot_index));
+    }
+    if (group->order_capacity)
+    {
+        uint32_t slot_handle = _mg_group_slots(group)[slot_index].handle;
+        _mg_order_remove(arena_internal, group, _mg_order_key(group, slot_index), slot_handle);
+    }
+}
+
+void _mg_group_rebuild_indexes(_MgArena* arena_internal, _MgGroup* group)
+{
+    if (group->index_capacity)
+    {
+        _mg_index_clear(arena_internal, group);
+    }
+    if (group->order_capacity)
+    {
+        _mg_order_clear(arena_internal, group);
+    }
+
+    _MgSlot* slots = _mg_group_slots(group);
+    for (uint32_t i = 1; i < group->slot_count; i++)
+    {
+        if (slots[i].status != _MG_SLOT_STATUS_VALID_WRITE)
+        {
+            continue;
+        }
+
+        // written before keys were checked, the first handle with a key keeps it
+        if (group->index_capacity)
+        {
+            _mg_index_insert(arena_internal, group, _mg_index_key(group, i), slots[i].handle);
+        }
+        if (group->order_capacity)
+        {
+            _mg_order_insert(arena_internal, group, _mg_order_key(group, i), slots[i].handle);
+        }
+    }
+}
+
+static uint64_t _mg_index_hash(uint64_t key)
+{
+    // murmur3 finalizer. keys are often sequential ids, every bit of them has to reach both halves of the hash
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdull;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ull;
+    key ^= key >> 33;
+    return key;
+}
+
+static uint8_t* _mg_index_ctrl(_MgIndex* index) // right behind the cache line aligned header
+{
+    return (uint8_t*)(index + 1);
+}
+
+static _MgIndexEntry* _mg_index_entries(_MgIndex* index, uint32_t capacity)
+{
+    return (_MgIndexEntry*)(_mg_index_ctrl(index) + capacity); // capacity is a multiple of the group size
+}
+
+static uint32_t _mg_index_lookup(_MgGroup* group, _MgIndex* index, uint64_t key)
+{
+    uint8_t* ctrl          = _mg_index_ctrl(index);
+    _MgIndexEntry* entries = _mg_index_entries(index, group->index_capacity);
+    uint64_t hash          = _mg_index_hash(key);
+    uint32_t group_mask    = group->index_capacity / _MG_INDEX_GROUP_SIZE - 1;
+    uint32_t probe         = (uint32_t)(hash >> 7) & group_mask;
+
+    // triangular steps visit every group once, and the table never fills up, so some group has an empty byte
+    for (uint32_t step = 1;; step++)
+    {
+        const uint8_t* bytes = ctrl + (size_t)probe * _MG_INDEX_GROUP_SIZE;
+        for (uint32_t match = _mg_simd_match16(bytes, (uint8_t)(hash & 0x7f)); match; match &= match - 1)
+        {
+            uint32_t position = probe * _MG_INDEX_GROUP_SIZE + (uint32_t)_mg_ctz_u64(match);
+            if (entries[position].key == key)
+            {
+                return position;
+            }
+        }
+
+        if (_mg_simd_match16(bytes, _MG_INDEX_EMPTY))
+        {
+            return _MG_INDEX_NONE;
+        }
+        probe = (probe + step) & group_mask;
+    }
+}
+
+static uint32_t _mg_index_free_position(_MgGroup* group, _MgIndex* index, uint64_t hash)
+{
+    // first empty or deleted byte on the key's probe sequence, both have the top bit set
+    uint8_t* ctrl       = _mg_index_ctrl(index);
+    uint32_t group_mask = group->index_capacity / _MG_INDEX_GROUP_SIZE - 1;
+    uint32_t probe      = (uint32_t)(hash >> 7) & group_mask;
+
+    for (uint32_t step = 1;; step++)
+    {
+        const uint8_t* bytes = ctrl + (size_t)probe * _MG_INDEX_GROUP_SIZE;
+        uint32_t open        = _mg_simd_match16(bytes, _MG_INDEX_EMPTY) | _mg_simd_match16(bytes, _MG_INDEX_DELETED);
+        if (open)
+        {
+            return probe * _MG_INDEX_GROUP_SIZE + (uint32_t)_mg_ctz_u64(open);
+        }
+        probe = (probe + step) & group_mask;
+    }
+}
+
+static void _mg_index_put(_MgGroup* group, _MgIndex* index, uint64_t key, uint32_t slot_handle)
+{
+    // a group never holds more keys than handles, so once the tombstones are gone there is room again
+    uint32_t capacity = group->index_capacity;
+    if (index->size + index->tombstones + 1 > capacity - capacity / 8)
+    {
+        _mg_index_rehash(group, index);
+    }
+
+    uint8_t* ctrl     = _mg_index_ctrl(index);
+    uint64_t hash     = _mg_index_hash(key);
+    uint32_t position = _mg_index_free_position(group, index, hash);
+    index->tombstones -= (ctrl[position] == _MG_INDEX_DELETED);
+    index->size++;
+
+    ctrl[position]                               = (uint8_t)(hash & 0x7f);
+    _mg_index_entries(index, capacity)[position] = (_MgIndexEntry){ key, slot_handle, 0 };
+}
+
+static void _mg_index_erase(_MgIndex* index, uint32_t position)
+{
+    // a group with an empty byte was never full, so no probe ever went past it and the entry can be empty again.
+    // in a group that filled up once it has to stay a tombstone, keys further along the probe depend on it.
+    uint8_t* ctrl = _mg_index_ctrl(index);
+    bool empty    = _mg_simd_match16(ctrl + position / _MG_INDEX_GROUP_SIZE * _MG_INDEX_GROUP_SIZE, _MG_INDEX_EMPTY);
+
+    ctrl[position] = empty ? _MG_INDEX_EMPTY : _MG_INDEX_DELETED;
+    index->tombstones += !empty;
+    index->size--;
+}
+
+static void _mg_index_rehash(_MgGroup* group, _MgIndex* index)
+{
+    // in place, the table is part of the arena and cannot grow. tombstones turn empty and every key is marked
+    // deleted, meaning not placed yet. each marked key then goes to the first empty or marked byte of its probe:
+    // its own group keeps it where it is, an empty byte takes it, a marked one swaps with it and the key that
+    // comes back is placed next.
+    uint8_t* ctrl          = _mg_index_ctrl(index);
+    _MgIndexEntry* entries = _mg_index_entries(index, group->index_capacity);
+
+    for (uint32_t i = 0; i < group->index_capacity; i++)
+    {
+        ctrl[i] = (ctrl[i] & 0x80) ? _MG_INDEX_EMPTY : _MG_INDEX_DELETED;
+    }
+
+    for (uint32_t i = 0; i < group->index_capacity; i++)
+    {
+        if (ctrl[i] != _MG_INDEX_DELETED)
+        {
+            continue;
+        }
+
+        uint64_t hash   = _mg_index_hash(entries[i].key);
+        uint32_t target = _mg_index_free_position(group, index, hash);
+        if (target / _MG_INDEX_GROUP_SIZE == i / _MG_INDEX_GROUP_SIZE)
+        {
+            ctrl[i] = (uint8_t)(hash & 0x7f);
+            continue;
+        }
+
+        if (ctrl[target] == _MG_INDEX_EMPTY)
+        {
+            entries[target] = entries[i];
+            ctrl[i]         = _MG_INDEX_EMPTY;
+        }
+        else
+        {
+            _MgIndexEntry waiting = entries[target];
+            entries[target]       = entries[i];
+            entries[i]            = waiting;
+            i--; // the key swapped in is placed on the next round
+        }
+        ctrl[target] = (uint8_t)(hash & 0x7f);
+    }
+
+    index->tombstones = 0;
+}
+
+static _MgOrderNode* _mg_order_node(_MgOrder* order, uint32_t id)
+{
+    return (_MgOrderNode*)(order + 1) + (id - 1);
+}
+
+static bool _mg_order_less(uint64_t key_a, uint32_t handle_a, uint64_t key_b, uint32_t handle_b)
+{
+    return key_a < key_b || (key_a == key_b && handle_a < handle_b);
+}
+
+static uint32_t _mg_order_child(_MgOrderNode* node, uint64_t key, uint32_t handle)
+{
+    // separator i is the smallest pair under child i + 1, so the child is the count of separators at or below
+    uint32_t low  = 0;
+    uint32_t high = node->count;
+    while (low < high)
+    {
+        uint32_t middle = (low + high) / 2;
+        if (_mg_order_less(key, handle, node->keys[middle], node->handles[middle]))
+        {
+            high = middle;
+        }
+        else
+        {
+            low = middle + 1;
+        }
+    }
+    return low;
+}
+
+static uint32_t _mg_order_position(_MgOrderNode* leaf, uint64_t key, uint32_t handle) // first pair at or after
+{
+    uint32_t low  = 0;
+    uint32_t high = leaf->count;
+    while (low < high)
+    {
+        uint32_t middle = (low + high) / 2;
+        if (_mg_order_less(leaf->keys[middle], leaf->handles[middle], key, handle))
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+static bool _mg_order_has_room(_MgOrder* order, uint32_t capacity, uint32_t needed)
+{
+    // freed nodes first, the free list is only walked as far as it has to
+    uint32_t available = capacity - order->used;
+    for (uint32_t id = order->free_head; id && available < needed; id = _mg_order_node(order, id)->next)
+    {
+        available++;
+    }
+    return available >= needed;
+}
+
+static uint32_t _mg_order_alloc(_MgOrder* order)
+{
+    uint32_t id = order->free_head;
+    if (id)
+    {
+        order->free_head = _mg_order_node(order, id)->next;
+    }
+    else
+    {
+        id = ++order->used; // put checked that the pool has room for every node it takes
+    }
+
+    _MgOrderNode* node = _mg_order_node(order, id);
+    node->count        = 0;
+    node->next         = 0;
+    return id;
+}
+
+static void _mg_order_free(_MgOrder* order, uint32_t id)
+{
+    _mg_order_node(order, id)->next = order->free_head;
+    order->free_head                = id;
+}
+
+static bool _mg_order_put(_MgOrder* order, uint32_t capacity, uint64_t key, uint32_t handle)
+{
+    // a new root and its split, then a split on every level below. checked before anything changes, so a pool
+    // that ran out leaves the tree as it was.
+    if (!_mg_order_has_room(order, capacity, order->height + 2))
+    {
+        return false;
+    }
+
+    if (!order->root)
+    {
+        order->root   = _mg_order_alloc(order);
+        order->height = 0;
+    }
+
+    // full nodes are split on the way down, so a split never has to go back up. a full root grows the tree.
+    if (_mg_order_node(order, order->root)->count == _MG_ORDER_FANOUT)
+    {
+        uint32_t root       = _mg_order_alloc(order);
+        _MgOrderNode* above = _mg_order_node(order, root);
+        above->children[0]  = order->root;
+        _mg_order_split(order, above, 0, order->height == 0);
+        order->root = root;
+        order->height++;
+    }
+
+    _MgOrderNode* node = _mg_order_node(order, order->root);
+    for (uint32_t level = order->height; level > 0; level--)
+    {
+        uint32_t child = _mg_order_child(node, key, handle);
+        if (_mg_order_node(order, node->children[child])->count == _MG_ORDER_FANOUT)
+        {
+            _mg_order_split(order, node, child, level == 1);
+            child += !_mg_order_less(key, handle, node->keys[child], node->handles[child]);
+        }
+        node = _mg_order_node(order, node->children[child]);
+    }
+
+    uint32_t position = _mg_order_position(node, key, handle);
+    uint32_t moved    = node->count - position;
+    memmove(&node->keys[position + 1], &node->keys[position], moved * sizeof(uint64_t));
+    memmove(&node->handles[position + 1], &node->handles[position], moved * sizeof(uint32_t));
+    node->keys[position]    = key;
+    node->handles[position] = handle;
+    node->count++;
+    order->size++;
+
+    return true;
+}
+
+static void _mg_order_split(_MgOrder* order, _MgOrderNode* parent, uint32_t child, bool leaf)
+{
+    uint32_t right_id   = _mg_order_alloc(order);
+    _MgOrderNode* left  = _mg_order_node(order, parent->children[child]);
+    _MgOrderNode* right = _mg_order_node(order, right_id);
+    uint64_t key;
+    uint32_t handle;
+
+    if (leaf)
+    {
+        // the upper half moves right, its first pair is also the separator
+        right->count = _MG_ORDER_FANOUT - _MG_ORDER_HALF;
+        memcpy(right->keys, &left->keys[_MG_ORDER_HALF], right->count * sizeof(uint64_t));
+        memcpy(right->handles, &left->handles[_MG_ORDER_HALF], right->count * sizeof(uint32_t));
+        right->next = left->next;
+        left->next  = right_id;
+        key         = right->keys[0];
+        handle      = right->handles[0];
+    }
+    else
+    {
+        // the middle separator moves up to the parent, the ones above it go right with their children
+        key          = left->keys[_MG_ORDER_HALF];
+        handle       = left->handles[_MG_ORDER_HALF];
+        right->count = _MG_ORDER_FANOUT - _MG_ORDER_HALF - 1;
+        memcpy(right->keys, &left->keys[_MG_ORDER_HALF + 1], right->count * sizeof(uint64_t));
+        memcpy(right->handles, &left->handles[_MG_ORDER_HALF + 1], right->count * sizeof(uint32_t));
+        memcpy(right->children, &left->children[_MG_ORDER_HALF + 1], (right->count + 1) * sizeof(uint32_t));
+    }
+    left->count = _MG_ORDER_HALF;
+
+    uint32_t moved = parent->count - child;
+    memmove(&parent->keys[child + 1], &parent->keys[child], moved * sizeof(uint64_t));
+    memmove(&parent->handles[child + 1], &parent->handles[child], moved * sizeof(uint32_t));
+    memmove(&parent->children[child + 2], &parent->children[child + 1], moved * sizeof(uint32_t));
+    parent->keys[child]         = key;
+    parent->handles[child]      = handle;
+    parent->children[child + 1] = right_id;
+    parent->count++;
+}
+
+static void _mg_order_erase(_MgOrder* order, uint64_t key, uint32_t handle)
+{
+    if (!order->root)
+    {
+        return;
+    }
+
+    // the inner nodes on the way down and the child taken at each, for the rebalancing on the way back up
+    _MgOrderNode* path[_MG_ORDER_DEPTH_MAX];
+    uint32_t taken[_MG_ORDER_DEPTH_MAX];
+    _MgOrderNode* node = _mg_order_node(order, order->root);
+    for (uint32_t level = 0; level < order->height; level++)
+    {
+        path[level]  = node;
+        taken[level] = _mg_order_child(node, key, handle);
+        node         = _mg_order_node(order, node->children[taken[level]]);
+    }
+
+    uint32_t position = _mg_order_position(node, key, handle);
+    if (position == node->count || node->keys[position] != key || node->handles[position] != handle)
+    {
+        return;
+    }
+
+    uint32_t moved = node->count - position - 1;
+    memmove(&node->keys[position], &node->keys[position + 1], moved * sizeof(uint64_t));
+    memmove(&node->handles[position], &node->handles[position + 1], moved * sizeof(uint32_t));
+    node->count--;
+    order->size--;
+
+    // leaves keep at least half their pairs, inner nodes half their children, the root anything
+    for (uint32_t level = order->height; level > 0; level--)
+    {
+        bool leaf = (level == order->height);
+        if (node->count >= (leaf ? _MG_ORDER_HALF : _MG_ORDER_HALF - 1))
+        {
+            break;
+        }
+        _mg_order_rebalance(order, path[level - 1], taken[level - 1], leaf);
+        node = path[level - 1];
+    }
+
+    _MgOrderNode* root = _mg_order_node(order, order->root);
+    if (root->count == 0)
+    {
+        uint32_t emptied = order->root;
+        order->root      = order->height ? root->children[0] : 0; // an inner root down to one child hands over
+        order->height -= (order->height > 0);
+        _mg_order_free(order, emptied);
+    }
+}
+
+static void _mg_order_rebalance(_MgOrder* order, _MgOrderNode* parent, uint32_t child, bool leaf)
+{
+    // the short child and a sibling either fit into one node, or the sibling lends it one pair through the parent
+    uint32_t separator  = child > 0 ? child - 1 : 0;
+    uint32_t right_id   = parent->children[separator + 1];
+    _MgOrderNode* left  = _mg_order_node(order, parent->children[separator]);
+    _MgOrderNode* right = _mg_order_node(order, right_id);
+    uint32_t pulled     = leaf ? 0 : 1; // inner nodes take the separator between them along
+
+    if (left->count + pulled + right->count <= _MG_ORDER_FANOUT)
+    {
+        if (!leaf)
+        {
+            left->keys[left->count]    = parent->keys[separator];
+            left->handles[left->count] = parent->handles[separator];
+            memcpy(&left->children[left->count + 1], right->children, (right->count + 1) * sizeof(uint32_t));
+        }
+        memcpy(&left->keys[left->count + pulled], right->keys, right->count * sizeof(uint64_t));
+        memcpy(&left->handles[left->count + pulled], right->handles, right->count * sizeof(uint32_t));
+        left->count += pulled + right->count;
+        left->next = leaf ? right->next : 0;
+
+        _mg_order_unlink(parent, separator);
+        _mg_order_free(order, right_id);
+        return;
+    }
+
+    if (separator == child) // the short one is on the left, it takes the right's first pair
+    {
+        if (leaf)
+        {
+            left->keys[left->count]    = right->keys[0];
+            left->handles[left->count] = right->handles[0];
+        }
+        else
+        {
+            left->keys[left->count]         = parent->keys[separator];
+            left->handles[left->count]      = parent->handles[separator];
+            left->children[left->count + 1] = right->children[0];
+            parent->keys[separator]         = right->keys[0];
+            parent->handles[separator]      = right->handles[0];
+            memmove(right->children, &right->children[1], right->count * sizeof(uint32_t));
+        }
+        left->count++;
+        right->count--;
+        memmove(right->keys, &right->keys[1], right->count * sizeof(uint64_t));
+        memmove(right->handles, &right->handles[1], right->count * sizeof(uint32_t));
+    }
+    else // the short one is on the right, it takes the left's last pair
+    {
+        memmove(&right->keys[1], right->keys, right->count * sizeof(uint64_t));
+        memmove(&right->handles[1], right->handles, right->count * sizeof(uint32_t));
+        if (leaf)
+        {
+            right->keys[0]    = left->keys[left->count - 1];
+            right->handles[0] = left->handles[left->count - 1];
+        }
+        else
+        {
+            memmove(&right->children[1], right->children, (right->count + 1) * sizeof(uint32_t));
+            right->keys[0]             = parent->keys[separator];
+            right->handles[0]          = parent->handles[separator];
+            right->children[0]         = left->children[left->count];
+            parent->keys[separator]    = left->keys[left->count - 1];
+            parent->handles[separator] = left->handles[left->count - 1];
+        }
+        left->count--;
+        right->count++;
+    }
+
+    if (leaf) // a leaf separator is the right leaf's first pair
+    {
+        parent->keys[separator]    = right->keys[0];
+        parent->handles[separator] = right->handles[0];
+    }
+}
+
+static void _mg_order_unlink(_MgOrderNode* node, uint32_t separator) // drops a separator and the child right of it
+{
+    uint32_t moved = node->count - separator - 1;
+    memmove(&node->keys[separator], &node->keys[separator + 1], moved * sizeof(uint64_t));
+    memmove(&node->handles[separator], &node->handles[separator + 1], moved * sizeof(uint32_t));
+    memmove(&node->children[separator + 1], &node->children[separator + 2], moved * sizeof(uint32_t));
+    node->count--;
+}
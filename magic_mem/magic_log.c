@@ -0,0 +1,695 @@
+#include "magic_log.h"
+#include "magic_arena.h"
+#include "magic_mem.h"
+#include "magic_platform.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define _MG_LOG_MAGIC 0x314c474du // "MGL1", also the format version
+
+enum {
+    _MG_LOG_BUFFER_SIZE       = 1 << 20, // per buffer, records are batched until one fills up or the interval ends
+    _MG_LOG_FLUSH_INTERVAL_MS = 10,
+};
+
+// every record carries its own magic and checksum, so a replay stops cleanly at a torn tail
+typedef struct _MgLogRecord {
+    uint32_t magic;
+    uint32_t op;
+    uint32_t type;
+    uint32_t handle;
+    uint32_t data_size; // payload bytes following the record
+    uint32_t padding;
+    uint64_t checksum; // over the payload, then over this header holding the payload's checksum
+} _MgLogRecord;
+
+// payload of the record that opens every batch on a replication stream
+typedef struct _MgLogBatch {
+    uint64_t size;     // bytes of records following this one
+    uint64_t end_lsn;  // leader log offset past the batch
+    uint64_t first_ns; // when the batch's oldest record was appended, for the follower's lag
+} _MgLogBatch;
+
+// callers append into the active buffer while the flush thread writes and syncs the other one, so every
+// caller that arrived during one sync shares the next (group commit)
+struct _MgLog {
+    _MgFile file; // or the caller's pipe or socket for a publisher
+    _MgThread thread;
+    _MgMutex mutex;
+    _MgCond flush_wake; // wakes the flush thread early
+    _MgCond flushed;    // durable_lsn moved or a buffer came free
+    uint8_t* buffers[2];
+    size_t buffer_size;
+    size_t fill; // bytes in buffers[active]
+    uint32_t active;
+    uint64_t appended_lsn; // log offset past the last appended record
+    uint64_t durable_lsn;  // everything before this offset is synced
+    uint64_t first_ns;     // publisher only: when the oldest record in buffers[active] was appended
+    uint32_t flush_interval_ms;
+    bool sync_commit;
+    bool stream; // publisher: batches go out behind a batch record and are never synced, the file is not closed
+    bool stop;
+    bool failed;
+};
+
+static _MgLog* _mg_log_create(_MgArena* arena_internal, uint32_t flush_interval_ms);
+static bool _mg_log_start(_MgLog* log);
+static void _mg_log_free(_MgLog* log);
+static void _mg_log_thread(void* arg);
+static bool _mg_log_send(_MgLog* log, const uint8_t* batch, size_t batch_size, uint64_t batch_lsn, uint64_t first_ns);
+static bool _mg_log_wait(_MgLog* log, uint64_t lsn);
+static uint64_t _mg_log_record_checksum(_MgLogRecord* record, const void* data);
+static bool _mg_log_replay_record(_MgArena* arena_internal, const _MgLogRecord* record, const uint8_t* data);
+
+MgStatus mg_arena_log_open(MgArena* arena, const MgLogDescriptor* descriptor)
+{
+    _MG_STATUS(arena, MG_ERROR_ARENA_INVALID);
+    _MG_STATUS(descriptor && descriptor->path, MG_ERROR_DATA_INVALID);
+    _MgArena* arena_internal = (_MgArena*)arena;
+    _MG_STATUS(!arena_internal->log, MG_ERROR_LOG_IO_FAILED); // already open
+    _MG_STATUS(arena_internal->alloc_kind != _MG_ARENA_ALLOC_SHARED, MG_ERROR_ARENA_SHARED); // log is process local
+
+    _MgLog* log = _mg_log_create(arena_internal, descriptor->flush_interval_ms);
+    _MG_STATUS(log, MG_ERROR_ARENA_ALLOC_FAILED);
+    log->sync_commit = descriptor->sync_commit;
+
+    if (!_mg_file_open_append(&log->file, descriptor->path, descriptor->truncate))
+    {
+        free(log);
+        _MG_STATUS(false, MG_ERROR_LOG_IO_FAILED);
+        return MG_ERROR_LOG_IO_FAILED;
+    }
+
+    if (!_mg_log_start(log))
+    {
+        _mg_file_close(&log->file);
+        free(log);
+        _MG_STATUS(false, MG_ERROR_LOG_IO_FAILED);
+        return MG_ERROR_LOG_IO_FAILED;
+    }
+
+    arena_internal->log = log;
+
+    return MG_SUCCESS;
+}
+
+MgStatus mg_arena_log_flush(MgArena* arena)
+{
+    _MG_STATUS(arena, MG_ERROR_ARENA_INVALID);
+    _MgArena* arena_internal = (_MgArena*)arena;
+    _MG_STATUS(arena_internal->log, MG_ERROR_LOG_IO_FAILED);
+
+    _MgLog* log = arena_internal->log;
+
+    _mg_mutex_lock(&log->mutex);
+    uint64_t lsn = log->appended_lsn;
+    _mg_mutex_unlock(&log->mutex);
+
+    _MG_STATUS(_mg_log_wait(log, lsn), MG_ERROR_LOG_IO_FAILED);
+
+    return MG_SUCCESS;
+}
+
+MgStatus mg_arena_log_close(MgArena* arena)
+{
+    _MG_STATUS(arena, MG_ERROR_ARENA_INVALID);
+    _MgArena* arena_internal = (_MgArena*)arena;
+    _MG_STATUS(arena_internal->log, MG_ERROR_LOG_IO_FAILED);
+
+    _mg_log_close(arena_internal->log);
+    arena_internal->log = NULL;
+
+    return MG_SUCCESS;
+}
+
+MgStatus mg_arena_publish_open(MgArena* arena, intptr_t stream, uint32_t flush_interval_ms)
+{
+    _MG_STATUS(arena, MG_ERROR_ARENA_INVALID);
+    _MgArena* arena_internal = (_MgArena*)arena;
+    _MG_STATUS(!arena_internal->publisher, MG_ERROR_LOG_IO_FAILED); // already publishing
+    _MG_STATUS(arena_internal->alloc_kind != _MG_ARENA_ALLOC_SHARED, MG_ERROR_ARENA_SHARED);
+
+    _MgLog* publisher = _mg_log_create(arena_internal, flush_interval_ms);
+    _MG_STATUS(publisher, MG_ERROR_ARENA_ALLOC_FAILED);
+    publisher->stream      = true;
+    publisher->file.opaque = stream;
+
+    if (!_mg_log_start(publisher))
+    {
+        free(publisher);
+        _MG_STATUS(false, MG_ERROR_LOG_IO_FAILED);
+        return MG_ERROR_LOG_IO_FAILED;
+    }
+
+    // the follower's mirror starts empty, so the stream opens with every live handle at its current generation
+    bool sent = true;
+    for (uint32_t i = 0; i < arena_internal->group_count && sent; i++)
+    {
+        _MgGroup* group = &_mg_arena_groups(arena_internal)[i];
+        if (group->size_class)
+        {
+            continue; // streamed through the variable size group's handles
+        }
+
+        // columnar groups have no record to send from, each one is gathered first
+        uint8_t* record = group->column_count ? (uint8_t*)malloc(group->handle_stride) : NULL;
+        sent            = !group->column_count || record;
+
+        for (uint32_t j = 1; j < group->slot_count && sent; j++)
+        {
+            _MgSlot* slot        = &_mg_group_slots(group)[j];
+            _MgSlotStatus status = _mg_slot_status(slot);
+            if (status != _MG_SLOT_STATUS_VALID_ALLOC && status != _MG_SLOT_STATUS_VALID_WRITE)
+            {
+                continue;
+            }
+
+            sent = _mg_log_append(publisher, _MG_LOG_OP_CREATE, group->handle_type, slot->handle, NULL, 0);
+            if (sent && status == _MG_SLOT_STATUS_VALID_WRITE)
+            {
+                size_t size         = 0;
+                const uint8_t* data = _mg_group_payload(group, j, &size);
+                if (record)
+                {
+                    _mg_group_load(group, j, record);
+                    data = record;
+                }
+                sent = _mg_log_append(publisher, _MG_LOG_OP_WRITE, group->handle_type, slot->handle, data,
+                (uint32_t)size);
+            }
+
+            if (sent && status == _MG_SLOT_STATUS_VALID_WRITE && group->blob_capacity)
+            {
+                size_t size         = 0;
+                const uint8_t* blob = _mg_blob_payload(arena_internal, group, j, &size);
+                sent = !blob || _mg_log_append(publisher, _MG_LOG_OP_BLOB, group->handle_type, slot->handle, blob,
+                (uint32_t)size);
+            }
+        }
+        free(record);
+    }
+
+    if (!sent)
+    {
+        _mg_log_close(publisher);
+        _MG_STATUS(false, MG_ERROR_LOG_IO_FAILED);
+        return MG_ERROR_LOG_IO_FAILED;
+    }
+
+    arena_internal->publisher = publisher;
+
+    return MG_SUCCESS;
+}
+
+MgStatus mg_arena_publish_close(MgArena* arena)
+{
+    _MG_STATUS(arena, MG_ERROR_ARENA_INVALID);
+    _MgArena* arena_internal = (_MgArena*)arena;
+    _MG_STATUS(arena_internal->publisher, MG_ERROR_LOG_IO_FAILED);
+
+    bool sent                 = _mg_log_close(arena_internal->publisher);
+    arena_internal->publisher = NULL;
+    _MG_STATUS(sent, MG_ERROR_LOG_IO_FAILED);
+
+    return MG_SUCCESS;
+}
+
+MgStatus mg_arena_follow(MgArena* mirror, intptr_t stream, MgReplicaStats* stats)
+{
+    _MG_STATUS(mirror, MG_ERROR_ARENA_INVALID);
+    _MG_STATUS(stats, MG_ERROR_DATA_INVALID);
+    _MgArena* arena_internal = (_MgArena*)mirror;
+    _MgFile file             = { stream };
+
+    _MgLogRecord record;
+    _MgLogBatch batch;
+    size_t received = _mg_stream_read(&file, &record, sizeof(record));
+    if (received == 0)
+    {
+        // the leader is gone, relink the free lists so the mirror can create handles of its own
+        for (uint32_t i = 0; i < arena_internal->group_count; i++)
+        {
+            _mg_group_rebuild_free_lists(&_mg_arena_groups(arena_internal)[i]);
+        }
+        stats->closed = true;
+        return MG_SUCCESS;
+    }
+
+    bool valid = (received == sizeof(record) && record.magic == _MG_LOG_MAGIC && record.op == _MG_LOG_OP_BATCH);
+    valid      = valid && record.data_size == sizeof(batch);
+    valid      = valid && _mg_stream_read(&file, &batch, sizeof(batch)) == sizeof(batch);
+    if (valid)
+    {
+        uint64_t checksum = record.checksum;
+        valid             = (_mg_log_record_checksum(&record, &batch) == checksum);
+    }
+    _MG_STATUS(valid && (size_t)batch.size == batch.size, MG_ERROR_LOG_IO_FAILED);
+
+    uint8_t* records = (uint8_t*)malloc(batch.size ? (size_t)batch.size : 1);
+    _MG_STATUS(records, MG_ERROR_ARENA_ALLOC_FAILED);
+    valid = (_mg_stream_read(&file, records, (size_t)batch.size) == batch.size);
+
+    // the same checks as a replay, except that a torn record is an error here and not the end of the history. the
+    // batch is applied to the end even when the mirror's own log fails, so the mirror stays in step with the leader.
+    size_t offset = 0;
+    bool logged   = true;
+    while (valid && offset < batch.size)
+    {
+        valid = (batch.size - offset >= sizeof(record));
+        if (valid)
+        {
+            memcpy(&record, records + offset, sizeof(record));
+            valid = (record.magic == _MG_LOG_MAGIC && record.data_size <= batch.size - offset - sizeof(record));
+        }
+
+        const uint8_t* data = records + offset + sizeof(record);
+        if (valid)
+        {
+            uint64_t checksum = record.checksum;
+            valid             = (_mg_log_record_checksum(&record, data) == checksum);
+            valid             = valid && _mg_log_replay_record(arena_internal, &record, data);
+        }
+
+        if (valid)
+        {
+            _MgGroup* group = arena_internal->track_dirty ? _mg_group_query(arena_internal, record.type) : NULL;
+            if (group)
+            {
+                _mg_group_mark_dirty(arena_internal, group, MG_DECODE_INDEX(record.handle));
+            }
+
+            // a mirror with a log of its own stays recoverable, one with a publisher feeds the next follower
+            if (arena_internal->log || arena_internal->publisher)
+            {
+                logged = logged && _mg_arena_log_append(arena_internal, (_MgLogOp)record.op, record.type,
+                record.handle, data, record.data_size);
+            }
+
+            offset += sizeof(record) + record.data_size;
+        }
+    }
+
+    free(records);
+    _MG_STATUS(valid, MG_ERROR_LOG_IO_FAILED);
+
+    uint64_t now_ns    = _mg_time_ns();
+    stats->applied_lsn = batch.end_lsn;
+    stats->lag_ns      = now_ns > batch.first_ns ? now_ns - batch.first_ns : 0;
+    stats->batch_count++;
+
+    _MG_STATUS(logged, MG_ERROR_LOG_IO_FAILED);
+
+    return MG_SUCCESS;
+}
+
+MgArena* mg_arena_replay(MgArenaDescriptor* descriptor, const char* path)
+{
+    _MG_CHECK(path, MG_ERROR_DATA_INVALID);
+
+    MgArena* arena = mg_arena_init(descriptor);
+    if (!arena)
+    {
+        return NULL;
+    }
+
+    // no log (or an empty one) replays to an empty arena
+    size_t file_size = 0;
+    uint8_t* file    = path ? (uint8_t*)_mg_file_map(path, &file_size) : NULL;
+    if (!file)
+    {
+        return arena;
+    }
+
+    _MgArena* arena_internal = (_MgArena*)arena;
+
+    // slots are forced straight to their logged state, free lists are rebuilt once at the end
+    size_t offset = 0;
+    while (offset + sizeof(_MgLogRecord) <= file_size)
+    {
+        _MgLogRecord record;
+        memcpy(&record, file + offset, sizeof(record));
+
+        bool complete = (record.magic == _MG_LOG_MAGIC);
+        complete      = complete && (record.data_size <= file_size - offset - sizeof(record));
+        if (!complete)
+        {
+            break; // torn tail, the crash happened while this record was written
+        }
+
+        const uint8_t* data = file + offset + sizeof(record);
+        uint64_t checksum   = record.checksum;
+        if (_mg_log_record_checksum(&record, data) != checksum)
+        {
+            break;
+        }
+
+        if (!_mg_log_replay_record(arena_internal, &record, data))
+        {
+            break;
+        }
+
+        offset += sizeof(record) + record.data_size;
+    }
+
+    _mg_file_unmap(file, file_size);
+
+    for (uint32_t i = 0; i < arena_internal->group_count; i++)
+    {
+        _mg_group_rebuild_free_lists(&_mg_arena_groups(arena_internal)[i]);
+    }
+
+    return arena;
+}
+
+bool _mg_log_append(_MgLog* log, _MgLogOp op, uint32_t type, uint32_t handle, const void* data, uint32_t size)
+{
+    uint64_t lsn = 0;
+    bool queued  = _mg_log_enqueue(log, op, type, handle, data, size, &lsn);
+    return queued && (log->sync_commit ? _mg_log_wait(log, lsn) : true);
+}
+
+bool _mg_log_enqueue(_MgLog* log, _MgLogOp op, uint32_t type, uint32_t handle, const void* data, uint32_t size,
+uint64_t* lsn)
+{
+    _MgLogRecord record = { 0 };
+    record.magic        = _MG_LOG_MAGIC;
+    record.op           = (uint32_t)op;
+    record.type         = type;
+    record.handle       = handle;
+    record.data_size    = size;
+    record.checksum     = _mg_log_record_checksum(&record, data); // outside the lock
+
+    size_t record_size = sizeof(record) + size;
+
+    _mg_mutex_lock(&log->mutex);
+
+    while (log->fill + record_size > log->buffer_size && !log->failed)
+    {
+        _mg_cond_broadcast(&log->flush_wake);
+        _mg_cond_wait(&log->flushed, &log->mutex);
+    }
+
+    if (log->failed)
+    {
+        _mg_mutex_unlock(&log->mutex);
+        return false; // the log can no longer promise durability, stop feeding it
+    }
+
+    uint8_t* buffer = log->buffers[log->active];
+    if (log->stream && log->fill == 0)
+    {
+        log->first_ns = _mg_time_ns();
+    }
+    memcpy(buffer + log->fill, &record, sizeof(record));
+    if (size > 0)
+    {
+        memcpy(buffer + log->fill + sizeof(record), data, size);
+    }
+    log->fill += record_size;
+    log->appended_lsn += record_size;
+
+    *lsn = log->appended_lsn;
+
+    if (log->fill > log->buffer_size / 2)
+    {
+        _mg_cond_broadcast(&log->flush_wake); // write early instead of letting callers block on a full buffer
+    }
+
+    _mg_mutex_unlock(&log->mutex);
+
+    return true;
+}
+
+bool _mg_log_close(_MgLog* log)
+{
+    _mg_mutex_lock(&log->mutex);
+    log->stop = true;
+    _mg_cond_broadcast(&log->flush_wake);
+    _mg_mutex_unlock(&log->mutex);
+
+    _mg_thread_join(&log->thread); // the thread flushes everything before it exits
+
+    bool written = !log->failed;
+    if (!log->stream)
+    {
+        _mg_file_close(&log->file);
+    }
+    _mg_log_free(log);
+
+    return written;
+}
+
+bool _mg_arena_log_append(_MgArena* arena_internal, _MgLogOp op, uint32_t type, uint32_t handle, const void* data,
+uint32_t size)
+{
+    if (arena_internal->publisher)
+    {
+        _mg_log_append(arena_internal->publisher, op, type, handle, data, size);
+    }
+    return arena_internal->log ? _mg_log_append(arena_internal->log, op, type, handle, data, size) : true;
+}
+
+void _mg_arena_log_enqueue(_MgArena* arena_internal, _MgLogOp op, uint32_t type, uint32_t handle, const void* data,
+uint32_t size, _MgLogTicket* ticket)
+{
+    if (arena_internal->publisher)
+    {
+        uint64_t sent = 0;
+        _mg_log_enqueue(arena_internal->publisher, op, type, handle, data, size, &sent);
+    }
+    if (arena_internal->log && !_mg_log_enqueue(arena_internal->log, op, type, handle, data, size, &ticket->lsn))
+    {
+        ticket->failed = true;
+    }
+}
+
+bool _mg_arena_log_commit(_MgArena* arena_internal, const _MgLogTicket* ticket)
+{
+    if (ticket->failed)
+    {
+        return false;
+    }
+    _MgLog* log = arena_internal->log;
+    return !log || !log->sync_commit || ticket->lsn == 0 || _mg_log_wait(log, ticket->lsn);
+}
+
+static _MgLog* _mg_log_create(_MgArena* arena_internal, uint32_t flush_interval_ms)
+{
+    // both buffers must hold at least one record of the largest group
+    size_t buffer_size = _MG_LOG_BUFFER_SIZE;
+    for (uint32_t i = 0; i < arena_internal->group_count; i++)
+    {
+        size_t record_size = sizeof(_MgLogRecord) + _mg_arena_groups(arena_internal)[i].handle_stride;
+        buffer_size        = record_size > buffer_size ? record_size : buffer_size;
+    }
+
+    _MgLog* log = (_MgLog*)calloc(1, sizeof(_MgLog) + 2 * buffer_size);
+    if (!log)
+    {
+        return NULL;
+    }
+
+    log->buffers[0]        = (uint8_t*)(log + 1);
+    log->buffers[1]        = log->buffers[0] + buffer_size;
+    log->buffer_size       = buffer_size;
+    log->flush_interval_ms = flush_interval_ms ? flush_interval_ms : _MG_LOG_FLUSH_INTERVAL_MS;
+
+    return log;
+}
+
+static bool _mg_log_start(_MgLog* log)
+{
+    _mg_mutex_init(&log->mutex);
+    _mg_cond_init(&log->flush_wake);
+    _mg_cond_init(&log->flushed);
+
+    if (!_mg_thread_create(&log->thread, _mg_log_thread, log))
+    {
+        _mg_cond_destroy(&log->flushed);
+        _mg_cond_destroy(&log->flush_wake);
+        _mg_mutex_destroy(&log->mutex);
+        return false;
+    }
+    return true;
+}
+
+static void _mg_log_free(_MgLog* log)
+{
+    _mg_cond_destroy(&log->flushed);
+    _mg_cond_destroy(&log->flush_wake);
+    _mg_mutex_destroy(&log->mutex);
+    free(log);
+}
+
+static void _mg_log_thread(void* arg)
+{
+    _MgLog* log = (_MgLog*)arg;
+
+    _mg_mutex_lock(&log->mutex);
+
+    for (;;)
+    {
+        if (log->fill == 0)
+        {
+            if (log->stop)
+            {
+                break;
+            }
+            _mg_cond_wait_timeout(&log->flush_wake, &log->mutex, log->flush_interval_ms);
+            continue;
+        }
+
+        // swap buffers, callers keep appending while this batch is written and synced
+        uint8_t* batch     = log->buffers[log->active];
+        size_t batch_size  = log->fill;
+        uint64_t batch_lsn = log->appended_lsn;
+        uint64_t first_ns  = log->first_ns;
+        log->active ^= 1;
+        log->fill = 0;
+
+        _mg_mutex_unlock(&log->mutex);
+        bool synced = log->stream ? _mg_log_send(log, batch, batch_size, batch_lsn, first_ns)
+                                  : _mg_file_write(&log->file, batch, batch_size) && _mg_file_sync(&log->file);
+        _mg_mutex_lock(&log->mutex);
+
+        log->durable_lsn = batch_lsn;
+        log->failed |= !synced;
+        _mg_cond_broadcast(&log->flushed);
+
+        if (!log->stop && log->fill < log->buffer_size / 2)
+        {
+            // let the next batch gather, unless a sync commit caller asks for it sooner
+            _mg_cond_wait_timeout(&log->flush_wake, &log->mutex, log->flush_interval_ms);
+        }
+    }
+
+    _mg_mutex_unlock(&log->mutex);
+}
+
+static bool _mg_log_send(_MgLog* log, const uint8_t* batch, size_t batch_size, uint64_t batch_lsn, uint64_t first_ns)
+{
+    // the follower reads the batch record first, so it knows how many bytes to wait for
+    struct {
+        _MgLogRecord record;
+        _MgLogBatch batch;
+    } header = { { 0 }, { 0 } };
+    header.batch.size       = batch_size;
+    header.batch.end_lsn    = batch_lsn;
+    header.batch.first_ns   = first_ns;
+    header.record.magic     = _MG_LOG_MAGIC;
+    header.record.op        = _MG_LOG_OP_BATCH;
+    header.record.data_size = sizeof(header.batch);
+    header.record.checksum  = _mg_log_record_checksum(&header.record, &header.batch);
+
+    return _mg_stream_write(&log->file, &header, sizeof(header)) && _mg_stream_write(&log->file, batch, batch_size);
+}
+
+static bool _mg_log_wait(_MgLog* log, uint64_t lsn)
+{
+    _mg_mutex_lock(&log->mutex);
+    while (log->durable_lsn < lsn && !log->failed)
+    {
+        _mg_cond_broadcast(&log->flush_wake);
+        _mg_cond_wait(&log->flushed, &log->mutex);
+    }
+    bool durable = !log->failed;
+    _mg_mutex_unlock(&log->mutex);
+
+    return durable;
+}
+
+static uint64_t _mg_log_record_checksum(_MgLogRecord* record, const void* data)
+{
+    record->checksum = _mg_checksum(data, record->data_size);
+    return _mg_checksum(record, sizeof(*record));
+}
+
+static bool _mg_log_replay_record(_MgArena* arena_internal, const _MgLogRecord* record, const uint8_t* data)
+{
+    _MgGroup* group = _mg_group_query(arena_internal, record->type);
+    if (!group)
+    {
+        return false; // the log belongs to an arena with different groups
+    }
+
+    if (record->op == _MG_LOG_OP_RESET)
+    {
+        _mg_group_reset(arena_internal, group, NULL);
+        return true;
+    }
+
+    uint32_t slot_index = MG_DECODE_INDEX(record->handle);
+    size_t max_size     = record->op == _MG_LOG_OP_BLOB ? group->blob_capacity : _mg_group_max_size(group);
+    bool keyless        = record->op == _MG_LOG_OP_WRITE && record->data_size < _mg_group_keys_end(group);
+    if (slot_index == 0 || slot_index >= group->slot_count || record->data_size > max_size || keyless)
+    {
+        return false;
+    }
+
+    _MgSlot* slot = &_mg_group_slots(group)[slot_index];
+
+    // variable size payloads go through their size classes, whose free lists stay valid the whole replay. a slot
+    // created again or erased gives back its size class slot and its blob, and its key like a rewritten one.
+    bool cleared = (record->op == _MG_LOG_OP_CREATE || record->op == _MG_LOG_OP_ERASE);
+    bool rekeyed = (cleared || record->op == _MG_LOG_OP_WRITE) && _mg_group_has_indexes(group);
+    if (rekeyed && slot->status == _MG_SLOT_STATUS_VALID_WRITE)
+    {
+        _mg_group_unindex(arena_internal, group, slot_index);
+    }
+    if (cleared && group->class_count && slot->status == _MG_SLOT_STATUS_VALID_WRITE)
+    {
+        _mg_variable_release(arena_internal, group, slot_index);
+    }
+    if (cleared && group->blob_capacity)
+    {
+        _mg_blob_release(arena_internal, group, slot_index);
+    }
+
+    switch (record->op)
+    {
+    case _MG_LOG_OP_CREATE:
+        slot->handle     = record->handle;
+        slot->generation = MG_DECODE_GENERATION(record->handle); // the next create of the slot moves past it
+        slot->status     = _MG_SLOT_STATUS_VALID_ALLOC;
+        _mg_group_mark_live(arena_internal, group, slot_index, false);
+        return true;
+
+    case _MG_LOG_OP_WRITE:
+        if (group->class_count &&
+            _mg_variable_write(arena_internal, group, slot_index, data, record->data_size) != MG_SUCCESS)
+        {
+            return false;
+        }
+        if (!group->class_count)
+        {
+            _mg_group_store(group, slot_index, data, record->data_size);
+            slot->status = _MG_SLOT_STATUS_VALID_WRITE;
+            _mg_group_mark_live(arena_internal, group, slot_index, true); // followers are scanned between batches
+        }
+        if (rekeyed && group->index_capacity)
+        {
+            _mg_index_insert(arena_internal, group, _mg_index_key(group, slot_index), slot->handle);
+        }
+        if (rekeyed && group->order_capacity)
+        {
+            return _mg_order_insert(arena_internal, group, _mg_order_key(group, slot_index), slot->handle);
+        }
+        return true;
+
+    case _MG_LOG_OP_BLOB:
+        return slot->status == _MG_SLOT_STATUS_VALID_WRITE &&
+               _mg_blob_write(arena_internal, group, slot_index, data, record->data_size) == MG_SUCCESS;
+
+    case _MG_LOG_OP_ERASE:
+        _mg_group_store(group, slot_index, NULL, 0);
+        slot->handle = 0;
+        slot->status = _MG_SLOT_STATUS_FREE;
+        _mg_group_mark_live(arena_internal, group, slot_index, false);
+        return true;
+
+    default: return false;
+    }
+}
@@ -0,0 +1,53 @@
+#ifndef MAGIC_LOG_HEADER
+#define MAGIC_LOG_HEADER
+
+// internal header, not part of the public api (include magic_mem.h instead)
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#if __cplusplus
+extern "C" {
+#endif
+
+typedef struct _MgLog _MgLog;
+struct _MgArena;
+
+typedef enum _MgLogOp {
+    _MG_LOG_OP_CREATE = 1,
+    _MG_LOG_OP_WRITE  = 2,
+    _MG_LOG_OP_ERASE  = 3,
+    _MG_LOG_OP_BATCH  = 4, // replication streams only, opens every batch
+    _MG_LOG_OP_BLOB   = 5,
+    _MG_LOG_OP_RESET  = 6, // handle 0, the whole group of the type
+} _MgLogOp;
+
+// what a call appended to the arena's log, start it zeroed
+typedef struct _MgLogTicket {
+    uint64_t lsn; // end of the last record, the one commit waits for
+    bool failed;  // a record could not be appended
+} _MgLogTicket;
+
+// buffers one record. with sync commit it returns once the record is durable, false if the log failed. enqueue
+// never waits, it only sets *lsn to the end of the record.
+extern bool _mg_log_append(_MgLog* log, _MgLogOp op, uint32_t type, uint32_t handle, const void* data, uint32_t size);
+extern bool _mg_log_enqueue(_MgLog* log, _MgLogOp op, uint32_t type, uint32_t handle, const void* data, uint32_t size,
+uint64_t* lsn);
+extern bool _mg_log_close(_MgLog* log); // false if a write failed since the log was opened
+
+// appends to the arena's log and to its replication publisher, whichever are open. only the log's result is
+// returned, a follower that went away never fails the leader's calls.
+extern bool _mg_arena_log_append(struct _MgArena* arena_internal, _MgLogOp op, uint32_t type, uint32_t handle,
+const void* data, uint32_t size);
+// the same split in two: enqueue runs under the shard lock of the change it records, so records of one slot reach
+// the log in the order their changes were made. commit runs once the lock is released and waits for the ticket's
+// records to become durable under sync commit, false if any of them failed.
+extern void _mg_arena_log_enqueue(struct _MgArena* arena_internal, _MgLogOp op, uint32_t type, uint32_t handle,
+const void* data, uint32_t size, _MgLogTicket* ticket);
+extern bool _mg_arena_log_commit(struct _MgArena* arena_internal, const _MgLogTicket* ticket);
+
+#if __cplusplus
+} // end extern "C"
+#endif
+
+#endif // MAGIC_LOG_HEADER
@@ -1,4 +1,9 @@
 #include "magic_mem.h"
+#include "magic_arena.h"
+#include "magic_log.h"
+#include "magic_platform.h"
+#include "magic_pool.h"
+#include "magic_simd.h"
 
 #include <malloc.h>
 #include <stdbool.h>
@@ -6,88 +11,374 @@
 #include <stdio.h>
 #include <string.h>
 
-#define MG_ENCODE_HANDLE(index, generation) (((generation) << _MG_SLOT_BIT_SHIFT) | ((index) & _MG_SLOT_BIT_MASK))
+typedef struct _MgForeachJob {
+    _MgGroup* group;
+    MgForeachFn fn;
+    void* ctx;
+} _MgForeachJob;
 
-#define MG_DECODE_INDEX(handle) ((handle) & _MG_SLOT_BIT_MASK)
-
-#define MG_DECODE_GENERATION(handle) ((handle) >> _MG_SLOT_BIT_SHIFT)
+typedef struct _MgCopyJob {
+    uint8_t* dst;
+    const uint8_t* src;
+    size_t size;
+} _MgCopyJob;
 
 enum {
-    _MG_HANDLE_INVALID = 0,
-    _MG_SLOT_BIT_SHIFT = 16,
-    _MG_SLOT_BIT_MASK  = (1 << _MG_SLOT_BIT_SHIFT) - 1,
+    _MG_COPY_CHUNK_SIZE = 1 << 20, // grain of a parallel block copy, smaller copies are a single memcpy
+    _MG_SCAN_CHUNK_WORDS = 64,     // selection words a scan or aggregate works through at once, 4096 rows
 };
 
-typedef enum _MgSlotStatus {
-    _MG_SLOT_STATUS_FREE,
-    _MG_SLOT_STATUS_VALID_ALLOC,
-    _MG_SLOT_STATUS_VALID_WRITE,
-    _MG_SLOT_STATUS_INVALID,
-} _MgSlotStatus;
-
-typedef struct _MgSlot {
-    union {
-        uint32_t handle;          // if allocated, stores generation + index
-        uint32_t next_free_index; // if free, this points to next free slot in group
-    };
-    uint32_t generation;
-    _MgSlotStatus status;
-} _MgSlot;
-
-typedef struct _MgGroup {
-    uint8_t* data;
-    _MgSlot* slots;
-    uint32_t slot_count;
-    uint32_t free_list_head;
-    uint32_t handle_stride;
-    uint32_t handle_type;
-    size_t size;
-} _MgGroup;
+// one per group of the arena. a variable size handle descriptor becomes several groups: the handle's own group,
+// whose payload is a _MgVariableRef, followed by one group per size class.
+typedef struct _MgGroupSpec {
+    MgHandleDescriptor handle; // stride adjusted for variable size groups and size classes
+    uint32_t class_count;
+    bool size_class;
+    MgField parts[2]; // the hot and cold fields a hot_size turns into, handle.fields points here then
+} _MgGroupSpec;
+
+static uint32_t _mg_group_spec_count(const MgArenaDescriptor* descriptor);
+static void _mg_group_spec(const MgArenaDescriptor* descriptor, uint32_t group_index, _MgGroupSpec* spec);
+static uint32_t _mg_group_slot_create(_MgArena* arena_internal, _MgGroup* group, _MgLogTicket* ticket);
+static bool _mg_group_slot_erase(_MgArena* arena_internal, _MgGroup* group, uint32_t slot_handle,
+_MgLogTicket* ticket);
+static MgStatus _mg_group_init(_MgArena* arena_internal, _MgGroup* group, uintptr_t group_start, MgHandleDescriptor* descriptor);
+static bool _mg_group_place(_MgArena* arena_internal, _MgGroup* group, uintptr_t group_start);
+static size_t _mg_group_alignment(const MgHandleDescriptor* descriptor);
+static size_t _mg_group_alloc_size(const MgHandleDescriptor* descriptor);
+static size_t _mg_group_blob_refs_size(const MgHandleDescriptor* descriptor, size_t slot_count);
+static size_t _mg_group_blobs_size(const MgHandleDescriptor* descriptor);
+static size_t _mg_group_handle_count(const MgHandleDescriptor* descriptor);
+static uint32_t _mg_group_index_capacity(const MgHandleDescriptor* descriptor);
+static size_t _mg_group_index_size(const MgHandleDescriptor* descriptor);
+static uint32_t _mg_group_order_capacity(const MgHandleDescriptor* descriptor);
+static size_t _mg_group_order_size(const MgHandleDescriptor* descriptor);
+static size_t _mg_group_columns_size(const MgHandleDescriptor* descriptor);
+static size_t _mg_group_live_size(const MgHandleDescriptor* descriptor, size_t slot_count);
+static size_t _mg_group_data_alloc_size(const MgHandleDescriptor* descriptor, size_t slot_count);
+static void _mg_group_geometry(const MgHandleDescriptor* descriptor, uint32_t* shard_count, uint32_t* shard_slot_count);
+static uint32_t _mg_slots_per_span(uint32_t stride, size_t span);
+static void _mg_arena_free(_MgArena* arena_internal);
+static _MgShard* _mg_group_shard(_MgGroup* group, uint32_t slot_index);
+static void _mg_shard_rebuild_free_list(_MgGroup* group, _MgShard* shard);
+static uint32_t _mg_group_slot_move(_MgArena* arena_internal, _MgGroup* group, uint32_t from, uint32_t to);
+static void _mg_group_log_move(_MgArena* arena_internal, _MgGroup* group, uint32_t from_handle, uint32_t to_handle,
+uint8_t* record, _MgLogTicket* ticket);
+static uint32_t _mg_shard_slot_alloc(_MgArena* arena_internal, _MgGroup* group, _MgShard* shard,
+_MgLogTicket* ticket);
+static _MgShard* _mg_group_owned_shard(_MgGroup* group);
+static void _mg_shard_remote_push(_MgGroup* group, _MgShard* shard, uint32_t slot_index);
+static void _mg_shard_remote_drain(_MgArena* arena_internal, _MgGroup* group, _MgShard* shard);
+static void _mg_arena_thread_release(_MgArena* arena_internal);
+static bool _mg_arena_locked(_MgArena* arena_internal);
+static void _mg_shard_lock(_MgArena* arena_internal, _MgShard* shard);
+static void _mg_shard_unlock(_MgArena* arena_internal, _MgShard* shard);
+static void _mg_group_foreach_range(void* ctx, uint32_t begin, uint32_t end);
+static MgStatus _mg_group_scan_column(_MgArena* arena_internal, MgHandleType handle_type, uint32_t field,
+_MgGroup** group, _MgColumn** column);
+static size_t _mg_group_select_live(_MgGroup* group, uint64_t* selection, size_t first_word, size_t word_count);
+static const void* _mg_handle_read_part(MgArena* arena, MgHandle handle, uint32_t part);
+static void _mg_block_copy(void* dst, const void* src, size_t size);
+static void _mg_block_copy_range(void* ctx, uint32_t begin, uint32_t end);
+static MgArena* _mg_arena_create(MgArenaDescriptor* descriptor, const char* shared_name, const char* file_path);
+static MgArena* _mg_arena_file_reopen(_MgArena* arena_internal, MgArenaDescriptor* descriptor, _MgFile file,
+size_t alloc_size);
+static bool _mg_arena_file_sync(_MgArena* arena_internal, bool async);
+static bool _mg_arena_shared(_MgArena* arena_internal);
+
+MgArena* mg_arena_init(MgArenaDescriptor* descriptor)
+{
+    return _mg_arena_create(descriptor, NULL, NULL);
+}
+
+MgArena* mg_arena_create_shared(const char* name, MgArenaDescriptor* descriptor)
+{
+    bool valid = name && name[0] != '\0' && strlen(name) < _MG_ARENA_NAME_SIZE;
+    _MG_CHECK(valid, MG_ERROR_DATA_INVALID);
+    return valid ? _mg_arena_create(descriptor, name, NULL) : NULL;
+}
 
-typedef struct _MgArena {
-    _MgGroup* groups;
-    uint32_t group_count;
-    size_t alloc_size;
-    const char* name;
-} _MgArena;
+MgArena* mg_arena_open_shared(const char* name, bool readonly)
+{
+    _MG_CHECK(name, MG_ERROR_DATA_INVALID);
 
-static MgStatus _mg_group_init(_MgGroup* group, uintptr_t slots_start, MgHandleDescriptor* descriptor);
-static _MgGroup* _mg_group_query(_MgArena* arena, uint32_t handle_type);
-static uint32_t _mg_group_slot_alloc(_MgGroup* group);
+    size_t size              = 0;
+    _MgArena* arena_internal = (_MgArena*)_mg_shm_open(name, readonly, &size);
+    _MG_CHECK(arena_internal, MG_ERROR_ARENA_INVALID);
+    if (!arena_internal)
+    {
+        return NULL;
+    }
 
-MgArena* mg_arena_init(MgArenaDescriptor* descriptor)
+    // the name exists as soon as the creator made it, the block is only usable once the creator published it
+    bool ready = size >= sizeof(_MgArena) && _mg_atomic_load_u32(&arena_internal->shared_ready) != 0;
+    ready      = ready && arena_internal->alloc_kind == _MG_ARENA_ALLOC_SHARED && arena_internal->alloc_size <= size;
+    _MG_CHECK(ready, MG_ERROR_ARENA_INVALID);
+    if (!ready)
+    {
+        _mg_shm_unmap(arena_internal, size);
+        return NULL;
+    }
+
+    return (MgArena*)arena_internal;
+}
+
+MgArena* mg_arena_open_file(const char* path, MgArenaDescriptor* descriptor)
+{
+    _MG_CHECK(path, MG_ERROR_DATA_INVALID);
+    return path ? _mg_arena_create(descriptor, NULL, path) : NULL;
+}
+
+MgStatus mg_arena_sync(MgArena* arena, bool async)
+{
+    _MG_STATUS(arena, MG_ERROR_ARENA_INVALID);
+    _MgArena* arena_internal = (_MgArena*)arena;
+    _MG_STATUS(arena_internal->alloc_kind == _MG_ARENA_ALLOC_FILE, MG_ERROR_ARENA_NOT_FILE);
+    _MG_STATUS(_mg_arena_file_sync(arena_internal, async), MG_ERROR_FILE_SYNC_FAILED);
+
+    return MG_SUCCESS;
+}
+
+static MgArena* _mg_arena_create(MgArenaDescriptor* descriptor, const char* shared_name, const char* file_path)
 {
     _MG_CHECK(descriptor, MG_ERROR_ARENA_DESC_INVALID);
     _MG_CHECK(descriptor->handle_descriptors && descriptor->handle_descriptors_count > 0, MG_ERROR_ARENA_DESC_INVALID);
-
-    size_t alloc_size = sizeof(_MgArena) + (sizeof(_MgGroup) * descriptor->handle_descriptors_count); // arena + arena->groups
+    _MG_CHECK(descriptor->sync_mode <= MG_ARENA_SYNC_THREAD_OWNED, MG_ERROR_ARENA_DESC_INVALID);
+
+    uint32_t group_count = _mg_group_spec_count(descriptor);
+    size_t groups_offset = _MG_ALIGN_UP(sizeof(_MgArena), MG_CACHE_LINE_SIZE);
+    size_t groups_size   = _MG_ALIGN_UP(sizeof(_MgGroup) * group_count, MG_CACHE_LINE_SIZE);
+    size_t alloc_size    = groups_offset + groups_size; // arena + arena->groups
+    bool paged           = false;
+    bool variable        = false;
+    bool blobs           = false;
+    bool indexed         = false;
+    bool keyed           = true; // every key and ordered field lies inside the payload
+    bool columned        = true; // every field lies inside the record, behind the one before it
 
     for (uint32_t i = 0; i < descriptor->handle_descriptors_count; i++)
     {
-        size_t handle_count  = descriptor->handle_descriptors[i].count + 1; // room for invalid slot 0
-        size_t handle_stride = descriptor->handle_descriptors[i].stride;
+        const MgHandleDescriptor* handle_descriptor = &descriptor->handle_descriptors[i];
+
+        size_t key_end   = (size_t)handle_descriptor->key_offset + sizeof(uint64_t);
+        size_t order_end = (size_t)handle_descriptor->order_offset + _mg_field_size(handle_descriptor->order_type);
+        keyed &= !handle_descriptor->indexed || key_end <= handle_descriptor->stride;
+        keyed &= handle_descriptor->order_type <= MG_FIELD_F64;
+        keyed &= handle_descriptor->order_type == MG_FIELD_NONE || order_end <= handle_descriptor->stride;
+
+        // columns hold plain fields, nothing that reads a record as a whole or places the slots shard by shard. a
+        // hot_size splits the records into two fields of their own.
+        uint32_t hot_size = handle_descriptor->hot_size;
+        bool split        = hot_size > 0;
+        bool columnar     = handle_descriptor->field_count > 0 || split;
+        columned &= !split || (handle_descriptor->field_count == 0 && hot_size < handle_descriptor->stride);
+        columned &= split || !columnar || handle_descriptor->fields;
+        columned &= handle_descriptor->field_count <= MG_FIELD_COUNT_MAX;
+        columned &= !columnar || (!handle_descriptor->variable && !handle_descriptor->indexed);
+        columned &= !columnar || handle_descriptor->order_type == MG_FIELD_NONE;
+        columned &= !columnar || handle_descriptor->numa_policy != MG_NUMA_POLICY_SHARDS;
+
+        uint32_t field_end = 0;
+        for (uint32_t j = 0; columned && j < handle_descriptor->field_count; j++)
+        {
+            const MgField* field = &handle_descriptor->fields[j];
+            columned &= field->size > 0 && field->offset >= field_end && field->offset <= handle_descriptor->stride;
+            columned &= field->size <= handle_descriptor->stride - field->offset;
+            columned &= field->type <= MG_FIELD_F64;
+            columned &= field->type == MG_FIELD_NONE || field->size == _mg_field_size(field->type);
+            field_end = field->offset + field->size;
+        }
+    }
+
+    for (uint32_t i = 0; i < group_count; i++)
+    {
+        _MgGroupSpec spec;
+        _mg_group_spec(descriptor, i, &spec);
+        paged |= (spec.handle.numa_policy != MG_NUMA_POLICY_DEFAULT);
+        variable |= spec.size_class;
+        blobs |= (spec.handle.blob_capacity > 0);
+        indexed |= spec.handle.indexed || spec.handle.order_type != MG_FIELD_NONE;
+
+        alloc_size = _MG_ALIGN_UP(alloc_size, _mg_group_alignment(&spec.handle));
+        alloc_size += _mg_group_alloc_size(&spec.handle); // group->shards + slots + data
+    }
+
+    // every size class has room for all of its group's handles, only the pages a class actually uses get backed
+    _MgArena* arena_internal = NULL;
+    _MgMemFile backing       = { 0 };
+    _MgFile file             = { 0 };
+    _MgArenaAlloc alloc_kind = (paged || variable) ? _MG_ARENA_ALLOC_PAGES : _MG_ARENA_ALLOC_HEAP;
+    alloc_kind               = descriptor->copy_on_write ? _MG_ARENA_ALLOC_VIEW : alloc_kind;
+    alloc_kind               = shared_name ? _MG_ARENA_ALLOC_SHARED : alloc_kind;
+    alloc_kind               = file_path ? _MG_ARENA_ALLOC_FILE : alloc_kind;
+
+    if (paged && descriptor->copy_on_write)
+    {
+        _MG_CHECK(false, MG_ERROR_ARENA_DESC_INVALID); // views are file pages, placement only applies to anonymous ones
+        return NULL;
+    }
+
+    if ((variable || blobs || indexed) && descriptor->sync_mode == MG_ARENA_SYNC_THREAD_OWNED)
+    {
+        // writes allocate from a size class or blob region of any shard, and update indexes all shards share
+        _MG_CHECK(false, MG_ERROR_ARENA_DESC_INVALID);
+        return NULL;
+    }
+
+    if (!keyed || !columned)
+    {
+        _MG_CHECK(false, MG_ERROR_ARENA_DESC_INVALID);
+        return NULL;
+    }
 
-        alloc_size += handle_count * sizeof(_MgSlot); // group->slots
-        alloc_size += handle_count * handle_stride;   // group->data
+    if (shared_name && (paged || descriptor->copy_on_write || descriptor->sync_mode == MG_ARENA_SYNC_THREAD_OWNED))
+    {
+        _MG_CHECK(false, MG_ERROR_ARENA_DESC_INVALID); // thread tokens only mean something inside one process
+        return NULL;
+    }
+
+    if (shared_name && (variable || indexed))
+    {
+        // readers of a shared arena cannot lock, a readonly mapping has no way to write the lock word. a variable
+        // size rewrite frees the class slot the old ref points at, and inserts rehash the index and split tree nodes
+        // in place, so such a reader could follow a slot or a node that is half updated or already reused.
+        _MG_CHECK(false, MG_ERROR_ARENA_DESC_INVALID);
+        return NULL;
+    }
+
+    if (file_path && (paged || descriptor->copy_on_write))
+    {
+        _MG_CHECK(false, MG_ERROR_ARENA_DESC_INVALID); // the file's pages are the arena, there is nothing to place
+        return NULL;
+    }
+
+    if (shared_name)
+    {
+        // zeroed by the os, every process maps the same block at its own address
+        alloc_size     = _MG_ALIGN_UP(alloc_size, _mg_page_size());
+        arena_internal = (_MgArena*)_mg_shm_create(shared_name, alloc_size);
+        _MG_CHECK(arena_internal, MG_ERROR_ARENA_ALLOC_FAILED);
+    }
+    else if (file_path)
+    {
+        // a new file reads as zero like fresh pages, an existing one already holds the arena
+        bool created   = false;
+        bool busy      = false;
+        alloc_size     = _MG_ALIGN_UP(alloc_size, _mg_page_size());
+        arena_internal = (_MgArena*)_mg_file_map_shared(&file, file_path, alloc_size, &created, &busy);
+        _MG_CHECK(!busy, MG_ERROR_ARENA_FILE_BUSY);
+        _MG_CHECK(arena_internal || busy, MG_ERROR_ARENA_ALLOC_FAILED);
+        if (arena_internal && !created)
+        {
+            return _mg_arena_file_reopen(arena_internal, descriptor, file, alloc_size);
+        }
+    }
+    else if (descriptor->copy_on_write)
+    {
+        // the arena is a private view of a memory file that holds the last snapshot, the view starts out zeroed
+        alloc_size     = _MG_ALIGN_UP(alloc_size, _mg_page_size());
+        bool created   = _mg_memfile_create(&backing, alloc_size);
+        arena_internal = created ? (_MgArena*)_mg_memfile_map_private(&backing, alloc_size) : NULL;
+        _MG_CHECK(arena_internal, MG_ERROR_ARENA_ALLOC_FAILED);
+        if (created && !arena_internal)
+        {
+            _mg_memfile_close(&backing);
+        }
+    }
+    else if (alloc_kind == _MG_ARENA_ALLOC_PAGES)
+    {
+        // numa placement works on whole pages, and the policy has to be set before anything touches them.
+        // fresh pages read as zero, so groups with default placement stay untouched until their owner writes.
+        alloc_size     = _MG_ALIGN_UP(alloc_size, _mg_page_size());
+        arena_internal = (_MgArena*)_mg_pages_reserve(alloc_size);
+        _MG_CHECK(arena_internal, MG_ERROR_ARENA_ALLOC_FAILED);
+
+        size_t header_size = _MG_ALIGN_UP(groups_offset + groups_size, _mg_page_size());
+        if (arena_internal && !_mg_pages_commit(arena_internal, header_size, _MG_PAGE_POLICY_DEFAULT, 0))
+        {
+            _mg_pages_release(arena_internal, alloc_size);
+            arena_internal = NULL;
+            _MG_CHECK(false, MG_ERROR_ARENA_ALLOC_FAILED);
+        }
+    }
+    else
+    {
+        arena_internal = (_MgArena*)_mg_aligned_alloc(alloc_size, MG_CACHE_LINE_SIZE);
+        _MG_CHECK(arena_internal, MG_ERROR_ARENA_ALLOC_FAILED);
+        if (arena_internal)
+        {
+            memset((void*)arena_internal, 0, alloc_size);
+        }
     }
 
-    _MgArena* arena_internal = (_MgArena*)malloc(alloc_size);
-    _MG_CHECK(arena_internal, MG_ERROR_ARENA_ALLOC_FAILED);
-    memset((void*)arena_internal, 0, alloc_size);
+    if (!arena_internal)
+    {
+        return NULL;
+    }
 
-    arena_internal->name        = descriptor->arena_name;
-    arena_internal->group_count = descriptor->handle_descriptors_count;
+    arena_internal->group_count = group_count;
     arena_internal->alloc_size  = alloc_size;
-    arena_internal->groups      = (_MgGroup*)(arena_internal + 1);
+    arena_internal->sync_mode   = descriptor->sync_mode;
+    arena_internal->lock_timing = descriptor->lock_timing;
+    arena_internal->track_dirty = descriptor->track_dirty;
+    arena_internal->alloc_kind  = alloc_kind;
+    arena_internal->backing     = backing;
+    arena_internal->file        = file;
+    _mg_offset_set(&arena_internal->groups, (uint8_t*)arena_internal + groups_offset);
+
+    if (descriptor->arena_name)
+    {
+        strncpy(arena_internal->name, descriptor->arena_name, _MG_ARENA_NAME_SIZE - 1); // zeroed, stays terminated
+    }
 
-    uintptr_t slots_start = (uintptr_t)(arena_internal->groups + arena_internal->group_count);
+    uintptr_t group_start = (uintptr_t)_mg_arena_groups(arena_internal) + groups_size;
 
     for (uint32_t i = 0; i < arena_internal->group_count; i++)
     {
-        _MgGroup* group = &arena_internal->groups[i];
-        _mg_group_init(group, slots_start, &descriptor->handle_descriptors[i]);
-        slots_start += (uintptr_t)group->slot_count * sizeof(_MgSlot);      // move addr pass slots
-        slots_start += (uintptr_t)group->slot_count * group->handle_stride; // move addr pass data
+        _MgGroupSpec spec;
+        _mg_group_spec(descriptor, i, &spec);
+        group_start = _MG_ALIGN_UP(group_start, _mg_group_alignment(&spec.handle));
+
+        _MgGroup* group = &_mg_arena_groups(arena_internal)[i];
+        MgStatus status = _mg_group_init(arena_internal, group, group_start, &spec.handle);
+        if (status != MG_SUCCESS)
+        {
+            _mg_arena_free(arena_internal);
+            return NULL;
+        }
+        group->class_count = spec.class_count;
+        group->size_class  = spec.size_class;
+        group_start += (uintptr_t)group->size; // move addr pass shards, slots and data
+    }
+
+    if (shared_name)
+    {
+        strcpy(arena_internal->shared_name, shared_name);
+        arena_internal->shared_creator = _mg_process_id();
+        _mg_atomic_store_u32(&arena_internal->shared_ready, 1);
+    }
+
+    if (file_path)
+    {
+        // the file holds a complete arena before the caller gets to change it
+        arena_internal->file_open = 1;
+        if (!_mg_arena_file_sync(arena_internal, false))
+        {
+            _MG_CHECK(false, MG_ERROR_FILE_SYNC_FAILED);
+            _mg_arena_free(arena_internal);
+            return NULL;
+        }
+    }
+
+    if (descriptor->copy_on_write)
+    {
+        // the initialized arena is the first snapshot
+        if (!_mg_memfile_commit(&backing, arena_internal, alloc_size))
+        {
+            _MG_CHECK(false, MG_ERROR_ARENA_ALLOC_FAILED);
+            _mg_arena_free(arena_internal);
+            return NULL;
+        }
     }
 
     return (MgArena*)arena_internal;
@@ -96,24 +387,151 @@ MgArena* mg_arena_init(MgArenaDescriptor* descriptor)
 void mg_arena_destroy(MgArena** arena)
 {
     _MG_CHECK(arena && *arena, MG_ERROR_ARENA_INVALID);
-    free(*arena);
+
+    _MgArena* arena_internal = (_MgArena*)*arena;
+    if (arena_internal->log)
+    {
+        _mg_log_close(arena_internal->log); // flushes whatever is still buffered
+    }
+    if (arena_internal->publisher)
+    {
+        _mg_log_close(arena_internal->publisher);
+    }
+
+    _mg_arena_free(arena_internal);
     *arena = NULL;
 }
 
+size_t mg_arena_size(MgArena* arena)
+{
+    _MG_CHECK(arena, MG_ERROR_ARENA_INVALID);
+    return ((_MgArena*)arena)->alloc_size;
+}
+
+MgArena* mg_arena_clone(MgArena* src)
+{
+    _MG_CHECK(src, MG_ERROR_ARENA_INVALID);
+    _MgArena* source = (_MgArena*)src;
+
+    // the block only refers to itself through offsets, so the copy needs no fix up pass once the bytes are moved
+    size_t header_size       = (size_t)((uint8_t*)&_mg_arena_groups(source)[source->group_count] - (uint8_t*)source);
+    _MgArena* arena_internal = NULL;
+
+    if (source->alloc_kind == _MG_ARENA_ALLOC_PAGES)
+    {
+        // same placement as the source: every group is committed with its policy before the copy first touches it.
+        // only the header and the groups are copied, the alignment gaps between them may not even be committed.
+        arena_internal = (_MgArena*)_mg_pages_reserve(source->alloc_size);
+        _MG_CHECK(arena_internal, MG_ERROR_ARENA_ALLOC_FAILED);
+
+        bool committed = arena_internal &&
+        _mg_pages_commit(arena_internal, _MG_ALIGN_UP(header_size, _mg_page_size()), _MG_PAGE_POLICY_DEFAULT, 0);
+        if (committed)
+        {
+            memcpy((void*)arena_internal, source, header_size);
+        }
+
+        for (uint32_t i = 0; committed && i < arena_internal->group_count; i++)
+        {
+            _MgGroup* group = &_mg_arena_groups(arena_internal)[i];
+            committed       = _mg_group_place(arena_internal, group, (uintptr_t)_mg_group_shards(group));
+            if (committed)
+            {
+                _mg_block_copy(_mg_group_shards(group), _mg_group_shards(&_mg_arena_groups(source)[i]), group->size);
+            }
+        }
+
+        if (arena_internal && !committed)
+        {
+            _mg_pages_release(arena_internal, source->alloc_size);
+            arena_internal = NULL;
+            _MG_CHECK(false, MG_ERROR_ARENA_ALLOC_FAILED);
+        }
+    }
+    else
+    {
+        // heap and mapped sources are one committed range, copied as a whole
+        arena_internal = (_MgArena*)_mg_aligned_alloc(source->alloc_size, MG_CACHE_LINE_SIZE);
+        _MG_CHECK(arena_internal, MG_ERROR_ARENA_ALLOC_FAILED);
+        if (arena_internal)
+        {
+            _mg_block_copy(arena_internal, source, source->alloc_size);
+            arena_internal->alloc_kind = _MG_ARENA_ALLOC_HEAP;
+        }
+    }
+
+    if (!arena_internal)
+    {
+        return NULL;
+    }
+
+    // the clone starts its own history: no log, no thread owners, and no snapshot for deltas to chain onto
+    arena_internal->checkpoint_base     = 0;
+    arena_internal->checkpoint_sequence = 0;
+    _mg_arena_reset_process_state(arena_internal);
+
+    return (MgArena*)arena_internal;
+}
+
 MgHandle mg_handle_create(MgArena* arena, uint32_t handle_type)
 {
     _MG_CHECK(arena, MG_ERROR_ARENA_INVALID);
     _MgArena* arena_internal = (_MgArena*)arena;
 
     _MgGroup* group = _mg_group_query(arena_internal, handle_type);
-    if (group)
+    if (!group)
+    {
+        _MG_CHECK(false, MG_ERROR_HANDLE_CREATION_FAILED);
+        return (MgHandle){ 0, 0 }; // invalid
+    }
+
+    bool logged          = (arena_internal->log || arena_internal->publisher);
+    _MgLogTicket ticket  = { 0 };
+    uint32_t slot_handle = _mg_group_slot_create(arena_internal, group, logged ? &ticket : NULL);
+    _MG_CHECK(slot_handle != _MG_HANDLE_INVALID, MG_ERROR_GROUP_EXHAUSTED);
+
+    // the handle exists either way, a record the log could not take is reported like it is for every other call
+    bool committed = !logged || _mg_arena_log_commit(arena_internal, &ticket);
+    _MG_CHECK(committed, MG_ERROR_LOG_IO_FAILED);
+
+    return (MgHandle){ slot_handle, handle_type };
+}
+
+static uint32_t _mg_group_slot_create(_MgArena* arena_internal, _MgGroup* group, _MgLogTicket* ticket)
+{
+    uint32_t slot_handle = _MG_HANDLE_INVALID;
+
+    if (arena_internal->sync_mode == MG_ARENA_SYNC_THREAD_OWNED)
+    {
+        // only ever the caller's own shard, nobody else allocates from it so no lock is needed
+        _MgShard* shard = _mg_group_owned_shard(group);
+        _MG_CHECK(shard, MG_ERROR_THREAD_NOT_ATTACHED);
+
+        if (shard)
+        {
+            if (_mg_atomic_load_u32(&shard->remote_free_head) != 0)
+            {
+                _mg_shard_remote_drain(arena_internal, group, shard);
+            }
+            slot_handle = _mg_shard_slot_alloc(arena_internal, group, shard, ticket);
+        }
+    }
+    else
     {
-        uint32_t slot_handle = _mg_group_slot_alloc(group);
-        return (MgHandle){ slot_handle, handle_type };
+        // start at the shard of the core we are running on, fall over to the others once it is full
+        uint32_t home_shard = group->shard_count > 1 ? _mg_cpu_current() % group->shard_count : 0;
+
+        for (uint32_t i = 0; i < group->shard_count && slot_handle == _MG_HANDLE_INVALID; i++)
+        {
+            _MgShard* shard = &_mg_group_shards(group)[(home_shard + i) % group->shard_count];
+
+            _mg_shard_lock(arena_internal, shard);
+            slot_handle = _mg_shard_slot_alloc(arena_internal, group, shard, ticket);
+            _mg_shard_unlock(arena_internal, shard);
+        }
     }
 
-    _MG_CHECK(false, MG_ERROR_HANDLE_CREATION_FAILED);
-    return (MgHandle){ 0, 0 }; // invalid
+    return slot_handle;
 }
 
 MgStatus mg_handle_write(MgArena* arena, MgHandle handle, const void* data, size_t data_size)
@@ -125,21 +543,108 @@ MgStatus mg_handle_write(MgArena* arena, MgHandle handle, const void* data, size
 
     _MgGroup* group = _mg_group_query(arena_internal, handle.type);
     _MG_STATUS(group, MG_ERROR_GROUP_QUERY_FAILED);
-    _MG_STATUS(data_size <= group->handle_stride, MG_ERROR_DATA_INVALID);
+    _MG_STATUS(data_size <= _mg_group_max_size(group), MG_ERROR_DATA_INVALID);
 
     uint32_t slot_index = MG_DECODE_INDEX(handle.slot_handle);
-    _MgSlot* slot       = &group->slots[slot_index];
-    _MG_STATUS(slot && slot->status == _MG_SLOT_STATUS_VALID_ALLOC, MG_ERROR_HANDLE_WRITE_FAILED);
+    _MG_STATUS(slot_index < group->slot_count, MG_ERROR_HANDLE_INVALID);
+    _MG_STATUS(data_size >= _mg_group_keys_end(group), MG_ERROR_DATA_INVALID);
+
+    _MgSlot* slot   = &_mg_group_slots(group)[slot_index];
+    _MgShard* shard = _mg_group_shard(group, slot_index);
+
+    _mg_shard_lock(arena_internal, shard);
+
+    // fixed size handles are written once, variable size ones may be written again with any size
+    MgStatus status = MG_ERROR_HANDLE_WRITE_FAILED;
+    bool written    = (slot->status == _MG_SLOT_STATUS_VALID_WRITE && slot->handle == handle.slot_handle);
+    bool allocated  = (slot->status == _MG_SLOT_STATUS_VALID_ALLOC && slot->handle == handle.slot_handle);
+    bool writable   = (allocated || (group->class_count && written));
+
+    // the key is claimed before the payload goes in, so a taken key leaves the handle as it was
+    uint64_t key     = 0;
+    uint64_t old_key = 0;
+    if (writable && group->index_capacity)
+    {
+        memcpy(&key, (const uint8_t*)data + group->key_offset, sizeof(key));
+        old_key  = written ? _mg_index_key(group, slot_index) : 0;
+        writable = written ? _mg_index_replace(arena_internal, group, old_key, key, slot->handle)
+                           : _mg_index_insert(arena_internal, group, key, slot->handle);
+        status   = writable ? status : MG_ERROR_INDEX_KEY_EXISTS;
+    }
+    bool keyed = (writable && group->index_capacity);
+
+    // so is its place in the ordered index, a rewrite that keeps the order key keeps the pair it has
+    uint64_t order     = 0;
+    uint64_t old_order = (writable && written && group->order_capacity) ? _mg_order_key(group, slot_index) : 0;
+    bool reordered     = false;
+    if (writable && group->order_capacity)
+    {
+        order     = _mg_order_encode(group->order_type, (const uint8_t*)data + group->order_offset);
+        reordered = !written || order != old_order;
+        writable  = !reordered || _mg_order_insert(arena_internal, group, order, slot->handle);
+        reordered = reordered && writable;
+        status    = writable ? status : MG_ERROR_ORDER_POOL_FULL;
+    }
+
+    if (writable && group->class_count)
+    {
+        status = _mg_variable_write(arena_internal, group, slot_index, data, data_size);
+    }
+    else if (writable)
+    {
+        _mg_group_store(group, slot_index, data, data_size);
 
-    uint8_t* slot_data = group->data + (slot_index * group->handle_stride);
-    memcpy((void*)slot_data, data, data_size);
+        _mg_slot_publish(slot, _MG_SLOT_STATUS_VALID_WRITE);
+        _mg_group_mark_dirty(arena_internal, group, slot_index);
+        _mg_group_mark_live(arena_internal, group, slot_index, true);
+        status = MG_SUCCESS;
+    }
+
+    if (keyed && status != MG_SUCCESS) // the payload stayed, so does its key
+    {
+        if (written)
+        {
+            _mg_index_replace(arena_internal, group, key, old_key, slot->handle);
+        }
+        else
+        {
+            _mg_index_remove(arena_internal, group, key);
+        }
+    }
+
+    if (reordered && status != MG_SUCCESS)
+    {
+        _mg_order_remove(arena_internal, group, order, slot->handle);
+    }
+    else if (reordered && written)
+    {
+        _mg_order_remove(arena_internal, group, old_order, slot->handle);
+    }
+
+    bool logged         = (arena_internal->log || arena_internal->publisher);
+    _MgLogTicket ticket = { 0 };
+    if (status == MG_SUCCESS && logged)
+    {
+        _mg_arena_log_enqueue(arena_internal, _MG_LOG_OP_WRITE, handle.type, handle.slot_handle, data,
+        (uint32_t)data_size, &ticket);
+    }
+
+    _mg_shard_unlock(arena_internal, shard);
 
-    slot->status = _MG_SLOT_STATUS_VALID_WRITE;
+    _MG_STATUS(status == MG_SUCCESS, status);
+
+    bool committed = !logged || _mg_arena_log_commit(arena_internal, &ticket);
+    _MG_STATUS(committed, MG_ERROR_LOG_IO_FAILED);
 
     return MG_SUCCESS;
 }
 
 const void* mg_handle_read(MgArena* arena, MgHandle handle)
+{
+    return mg_handle_read_sized(arena, handle, NULL);
+}
+
+const void* mg_handle_read_sized(MgArena* arena, MgHandle handle, size_t* data_size)
 {
     _MG_CHECK(arena, MG_ERROR_ARENA_INVALID);
     _MG_CHECK(handle.slot_handle != _MG_HANDLE_INVALID, MG_ERROR_HANDLE_INVALID);
@@ -149,10 +654,33 @@ const void* mg_handle_read(MgArena* arena, MgHandle handle)
     _MG_CHECK(group, MG_ERROR_GROUP_QUERY_FAILED);
 
     uint32_t slot_index = MG_DECODE_INDEX(handle.slot_handle);
-    _MgSlot* slot       = &group->slots[slot_index];
-    _MG_CHECK(slot && (slot->status == _MG_SLOT_STATUS_VALID_WRITE), MG_ERROR_HANDLE_READ_FAILED);
+    _MG_CHECK(slot_index < group->slot_count, MG_ERROR_HANDLE_INVALID);
+    _MG_CHECK(!group->column_count, MG_ERROR_GROUP_COLUMNAR); // no record to point at, see mg_handle_read_field
+
+    _MgSlot* slot   = &_mg_group_slots(group)[slot_index];
+    _MgShard* shard = _mg_group_shard(group, slot_index);
+
+    // other processes may have mapped a shared arena readonly, so its readers never take the lock
+    bool locked = !_mg_arena_shared(arena_internal);
+    if (locked)
+    {
+        _mg_shard_lock(arena_internal, shard);
+    }
+    bool readable = (_mg_slot_status(slot) == _MG_SLOT_STATUS_VALID_WRITE && slot->handle == handle.slot_handle);
+    size_t size   = 0;
+    uint8_t* data = readable ? _mg_group_payload(group, slot_index, &size) : NULL; // a rewrite may move it
+    if (locked)
+    {
+        _mg_shard_unlock(arena_internal, shard);
+    }
 
-    return (void*)(group->data + (slot_index * group->handle_stride));
+    _MG_CHECK(readable, MG_ERROR_HANDLE_READ_FAILED);
+
+    if (data_size)
+    {
+        *data_size = size;
+    }
+    return (void*)data;
 }
 
 void mg_handle_erase(MgArena* arena, MgHandle handle)
@@ -164,16 +692,71 @@ void mg_handle_erase(MgArena* arena, MgHandle handle)
     _MG_CHECK(group, MG_ERROR_GROUP_QUERY_FAILED);
 
     uint32_t slot_index = MG_DECODE_INDEX(handle.slot_handle);
-    _MgSlot* slot       = &group->slots[slot_index];
-    _MG_CHECK(slot && (slot->status == _MG_SLOT_STATUS_VALID_WRITE), MG_ERROR_HANDLE_ERASE_FAILED);
+    _MG_CHECK(slot_index < group->slot_count, MG_ERROR_HANDLE_INVALID);
+
+    bool logged         = (arena_internal->log || arena_internal->publisher);
+    _MgLogTicket ticket = { 0 };
+    bool erasable       = slot_index < group->slot_count &&
+                    _mg_group_slot_erase(arena_internal, group, handle.slot_handle, logged ? &ticket : NULL);
 
-    slot->handle = 0;
-    slot->status = _MG_SLOT_STATUS_FREE;
+    _MG_CHECK(erasable, MG_ERROR_HANDLE_ERASE_FAILED);
 
-    memset((void*)(group->data + (slot_index * group->handle_stride)), 0, group->handle_stride);
+    bool committed = !erasable || !logged || _mg_arena_log_commit(arena_internal, &ticket);
+    _MG_CHECK(committed, MG_ERROR_LOG_IO_FAILED);
+}
+
+static bool _mg_group_slot_erase(_MgArena* arena_internal, _MgGroup* group, uint32_t slot_handle,
+_MgLogTicket* ticket)
+{
+    uint32_t slot_index = MG_DECODE_INDEX(slot_handle);
+    _MgSlot* slot       = &_mg_group_slots(group)[slot_index];
+    _MgShard* shard     = _mg_group_shard(group, slot_index);
+
+    _mg_shard_lock(arena_internal, shard);
+
+    // a handle defragment moved away from may point at a slot someone else holds by now
+    bool erasable = (slot->status == _MG_SLOT_STATUS_VALID_WRITE && slot->handle == slot_handle);
+    if (erasable)
+    {
+        if (_mg_group_has_indexes(group))
+        {
+            _mg_group_unindex(arena_internal, group, slot_index); // while the payload still has its keys
+        }
+        if (group->class_count)
+        {
+            _mg_variable_release(arena_internal, group, slot_index);
+        }
+        if (group->blob_capacity)
+        {
+            _mg_blob_release(arena_internal, group, slot_index);
+        }
+        if (ticket)
+        {
+            _mg_arena_log_enqueue(arena_internal, _MG_LOG_OP_ERASE, group->handle_type, slot->handle, NULL, 0, ticket);
+        }
+
+        slot->handle = 0;
+        slot->status = _MG_SLOT_STATUS_FREE;
+        _mg_group_mark_dirty(arena_internal, group, slot_index);
+        _mg_group_mark_live(arena_internal, group, slot_index, false);
+
+        _mg_group_store(group, slot_index, NULL, 0);
 
-    slot->next_free_index = group->free_list_head;
-    group->free_list_head = slot_index;
+        bool remote = (arena_internal->sync_mode == MG_ARENA_SYNC_THREAD_OWNED && shard->owner != _mg_thread_token());
+        if (remote)
+        {
+            _mg_shard_remote_push(group, shard, slot_index); // the owner picks it up on its next create
+        }
+        else
+        {
+            slot->next_free_index = shard->free_list_head; // slots always return to the shard that owns them
+            shard->free_list_head = slot_index;
+        }
+    }
+
+    _mg_shard_unlock(arena_internal, shard);
+
+    return erasable;
 }
 
 bool mg_handle_valid(MgArena* arena, MgHandle handle)
@@ -193,93 +776,1461 @@ bool mg_handle_valid(MgArena* arena, MgHandle handle)
 
         if (valid)
         {
-            _MgSlot* slot = &group->slots[slot_index];
-            valid &= (slot->status == _MG_SLOT_STATUS_VALID_WRITE);
+            _MgSlot* slot   = &_mg_group_slots(group)[slot_index];
+            _MgShard* shard = _mg_group_shard(group, slot_index);
+
+            bool locked = !_mg_arena_shared(arena_internal);
+            if (locked)
+            {
+                _mg_shard_lock(arena_internal, shard);
+            }
+            valid &= (_mg_slot_status(slot) == _MG_SLOT_STATUS_VALID_WRITE);
             valid &= (slot->generation == MG_DECODE_GENERATION(handle.slot_handle));
+            if (locked)
+            {
+                _mg_shard_unlock(arena_internal, shard);
+            }
         }
     }
 
     return valid;
 }
 
-void mg_arena_print(MgArena* arena)
+MgStatus mg_handle_blob_write(MgArena* arena, MgHandle handle, const void* data, size_t data_size)
 {
-    _MG_CHECK(arena, MG_ERROR_ARENA_INVALID);
+    _MG_STATUS(arena, MG_ERROR_ARENA_INVALID);
+    _MG_STATUS(data && data_size > 0, MG_ERROR_DATA_INVALID);
     _MgArena* arena_internal = (_MgArena*)arena;
 
-    printf("=== Arena Layout ===\n");
-    printf("Arena Name: %s\n", arena_internal->name);
-    printf("Block Count: %u\n", arena_internal->group_count);
-    printf("Arena Payload Size: %zu bytes\n", arena_internal->alloc_size);
-    printf("Arena Header Address: %p\n", (void*)arena_internal);
+    _MgGroup* group = _mg_group_query(arena_internal, handle.type);
+    _MG_STATUS(group, MG_ERROR_GROUP_QUERY_FAILED);
+    _MG_STATUS(group->blob_capacity > 0, MG_ERROR_GROUP_NO_BLOBS);
 
-    for (uint32_t i = 0; i < arena_internal->group_count; i++)
-    {
-        _MgGroup* group = &arena_internal->groups[i];
+    uint32_t slot_index = MG_DECODE_INDEX(handle.slot_handle);
+    _MG_STATUS(slot_index != 0 && slot_index < group->slot_count, MG_ERROR_HANDLE_INVALID);
 
-        printf("\n[[ Group %u ]]:", i);
-        printf("Header Address: [0x%p]\n", (void*)group);
-        printf("Slot Array Address: [0x%p]\n", (void*)group->slots);
-        printf("Data Block Address: [0x%p]\n", (void*)group->data);
-        printf("Total Group Size: (%zu bytes)\n", group->size);
+    _MgSlot* slot   = &_mg_group_slots(group)[slot_index];
+    _MgShard* shard = _mg_group_shard(group, slot_index);
 
-        printf("Handle Desc: [type: %u, stride: %u]\n", group->handle_type, group->handle_stride);
-        printf("Mutable State: [next slot index: %u]\n", group->free_list_head);
+    // the shard lock keeps the handle from being erased while its blob goes in
+    _mg_shard_lock(arena_internal, shard);
+    MgStatus status = MG_ERROR_HANDLE_INVALID;
+    if (slot->status == _MG_SLOT_STATUS_VALID_WRITE && slot->handle == handle.slot_handle)
+    {
+        status = _mg_blob_write(arena_internal, group, slot_index, data, data_size);
+    }
+    bool logged         = (arena_internal->log || arena_internal->publisher);
+    _MgLogTicket ticket = { 0 };
+    if (status == MG_SUCCESS && logged)
+    {
+        _mg_arena_log_enqueue(arena_internal, _MG_LOG_OP_BLOB, handle.type, handle.slot_handle, data,
+        (uint32_t)data_size, &ticket);
     }
+    _mg_shard_unlock(arena_internal, shard);
 
-    printf("===============\n\n");
+    _MG_STATUS(status == MG_SUCCESS, status);
+
+    bool committed = !logged || _mg_arena_log_commit(arena_internal, &ticket);
+    _MG_STATUS(committed, MG_ERROR_LOG_IO_FAILED);
+
+    return MG_SUCCESS;
 }
 
-static MgStatus _mg_group_init(_MgGroup* group, uintptr_t slots_start, MgHandleDescriptor* descriptor)
+const void* mg_handle_blob_read(MgArena* arena, MgHandle handle, size_t* data_size)
 {
-    _MG_STATUS(group && descriptor, MG_ERROR_GROUP_CREATION_FAILED);
-    _MG_STATUS(descriptor->count > 0 && descriptor->stride > 0, MG_ERROR_GROUP_CREATION_FAILED);
+    _MG_CHECK(arena, MG_ERROR_ARENA_INVALID);
+    _MgArena* arena_internal = (_MgArena*)arena;
 
-    size_t slot_count = descriptor->count + 1; // include invalid slot 0
+    _MgGroup* group = _mg_group_query(arena_internal, handle.type);
+    _MG_CHECK(group && group->blob_capacity > 0, MG_ERROR_GROUP_NO_BLOBS);
 
-    group->slots = (_MgSlot*)slots_start;
-    group->data  = (uint8_t*)(slots_start + slot_count * sizeof(_MgSlot));
+    uint32_t slot_index = MG_DECODE_INDEX(handle.slot_handle);
+    bool valid          = group && group->blob_capacity > 0 && slot_index != 0 && slot_index < group->slot_count;
+    _MG_CHECK(valid, MG_ERROR_HANDLE_INVALID);
+    if (!valid)
+    {
+        return NULL;
+    }
 
-    group->slot_count    = (uint32_t)slot_count;
-    group->handle_type   = descriptor->type;
-    group->handle_stride = descriptor->stride;
-    group->size          = slot_count * (sizeof(_MgSlot) + descriptor->stride);
+    _MgSlot* slot   = &_mg_group_slots(group)[slot_index];
+    _MgShard* shard = _mg_group_shard(group, slot_index);
 
-    group->slots[0].handle     = 0; // invalid slot 0
-    group->slots[0].generation = 0;
-    group->slots[0].status     = _MG_SLOT_STATUS_INVALID;
+    bool locked = !_mg_arena_shared(arena_internal);
+    if (locked)
+    {
+        _mg_shard_lock(arena_internal, shard);
+    }
+    bool readable       = (_mg_slot_status(slot) == _MG_SLOT_STATUS_VALID_WRITE && slot->handle == handle.slot_handle);
+    size_t size         = 0;
+    const uint8_t* blob = readable ? _mg_blob_payload(arena_internal, group, slot_index, &size) : NULL;
+    if (locked)
+    {
+        _mg_shard_unlock(arena_internal, shard);
+    }
 
-    group->free_list_head = 1; // free list for slots 1..N
+    _MG_CHECK(readable, MG_ERROR_HANDLE_READ_FAILED);
 
-    for (uint32_t i = 1; i < slot_count; i++)
+    if (data_size)
     {
-        _MgSlot* slot    = &group->slots[i];
-        slot->status     = _MG_SLOT_STATUS_FREE;
-        slot->generation = 0;
+        *data_size = size;
+    }
+    return (const void*)blob;
+}
 
-        if (i < slot_count - 1)
+MgStatus mg_group_compact(MgArena* arena, MgHandleType handle_type)
+{
+    _MG_STATUS(arena, MG_ERROR_ARENA_INVALID);
+    _MgArena* arena_internal = (_MgArena*)arena;
+
+    _MgGroup* group = _mg_group_query(arena_internal, handle_type);
+    _MG_STATUS(group, MG_ERROR_GROUP_QUERY_FAILED);
+    _MG_STATUS(group->blob_capacity > 0, MG_ERROR_GROUP_NO_BLOBS);
+
+    // only blobs move, handles and their contents stay the same, so there is nothing to log
+    _mg_blob_compact(arena_internal, group);
+
+    return MG_SUCCESS;
+}
+
+MgStatus mg_group_reset(MgArena* arena, MgHandleType handle_type)
+{
+    _MG_STATUS(arena, MG_ERROR_ARENA_INVALID);
+    _MgArena* arena_internal = (_MgArena*)arena;
+
+    _MgGroup* group = _mg_group_query(arena_internal, handle_type);
+    _MG_STATUS(group, MG_ERROR_GROUP_QUERY_FAILED);
+
+    bool logged         = (arena_internal->log || arena_internal->publisher);
+    _MgLogTicket ticket = { 0 };
+    _mg_group_reset(arena_internal, group, logged ? &ticket : NULL);
+
+    bool committed = !logged || _mg_arena_log_commit(arena_internal, &ticket);
+    _MG_STATUS(committed, MG_ERROR_LOG_IO_FAILED);
+
+    return MG_SUCCESS;
+}
+
+void _mg_group_reset(_MgArena* arena_internal, _MgGroup* group, _MgLogTicket* ticket)
+{
+    // every shard of the group and of its size classes is held at once, in the order writes take them, so no one
+    // sees the group half reset
+    for (uint32_t i = 0; i <= group->class_count; i++)
+    {
+        for (uint32_t j = 0; j < group[i].shard_count; j++)
+        {
+            _mg_shard_lock(arena_internal, &_mg_group_shards(&group[i])[j]);
+        }
+    }
+
+    for (uint32_t i = 0; i <= group->class_count; i++)
+    {
+        _MgGroup* reset = &group[i];
+        _MgSlot* slots  = _mg_group_slots(reset);
+
+        // slots keep their generation, so handles from before the reset never match a slot created after it.
+        // only used slots are cleared, pages no slot ever touched stay uncommitted.
+        for (uint32_t j = 1; j < reset->slot_count; j++)
+        {
+            if (slots[j].status != _MG_SLOT_STATUS_FREE)
+            {
+                _mg_group_store(reset, j, NULL, 0);
+                slots[j].handle = 0;
+                slots[j].status = _MG_SLOT_STATUS_FREE;
+                _mg_group_mark_dirty(arena_internal, reset, j);
+            }
+        }
+        _mg_group_rebuild_free_lists(reset);
+    }
+
+    if (group->blob_capacity)
+    {
+        _mg_blob_reset(arena_internal, group);
+    }
+    if (group->index_capacity)
+    {
+        _mg_index_clear(arena_internal, group);
+    }
+    if (group->order_capacity)
+    {
+        _mg_order_clear(arena_internal, group);
+    }
+    if (ticket)
+    {
+        _mg_arena_log_enqueue(arena_internal, _MG_LOG_OP_RESET, group->handle_type, 0, NULL, 0, ticket);
+    }
+
+    for (uint32_t i = group->class_count + 1; i-- > 0;)
+    {
+        for (uint32_t j = group[i].shard_count; j-- > 0;)
+        {
+            _mg_shard_unlock(arena_internal, &_mg_group_shards(&group[i])[j]);
+        }
+    }
+}
+
+MgStatus mg_group_defragment(MgArena* arena, MgHandleType handle_type, size_t byte_budget,
+uint64_t time_budget_ns, MgRelocateFn fn, void* ctx, bool* packed)
+{
+    _MG_STATUS(arena, MG_ERROR_ARENA_INVALID);
+    _MgArena* arena_internal = (_MgArena*)arena;
+
+    _MgGroup* group = _mg_group_query(arena_internal, handle_type);
+    _MG_STATUS(group, MG_ERROR_GROUP_QUERY_FAILED);
+
+    bool logged     = (arena_internal->log || arena_internal->publisher);
+    uint8_t* record = (logged && group->column_count) ? (uint8_t*)malloc(group->handle_stride) : NULL;
+    _MG_STATUS(!logged || !group->column_count || record, MG_ERROR_ARENA_ALLOC_FAILED);
+
+    _MgSlot* slots      = _mg_group_slots(group);
+    uint64_t start      = time_budget_ns ? _mg_time_ns() : 0;
+    size_t moved        = 0;
+    bool done           = true;
+    _MgLogTicket ticket = { 0 };
+
+    for (uint32_t i = 0; i < group->shard_count && done && !ticket.failed; i++)
+    {
+        _MgShard* shard = &_mg_group_shards(group)[i];
+        uint32_t first  = shard->slot_begin > 0 ? shard->slot_begin : 1;
+        uint32_t high   = shard->slot_end;
+        bool relocated  = false;
+
+        // sorted, the free list hands out the lowest free slot first. the slots moved out of stay unlinked until
+        // the shard is done, so nothing is ever moved back into them.
+        _mg_shard_lock(arena_internal, shard);
+        _mg_shard_rebuild_free_list(group, shard);
+        _mg_shard_unlock(arena_internal, shard);
+
+        for (;;)
+        {
+            bool spent = moved > 0 && ((byte_budget && moved >= byte_budget) ||
+                                       (time_budget_ns && _mg_time_ns() - start >= time_budget_ns));
+
+            _mg_shard_lock(arena_internal, shard);
+            while (high > first && slots[high - 1].status == _MG_SLOT_STATUS_FREE)
+            {
+                high--;
+            }
+            uint32_t from = high - 1;
+            uint32_t to   = shard->free_list_head;
+            bool movable  = high > first && to != 0 && to < from;
+
+            if (!movable || spent || ticket.failed)
+            {
+                if (relocated)
+                {
+                    _mg_shard_rebuild_free_list(group, shard);
+                }
+                _mg_shard_unlock(arena_internal, shard);
+                done = !movable;
+                break;
+            }
+
+            uint32_t from_handle  = slots[from].handle;
+            shard->free_list_head = slots[to].next_free_index;
+            uint32_t to_handle    = _mg_group_slot_move(arena_internal, group, from, to);
+            relocated             = true;
+            if (logged)
+            {
+                _mg_group_log_move(arena_internal, group, from_handle, to_handle, record, &ticket);
+            }
+            _mg_shard_unlock(arena_internal, shard);
+
+            moved += group->handle_stride;
+            if (fn)
+            {
+                fn((MgHandle){ from_handle, handle_type }, (MgHandle){ to_handle, handle_type }, ctx);
+            }
+        }
+    }
+    free(record);
+
+    bool committed = !logged || _mg_arena_log_commit(arena_internal, &ticket);
+    _MG_STATUS(committed, MG_ERROR_LOG_IO_FAILED);
+
+    if (packed)
+    {
+        *packed = done;
+    }
+    return MG_SUCCESS;
+}
+
+static uint32_t _mg_group_slot_move(_MgArena* arena_internal, _MgGroup* group, uint32_t from, uint32_t to)
+{
+    _MgSlot* slots = _mg_group_slots(group);
+    bool written   = (slots[from].status == _MG_SLOT_STATUS_VALID_WRITE);
+
+    if (written && _mg_group_has_indexes(group))
+    {
+        _mg_group_unindex(arena_internal, group, from); // while the keys still sit under the old handle
+    }
+
+    // a variable size record is its ref, so the size class slot changes owners without moving
+    if (!group->column_count)
+    {
+        uint8_t* data = _mg_group_data(group);
+        memcpy(data + (size_t)to * group->handle_stride, data + (size_t)from * group->handle_stride,
+        group->handle_stride);
+    }
+    for (uint32_t i = 0; i < group->column_count; i++)
+    {
+        _MgColumn* column = &_mg_group_columns(group)[i];
+        memcpy(_mg_column_cell(group, column, to), _mg_column_cell(group, column, from), column->size);
+    }
+    _mg_group_store(group, from, NULL, 0);
+    if (group->blob_capacity)
+    {
+        _mg_blob_move(arena_internal, group, from, to);
+    }
+
+    // a new generation like any create, so the old handle never matches the slot it came from or went to
+    uint32_t generation = ++(slots[to].generation);
+    slots[to].handle    = MG_ENCODE_HANDLE(to, generation);
+    slots[to].status    = slots[from].status;
+    slots[from].handle  = 0;
+    slots[from].status  = _MG_SLOT_STATUS_FREE;
+    _mg_group_mark_dirty(arena_internal, group, to);
+    _mg_group_mark_dirty(arena_internal, group, from);
+    _mg_group_mark_live(arena_internal, group, to, written);
+    _mg_group_mark_live(arena_internal, group, from, false);
+
+    if (written && group->index_capacity)
+    {
+        _mg_index_insert(arena_internal, group, _mg_index_key(group, to), slots[to].handle);
+    }
+    if (written && group->order_capacity)
+    {
+        _mg_order_insert(arena_internal, group, _mg_order_key(group, to), slots[to].handle);
+    }
+
+    return slots[to].handle;
+}
+
+static void _mg_group_log_move(_MgArena* arena_internal, _MgGroup* group, uint32_t from_handle, uint32_t to_handle,
+uint8_t* record, _MgLogTicket* ticket)
+{
+    // the log has no move, it is the erase of the old handle and the create of the new one. the erase goes first
+    // so replay takes the keys off the old handle before the new one claims them.
+    MgHandleType type   = group->handle_type;
+    uint32_t slot_index = MG_DECODE_INDEX(to_handle);
+    bool written        = (_mg_group_slots(group)[slot_index].status == _MG_SLOT_STATUS_VALID_WRITE);
+
+    _mg_arena_log_enqueue(arena_internal, _MG_LOG_OP_ERASE, type, from_handle, NULL, 0, ticket);
+    _mg_arena_log_enqueue(arena_internal, _MG_LOG_OP_CREATE, type, to_handle, NULL, 0, ticket);
+
+    if (written)
+    {
+        size_t size         = 0;
+        const uint8_t* data = _mg_group_payload(group, slot_index, &size);
+        if (record)
+        {
+            _mg_group_load(group, slot_index, record);
+            data = record;
+        }
+        _mg_arena_log_enqueue(arena_internal, _MG_LOG_OP_WRITE, type, to_handle, data, (uint32_t)size, ticket);
+    }
+    if (written && group->blob_capacity)
+    {
+        size_t size         = 0;
+        const uint8_t* blob = _mg_blob_payload(arena_internal, group, slot_index, &size);
+        if (blob)
+        {
+            _mg_arena_log_enqueue(arena_internal, _MG_LOG_OP_BLOB, type, to_handle, blob, (uint32_t)size, ticket);
+        }
+    }
+}
+
+MgHandle mg_handle_find(MgArena* arena, MgHandleType handle_type, uint64_t key)
+{
+    _MG_CHECK(arena, MG_ERROR_ARENA_INVALID);
+    _MgArena* arena_internal = (_MgArena*)arena;
+
+    _MgGroup* group = _mg_group_query(arena_internal, handle_type);
+    _MG_CHECK(group && group->index_capacity, MG_ERROR_GROUP_NOT_INDEXED);
+    if (!group || !group->index_capacity)
+    {
+        return (MgHandle){ 0, 0 }; // invalid
+    }
+
+    uint32_t slot_handle = _mg_index_find(arena_internal, group, key);
+    return (MgHandle){ slot_handle, slot_handle ? handle_type : 0 };
+}
+
+MgStatus mg_group_range(MgArena* arena, MgHandleType handle_type, const void* min, const void* max,
+MgForeachFn fn, void* ctx)
+{
+    _MG_STATUS(arena, MG_ERROR_ARENA_INVALID);
+    _MG_STATUS(fn, MG_ERROR_DATA_INVALID);
+    _MgArena* arena_internal = (_MgArena*)arena;
+
+    _MgGroup* group = _mg_group_query(arena_internal, handle_type);
+    _MG_STATUS(group, MG_ERROR_GROUP_QUERY_FAILED);
+    _MG_STATUS(group->order_capacity, MG_ERROR_GROUP_NOT_ORDERED);
+
+    uint64_t key   = min ? _mg_order_encode(group->order_type, (const uint8_t*)min) : 0;
+    uint64_t high  = max ? _mg_order_encode(group->order_type, (const uint8_t*)max) : UINT64_MAX;
+    uint32_t after = 0;
+    bool more      = (key <= high);
+
+    // a batch at a time under the tree's lock, fn runs after it is released. handles erased in between are skipped.
+    uint32_t handles[_MG_ORDER_BATCH];
+    while (more)
+    {
+        uint32_t count = _mg_order_collect(arena_internal, group, &key, &after, high, handles, &more);
+        for (uint32_t i = 0; i < count; i++)
+        {
+            uint32_t slot_index = MG_DECODE_INDEX(handles[i]);
+            _MgSlot* slot       = &_mg_group_slots(group)[slot_index];
+            if (_mg_slot_status(slot) == _MG_SLOT_STATUS_VALID_WRITE && slot->handle == handles[i])
+            {
+                MgHandle handle = { handles[i], handle_type };
+                fn(handle, _mg_group_payload(group, slot_index, NULL), ctx);
+            }
+        }
+    }
+
+    return MG_SUCCESS;
+}
+
+const void* mg_handle_read_field(MgArena* arena, MgHandle handle, uint32_t field)
+{
+    _MG_CHECK(arena, MG_ERROR_ARENA_INVALID);
+    _MgArena* arena_internal = (_MgArena*)arena;
+
+    _MgGroup* group = _mg_group_query(arena_internal, handle.type);
+    _MG_CHECK(group && group->column_count > 0, MG_ERROR_GROUP_NOT_COLUMNAR);
+    _MG_CHECK(!group || field < group->column_count, MG_ERROR_DATA_INVALID);
+
+    uint32_t slot_index = MG_DECODE_INDEX(handle.slot_handle);
+    bool valid          = group && field < group->column_count && slot_index != 0 && slot_index < group->slot_count;
+    _MG_CHECK(valid, MG_ERROR_HANDLE_INVALID);
+    if (!valid)
+    {
+        return NULL;
+    }
+
+    _MgSlot* slot   = &_mg_group_slots(group)[slot_index];
+    _MgShard* shard = _mg_group_shard(group, slot_index);
+
+    bool locked = !_mg_arena_shared(arena_internal);
+    if (locked)
+    {
+        _mg_shard_lock(arena_internal, shard);
+    }
+    bool readable = (_mg_slot_status(slot) == _MG_SLOT_STATUS_VALID_WRITE && slot->handle == handle.slot_handle);
+    if (locked)
+    {
+        _mg_shard_unlock(arena_internal, shard);
+    }
+
+    _MG_CHECK(readable, MG_ERROR_HANDLE_READ_FAILED);
+
+    return readable ? (const void*)_mg_column_cell(group, &_mg_group_columns(group)[field], slot_index) : NULL;
+}
+
+MgStatus mg_handle_write_field(MgArena* arena, MgHandle handle, uint32_t field, const void* data)
+{
+    _MG_STATUS(arena, MG_ERROR_ARENA_INVALID);
+    _MG_STATUS(data, MG_ERROR_DATA_INVALID);
+    _MgArena* arena_internal = (_MgArena*)arena;
+
+    _MgGroup* group = _mg_group_query(arena_internal, handle.type);
+    _MG_STATUS(group, MG_ERROR_GROUP_QUERY_FAILED);
+    _MG_STATUS(group->column_count > 0, MG_ERROR_GROUP_NOT_COLUMNAR);
+    _MG_STATUS(field < group->column_count, MG_ERROR_DATA_INVALID);
+
+    uint32_t slot_index = MG_DECODE_INDEX(handle.slot_handle);
+    _MG_STATUS(slot_index != 0 && slot_index < group->slot_count, MG_ERROR_HANDLE_INVALID);
+
+    // the log only knows whole records, so a logged field write sends the record as it is after the write
+    bool logged     = (arena_internal->log || arena_internal->publisher);
+    uint8_t* record = logged ? (uint8_t*)malloc(group->handle_stride) : NULL;
+    _MG_STATUS(!logged || record, MG_ERROR_ARENA_ALLOC_FAILED);
+
+    _MgSlot* slot     = &_mg_group_slots(group)[slot_index];
+    _MgShard* shard   = _mg_group_shard(group, slot_index);
+    _MgColumn* column = &_mg_group_columns(group)[field];
+
+    _mg_shard_lock(arena_internal, shard);
+    bool written = (slot->status == _MG_SLOT_STATUS_VALID_WRITE && slot->handle == handle.slot_handle);
+    if (written)
+    {
+        memcpy(_mg_column_cell(group, column, slot_index), data, column->size);
+        _mg_group_mark_dirty(arena_internal, group, slot_index);
+    }
+    _MgLogTicket ticket = { 0 };
+    if (written && record)
+    {
+        _mg_group_load(group, slot_index, record);
+        _mg_arena_log_enqueue(arena_internal, _MG_LOG_OP_WRITE, handle.type, handle.slot_handle, record,
+        group->handle_stride, &ticket);
+    }
+    _mg_shard_unlock(arena_internal, shard);
+    free(record);
+
+    _MG_STATUS(written, MG_ERROR_HANDLE_WRITE_FAILED);
+
+    bool committed = !logged || _mg_arena_log_commit(arena_internal, &ticket);
+    _MG_STATUS(committed, MG_ERROR_LOG_IO_FAILED);
+
+    return MG_SUCCESS;
+}
+
+void* mg_group_column(MgArena* arena, MgHandleType handle_type, uint32_t field, size_t* row_count)
+{
+    _MG_CHECK(arena, MG_ERROR_ARENA_INVALID);
+    _MgArena* arena_internal = (_MgArena*)arena;
+
+    _MgGroup* group = _mg_group_query(arena_internal, handle_type);
+    _MG_CHECK(group && group->column_count > 0, MG_ERROR_GROUP_NOT_COLUMNAR);
+
+    bool valid = group && field < group->column_count;
+    _MG_CHECK(valid, MG_ERROR_DATA_INVALID);
+    if (!valid)
+    {
+        return NULL;
+    }
+
+    if (row_count)
+    {
+        *row_count = group->slot_count; // row 0 belongs to the invalid slot and stays zero
+    }
+    return _mg_column_cell(group, &_mg_group_columns(group)[field], 0);
+}
+
+uint32_t mg_handle_row(MgHandle handle)
+{
+    return MG_DECODE_INDEX(handle.slot_handle);
+}
+
+MgStatus mg_group_scan(MgArena* arena, MgHandleType handle_type, uint32_t field, MgScanOp op, const void* value,
+uint64_t* selection, size_t* match_count)
+{
+    _MG_STATUS(arena, MG_ERROR_ARENA_INVALID);
+    _MG_STATUS(value && selection && (uint32_t)op <= MG_SCAN_GE, MG_ERROR_DATA_INVALID);
+    _MgArena* arena_internal = (_MgArena*)arena;
+
+    _MgGroup* group;
+    _MgColumn* column;
+    MgStatus status = _mg_group_scan_column(arena_internal, handle_type, field, &group, &column);
+    _MG_STATUS(status == MG_SUCCESS, status);
+
+    // the whole column in one go, rows of unwritten slots compare too and are masked out behind it
+    _mg_simd_compare(column->type, op, _mg_column_cell(group, column, 0), value, group->slot_count, selection);
+    size_t matches = _mg_group_select_live(group, selection, 0, _mg_group_dirty_words(group));
+
+    if (match_count)
+    {
+        *match_count = matches;
+    }
+
+    return MG_SUCCESS;
+}
+
+MgStatus mg_group_scan_handles(MgArena* arena, MgHandleType handle_type, uint32_t field, MgScanOp op,
+const void* value, MgHandle* handles, size_t capacity, size_t* match_count)
+{
+    _MG_STATUS(arena, MG_ERROR_ARENA_INVALID);
+    _MG_STATUS(value && (handles || capacity == 0) && (uint32_t)op <= MG_SCAN_GE, MG_ERROR_DATA_INVALID);
+    _MgArena* arena_internal = (_MgArena*)arena;
+
+    _MgGroup* group;
+    _MgColumn* column;
+    MgStatus status = _mg_group_scan_column(arena_internal, handle_type, field, &group, &column);
+    _MG_STATUS(status == MG_SUCCESS, status);
+
+    // a chunk of the selection at a time on the stack, its bits turn into handles while they are still cached
+    uint64_t chunk[_MG_SCAN_CHUNK_WORDS];
+    const uint8_t* cells = _mg_column_cell(group, column, 0);
+    _MgSlot* slots       = _mg_group_slots(group);
+    size_t matches       = 0;
+
+    for (size_t row = 0; row < group->slot_count; row += _MG_SCAN_CHUNK_WORDS * 64)
+    {
+        size_t rows  = group->slot_count - row;
+        rows         = rows < _MG_SCAN_CHUNK_WORDS * 64 ? rows : _MG_SCAN_CHUNK_WORDS * 64;
+        size_t words = (rows + 63) / 64;
+        _mg_simd_compare(column->type, op, cells + row * column->size, value, rows, chunk);
+        _mg_group_select_live(group, chunk, row / 64, words);
+
+        for (size_t i = 0; i < words; i++)
+        {
+            for (uint64_t bits = chunk[i]; bits; bits &= bits - 1)
+            {
+                uint32_t slot_index = (uint32_t)(row + i * 64 + _mg_ctz_u64(bits));
+                if (matches < capacity)
+                {
+                    handles[matches].slot_handle = slots[slot_index].handle;
+                    handles[matches].type        = handle_type;
+                }
+                matches++;
+            }
+        }
+    }
+
+    if (match_count)
+    {
+        *match_count = matches;
+    }
+
+    return MG_SUCCESS;
+}
+
+MgStatus mg_group_aggregate(MgArena* arena, MgHandleType handle_type, uint32_t field, const uint64_t* selection,
+MgAggregate* result)
+{
+    _MG_STATUS(arena, MG_ERROR_ARENA_INVALID);
+    _MG_STATUS(result, MG_ERROR_DATA_INVALID);
+    _MgArena* arena_internal = (_MgArena*)arena;
+
+    _MgGroup* group;
+    _MgColumn* column;
+    MgStatus status = _mg_group_scan_column(arena_internal, handle_type, field, &group, &column);
+    _MG_STATUS(status == MG_SUCCESS, status);
+
+    // a selection may still hold rows erased since the scan that made it, only the written ones count
+    uint64_t chunk[_MG_SCAN_CHUNK_WORDS];
+    const uint8_t* cells = _mg_column_cell(group, column, 0);
+    memset((void*)result, 0, sizeof(MgAggregate));
+
+    for (size_t row = 0; row < group->slot_count; row += _MG_SCAN_CHUNK_WORDS * 64)
+    {
+        size_t rows  = group->slot_count - row;
+        rows         = rows < _MG_SCAN_CHUNK_WORDS * 64 ? rows : _MG_SCAN_CHUNK_WORDS * 64;
+        size_t words = (rows + 63) / 64;
+        if (selection)
+        {
+            memcpy(chunk, selection + row / 64, words * sizeof(uint64_t));
+        }
+        else
+        {
+            memset((void*)chunk, 0xff, words * sizeof(uint64_t));
+        }
+        _mg_group_select_live(group, chunk, row / 64, words);
+        _mg_simd_aggregate(column->type, cells + row * column->size, chunk, rows, result);
+    }
+
+    return MG_SUCCESS;
+}
+
+const void* mg_handle_read_hot(MgArena* arena, MgHandle handle)
+{
+    return _mg_handle_read_part(arena, handle, 0);
+}
+
+const void* mg_handle_read_cold(MgArena* arena, MgHandle handle)
+{
+    return _mg_handle_read_part(arena, handle, 1);
+}
+
+MgStatus mg_arena_thread_attach(MgArena* arena)
+{
+    _MG_STATUS(arena, MG_ERROR_ARENA_INVALID);
+    _MgArena* arena_internal = (_MgArena*)arena;
+    _MG_STATUS(arena_internal->sync_mode == MG_ARENA_SYNC_THREAD_OWNED, MG_ERROR_THREAD_ATTACH_FAILED);
+
+    uint32_t token       = _mg_thread_token();
+    uint32_t provisional = ~token; // never a thread's token, the counter would have to wrap first
+    bool attached        = true;
+
+    // claim the first unowned shard of every group, all or nothing. shards are claimed for a provisional owner
+    // first, so a failed call gives back exactly the ones it took and none the thread owned before.
+    for (uint32_t i = 0; i < arena_internal->group_count && attached; i++)
+    {
+        _MgGroup* group = &_mg_arena_groups(arena_internal)[i];
+        if (_mg_group_owned_shard(group))
+        {
+            continue; // attached before
+        }
+
+        attached = false;
+        for (uint32_t j = 0; j < group->shard_count && !attached; j++)
+        {
+            attached = _mg_atomic_cas_u32(&_mg_group_shards(group)[j].owner, 0, provisional);
+        }
+    }
+
+    for (uint32_t i = 0; i < arena_internal->group_count; i++)
+    {
+        _MgGroup* group = &_mg_arena_groups(arena_internal)[i];
+        for (uint32_t j = 0; j < group->shard_count; j++)
+        {
+            _MgShard* shard = &_mg_group_shards(group)[j];
+            if (_mg_atomic_load_u32(&shard->owner) == provisional)
+            {
+                _mg_atomic_store_u32(&shard->owner, attached ? token : 0);
+            }
+        }
+    }
+
+    _MG_STATUS(attached, MG_ERROR_THREAD_ATTACH_FAILED);
+
+    return MG_SUCCESS;
+}
+
+MgStatus mg_arena_thread_detach(MgArena* arena)
+{
+    _MG_STATUS(arena, MG_ERROR_ARENA_INVALID);
+    _MgArena* arena_internal = (_MgArena*)arena;
+    _MG_STATUS(arena_internal->sync_mode == MG_ARENA_SYNC_THREAD_OWNED, MG_ERROR_THREAD_NOT_ATTACHED);
+
+    // handles created by this thread stay valid, the next thread to attach inherits them with the shard
+    _mg_arena_thread_release(arena_internal);
+
+    return MG_SUCCESS;
+}
+
+uint32_t mg_handle_shard(MgArena* arena, MgHandle handle)
+{
+    _MG_CHECK(arena, MG_ERROR_ARENA_INVALID);
+    _MgArena* arena_internal = (_MgArena*)arena;
+
+    _MgGroup* group = _mg_group_query(arena_internal, handle.type);
+    _MG_CHECK(group, MG_ERROR_GROUP_QUERY_FAILED);
+
+    return MG_DECODE_INDEX(handle.slot_handle) / group->shard_slot_count;
+}
+
+MgStatus mg_group_foreach(MgArena* arena, MgHandleType handle_type, MgForeachFn fn, void* ctx)
+{
+    _MG_STATUS(arena, MG_ERROR_ARENA_INVALID);
+    _MG_STATUS(fn, MG_ERROR_DATA_INVALID);
+    _MgArena* arena_internal = (_MgArena*)arena;
+
+    _MgGroup* group = _mg_group_query(arena_internal, handle_type);
+    _MG_STATUS(group, MG_ERROR_GROUP_QUERY_FAILED);
+
+    _MgForeachJob job = { group, fn, ctx };
+    _mg_group_foreach_range(&job, 0, group->slot_count);
+
+    return MG_SUCCESS;
+}
+
+MgStatus mg_group_parallel_foreach(MgArena* arena, MgHandleType handle_type, MgForeachFn fn, void* ctx, uint32_t grain)
+{
+    _MG_STATUS(arena, MG_ERROR_ARENA_INVALID);
+    _MG_STATUS(fn, MG_ERROR_DATA_INVALID);
+    _MgArena* arena_internal = (_MgArena*)arena;
+
+    _MgGroup* group = _mg_group_query(arena_internal, handle_type);
+    _MG_STATUS(group, MG_ERROR_GROUP_QUERY_FAILED);
+
+    // columnar groups line up with every column, the slots a line of the narrowest column holds cover the others
+    uint32_t line_slots = _mg_slots_per_span(group->handle_stride, MG_CACHE_LINE_SIZE);
+    for (uint32_t i = 0; i < group->column_count; i++)
+    {
+        uint32_t column_slots = _mg_slots_per_span(_mg_group_columns(group)[i].size, MG_CACHE_LINE_SIZE);
+        line_slots            = (i == 0 || column_slots > line_slots) ? column_slots : line_slots;
+    }
+
+    if (grain == 0)
+    {
+        grain = group->slot_count / (_mg_pool_worker_count() * 8); // a few chunks per worker leaves room to steal
+    }
+    grain = (uint32_t)_MG_ALIGN_UP((grain > line_slots ? grain : line_slots), line_slots);
+
+    // chunks are counted from slot 0 so boundaries line up with the cache-line aligned data array
+    _MgForeachJob job = { group, fn, ctx };
+    _mg_pool_run(0, group->slot_count, grain, _mg_group_foreach_range, &job);
+
+    return MG_SUCCESS;
+}
+
+MgStatus mg_group_lock_stats(MgArena* arena, MgHandleType handle_type, MgLockStats* stats)
+{
+    _MG_STATUS(arena, MG_ERROR_ARENA_INVALID);
+    _MG_STATUS(stats, MG_ERROR_DATA_INVALID);
+    _MgArena* arena_internal = (_MgArena*)arena;
+
+    _MgGroup* group = _mg_group_query(arena_internal, handle_type);
+    _MG_STATUS(group, MG_ERROR_GROUP_QUERY_FAILED);
+
+    memset((void*)stats, 0, sizeof(MgLockStats));
+
+    // sum over the shards without taking their locks, so asking for the stats never shows up in them. a lock
+    // changing hands meanwhile may leave one shard's counters a single acquire apart from each other.
+    for (uint32_t i = 0; i < group->shard_count; i++)
+    {
+        _MgLock* lock        = &_mg_group_shards(group)[i].lock;
+        uint64_t max_hold_ns = _mg_atomic_load_u64((volatile uint64_t*)&lock->max_hold_time_ns);
+
+        stats->acquire_count += _mg_atomic_load_u64((volatile uint64_t*)&lock->acquire_count);
+        stats->contended_count += _mg_atomic_load_u64((volatile uint64_t*)&lock->contended_count);
+        stats->hold_time_ns += _mg_atomic_load_u64((volatile uint64_t*)&lock->hold_time_ns);
+        if (max_hold_ns > stats->max_hold_time_ns)
+        {
+            stats->max_hold_time_ns = max_hold_ns;
+        }
+    }
+
+    return MG_SUCCESS;
+}
+
+uint32_t mg_numa_node_count(void)
+{
+    return _mg_numa_node_count();
+}
+
+uint32_t mg_numa_node_current(void)
+{
+    return _mg_numa_node_current();
+}
+
+void mg_arena_print(MgArena* arena)
+{
+    _MG_CHECK(arena, MG_ERROR_ARENA_INVALID);
+    _MgArena* arena_internal = (_MgArena*)arena;
+
+    printf("=== Arena Layout ===\n");
+    printf("Arena Name: %s\n", arena_internal->name);
+    printf("Block Count: %u\n", arena_internal->group_count);
+    printf("Arena Payload Size: %zu bytes\n", arena_internal->alloc_size);
+    printf("Arena Header Address: %p\n", (void*)arena_internal);
+    printf("Sync Mode: %u\n", (uint32_t)arena_internal->sync_mode);
+
+    for (uint32_t i = 0; i < arena_internal->group_count; i++)
+    {
+        _MgGroup* group = &_mg_arena_groups(arena_internal)[i];
+
+        printf("\n[[ Group %u ]]:", i);
+        printf("Header Address: [0x%p]\n", (void*)group);
+        printf("Slot Array Address: [0x%p]\n", (void*)_mg_group_slots(group));
+        printf("Data Block Address: [0x%p]\n", (void*)_mg_group_data(group));
+        printf("Total Group Size: (%zu bytes)\n", group->size);
+
+        printf("Handle Desc: [type: %u, stride: %u]\n", group->handle_type, group->handle_stride);
+        printf("Numa Placement: [policy: %u, node: %u]\n", (uint32_t)group->numa_policy, group->numa_node);
+        if (group->blob_capacity)
+        {
+            _MgBlobRegion* region = _mg_group_blob_region(group);
+            printf("Blob Region: [capacity: %u, head: %u, garbage: %u]\n", group->blob_capacity, region->head,
+            region->garbage);
+        }
+        if (group->index_capacity)
+        {
+            _MgIndex* index = _mg_group_index(group);
+            printf("Index: [capacity: %u, keys: %u, tombstones: %u, key offset: %u]\n", group->index_capacity,
+            index->size, index->tombstones, group->key_offset);
+        }
+        if (group->order_capacity)
+        {
+            _MgOrder* order = _mg_group_order(group);
+            printf("Ordered Index: [nodes: %u of %u, height: %u, entries: %u, field: %u at %u]\n", order->used,
+            group->order_capacity, order->height, order->size, (uint32_t)group->order_type, group->order_offset);
+        }
+
+        for (uint32_t j = 0; j < group->column_count; j++)
+        {
+            _MgColumn* column = &_mg_group_columns(group)[j];
+            printf("Column %u: [field offset: %u, size: %u, address: 0x%p]\n", j, column->offset, column->size,
+            (void*)_mg_column_cell(group, column, 0));
+        }
+
+        for (uint32_t j = 0; j < group->shard_count; j++)
+        {
+            _MgShard* shard = &_mg_group_shards(group)[j];
+            printf("Shard %u: [slots: %u..%u, next slot index: %u]\n", j, shard->slot_begin, shard->slot_end - 1,
+            shard->free_list_head);
+
+            if (arena_internal->sync_mode == MG_ARENA_SYNC_THREAD_OWNED)
+            {
+                printf("Owner: [thread: %u, remote free head: %u]\n", shard->owner, shard->remote_free_head);
+            }
+            else if (_mg_arena_locked(arena_internal))
+            {
+                printf("Lock Stats: [acquired: %llu, contended: %llu, held: %llu ns]\n",
+                (unsigned long long)shard->lock.acquire_count, (unsigned long long)shard->lock.contended_count,
+                (unsigned long long)shard->lock.hold_time_ns);
+            }
+        }
+    }
+
+    printf("===============\n\n");
+}
+
+static MgStatus _mg_group_init(_MgArena* arena_internal, _MgGroup* group, uintptr_t group_start, MgHandleDescriptor* descriptor)
+{
+    _MG_STATUS(group && descriptor, MG_ERROR_GROUP_CREATION_FAILED);
+    _MG_STATUS(descriptor->count > 0 && descriptor->stride > 0, MG_ERROR_GROUP_CREATION_FAILED);
+    _MG_STATUS(descriptor->numa_policy <= MG_NUMA_POLICY_SHARDS, MG_ERROR_GROUP_CREATION_FAILED);
+    _MG_STATUS(descriptor->numa_policy != MG_NUMA_POLICY_BIND || descriptor->numa_node < _mg_numa_node_count(),
+    MG_ERROR_GROUP_CREATION_FAILED);
+
+    uint32_t shard_count, shard_slot_count;
+    _mg_group_geometry(descriptor, &shard_count, &shard_slot_count);
+
+    size_t slot_count = (size_t)shard_count * shard_slot_count; // includes invalid slot 0
+    _MG_STATUS(slot_count <= (size_t)_MG_SLOT_BIT_MASK + 1, MG_ERROR_GROUP_CREATION_FAILED); // index must fit the handle
+
+    size_t shards_size = _MG_ALIGN_UP(shard_count * sizeof(_MgShard), _mg_group_alignment(descriptor));
+    size_t slots_size  = _MG_ALIGN_UP(slot_count * sizeof(_MgSlot), _mg_group_alignment(descriptor));
+    size_t dirty_size  = _MG_ALIGN_UP((slot_count + 63) / 64 * sizeof(uint64_t), _mg_group_alignment(descriptor));
+    size_t refs_size   = _mg_group_blob_refs_size(descriptor, slot_count);
+    size_t blobs_size  = _mg_group_blobs_size(descriptor);
+    size_t index_size  = _mg_group_index_size(descriptor);
+    size_t order_size  = _mg_group_order_size(descriptor);
+    size_t column_size = _mg_group_columns_size(descriptor);
+    size_t live_size   = _mg_group_live_size(descriptor, slot_count);
+
+    // the blob arrays, the indexes and the column table sit in front of the data, so they are placed with the
+    // metadata when shards get own nodes
+    uintptr_t blobs_start = group_start + shards_size + slots_size + dirty_size;
+    uintptr_t index_start = blobs_start + refs_size + blobs_size;
+    uintptr_t live_start  = index_start + index_size + order_size + column_size;
+    uintptr_t data_start  = live_start + live_size;
+    _mg_offset_set(&group->shards, (void*)group_start);
+    _mg_offset_set(&group->slots, (void*)(group_start + shards_size));
+    _mg_offset_set(&group->dirty, (void*)(group_start + shards_size + slots_size));
+    _mg_offset_set(&group->blob_refs, (void*)blobs_start); // the rest are empty unless the group has them
+    _mg_offset_set(&group->blobs, (void*)(blobs_start + refs_size));
+    _mg_offset_set(&group->index, (void*)index_start);
+    _mg_offset_set(&group->order, (void*)(index_start + index_size)); // a zeroed header is an empty tree
+    _mg_offset_set(&group->columns, (void*)(index_start + index_size + order_size));
+    _mg_offset_set(&group->live, (void*)live_start);
+    _mg_offset_set(&group->data, (void*)data_start);
+
+    group->slot_count       = (uint32_t)slot_count;
+    group->shard_count      = shard_count;
+    group->shard_slot_count = shard_slot_count;
+    group->handle_type      = descriptor->type;
+    group->handle_stride    = descriptor->stride;
+    group->numa_policy      = descriptor->numa_policy;
+    group->numa_node        = descriptor->numa_node;
+    group->blob_capacity    = descriptor->blob_capacity;
+    group->index_capacity   = _mg_group_index_capacity(descriptor);
+    group->key_offset       = descriptor->key_offset;
+    group->order_capacity   = _mg_group_order_capacity(descriptor);
+    group->order_offset     = descriptor->order_offset;
+    group->order_type       = descriptor->order_type;
+    group->column_count     = descriptor->field_count;
+    group->hot_size         = descriptor->hot_size;
+    group->size             = _mg_group_alloc_size(descriptor);
+
+    // placement first, the slot writes below are the first touch of the group's metadata pages
+    _MG_STATUS(_mg_group_place(arena_internal, group, group_start), MG_ERROR_ARENA_ALLOC_FAILED);
+
+    _mg_group_slots(group)[0].handle     = 0; // invalid slot 0
+    _mg_group_slots(group)[0].generation = 0;
+    _mg_group_slots(group)[0].status     = _MG_SLOT_STATUS_INVALID;
+
+    // columns follow each other in field order, each one starting on a line of its own
+    size_t column_start = 0;
+    for (uint32_t i = 0; i < group->column_count; i++)
+    {
+        _MgColumn* column = &_mg_group_columns(group)[i];
+        column->offset    = descriptor->fields[i].offset;
+        column->size      = descriptor->fields[i].size;
+        column->type      = descriptor->fields[i].type;
+        column->start     = column_start;
+        column_start += _MG_ALIGN_UP(slot_count * column->size, _mg_group_alignment(descriptor));
+    }
+
+    for (uint32_t i = 0; i < shard_count; i++)
+    {
+        _MgShard* shard   = &_mg_group_shards(group)[i];
+        shard->slot_begin = i * shard_slot_count;
+        shard->slot_end   = shard->slot_begin + shard_slot_count;
+
+        uint32_t first_slot = shard->slot_begin > 0 ? shard->slot_begin : 1; // shard 0 skips invalid slot 0
+        for (uint32_t j = first_slot; j < shard->slot_end; j++)
+        {
+            _MgSlot* slot    = &_mg_group_slots(group)[j];
+            slot->status     = _MG_SLOT_STATUS_FREE;
+            slot->generation = 0;
+        }
+    }
+
+    _mg_group_rebuild_free_lists(group);
+
+    if (group->index_capacity)
+    {
+        _mg_index_clear(arena_internal, group); // zeroed control bytes would read as full
+    }
+
+    return MG_SUCCESS;
+}
+
+void _mg_group_rebuild_free_lists(_MgGroup* group)
+{
+    _MgSlot* slots = _mg_group_slots(group);
+
+    for (uint32_t i = 0; i < group->shard_count; i++)
+    {
+        _mg_shard_rebuild_free_list(group, &_mg_group_shards(group)[i]);
+    }
+
+    // scans only see the bitmap, so every path that forces slot statuses in bulk recounts it here
+    if (group->column_count)
+    {
+        uint64_t* live = _mg_group_live(group);
+        memset((void*)live, 0, (size_t)_mg_group_dirty_words(group) * sizeof(uint64_t));
+        for (uint32_t i = 1; i < group->slot_count; i++)
+        {
+            live[i / 64] |= (uint64_t)(slots[i].status == _MG_SLOT_STATUS_VALID_WRITE) << (i % 64);
+        }
+    }
+}
+
+static void _mg_shard_rebuild_free_list(_MgGroup* group, _MgShard* shard)
+{
+    _MgSlot* slots = _mg_group_slots(group);
+
+    // walk backwards so the list comes out in ascending order, lowest slot first
+    uint32_t head = 0; // 0 ends the list, slot 0 is never free
+    for (uint32_t j = shard->slot_end; j-- > shard->slot_begin;)
+    {
+        if (slots[j].status == _MG_SLOT_STATUS_FREE)
+        {
+            slots[j].next_free_index = head;
+            head                     = j;
+        }
+    }
+
+    shard->free_list_head   = head;
+    shard->remote_free_head = 0;
+}
+
+static bool _mg_group_place(_MgArena* arena_internal, _MgGroup* group, uintptr_t group_start)
+{
+    if (arena_internal->alloc_kind != _MG_ARENA_ALLOC_PAGES)
+    {
+        return true; // heap arenas are already committed and zeroed
+    }
+
+    switch (group->numa_policy)
+    {
+    case MG_NUMA_POLICY_BIND:
+        return _mg_pages_commit((void*)group_start, group->size, _MG_PAGE_POLICY_BIND, group->numa_node);
+
+    case MG_NUMA_POLICY_INTERLEAVE:
+        return _mg_pages_commit((void*)group_start, group->size, _MG_PAGE_POLICY_INTERLEAVE, 0);
+
+    case MG_NUMA_POLICY_SHARDS:
+    {
+        // shared metadata is interleaved, every shard's payload pages go to the shard's own node
+        bool committed = _mg_pages_commit((void*)group_start, (uintptr_t)_mg_group_data(group) - group_start,
+        _MG_PAGE_POLICY_INTERLEAVE, 0);
+
+        size_t shard_data_size = (size_t)group->shard_slot_count * group->handle_stride;
+        for (uint32_t i = 0; i < group->shard_count && committed; i++)
+        {
+            uint32_t node       = (group->numa_node + i) % _mg_numa_node_count();
+            uint8_t* shard_data = _mg_group_data(group) + i * shard_data_size;
+            committed           = _mg_pages_commit(shard_data, shard_data_size, _MG_PAGE_POLICY_BIND, node);
+        }
+        return committed;
+    }
+
+    default: return _mg_pages_commit((void*)group_start, group->size, _MG_PAGE_POLICY_DEFAULT, 0);
+    }
+}
+
+static size_t _mg_group_alignment(const MgHandleDescriptor* descriptor)
+{
+    // numa placement is applied per page, so placed groups (and their shards) start and end on page boundaries
+    return descriptor->numa_policy != MG_NUMA_POLICY_DEFAULT ? _mg_page_size() : MG_CACHE_LINE_SIZE;
+}
+
+static size_t _mg_group_alloc_size(const MgHandleDescriptor* descriptor)
+{
+    uint32_t shard_count, shard_slot_count;
+    _mg_group_geometry(descriptor, &shard_count, &shard_slot_count);
+
+    size_t slot_count = (size_t)shard_count * shard_slot_count;
+    size_t alignment  = _mg_group_alignment(descriptor);
+
+    // every array starts on a cache line (a page when placed), so parallel chunks and shards split on line boundaries
+    size_t alloc_size = _MG_ALIGN_UP(shard_count * sizeof(_MgShard), alignment);     // group->shards
+    alloc_size += _MG_ALIGN_UP(slot_count * sizeof(_MgSlot), alignment);             // group->slots
+    alloc_size += _MG_ALIGN_UP((slot_count + 63) / 64 * sizeof(uint64_t), alignment); // group->dirty
+    alloc_size += _mg_group_blob_refs_size(descriptor, slot_count);                  // group->blob_refs
+    alloc_size += _mg_group_blobs_size(descriptor);                                  // group->blobs
+    alloc_size += _mg_group_index_size(descriptor);                                  // group->index
+    alloc_size += _mg_group_order_size(descriptor);                                  // group->order
+    alloc_size += _mg_group_columns_size(descriptor);                                // group->columns
+    alloc_size += _mg_group_live_size(descriptor, slot_count);                       // group->live
+    alloc_size += _mg_group_data_alloc_size(descriptor, slot_count);                 // group->data
+
+    return alloc_size;
+}
+
+static size_t _mg_group_blob_refs_size(const MgHandleDescriptor* descriptor, size_t slot_count)
+{
+    size_t size = descriptor->blob_capacity ? slot_count * sizeof(_MgBlobRef) : 0;
+    return _MG_ALIGN_UP(size, _mg_group_alignment(descriptor));
+}
+
+static size_t _mg_group_blobs_size(const MgHandleDescriptor* descriptor) // region header and its bytes
+{
+    size_t size = descriptor->blob_capacity ? sizeof(_MgBlobRegion) + descriptor->blob_capacity : 0;
+    return _MG_ALIGN_UP(size, _mg_group_alignment(descriptor));
+}
+
+static size_t _mg_group_handle_count(const MgHandleDescriptor* descriptor)
+{
+    // shards round up to whole spans, so a sharded group holds more handles than its descriptor's count
+    uint32_t shard_count, shard_slot_count;
+    _mg_group_geometry(descriptor, &shard_count, &shard_slot_count);
+    return (size_t)shard_count * shard_slot_count - 1; // without invalid slot 0
+}
+
+static uint32_t _mg_group_index_capacity(const MgHandleDescriptor* descriptor)
+{
+    return descriptor->indexed ? _mg_index_capacity(_mg_group_handle_count(descriptor)) : 0;
+}
+
+static size_t _mg_group_index_size(const MgHandleDescriptor* descriptor)
+{
+    return _MG_ALIGN_UP(_mg_index_size(_mg_group_index_capacity(descriptor)), _mg_group_alignment(descriptor));
+}
+
+static uint32_t _mg_group_order_capacity(const MgHandleDescriptor* descriptor)
+{
+    return descriptor->order_type != MG_FIELD_NONE ? _mg_order_capacity(_mg_group_handle_count(descriptor)) : 0;
+}
+
+static size_t _mg_group_order_size(const MgHandleDescriptor* descriptor)
+{
+    return _MG_ALIGN_UP(_mg_order_size(_mg_group_order_capacity(descriptor)), _mg_group_alignment(descriptor));
+}
+
+static size_t _mg_group_columns_size(const MgHandleDescriptor* descriptor)
+{
+    return _MG_ALIGN_UP(descriptor->field_count * sizeof(_MgColumn), _mg_group_alignment(descriptor));
+}
+
+static size_t _mg_group_live_size(const MgHandleDescriptor* descriptor, size_t slot_count)
+{
+    size_t size = descriptor->field_count ? (slot_count + 63) / 64 * sizeof(uint64_t) : 0;
+    return _MG_ALIGN_UP(size, _mg_group_alignment(descriptor));
+}
+
+static size_t _mg_group_data_alloc_size(const MgHandleDescriptor* descriptor, size_t slot_count)
+{
+    size_t alignment = _mg_group_alignment(descriptor);
+    if (descriptor->field_count == 0)
+    {
+        return _MG_ALIGN_UP(slot_count * descriptor->stride, alignment);
+    }
+
+    size_t size = 0;
+    for (uint32_t i = 0; i < descriptor->field_count; i++)
+    {
+        size += _MG_ALIGN_UP(slot_count * descriptor->fields[i].size, alignment);
+    }
+    return size;
+}
+
+static uint32_t _mg_group_spec_count(const MgArenaDescriptor* descriptor)
+{
+    uint32_t group_count = 0;
+    for (uint32_t i = 0; i < descriptor->handle_descriptors_count; i++)
+    {
+        _MgGroupSpec spec;
+        _mg_group_spec(descriptor, group_count, &spec);
+        group_count += 1 + spec.class_count;
+    }
+    return group_count;
+}
+
+static void _mg_group_spec(const MgArenaDescriptor* descriptor, uint32_t group_index, _MgGroupSpec* spec)
+{
+    // walk the handle descriptors, each one covers its own group plus its size classes
+    uint32_t first = 0;
+    for (uint32_t i = 0; i < descriptor->handle_descriptors_count; i++)
+    {
+        const MgHandleDescriptor* handle_descriptor = &descriptor->handle_descriptors[i];
+
+        uint32_t class_count = 0;
+        if (handle_descriptor->variable)
         {
-            slot->next_free_index = i + 1;
+            class_count = 1;
+            while (((size_t)_MG_SIZE_CLASS_MIN << (class_count - 1)) < handle_descriptor->stride)
+            {
+                class_count++;
+            }
         }
-        else
+
+        if (group_index <= first + class_count)
         {
-            slot->next_free_index = 0; // last slot
+            spec->handle      = *handle_descriptor;
+            spec->class_count = 0;
+            spec->size_class  = (group_index != first);
+
+            if (group_index == first && class_count)
+            {
+                spec->handle.stride = sizeof(_MgVariableRef);
+                spec->class_count   = class_count;
+            }
+            else if (handle_descriptor->hot_size)
+            {
+                uint32_t hot_size        = handle_descriptor->hot_size;
+                spec->parts[0]           = (MgField){ 0, hot_size, MG_FIELD_NONE };
+                spec->parts[1]           = (MgField){ hot_size, handle_descriptor->stride - hot_size, MG_FIELD_NONE };
+                spec->handle.fields      = spec->parts;
+                spec->handle.field_count = 2;
+            }
+            else if (spec->size_class)
+            {
+                size_t class_size   = (size_t)_MG_SIZE_CLASS_MIN << (group_index - first - 1);
+                spec->handle.stride = class_size < handle_descriptor->stride ? (uint32_t)class_size
+                                                                             : handle_descriptor->stride;
+
+                spec->handle.blob_capacity = 0; // blobs and keys belong to the handles in front
+                spec->handle.indexed       = false;
+                spec->handle.order_type    = MG_FIELD_NONE;
+            }
+            return;
         }
+
+        first += 1 + class_count;
     }
+}
 
-    return MG_SUCCESS;
+static void _mg_group_geometry(const MgHandleDescriptor* descriptor, uint32_t* shard_count, uint32_t* shard_slot_count)
+{
+    size_t slot_count = descriptor->count + 1; // include invalid slot 0
+
+    if (descriptor->shard_count <= 1)
+    {
+        *shard_count      = 1;
+        *shard_slot_count = (uint32_t)slot_count;
+        return;
+    }
+
+    // every shard holds a whole number of cache lines of payload, so two shards never write the same line.
+    // shards placed on their own numa nodes need whole pages instead.
+    size_t span         = descriptor->numa_policy == MG_NUMA_POLICY_SHARDS ? _mg_page_size() : MG_CACHE_LINE_SIZE;
+    uint32_t span_slots = _mg_slots_per_span(descriptor->stride, span);
+    for (uint32_t i = 0; i < descriptor->field_count; i++) // columnar groups split every column on a span
+    {
+        uint32_t column_slots = _mg_slots_per_span(descriptor->fields[i].size, span);
+        span_slots            = (i == 0 || column_slots > span_slots) ? column_slots : span_slots;
+    }
+
+    size_t per_shard  = (slot_count + descriptor->shard_count - 1) / descriptor->shard_count;
+    *shard_count      = descriptor->shard_count;
+    *shard_slot_count = (uint32_t)_MG_ALIGN_UP(per_shard, span_slots);
+}
+
+static uint32_t _mg_slots_per_span(uint32_t stride, size_t span)
+{
+    // smallest slot count whose payload bytes are a whole number of spans (span is a power of two)
+    uint32_t span_slots = (uint32_t)span;
+    for (; (stride & 1) == 0 && span_slots > 1; stride >>= 1)
+    {
+        span_slots >>= 1;
+    }
+    return span_slots;
+}
+
+static void _mg_arena_free(_MgArena* arena_internal)
+{
+    if (arena_internal->alloc_kind == _MG_ARENA_ALLOC_PAGES)
+    {
+        _mg_pages_release(arena_internal, arena_internal->alloc_size);
+    }
+    else if (arena_internal->alloc_kind == _MG_ARENA_ALLOC_MAPPED)
+    {
+        _mg_snapshot_unmap(arena_internal);
+    }
+    else if (arena_internal->alloc_kind == _MG_ARENA_ALLOC_VIEW)
+    {
+        _MgMemFile backing = arena_internal->backing; // lives in the view
+        _mg_memfile_unmap(arena_internal, arena_internal->alloc_size);
+        _mg_memfile_close(&backing);
+    }
+    else if (arena_internal->alloc_kind == _MG_ARENA_ALLOC_SHARED)
+    {
+        if (arena_internal->shared_creator == _mg_process_id())
+        {
+            _mg_shm_remove(arena_internal->shared_name);
+        }
+        _mg_shm_unmap(arena_internal, arena_internal->alloc_size);
+    }
+    else if (arena_internal->alloc_kind == _MG_ARENA_ALLOC_FILE)
+    {
+        // a clean close: everything durable first, then the flag that spares the next open its recovery
+        _MgFile file = arena_internal->file;
+        if (_mg_arena_file_sync(arena_internal, false))
+        {
+            arena_internal->file_open = 0;
+            _mg_file_flush(&file, arena_internal, _mg_page_size(), false);
+        }
+        _mg_file_unmap_shared(&file, arena_internal, arena_internal->alloc_size);
+    }
+    else
+    {
+        _mg_aligned_free(arena_internal);
+    }
+}
+
+static MgArena* _mg_arena_file_reopen(_MgArena* arena_internal, MgArenaDescriptor* descriptor, _MgFile file,
+size_t alloc_size)
+{
+    // the file is only trusted if it was made from the same groups, the size alone could match by chance
+    bool valid = arena_internal->alloc_kind == _MG_ARENA_ALLOC_FILE && arena_internal->alloc_size == alloc_size;
+    valid      = valid && arena_internal->group_count == _mg_group_spec_count(descriptor);
+    valid      = valid && arena_internal->groups == (_MgOffset)_MG_ALIGN_UP(sizeof(_MgArena), MG_CACHE_LINE_SIZE);
+    for (uint32_t i = 0; valid && i < arena_internal->group_count; i++)
+    {
+        _MgGroupSpec spec;
+        _mg_group_spec(descriptor, i, &spec);
+        _MgGroup* group = &_mg_arena_groups(arena_internal)[i];
+        valid           = group->handle_type == spec.handle.type && group->handle_stride == spec.handle.stride;
+        valid           = valid && group->size == _mg_group_alloc_size(&spec.handle);
+        valid           = valid && group->class_count == spec.class_count && group->size_class == spec.size_class;
+        valid           = valid && group->blob_capacity == spec.handle.blob_capacity;
+        valid           = valid && group->index_capacity == _mg_group_index_capacity(&spec.handle);
+        valid           = valid && group->key_offset == spec.handle.key_offset;
+        valid           = valid && group->order_capacity == _mg_group_order_capacity(&spec.handle);
+        valid           = valid && group->order_type == spec.handle.order_type;
+        valid           = valid && group->order_offset == spec.handle.order_offset;
+        valid           = valid && group->column_count == spec.handle.field_count;
+        valid           = valid && group->hot_size == spec.handle.hot_size;
+        for (uint32_t j = 0; valid && j < group->column_count; j++)
+        {
+            _MgColumn* column = &_mg_group_columns(group)[j];
+            valid             = column->offset == spec.handle.fields[j].offset;
+            valid             = valid && column->size == spec.handle.fields[j].size;
+            valid             = valid && column->type == spec.handle.fields[j].type;
+        }
+    }
+
+    _MG_CHECK(valid, MG_ERROR_ARENA_DESC_INVALID);
+    if (!valid)
+    {
+        _mg_file_unmap_shared(&file, arena_internal, alloc_size);
+        return NULL;
+    }
+
+    _mg_arena_reset_process_state(arena_internal);
+
+    // a crash can leave free list links from before and after the last write back side by side, while every slot's
+    // status is still whole. relinking from the statuses makes the lists agree again, the same goes for indexes.
+    if (arena_internal->file_open)
+    {
+        for (uint32_t i = 0; i < arena_internal->group_count; i++)
+        {
+            _MgGroup* group = &_mg_arena_groups(arena_internal)[i];
+            _mg_group_rebuild_free_lists(group);
+            if (_mg_group_has_indexes(group))
+            {
+                _mg_group_rebuild_indexes(arena_internal, group);
+            }
+        }
+    }
+
+    arena_internal->file      = file;
+    arena_internal->file_open = 1;
+
+    return (MgArena*)arena_internal;
+}
+
+static bool _mg_arena_file_sync(_MgArena* arena_internal, bool async)
+{
+    // payloads first, then the metadata that points at them, so a sync that completes never writes a slot status
+    // ahead of its payload. it cannot order the kernel's own write back between syncs.
+    _MgFile file     = arena_internal->file;
+    size_t page_size = _mg_page_size();
+    bool synced      = true;
+
+    for (uint32_t i = 0; synced && i < arena_internal->group_count; i++)
+    {
+        _MgGroup* group = &_mg_arena_groups(arena_internal)[i];
+        uintptr_t data  = (uintptr_t)_mg_group_data(group);
+        uintptr_t begin = data & ~((uintptr_t)page_size - 1);
+        uintptr_t end   = _MG_ALIGN_UP(data + _mg_group_data_size(group), page_size);
+        synced          = _mg_file_flush(&file, (void*)begin, end - begin, async);
+    }
+
+    return synced && _mg_file_flush(&file, arena_internal, arena_internal->alloc_size, async);
+}
+
+static void _mg_block_copy(void* dst, const void* src, size_t size)
+{
+    if (size <= _MG_COPY_CHUNK_SIZE)
+    {
+        memcpy(dst, src, size);
+        return;
+    }
+
+    // big blocks are split over the pool, and streamed so the copy does not flush the callers' caches
+    _MgCopyJob job       = { (uint8_t*)dst, (const uint8_t*)src, size };
+    uint32_t chunk_count = (uint32_t)((size + _MG_COPY_CHUNK_SIZE - 1) / _MG_COPY_CHUNK_SIZE);
+    _mg_pool_run(0, chunk_count, 1, _mg_block_copy_range, &job);
+}
+
+static void _mg_block_copy_range(void* ctx, uint32_t begin, uint32_t end)
+{
+    _MgCopyJob* job = (_MgCopyJob*)ctx;
+    size_t from     = (size_t)begin * _MG_COPY_CHUNK_SIZE;
+    size_t to       = (size_t)end * _MG_COPY_CHUNK_SIZE;
+    to              = to < job->size ? to : job->size;
+    _mg_memcpy_stream(job->dst + from, job->src + from, to - from);
+}
+
+void _mg_arena_reset_process_state(_MgArena* arena_internal)
+{
+    // locks, thread ownership and the log belong to the process (and arena) that wrote the block. only written when
+    // set, so shard pages of a mapped snapshot that were saved idle stay shared with the file.
+    for (uint32_t i = 0; i < arena_internal->group_count; i++)
+    {
+        _MgGroup* group = &_mg_arena_groups(arena_internal)[i];
+        for (uint32_t j = 0; j < group->shard_count; j++)
+        {
+            _MgShard* shard = &_mg_group_shards(group)[j];
+            if (shard->lock.state != 0)
+            {
+                shard->lock.state = 0;
+            }
+            if (shard->owner != 0)
+            {
+                shard->owner = 0;
+            }
+        }
+
+        if (group->blob_capacity && _mg_group_blob_region(group)->lock.state != 0)
+        {
+            _mg_group_blob_region(group)->lock.state = 0;
+        }
+        if (group->index_capacity && _mg_group_index(group)->lock.state != 0)
+        {
+            _mg_group_index(group)->lock.state = 0;
+        }
+        if (group->order_capacity && _mg_group_order(group)->lock.state != 0)
+        {
+            _mg_group_order(group)->lock.state = 0;
+        }
+    }
+
+    if (arena_internal->log)
+    {
+        arena_internal->log = NULL;
+    }
+    if (arena_internal->publisher)
+    {
+        arena_internal->publisher = NULL;
+    }
+    if (arena_internal->backing.opaque != 0)
+    {
+        arena_internal->backing.opaque = 0;
+    }
+    if (arena_internal->file.opaque != 0)
+    {
+        arena_internal->file.opaque = 0;
+    }
 }
 
-static _MgGroup* _mg_group_query(_MgArena* arena_internal, uint32_t handle_type)
+_MgGroup* _mg_group_query(_MgArena* arena_internal, uint32_t handle_type)
 {
     _MG_CHECK(arena_internal, MG_ERROR_ARENA_INVALID);
     _MG_CHECK(handle_type <= arena_internal->group_count, MG_ERROR_HANDLE_TYPE_INVALID);
 
     for (uint32_t i = 0; i < arena_internal->group_count; i++)
     {
-        if (arena_internal->groups[i].handle_type == handle_type)
+        if (_mg_arena_groups(arena_internal)[i].handle_type == handle_type)
         {
-            return &arena_internal->groups[i];
+            return &_mg_arena_groups(arena_internal)[i];
         }
     }
 
@@ -287,19 +2238,339 @@ static _MgGroup* _mg_group_query(_MgArena* arena_internal, uint32_t handle_type)
     return NULL;
 }
 
-static uint32_t _mg_group_slot_alloc(_MgGroup* group)
+static _MgShard* _mg_group_shard(_MgGroup* group, uint32_t slot_index)
+{
+    return &_mg_group_shards(group)[slot_index / group->shard_slot_count];
+}
+
+static uint32_t _mg_shard_slot_alloc(_MgArena* arena_internal, _MgGroup* group, _MgShard* shard,
+_MgLogTicket* ticket)
 {
-    _MG_CHECK(group->free_list_head != 0, MG_ERROR_GROUP_EXHAUSTED);
+    if (shard->free_list_head == 0)
+    {
+        return _MG_HANDLE_INVALID; // shard exhausted, caller moves on to the next shard
+    }
 
-    uint32_t slot_index = group->free_list_head;
-    _MgSlot* slot       = &group->slots[slot_index];
+    uint32_t slot_index = shard->free_list_head;
+    _MgSlot* slot       = &_mg_group_slots(group)[slot_index];
     _MG_CHECK(slot->status == _MG_SLOT_STATUS_FREE, MG_ERROR_GROUP_SLOT_ALLOC_FAILED);
 
-    group->free_list_head = slot->handle; // advance to next free slot
+    shard->free_list_head = slot->next_free_index; // advance to next free slot
 
     uint32_t slot_generation = ++(slot->generation);
     slot->handle             = MG_ENCODE_HANDLE(slot_index, slot_generation);
     slot->status             = _MG_SLOT_STATUS_VALID_ALLOC;
+    _mg_group_mark_dirty(arena_internal, group, slot_index);
+
+    if (ticket)
+    {
+        _mg_arena_log_enqueue(arena_internal, _MG_LOG_OP_CREATE, group->handle_type, slot->handle, NULL, 0, ticket);
+    }
 
     return slot->handle;
+}
+
+static _MgShard* _mg_group_owned_shard(_MgGroup* group)
+{
+    uint32_t token = _mg_thread_token();
+    for (uint32_t i = 0; i < group->shard_count; i++)
+    {
+        if (_mg_group_shards(group)[i].owner == token)
+        {
+            return &_mg_group_shards(group)[i];
+        }
+    }
+    return NULL;
+}
+
+static void _mg_shard_remote_push(_MgGroup* group, _MgShard* shard, uint32_t slot_index)
+{
+    // treiber push, many erasing threads against one draining owner. the owner takes the whole stack at once,
+    // so a popped entry is never pushed back while a push is in flight and there is no aba.
+    _MgSlot* slot = &_mg_group_slots(group)[slot_index];
+    uint32_t head;
+    do
+    {
+        head                  = _mg_atomic_load_u32(&shard->remote_free_head);
+        slot->next_free_index = head;
+    } while (!_mg_atomic_cas_u32(&shard->remote_free_head, head, slot_index));
+}
+
+static void _mg_shard_remote_drain(_MgArena* arena_internal, _MgGroup* group, _MgShard* shard)
+{
+    uint32_t head = _mg_atomic_exchange_u32(&shard->remote_free_head, 0);
+    if (head == 0)
+    {
+        return;
+    }
+
+    // splice the whole batch in front of the local free list
+    uint32_t tail = head;
+    while (_mg_group_slots(group)[tail].next_free_index != 0)
+    {
+        tail = _mg_group_slots(group)[tail].next_free_index;
+    }
+
+    _mg_group_slots(group)[tail].next_free_index = shard->free_list_head;
+    _mg_group_mark_dirty(arena_internal, group, tail);
+    shard->free_list_head = head;
+}
+
+static void _mg_arena_thread_release(_MgArena* arena_internal)
+{
+    for (uint32_t i = 0; i < arena_internal->group_count; i++)
+    {
+        _MgGroup* group = &_mg_arena_groups(arena_internal)[i];
+        _MgShard* shard = _mg_group_owned_shard(group);
+        if (shard)
+        {
+            _mg_shard_remote_drain(arena_internal, group, shard);
+            _mg_atomic_store_u32(&shard->owner, 0);
+        }
+    }
+}
+
+void _mg_group_mark_dirty(_MgArena* arena_internal, _MgGroup* group, uint32_t slot_index)
+{
+    if (!arena_internal->track_dirty)
+    {
+        return;
+    }
+
+    uint64_t* word = &_mg_group_dirty(group)[slot_index / 64];
+    uint64_t bit   = 1ull << (slot_index % 64);
+
+    // one word covers 64 neighbouring slots, which may belong to other shards or threads
+    if (arena_internal->sync_mode == MG_ARENA_SYNC_NONE)
+    {
+        *word |= bit;
+    }
+    else if ((*word & bit) == 0)
+    {
+        _mg_atomic_fetch_or_u64(word, bit);
+    }
+}
+
+void _mg_group_mark_live(_MgArena* arena_internal, _MgGroup* group, uint32_t slot_index, bool live)
+{
+    if (!group->column_count)
+    {
+        return;
+    }
+
+    uint64_t* word = &_mg_group_live(group)[slot_index / 64];
+    uint64_t bit   = 1ull << (slot_index % 64);
+
+    // the same word sharing as the dirty bits, only that live bits are cleared again
+    if (arena_internal->sync_mode == MG_ARENA_SYNC_NONE)
+    {
+        *word = live ? (*word | bit) : (*word & ~bit);
+    }
+    else if (live)
+    {
+        _mg_atomic_fetch_or_u64(word, bit);
+    }
+    else
+    {
+        _mg_atomic_fetch_and_u64(word, ~bit);
+    }
+}
+
+uint8_t* _mg_group_payload(_MgGroup* group, uint32_t slot_index, size_t* size)
+{
+    uint8_t* data = _mg_group_data(group) + (size_t)slot_index * group->handle_stride;
+    if (!group->class_count)
+    {
+        if (size)
+        {
+            *size = group->handle_stride;
+        }
+        return group->column_count ? NULL : data;
+    }
+
+    _MgVariableRef ref;
+    memcpy(&ref, data, sizeof(ref));
+    _MgGroup* class_group = group + 1 + _mg_group_class(group, ref.size);
+
+    if (size)
+    {
+        *size = ref.size;
+    }
+    return _mg_group_data(class_group) + (size_t)MG_DECODE_INDEX(ref.slot_handle) * class_group->handle_stride;
+}
+
+void _mg_group_load(_MgGroup* group, uint32_t slot_index, uint8_t* record)
+{
+    if (!group->column_count)
+    {
+        memcpy(record, _mg_group_data(group) + (size_t)slot_index * group->handle_stride, group->handle_stride);
+        return;
+    }
+
+    memset(record, 0, group->handle_stride); // the bytes between fields were dropped when the record was stored
+    for (uint32_t i = 0; i < group->column_count; i++)
+    {
+        _MgColumn* column = &_mg_group_columns(group)[i];
+        memcpy(record + column->offset, _mg_column_cell(group, column, slot_index), column->size);
+    }
+}
+
+void _mg_group_store(_MgGroup* group, uint32_t slot_index, const void* data, size_t size)
+{
+    if (!group->column_count)
+    {
+        uint8_t* slot_data = _mg_group_data(group) + (size_t)slot_index * group->handle_stride;
+        if (size)
+        {
+            memcpy(slot_data, data, size);
+        }
+        memset(slot_data + size, 0, group->handle_stride - size);
+        return;
+    }
+
+    // a record shorter than the stride covers the fields in front in full, one field in part and the rest not
+    for (uint32_t i = 0; i < group->column_count; i++)
+    {
+        _MgColumn* column = &_mg_group_columns(group)[i];
+        uint8_t* cell     = _mg_column_cell(group, column, slot_index);
+        size_t covered    = size > column->offset ? size - column->offset : 0;
+        covered           = covered < column->size ? covered : column->size;
+        if (covered)
+        {
+            memcpy(cell, (const uint8_t*)data + column->offset, covered);
+        }
+        memset(cell + covered, 0, column->size - covered);
+    }
+}
+
+MgStatus _mg_variable_write(_MgArena* arena_internal, _MgGroup* group, uint32_t slot_index, const void* data,
+size_t size)
+{
+    _MgSlot* slot         = &_mg_group_slots(group)[slot_index];
+    _MgVariableRef* ref   = (_MgVariableRef*)(_mg_group_data(group) + (size_t)slot_index * group->handle_stride);
+    uint32_t class_index  = _mg_group_class(group, size);
+    _MgGroup* class_group = group + 1 + class_index;
+    bool written          = (slot->status == _MG_SLOT_STATUS_VALID_WRITE);
+
+    // a payload that still fits its class is overwritten where it is, otherwise it moves to the class that fits
+    if (written && _mg_group_class(group, ref->size) == class_index)
+    {
+        uint32_t class_slot = MG_DECODE_INDEX(ref->slot_handle);
+        memcpy(_mg_group_data(class_group) + (size_t)class_slot * class_group->handle_stride, data, size);
+        ref->size = (uint32_t)size;
+        _mg_group_mark_dirty(arena_internal, class_group, class_slot);
+        _mg_group_mark_dirty(arena_internal, group, slot_index);
+        return MG_SUCCESS;
+    }
+
+    uint32_t class_handle = _mg_group_slot_create(arena_internal, class_group, NULL);
+    _MG_STATUS(class_handle != _MG_HANDLE_INVALID, MG_ERROR_GROUP_EXHAUSTED);
+
+    // nobody else knows the new class slot yet, so it is filled and published without its lock
+    uint32_t class_slot = MG_DECODE_INDEX(class_handle);
+    memcpy(_mg_group_data(class_group) + (size_t)class_slot * class_group->handle_stride, data, size);
+    _mg_slot_publish(&_mg_group_slots(class_group)[class_slot], _MG_SLOT_STATUS_VALID_WRITE);
+    _mg_group_mark_dirty(arena_internal, class_group, class_slot);
+
+    if (written)
+    {
+        _mg_variable_release(arena_internal, group, slot_index);
+    }
+
+    ref->slot_handle = class_handle;
+    ref->size        = (uint32_t)size;
+    _mg_slot_publish(slot, _MG_SLOT_STATUS_VALID_WRITE);
+    _mg_group_mark_dirty(arena_internal, group, slot_index);
+
+    return MG_SUCCESS;
+}
+
+void _mg_variable_release(_MgArena* arena_internal, _MgGroup* group, uint32_t slot_index)
+{
+    _MgVariableRef* ref   = (_MgVariableRef*)(_mg_group_data(group) + (size_t)slot_index * group->handle_stride);
+    _MgGroup* class_group = group + 1 + _mg_group_class(group, ref->size);
+    _mg_group_slot_erase(arena_internal, class_group, ref->slot_handle, NULL);
+}
+
+static bool _mg_arena_shared(_MgArena* arena_internal)
+{
+    return arena_internal->alloc_kind == _MG_ARENA_ALLOC_SHARED;
+}
+
+static bool _mg_arena_locked(_MgArena* arena_internal)
+{
+    return arena_internal->sync_mode == MG_ARENA_SYNC_GROUP_SPIN ||
+           arena_internal->sync_mode == MG_ARENA_SYNC_GROUP_ADAPTIVE;
+}
+
+static void _mg_shard_lock(_MgArena* arena_internal, _MgShard* shard)
+{
+    if (_mg_arena_locked(arena_internal))
+    {
+        bool adaptive = (arena_internal->sync_mode == MG_ARENA_SYNC_GROUP_ADAPTIVE);
+        _mg_lock_acquire(&shard->lock, adaptive, arena_internal->lock_timing);
+    }
+}
+
+static void _mg_shard_unlock(_MgArena* arena_internal, _MgShard* shard)
+{
+    if (_mg_arena_locked(arena_internal))
+    {
+        _mg_lock_release(&shard->lock, arena_internal->lock_timing);
+    }
+}
+
+static MgStatus _mg_group_scan_column(_MgArena* arena_internal, MgHandleType handle_type, uint32_t field,
+_MgGroup** group, _MgColumn** column)
+{
+    *group = _mg_group_query(arena_internal, handle_type);
+    _MG_STATUS(*group, MG_ERROR_GROUP_QUERY_FAILED);
+    _MG_STATUS((*group)->column_count > 0, MG_ERROR_GROUP_NOT_COLUMNAR);
+    _MG_STATUS(field < (*group)->column_count, MG_ERROR_DATA_INVALID);
+
+    *column = &_mg_group_columns(*group)[field];
+    _MG_STATUS((*column)->type != MG_FIELD_NONE, MG_ERROR_DATA_INVALID); // plain bytes have no order to compare by
+
+    return MG_SUCCESS;
+}
+
+static size_t _mg_group_select_live(_MgGroup* group, uint64_t* selection, size_t first_word, size_t word_count)
+{
+    // selection covers the live words from first_word on, what is left are the matches
+    const uint64_t* live = _mg_group_live(group) + first_word;
+    size_t matches       = 0;
+    for (size_t i = 0; i < word_count; i++)
+    {
+        selection[i] &= live[i];
+        matches += _mg_popcount_u64(selection[i]);
+    }
+    return matches;
+}
+
+static const void* _mg_handle_read_part(MgArena* arena, MgHandle handle, uint32_t part)
+{
+    _MG_CHECK(arena, MG_ERROR_ARENA_INVALID);
+    _MgGroup* group = arena ? _mg_group_query((_MgArena*)arena, handle.type) : NULL;
+
+    // the parts are the group's two columns, a group split by fields of its own has no hot part to hand out
+    bool split = group && group->hot_size > 0;
+    _MG_CHECK(split, MG_ERROR_GROUP_NOT_SPLIT);
+
+    return split ? mg_handle_read_field(arena, handle, part) : NULL;
+}
+
+static void _mg_group_foreach_range(void* ctx, uint32_t begin, uint32_t end)
+{
+    _MgForeachJob* job = (_MgForeachJob*)ctx;
+    _MgGroup* group    = job->group;
+
+    for (uint32_t i = begin; i < end; i++)
+    {
+        _MgSlot* slot = &_mg_group_slots(group)[i];
+        if (_mg_slot_status(slot) == _MG_SLOT_STATUS_VALID_WRITE) // slot 0 is never valid
+        {
+            MgHandle handle = { slot->handle, group->handle_type };
+            job->fn(handle, _mg_group_payload(group, i, NULL), job->ctx);
+        }
+    }
 }
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include "magic_debug.h"
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #if !((defined(__STDC__) && __STDC__ == 1 && defined(__STDC_VERSION__) && __STDC_VERSION__ >= 199901L) || \
@@ -17,37 +18,361 @@ extern "C" {
 
 typedef uint32_t MgHandleType; // zero is reserved for invalid handle
 
+#define MG_HANDLE_INVALID 0
+
 typedef struct MgHandle {
     uint32_t slot_handle;
     MgHandleType type;
 } MgHandle;
 
+typedef enum MgNumaPolicy {
+    MG_NUMA_POLICY_DEFAULT    = 0, // first touch, pages land on the node of the thread that writes them first
+    MG_NUMA_POLICY_BIND       = 1, // the whole group lives on numa_node
+    MG_NUMA_POLICY_INTERLEAVE = 2, // the group is spread page by page over every node
+    MG_NUMA_POLICY_SHARDS     = 3, // shard i's payload lives on node (numa_node + i) % node count
+} MgNumaPolicy;
+
+typedef enum MgFieldType {
+    MG_FIELD_NONE = 0,
+    MG_FIELD_U32  = 1,
+    MG_FIELD_I32  = 2,
+    MG_FIELD_U64  = 3,
+    MG_FIELD_I64  = 4,
+    MG_FIELD_F32  = 5,
+    MG_FIELD_F64  = 6,
+} MgFieldType;
+
+#define MG_FIELD_COUNT_MAX 64
+
+typedef struct MgField {
+    uint32_t offset; // of the field in the record
+    uint32_t size;
+    MgFieldType type; // lets mg_group_scan compare the field, MG_FIELD_NONE for plain bytes
+} MgField;
+
+typedef enum MgScanOp {
+    MG_SCAN_EQ = 0,
+    MG_SCAN_NE = 1,
+    MG_SCAN_LT = 2,
+    MG_SCAN_LE = 3,
+    MG_SCAN_GT = 4,
+    MG_SCAN_GE = 5,
+} MgScanOp;
+
+typedef union MgValue {
+    uint64_t u64; // MG_FIELD_U32 and MG_FIELD_U64
+    int64_t i64;  // MG_FIELD_I32 and MG_FIELD_I64
+    double f64;   // MG_FIELD_F32 and MG_FIELD_F64
+} MgValue;
+
+typedef struct MgAggregate {
+    uint64_t count;
+    MgValue sum; // integer sums wrap around
+    MgValue min; // zero while count is 0
+    MgValue max;
+} MgAggregate;
+
 typedef struct MgHandleDescriptor {
     MgHandleType type;
     size_t count;
     uint32_t stride;
+    uint32_t shard_count; // 0 or 1 for a single group, otherwise the slots are split into per-core shards
+    MgNumaPolicy numa_policy;
+    uint32_t numa_node;
+    bool variable;          // payloads of any size up to stride in power of two size classes, see mg_handle_read_sized
+    uint32_t blob_capacity; // bytes of blob storage shared by the group's handles, see mg_handle_blob_write
+    bool indexed;           // handles can be looked up by a uint64_t key in their payload, see mg_handle_find
+    uint32_t key_offset;    // where that key sits in the payload
+    MgFieldType order_type; // handles are kept sorted by a payload field of this type, see mg_group_range
+    uint32_t order_offset;  // where that field sits in the payload
+    const MgField* fields;  // every field is stored in a column of its own, see mg_group_column
+    uint32_t field_count;   // 0 keeps the records whole
+    uint32_t hot_size;      // the first hot_size bytes of every record live apart from the rest, see mg_handle_read_hot
 } MgHandleDescriptor;
 
+typedef enum MgArenaSyncMode {
+    MG_ARENA_SYNC_NONE           = 0, // no locking, arena must only be touched by one thread at a time
+    MG_ARENA_SYNC_GROUP_SPIN     = 1, // independent spinlock per group, handle types never contend with each other
+    MG_ARENA_SYNC_GROUP_ADAPTIVE = 2, // same as spin, but yields the core after a short spin
+    MG_ARENA_SYNC_THREAD_OWNED   = 3, // every attached thread owns one shard per group, see mg_arena_thread_attach
+} MgArenaSyncMode;
+
 typedef struct MgArenaDescriptor {
     const char* arena_name;
     MgHandleDescriptor* handle_descriptors;
     uint32_t handle_descriptors_count;
+    MgArenaSyncMode sync_mode;
+    bool lock_timing; // track lock hold times (costs two clock reads per locked call)
+    bool track_dirty; // remember created, written and erased slots for mg_arena_save_delta
+    bool copy_on_write; // back the arena with a memory file for mg_arena_snapshot, no numa placement
 } MgArenaDescriptor;
 
+typedef struct MgLogDescriptor {
+    const char* path;
+    bool truncate;              // start the log empty, otherwise new records are appended to the file
+    bool sync_commit;           // logged calls wait until their record is durable, concurrent callers share a sync
+    uint32_t flush_interval_ms; // how long records may gather before the flush thread writes them, 0 means 10ms
+} MgLogDescriptor;
+
+typedef struct MgReplicaStats {
+    uint64_t applied_lsn; // leader log offset the mirror has caught up to
+    uint64_t lag_ns;      // from the leader appending the oldest record of the last batch until it was applied
+    uint64_t batch_count;
+    bool closed; // the leader closed the stream, the mirror is complete and may take over
+} MgReplicaStats;
+
+typedef struct MgLockStats {
+    uint64_t acquire_count;
+    uint64_t contended_count;  // acquisitions that had to wait for another thread
+    uint64_t hold_time_ns;     // total time held, zero unless lock_timing is set
+    uint64_t max_hold_time_ns; // longest single hold, zero unless lock_timing is set
+} MgLockStats;
+
+// called once per live handle, data points straight at the handle's payload (NULL for columnar groups)
+typedef void (*MgForeachFn)(MgHandle handle, void* data, void* ctx);
+// called once per handle mg_group_defragment moved, from is stale from then on and to holds its payload
+typedef void (*MgRelocateFn)(MgHandle from, MgHandle to, void* ctx);
+
+typedef enum MgDiffKind {
+    MG_DIFF_CREATED  = 1, // written handle that did not exist before
+    MG_DIFF_ERASED   = 2, // handle that no longer exists, no data
+    MG_DIFF_MODIFIED = 3, // same handle, different payload
+} MgDiffKind;
+
+typedef struct MgDiffEntry {
+    MgDiffKind kind;
+    MgHandle handle;
+    // the new payload, points into the diffed arena until it changes. columnar groups have no record there, their
+    // data is a copy that lasts until fn returns.
+    const void* data;
+    size_t data_size; // the group's stride, zero for erased handles
+} MgDiffEntry;
+
+typedef void (*MgDiffFn)(const MgDiffEntry* entry, void* ctx);
+
+#define MG_SERIAL_ALIGNMENT 16 // alignment of mg_serial_arena_write, enough for any scalar type
+
+typedef struct MgSerialArena {
+    uint8_t* data;
+    size_t write_marker; // offset of the next free byte
+    size_t end_marker;   // the capacity, rounded up to whole pages
+    size_t committed;    // bytes from data that have memory behind them, only ever grows
+} MgSerialArena;
+
+typedef size_t MgSerialMarker; // a write marker saved by mg_serial_arena_mark
+
+#define MG_FRAME_REGIONS_MAX 4
+
+typedef struct MgFrameArena {
+    MgSerialArena regions[MG_FRAME_REGIONS_MAX];
+    uint32_t region_count;
+    uint32_t current;     // region the running frame allocates from
+    uint64_t frame_index; // frames begun so far
+} MgFrameArena;
+
 #define MG_DEFINE_OPAQUE_HANDLE(object) typedef struct object##_T* object;
 MG_DEFINE_OPAQUE_HANDLE(MgSegment);
 MG_DEFINE_OPAQUE_HANDLE(MgBlock);
 MG_DEFINE_OPAQUE_HANDLE(MgArena);
 
 extern MgArena* mg_arena_init(MgArenaDescriptor* descriptor);
+
+// shared arenas live in named shared memory, so a producer process writes handles that consumer processes read in
+// place. handles are plain integers that mean the same in every process. readers never lock, a process that opened
+// the arena readonly may only read, check and iterate. no numa placement, copy on write, variable size groups,
+// indexes, log or thread owned mode.
+// the creator's mg_arena_destroy removes the name, processes that opened it keep their mapping until they destroy.
+extern MgArena* mg_arena_create_shared(const char* name, MgArenaDescriptor* descriptor);
+extern MgArena* mg_arena_open_shared(const char* name, bool readonly);
+
+// file backed arenas: the arena block is a shared mapping of the file, so writes land in the page cache and the
+// kernel pages arenas larger than memory in and out. a missing or empty file is created from the descriptor, an
+// existing one is used as it is, so every handle is valid again without loading anything. it keeps the settings
+// it was created with and the descriptor must describe the same groups. one arena at a time has the file open, it
+// is locked until mg_arena_destroy and opening it again meanwhile fails with MG_ERROR_ARENA_FILE_BUSY.
+extern MgArena* mg_arena_open_file(const char* path, MgArenaDescriptor* descriptor);
+// makes every change so far durable, payloads before the slot metadata that points at them. async only starts the
+// write back. the kernel also writes pages back on its own, in any order, so after a crash handles changed since
+// the last completed sync may show an older payload. the next open relinks the free lists, mg_arena_destroy syncs.
+extern MgStatus mg_arena_sync(MgArena* arena, bool async);
 extern void mg_arena_destroy(MgArena** arena);
+// the arena is a single position independent block of this many bytes starting at the arena pointer,
+// a byte for byte copy of it is a working arena at its new address
+extern size_t mg_arena_size(MgArena* arena);
+// independent copy of the whole arena: every handle of src is valid in the clone with the same contents. src must
+// not be modified while it is cloned. the clone keeps the numa placement but not the log or thread attachments.
+extern MgArena* mg_arena_clone(MgArena* src);
+
+// snapshots: the arena block written to a file behind a versioned header. nothing may modify the arena while it
+// is saved. loading maps the file copy on write, so every saved handle is valid again without parsing or copying,
+// and later changes to the loaded arena never reach the file. mg_arena_destroy unmaps it.
+extern MgStatus mg_arena_save(MgArena* arena, const char* path);
+extern MgArena* mg_arena_load_mapped(const char* path);
+extern MgStatus mg_arena_verify(const char* path); // checks the checksum, reads the whole file
+
+// incremental checkpoints, the arena needs track_dirty. a delta holds only the slots created, written or erased
+// since the previous save or delta, so its size follows the churn rather than the arena size. loading applies
+// the deltas in order on top of the snapshot they were taken from, the result keeps chaining new deltas.
+extern MgStatus mg_arena_save_delta(MgArena* arena, const char* path);
+extern MgArena* mg_arena_load_chain(const char* base_path, const char** delta_paths, uint32_t delta_count);
+
+// in memory snapshots, the arena needs copy_on_write. the arena is a copy on write view of the last snapshot, so
+// a write duplicates only the page it lands on. taking a snapshot copies just those pages, a rollback drops them
+// and the arena reads the snapshot again. neither copies an unchanged page, but finding the changed ones costs a
+// snapshot a page map entry per arena page on linux, and posix builds without a page map copy the whole arena.
+// a rollback is one remap. nothing may use the arena while either runs, thread attachments are kept.
+extern MgStatus mg_arena_snapshot(MgArena* arena);
+extern MgStatus mg_arena_rollback(MgArena* arena); // not while a log is open, it would still hold the undone calls
+
+// operation log: every create, write and erase is appended as a record and made durable by a background thread
+// that batches records into one write and sync. replay rebuilds an arena from a log with every slot at the
+// generation it was logged with, so handles held by clients stay valid (or stay erased) across a crash. records
+// are queued under the shard lock of the change, so the log has the calls on one handle in the order they applied.
+// a record the log could not take leaves the change in place and is reported as MG_ERROR_LOG_IO_FAILED, returned by
+// calls with a status and raised like any other error by create and erase.
+extern MgStatus mg_arena_log_open(MgArena* arena, const MgLogDescriptor* descriptor);
+extern MgStatus mg_arena_log_flush(MgArena* arena); // waits until everything logged so far is durable
+extern MgStatus mg_arena_log_close(MgArena* arena); // flushes, mg_arena_destroy closes an open log too
+extern MgArena* mg_arena_replay(MgArenaDescriptor* descriptor, const char* path);
+
+// replication: a publisher streams the same records as the log to a follower process, over a pipe or connected
+// stream socket (an fd, a HANDLE on windows) that the caller opens and closes. the stream starts with every live
+// handle, so nothing may modify the arena while the publisher opens. the follower applies each batch to a mirror
+// made from the same descriptor, every handle at the leader's generation. a slow follower eventually blocks the
+// leader's calls, one that went away is dropped and only reported by mg_arena_publish_close.
+extern MgStatus mg_arena_publish_open(MgArena* arena, intptr_t stream, uint32_t flush_interval_ms); // 0 means 10ms
+extern MgStatus mg_arena_publish_close(MgArena* arena); // sends what is still buffered
+// blocks until the next batch arrives and applies it. the mirror may be read between calls but nothing else may
+// modify it. stats accumulate over calls, start them zeroed. at the end of the stream it sets stats->closed.
+extern MgStatus mg_arena_follow(MgArena* mirror, intptr_t stream, MgReplicaStats* stats);
+
+// replication: diff reports every handle created, erased or modified going from one arena to another built from
+// the same descriptor, unchanged runs of slots are skipped with vector compares. patch applies such entries to a
+// copy of the first arena, which then has the same handles with the same contents, so only the changes travel.
+// nothing may modify the arenas while they are diffed or patched.
+extern MgStatus mg_arena_diff(MgArena* from, MgArena* to, MgDiffFn fn, void* ctx);
+extern MgStatus mg_arena_patch(MgArena* arena, const MgDiffEntry* entries, uint32_t entry_count);
 
 extern MgHandle mg_handle_create(MgArena* arena, uint32_t handle_type);
 extern MgStatus mg_handle_write(MgArena* arena, MgHandle handle, const void* data, size_t data_size);
 extern const void* mg_handle_read(MgArena* arena, MgHandle handle);
+// variable size handles: every size class has room for count handles, but only the pages a class uses get memory.
+// they may be written again with a new size, a payload that outgrows its class moves to the next one, so pointers
+// from an earlier read are stale after a write. data_size is the size last written, the stride for fixed size types.
+// not in thread owned arenas.
+extern const void* mg_handle_read_sized(MgArena* arena, MgHandle handle, size_t* data_size);
 extern void mg_handle_erase(MgArena* arena, MgHandle handle);
 extern bool mg_handle_valid(MgArena* arena, MgHandle handle);
 
+// blobs: a written handle of a group with a blob_capacity can carry one byte buffer of any size next to its
+// payload. blobs are bumped into the group's blob region, the holes replaced and erased ones leave behind are
+// reclaimed by compaction, which a write that does not fit runs on its own. compaction moves blobs, so a pointer
+// from mg_handle_blob_read is stale after the next blob write or compaction of the group. blobs are 8 byte
+// aligned, and not part of deltas or diffs. not in thread owned arenas.
+extern MgStatus mg_handle_blob_write(MgArena* arena, MgHandle handle, const void* data, size_t data_size);
+extern const void* mg_handle_blob_read(MgArena* arena, MgHandle handle, size_t* data_size); // NULL without a blob
+extern MgStatus mg_group_compact(MgArena* arena, MgHandleType handle_type);
+// erases every handle of the group at once and empties its blob region. in thread owned arenas only while no
+// other thread uses the group.
+extern MgStatus mg_group_reset(MgArena* arena, MgHandleType handle_type);
+
+// indexed groups: writing a handle files it under the uint64_t key at key_offset of its payload, erasing it takes
+// the key out again. keys are unique within the group, a write whose key another handle holds fails with
+// MG_ERROR_INDEX_KEY_EXISTS and changes nothing. payloads have to reach past the key, and the key may only change
+// through mg_handle_write. not in thread owned arenas.
+extern MgHandle mg_handle_find(MgArena* arena, MgHandleType handle_type, uint64_t key); // invalid if not indexed
+// ordered groups: written handles are kept in a b+ tree sorted by the field at order_offset, ties in handle order.
+// mg_group_range calls fn for every handle whose field lies within min and max (both inclusive, pointers to a
+// value of the field's type, NULL for no bound) in ascending order, and never visits the rest of the group. fn
+// runs without any lock held, so it may read, write and erase handles, changes behind the walk are not seen.
+// floats sort by value with -0 below 0. not in thread owned arenas.
+extern MgStatus mg_group_range(MgArena* arena, MgHandleType handle_type, const void* min, const void* max,
+MgForeachFn fn, void* ctx);
+
+// columnar groups: a descriptor with fields keeps each field in a column of its own, the field of every slot back
+// to back, so a kernel over one field streams only that field's bytes. mg_handle_write takes the whole record and
+// splits it over the columns, bytes outside every field are dropped. there is no record to point at, so
+// mg_handle_read fails and foreach passes no data, fields are read and written one at a time or a column at once.
+// a column has one row per slot, rows of erased and unwritten slots read as zero. writes through a column skip
+// the log and dirty tracking, like writes through the data foreach passes. fields lie in the record in ascending
+// order without overlapping. not variable size, indexed or ordered, and no MG_NUMA_POLICY_SHARDS placement.
+extern const void* mg_handle_read_field(MgArena* arena, MgHandle handle, uint32_t field);
+extern MgStatus mg_handle_write_field(MgArena* arena, MgHandle handle, uint32_t field, const void* data); // written
+extern void* mg_group_column(MgArena* arena, MgHandleType handle_type, uint32_t field, size_t* row_count);
+extern uint32_t mg_handle_row(MgHandle handle); // of the handle in its group's columns
+
+// column scans: a typed field of a columnar group is compared against a constant of the field's type, op value,
+// over every row at once with the widest vector instructions the cpu has. mg_group_scan sets bit row % 64 of
+// selection[row / 64] for every written handle that matches and clears the rest, selection holds
+// (row_count + 63) / 64 words. mg_group_scan_handles lists the matching handles in row order instead, up to
+// capacity of them, match_count is the number of matches either way. mg_group_aggregate sums a field and finds
+// its min and max over the selected rows (NULL selects every written handle). floats compare like ieee says, nan
+// only matches MG_SCAN_NE, is counted and summed but never a min or max. no creates or erases in the group
+// during a scan, like foreach.
+extern MgStatus mg_group_scan(MgArena* arena, MgHandleType handle_type, uint32_t field, MgScanOp op,
+const void* value, uint64_t* selection, size_t* match_count);
+extern MgStatus mg_group_scan_handles(MgArena* arena, MgHandleType handle_type, uint32_t field, MgScanOp op,
+const void* value, MgHandle* handles, size_t capacity, size_t* match_count);
+extern MgStatus mg_group_aggregate(MgArena* arena, MgHandleType handle_type, uint32_t field,
+const uint64_t* selection, MgAggregate* result);
+
+// hot/cold groups: a descriptor with a hot_size keeps the first hot_size bytes of every record, its hot part, in one
+// array and the rest of the stride, its cold part, in another, both indexed by slot. a loop that only reads hot
+// parts streams hot_size bytes per handle instead of the whole stride. the group is a columnar group with the hot
+// part as field 0 and the cold part as field 1: mg_handle_write splits a record, mg_handle_write_field rewrites one
+// part and mg_group_column hands out a whole array. hot_size is below the stride, no fields besides.
+extern const void* mg_handle_read_hot(MgArena* arena, MgHandle handle);
+extern const void* mg_handle_read_cold(MgArena* arena, MgHandle handle);
+
+// defragmentation: erases leave holes that creates refill in any order, so the live handles of a long running
+// group end up scattered over its slots and every walk over it touches lines that are mostly empty.
+// mg_group_defragment moves the last live handles of each shard into the lowest free slots in front of them,
+// payload, blob and keys included, until every shard is packed at its front. the handle changes with its slot, fn
+// gets the old and new one of every move (outside any lock) to update whatever holds handles, and stale handles
+// fail like erased ones. a call stops after moving byte_budget bytes of records or after time_budget_ns (0 for no
+// limit), having moved at least one handle, packed tells whether the group is dense again. afterwards creates
+// fill the front first. size class payloads stay where they are. other threads leave the group alone meanwhile.
+extern MgStatus mg_group_defragment(MgArena* arena, MgHandleType handle_type, size_t byte_budget,
+uint64_t time_budget_ns, MgRelocateFn fn, void* ctx, bool* packed);
+
+// thread owned arenas: each thread creates only from its own shard, without locks or atomics.
+// erasing a handle from another thread queues the slot back to its owner, who reclaims it on its next create.
+extern MgStatus mg_arena_thread_attach(MgArena* arena);
+extern MgStatus mg_arena_thread_detach(MgArena* arena);
+
+extern uint32_t mg_handle_shard(MgArena* arena, MgHandle handle); // shard id lives in the high bits of the slot index
+
+// visits every written handle of a type. the group must not be created into or erased from while iterating.
+extern MgStatus mg_group_foreach(MgArena* arena, MgHandleType handle_type, MgForeachFn fn, void* ctx);
+// same as mg_group_foreach, but chunks of grain slots run on the built-in work-stealing pool (grain 0 picks one).
+// chunks are rounded so they start on a cache line and no two workers ever write the same line.
+extern MgStatus mg_group_parallel_foreach(MgArena* arena, MgHandleType handle_type, MgForeachFn fn, void* ctx, uint32_t grain);
+
+extern uint32_t mg_numa_node_count(void);
+extern uint32_t mg_numa_node_current(void);
+
+extern MgStatus mg_group_lock_stats(MgArena* arena, MgHandleType handle_type, MgLockStats* stats);
+
+// serial arenas: a bump allocator for scratch data that never goes through malloc. allocations are carved off at
+// the write marker, clear drops all of them at once, and restoring a marker saved with mark drops everything
+// allocated after it, for temporaries of a scope. the capacity is reserved up front and pages are committed as
+// the marker first reaches them, so allocations never move. not thread safe, use one per thread or request.
+extern MgStatus mg_serial_arena_init(MgSerialArena* arena, size_t capacity);
+extern void mg_serial_arena_destroy(MgSerialArena* arena);
+extern void* mg_serial_arena_alloc(MgSerialArena* arena, size_t size, size_t alignment); // NULL once full
+extern void* mg_serial_arena_write(MgSerialArena* arena, const void* data, size_t size); // copy at MG_SERIAL_ALIGNMENT
+extern void mg_serial_arena_clear(MgSerialArena* arena); // committed pages are kept for the next round
+extern MgSerialMarker mg_serial_arena_mark(MgSerialArena* arena);
+extern MgStatus mg_serial_arena_restore(MgSerialArena* arena, MgSerialMarker marker); // not past the write marker
+
+// frame arenas: per frame scratch memory from region_count serial arenas used in turn. mg_frame_begin clears the
+// region of the oldest frame and makes it current, so whatever a frame allocated stays valid through the next
+// region_count - 1 frames (one more frame with two regions) and is dropped without freeing anything one by one.
+extern MgStatus mg_frame_arena_init(MgFrameArena* frames, uint32_t region_count, size_t region_capacity);
+extern void mg_frame_arena_destroy(MgFrameArena* frames);
+extern void mg_frame_begin(MgFrameArena* frames);
+extern void* mg_frame_alloc(MgFrameArena* frames, size_t size, size_t alignment); // NULL once the region is full
+
 extern void mg_arena_print(MgArena* arena);
 
 #if __cplusplus
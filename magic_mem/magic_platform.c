@@ -0,0 +1,1247 @@
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE // sched_getcpu
+#endif
+
+#include "magic_platform.h"
+
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define _MG_STREAM_STORES 1
+#endif
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <malloc.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
+#endif
+
+enum {
+    _MG_LOCK_SPIN_LIMIT = 128, // adaptive locks yield the core after this many failed polls
+};
+
+void _mg_lock_acquire(_MgLock* lock, bool adaptive, bool timing)
+{
+    if (!_mg_atomic_cas_u32(&lock->state, 0, 1))
+    {
+        uint32_t spins = 0;
+        do
+        {
+            while (_mg_atomic_load_u32(&lock->state) != 0)
+            {
+                if (adaptive && ++spins >= _MG_LOCK_SPIN_LIMIT)
+                {
+                    _mg_thread_yield();
+                    spins = 0;
+                }
+                else
+                {
+                    _mg_cpu_relax();
+                }
+            }
+        } while (!_mg_atomic_cas_u32(&lock->state, 0, 1));
+
+        lock->contended_count++;
+    }
+
+    lock->acquire_count++;
+
+    if (timing)
+    {
+        lock->acquire_time_ns = _mg_time_ns();
+    }
+}
+
+void _mg_lock_release(_MgLock* lock, bool timing)
+{
+    if (timing)
+    {
+        uint64_t held_ns = _mg_time_ns() - lock->acquire_time_ns;
+        lock->hold_time_ns += held_ns;
+        if (held_ns > lock->max_hold_time_ns)
+        {
+            lock->max_hold_time_ns = held_ns;
+        }
+    }
+
+    _mg_atomic_store_u32(&lock->state, 0);
+}
+
+uint32_t _mg_thread_token(void)
+{
+    static volatile uint32_t next_token;
+    static _MG_THREAD_LOCAL uint32_t thread_token;
+    if (thread_token == 0)
+    {
+        thread_token = _mg_atomic_fetch_add_u32(&next_token, 1) + 1;
+    }
+    return thread_token;
+}
+
+void _mg_memcpy_stream(void* dst, const void* src, size_t size)
+{
+#if defined(_MG_STREAM_STORES)
+    uint8_t* to         = (uint8_t*)dst;
+    const uint8_t* from = (const uint8_t*)src;
+
+    size_t head = ((uintptr_t)0 - (uintptr_t)to) & 15; // streaming stores need an aligned destination
+    head        = head < size ? head : size;
+    memcpy(to, from, head);
+    to += head;
+    from += head;
+    size -= head;
+
+    for (; size >= 64; size -= 64, to += 64, from += 64)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i*)from + 0);
+        __m128i b = _mm_loadu_si128((const __m128i*)from + 1);
+        __m128i c = _mm_loadu_si128((const __m128i*)from + 2);
+        __m128i d = _mm_loadu_si128((const __m128i*)from + 3);
+        _mm_stream_si128((__m128i*)to + 0, a);
+        _mm_stream_si128((__m128i*)to + 1, b);
+        _mm_stream_si128((__m128i*)to + 2, c);
+        _mm_stream_si128((__m128i*)to + 3, d);
+    }
+    _mm_sfence(); // streamed stores are weakly ordered, publish them before the caller hands the copy out
+
+    memcpy(to, from, size);
+#else
+    memcpy(dst, src, size);
+#endif
+}
+
+#if defined(_WIN32)
+
+typedef char _mg_thread_fits[(sizeof(HANDLE) * 2 <= sizeof(_MgThread)) ? 1 : -1];
+typedef char _mg_mutex_fits[(sizeof(SRWLOCK) <= sizeof(_MgMutex)) ? 1 : -1];
+typedef char _mg_cond_fits[(sizeof(CONDITION_VARIABLE) <= sizeof(_MgCond)) ? 1 : -1];
+
+typedef struct _MgThreadStart {
+    _MgThreadFn fn;
+    void* arg;
+} _MgThreadStart;
+
+static DWORD WINAPI _mg_thread_entry(LPVOID param)
+{
+    _MgThreadStart start = *(_MgThreadStart*)param;
+    HeapFree(GetProcessHeap(), 0, param);
+    start.fn(start.arg);
+    return 0;
+}
+
+bool _mg_thread_create(_MgThread* thread, _MgThreadFn fn, void* arg)
+{
+    _MgThreadStart* start = (_MgThreadStart*)HeapAlloc(GetProcessHeap(), 0, sizeof(_MgThreadStart));
+    if (!start)
+    {
+        return false;
+    }
+    start->fn  = fn;
+    start->arg = arg;
+
+    HANDLE handle = CreateThread(NULL, 0, _mg_thread_entry, start, 0, NULL);
+    if (!handle)
+    {
+        HeapFree(GetProcessHeap(), 0, start);
+        return false;
+    }
+
+    *(HANDLE*)thread->opaque = handle;
+    return true;
+}
+
+void _mg_thread_join(_MgThread* thread)
+{
+    HANDLE handle = *(HANDLE*)thread->opaque;
+    WaitForSingleObject(handle, INFINITE);
+    CloseHandle(handle);
+}
+
+void _mg_mutex_init(_MgMutex* mutex)
+{
+    InitializeSRWLock((SRWLOCK*)mutex->opaque);
+}
+
+void _mg_mutex_destroy(_MgMutex* mutex)
+{
+    (void)mutex; // srw locks own no resources
+}
+
+void _mg_mutex_lock(_MgMutex* mutex)
+{
+    AcquireSRWLockExclusive((SRWLOCK*)mutex->opaque);
+}
+
+void _mg_mutex_unlock(_MgMutex* mutex)
+{
+    ReleaseSRWLockExclusive((SRWLOCK*)mutex->opaque);
+}
+
+void _mg_cond_init(_MgCond* cond)
+{
+    InitializeConditionVariable((CONDITION_VARIABLE*)cond->opaque);
+}
+
+void _mg_cond_destroy(_MgCond* cond)
+{
+    (void)cond;
+}
+
+void _mg_cond_wait(_MgCond* cond, _MgMutex* mutex)
+{
+    SleepConditionVariableSRW((CONDITION_VARIABLE*)cond->opaque, (SRWLOCK*)mutex->opaque, INFINITE, 0);
+}
+
+void _mg_cond_wait_timeout(_MgCond* cond, _MgMutex* mutex, uint32_t timeout_ms)
+{
+    SleepConditionVariableSRW((CONDITION_VARIABLE*)cond->opaque, (SRWLOCK*)mutex->opaque, timeout_ms, 0);
+}
+
+void _mg_cond_broadcast(_MgCond* cond)
+{
+    WakeAllConditionVariable((CONDITION_VARIABLE*)cond->opaque);
+}
+
+uint32_t _mg_cpu_count(void)
+{
+    DWORD count = GetActiveProcessorCount(ALL_PROCESSOR_GROUPS);
+    return count > 0 ? (uint32_t)count : 1;
+}
+
+uint32_t _mg_cpu_current(void)
+{
+    return (uint32_t)GetCurrentProcessorNumber();
+}
+
+size_t _mg_page_size(void)
+{
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (size_t)info.dwPageSize;
+}
+
+void* _mg_pages_reserve(size_t size)
+{
+    return VirtualAlloc(NULL, size, MEM_RESERVE, PAGE_READWRITE);
+}
+
+void _mg_pages_release(void* ptr, size_t size)
+{
+    (void)size;
+    VirtualFree(ptr, 0, MEM_RELEASE);
+}
+
+bool _mg_pages_commit(void* ptr, size_t size, _MgPagePolicy policy, uint32_t node)
+{
+    HANDLE process = GetCurrentProcess();
+
+    switch (policy)
+    {
+    case _MG_PAGE_POLICY_BIND:
+        if (VirtualAllocExNuma(process, ptr, size, MEM_COMMIT, PAGE_READWRITE, node))
+        {
+            return true;
+        }
+        break; // fall back to default placement
+
+    case _MG_PAGE_POLICY_INTERLEAVE:
+    {
+        size_t page_size    = _mg_page_size();
+        uint32_t node_count = _mg_numa_node_count();
+        bool placed         = true;
+        for (size_t offset = 0; offset < size && placed; offset += page_size)
+        {
+            size_t length = (size - offset) < page_size ? (size - offset) : page_size;
+            placed        = VirtualAllocExNuma(process, (uint8_t*)ptr + offset, length, MEM_COMMIT, PAGE_READWRITE,
+                     (DWORD)((offset / page_size) % node_count)) != NULL;
+        }
+        if (placed)
+        {
+            return true;
+        }
+        break;
+    }
+
+    default: break;
+    }
+
+    return VirtualAlloc(ptr, size, MEM_COMMIT, PAGE_READWRITE) != NULL;
+}
+
+uint32_t _mg_numa_node_count(void)
+{
+    ULONG highest = 0;
+    return GetNumaHighestNodeNumber(&highest) ? (uint32_t)highest + 1 : 1;
+}
+
+uint32_t _mg_numa_node_current(void)
+{
+    PROCESSOR_NUMBER processor;
+    GetCurrentProcessorNumberEx(&processor);
+
+    USHORT node = 0;
+    return GetNumaProcessorNodeEx(&processor, &node) ? (uint32_t)node : 0;
+}
+
+void* _mg_file_map(const char* path, size_t* size)
+{
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return NULL;
+    }
+
+    void* ptr = NULL;
+    LARGE_INTEGER file_size;
+    if (GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0)
+    {
+        HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+        if (mapping)
+        {
+            ptr = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+            CloseHandle(mapping); // the view keeps the mapping alive
+        }
+        *size = (size_t)file_size.QuadPart;
+    }
+
+    CloseHandle(file);
+    return ptr;
+}
+
+void _mg_file_unmap(void* ptr, size_t size)
+{
+    (void)size;
+    UnmapViewOfFile(ptr);
+}
+
+void* _mg_file_map_shared(_MgFile* file, const char* path, size_t size, bool* created, bool* busy)
+{
+    // sharing only reads is the lock, a second writer is turned away until this handle closes
+    HANDLE handle = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, OPEN_ALWAYS,
+    FILE_ATTRIBUTE_NORMAL, NULL);
+    if (handle == INVALID_HANDLE_VALUE)
+    {
+        *busy = (GetLastError() == ERROR_SHARING_VIOLATION);
+        return NULL;
+    }
+
+    LARGE_INTEGER file_size = { 0 };
+    if (!GetFileSizeEx(handle, &file_size) || (file_size.QuadPart != 0 && (uint64_t)file_size.QuadPart != size))
+    {
+        CloseHandle(handle);
+        return NULL;
+    }
+
+    // the section grows an empty file to its size, the view keeps the section alive
+    HANDLE section = CreateFileMappingA(handle, NULL, PAGE_READWRITE, (DWORD)((uint64_t)size >> 32), (DWORD)size, NULL);
+    void* ptr      = section ? MapViewOfFile(section, FILE_MAP_WRITE, 0, 0, size) : NULL;
+    if (section)
+    {
+        CloseHandle(section);
+    }
+    if (!ptr)
+    {
+        CloseHandle(handle);
+        return NULL;
+    }
+
+    file->opaque = (intptr_t)handle;
+    *created     = (file_size.QuadPart == 0);
+    return ptr;
+}
+
+bool _mg_file_flush(_MgFile* file, void* ptr, size_t size, bool async)
+{
+    // the view flush only hands the pages to the cache manager, the file flush waits for the disk
+    return FlushViewOfFile(ptr, size) && (async || FlushFileBuffers((HANDLE)file->opaque));
+}
+
+void _mg_file_unmap_shared(_MgFile* file, void* ptr, size_t size)
+{
+    (void)size;
+    UnmapViewOfFile(ptr);
+    CloseHandle((HANDLE)file->opaque);
+}
+
+bool _mg_file_open_append(_MgFile* file, const char* path, bool truncate)
+{
+    DWORD disposition = truncate ? CREATE_ALWAYS : OPEN_ALWAYS;
+    HANDLE handle = CreateFileA(path, FILE_APPEND_DATA, FILE_SHARE_READ, NULL, disposition, FILE_ATTRIBUTE_NORMAL, NULL);
+    file->opaque  = (intptr_t)handle;
+    return handle != INVALID_HANDLE_VALUE;
+}
+
+bool _mg_file_write(_MgFile* file, const void* data, size_t size)
+{
+    const uint8_t* bytes = (const uint8_t*)data;
+    while (size > 0)
+    {
+        DWORD chunk   = size > 0x40000000 ? 0x40000000 : (DWORD)size;
+        DWORD written = 0;
+        if (!WriteFile((HANDLE)file->opaque, bytes, chunk, &written, NULL))
+        {
+            return false;
+        }
+        bytes += written;
+        size -= written;
+    }
+    return true;
+}
+
+bool _mg_file_sync(_MgFile* file)
+{
+    return FlushFileBuffers((HANDLE)file->opaque) != 0;
+}
+
+void _mg_file_close(_MgFile* file)
+{
+    CloseHandle((HANDLE)file->opaque);
+}
+
+bool _mg_file_replace(const char* from, const char* to)
+{
+    return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+}
+
+bool _mg_stream_write(_MgFile* stream, const void* data, size_t size)
+{
+    return _mg_file_write(stream, data, size); // a broken pipe is an error here, not a signal
+}
+
+size_t _mg_stream_read(_MgFile* stream, void* data, size_t size)
+{
+    uint8_t* bytes = (uint8_t*)data;
+    size_t total   = 0;
+    while (total < size)
+    {
+        DWORD chunk = (size - total) > 0x40000000 ? 0x40000000 : (DWORD)(size - total);
+        DWORD read  = 0;
+        if (!ReadFile((HANDLE)stream->opaque, bytes + total, chunk, &read, NULL) || read == 0)
+        {
+            break; // ERROR_BROKEN_PIPE once the writer closed its end
+        }
+        total += read;
+    }
+    return total;
+}
+
+bool _mg_memfile_create(_MgMemFile* file, size_t size)
+{
+    HANDLE section = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, (DWORD)((uint64_t)size >> 32),
+    (DWORD)size, NULL);
+    file->opaque = (intptr_t)section;
+    return section != NULL;
+}
+
+void* _mg_memfile_map_private(_MgMemFile* file, size_t size)
+{
+    return MapViewOfFile((HANDLE)file->opaque, FILE_MAP_COPY, 0, 0, size);
+}
+
+void _mg_memfile_unmap(void* view, size_t size)
+{
+    (void)size;
+    UnmapViewOfFile(view);
+}
+
+void _mg_memfile_close(_MgMemFile* file)
+{
+    CloseHandle((HANDLE)file->opaque);
+}
+
+bool _mg_memfile_commit(_MgMemFile* file, void* view, size_t size)
+{
+    uint8_t* shared = (uint8_t*)MapViewOfFile((HANDLE)file->opaque, FILE_MAP_WRITE, 0, 0, size);
+    if (!shared)
+    {
+        return false;
+    }
+
+    // a duplicated page turns from PAGE_WRITECOPY into PAGE_READWRITE, so walking the regions of the view finds
+    // every modified range without comparing any data
+    uint8_t* at  = (uint8_t*)view;
+    uint8_t* end = at + size;
+    bool walked  = true;
+    while (at < end && walked)
+    {
+        MEMORY_BASIC_INFORMATION info;
+        walked = VirtualQuery(at, &info, sizeof(info)) != 0;
+        if (walked)
+        {
+            uint8_t* region_end = (uint8_t*)info.BaseAddress + info.RegionSize;
+            size_t length       = (size_t)((region_end < end ? region_end : end) - at);
+            if (info.Protect == PAGE_READWRITE)
+            {
+                memcpy(shared + (at - (uint8_t*)view), at, length);
+            }
+            at += length;
+        }
+    }
+
+    UnmapViewOfFile(shared);
+    return walked && _mg_memfile_revert(file, view, size);
+}
+
+void* _mg_shm_create(const char* name, size_t size)
+{
+    HANDLE section = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, (DWORD)((uint64_t)size >> 32),
+    (DWORD)size, name);
+    if (section && GetLastError() == ERROR_ALREADY_EXISTS)
+    {
+        CloseHandle(section);
+        section = NULL;
+    }
+
+    void* ptr = section ? MapViewOfFile(section, FILE_MAP_ALL_ACCESS, 0, 0, size) : NULL;
+    if (section)
+    {
+        CloseHandle(section); // the view keeps the section alive
+    }
+    return ptr;
+}
+
+void* _mg_shm_open(const char* name, bool readonly, size_t* size)
+{
+    DWORD access   = readonly ? FILE_MAP_READ : FILE_MAP_ALL_ACCESS;
+    HANDLE section = OpenFileMappingA(access, FALSE, name);
+    if (!section)
+    {
+        return NULL;
+    }
+
+    void* ptr = MapViewOfFile(section, access, 0, 0, 0);
+    CloseHandle(section);
+
+    MEMORY_BASIC_INFORMATION info;
+    if (ptr && VirtualQuery(ptr, &info, sizeof(info)) != 0)
+    {
+        *size = info.RegionSize;
+    }
+    return ptr;
+}
+
+void _mg_shm_unmap(void* ptr, size_t size)
+{
+    (void)size;
+    UnmapViewOfFile(ptr);
+}
+
+void _mg_shm_remove(const char* name)
+{
+    (void)name; // sections are named only while mapped
+}
+
+bool _mg_memfile_revert(_MgMemFile* file, void* view, size_t size)
+{
+    // a view cannot drop its private pages in place, it is mapped again at the same address
+    UnmapViewOfFile(view);
+    return MapViewOfFileEx((HANDLE)file->opaque, FILE_MAP_COPY, 0, 0, size, view) == view;
+}
+
+uint32_t _mg_process_id(void)
+{
+    return (uint32_t)GetCurrentProcessId();
+}
+
+uint64_t _mg_time_ns(void)
+{
+    static LARGE_INTEGER frequency;
+    if (frequency.QuadPart == 0)
+    {
+        QueryPerformanceFrequency(&frequency);
+    }
+
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return (uint64_t)((double)counter.QuadPart * (1e9 / (double)frequency.QuadPart));
+}
+
+void _mg_thread_yield(void)
+{
+    SwitchToThread();
+}
+
+void* _mg_aligned_alloc(size_t size, size_t alignment)
+{
+    return _aligned_malloc(size, alignment);
+}
+
+void _mg_aligned_free(void* ptr)
+{
+    _aligned_free(ptr);
+}
+
+#else
+
+typedef char _mg_thread_fits[(sizeof(pthread_t) <= sizeof(_MgThread)) ? 1 : -1];
+typedef char _mg_mutex_fits[(sizeof(pthread_mutex_t) <= sizeof(_MgMutex)) ? 1 : -1];
+typedef char _mg_cond_fits[(sizeof(pthread_cond_t) <= sizeof(_MgCond)) ? 1 : -1];
+
+typedef struct _MgThreadStart {
+    _MgThreadFn fn;
+    void* arg;
+} _MgThreadStart;
+
+static void* _mg_thread_entry(void* param)
+{
+    _MgThreadStart start = *(_MgThreadStart*)param;
+    free(param);
+    start.fn(start.arg);
+    return NULL;
+}
+
+bool _mg_thread_create(_MgThread* thread, _MgThreadFn fn, void* arg)
+{
+    _MgThreadStart* start = (_MgThreadStart*)malloc(sizeof(_MgThreadStart));
+    if (!start)
+    {
+        return false;
+    }
+    start->fn  = fn;
+    start->arg = arg;
+
+    if (pthread_create((pthread_t*)thread->opaque, NULL, _mg_thread_entry, start) != 0)
+    {
+        free(start);
+        return false;
+    }
+    return true;
+}
+
+void _mg_thread_join(_MgThread* thread)
+{
+    pthread_join(*(pthread_t*)thread->opaque, NULL);
+}
+
+void _mg_mutex_init(_MgMutex* mutex)
+{
+    pthread_mutex_init((pthread_mutex_t*)mutex->opaque, NULL);
+}
+
+void _mg_mutex_destroy(_MgMutex* mutex)
+{
+    pthread_mutex_destroy((pthread_mutex_t*)mutex->opaque);
+}
+
+void _mg_mutex_lock(_MgMutex* mutex)
+{
+    pthread_mutex_lock((pthread_mutex_t*)mutex->opaque);
+}
+
+void _mg_mutex_unlock(_MgMutex* mutex)
+{
+    pthread_mutex_unlock((pthread_mutex_t*)mutex->opaque);
+}
+
+void _mg_cond_init(_MgCond* cond)
+{
+    pthread_cond_init((pthread_cond_t*)cond->opaque, NULL);
+}
+
+void _mg_cond_destroy(_MgCond* cond)
+{
+    pthread_cond_destroy((pthread_cond_t*)cond->opaque);
+}
+
+void _mg_cond_wait(_MgCond* cond, _MgMutex* mutex)
+{
+    pthread_cond_wait((pthread_cond_t*)cond->opaque, (pthread_mutex_t*)mutex->opaque);
+}
+
+void _mg_cond_wait_timeout(_MgCond* cond, _MgMutex* mutex, uint32_t timeout_ms)
+{
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    uint64_t nsec     = (uint64_t)deadline.tv_nsec + (uint64_t)timeout_ms * 1000000ull;
+    deadline.tv_sec  += (time_t)(nsec / 1000000000ull);
+    deadline.tv_nsec  = (long)(nsec % 1000000000ull);
+    pthread_cond_timedwait((pthread_cond_t*)cond->opaque, (pthread_mutex_t*)mutex->opaque, &deadline);
+}
+
+void _mg_cond_broadcast(_MgCond* cond)
+{
+    pthread_cond_broadcast((pthread_cond_t*)cond->opaque);
+}
+
+uint32_t _mg_cpu_count(void)
+{
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (uint32_t)count : 1;
+}
+
+uint32_t _mg_cpu_current(void)
+{
+#if defined(__linux__)
+    int cpu = sched_getcpu();
+    if (cpu >= 0)
+    {
+        return (uint32_t)cpu;
+    }
+#endif
+    // no cheap way to ask for the core, hand every thread its own id instead
+    return _mg_thread_token() - 1;
+}
+
+size_t _mg_page_size(void)
+{
+    long page_size = sysconf(_SC_PAGESIZE);
+    return page_size > 0 ? (size_t)page_size : 4096;
+}
+
+void* _mg_pages_reserve(size_t size)
+{
+    void* ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return ptr != MAP_FAILED ? ptr : NULL;
+}
+
+void _mg_pages_release(void* ptr, size_t size)
+{
+    munmap(ptr, size);
+}
+
+#if defined(__linux__)
+
+enum {
+    _MG_MPOL_BIND       = 2, // values from linux/mempolicy.h, no libnuma needed
+    _MG_MPOL_INTERLEAVE = 3,
+    _MG_NUMA_MAX_NODES  = 1024,
+};
+
+bool _mg_pages_commit(void* ptr, size_t size, _MgPagePolicy policy, uint32_t node)
+{
+    if (policy == _MG_PAGE_POLICY_DEFAULT)
+    {
+        return true; // anonymous pages are placed by first touch anyway
+    }
+
+    unsigned long node_mask[_MG_NUMA_MAX_NODES / (8 * sizeof(unsigned long))] = { 0 };
+    const uint32_t mask_bits = 8 * sizeof(unsigned long);
+
+    int mode = _MG_MPOL_BIND;
+    if (policy == _MG_PAGE_POLICY_INTERLEAVE)
+    {
+        mode = _MG_MPOL_INTERLEAVE;
+        for (uint32_t i = 0; i < _mg_numa_node_count() && i < _MG_NUMA_MAX_NODES; i++)
+        {
+            node_mask[i / mask_bits] |= 1ul << (i % mask_bits);
+        }
+    }
+    else if (node < _MG_NUMA_MAX_NODES)
+    {
+        node_mask[node / mask_bits] |= 1ul << (node % mask_bits);
+    }
+
+    // must run before the pages are touched, the policy only steers where future faults allocate.
+    // the kernel drops the top bit of maxnode, hence the + 1.
+    syscall(SYS_mbind, ptr, size, mode, node_mask, (unsigned long)_MG_NUMA_MAX_NODES + 1, 0u);
+    return true;
+}
+
+uint32_t _mg_numa_node_count(void)
+{
+    static uint32_t node_count;
+    if (node_count == 0)
+    {
+        // "0", "0-1" or "0,2-3", the highest id wins
+        uint32_t highest = 0;
+        FILE* online     = fopen("/sys/devices/system/node/online", "r");
+        if (online)
+        {
+            unsigned int value;
+            while (fscanf(online, "%u", &value) == 1)
+            {
+                highest = value > highest ? value : highest;
+                if (fgetc(online) == EOF)
+                {
+                    break;
+                }
+            }
+            fclose(online);
+        }
+        node_count = highest + 1;
+    }
+    return node_count;
+}
+
+uint32_t _mg_numa_node_current(void)
+{
+    unsigned int cpu = 0, node = 0;
+    return syscall(SYS_getcpu, &cpu, &node, NULL) == 0 ? (uint32_t)node : 0;
+}
+
+#else
+
+bool _mg_pages_commit(void* ptr, size_t size, _MgPagePolicy policy, uint32_t node)
+{
+    (void)ptr, (void)size, (void)policy, (void)node;
+    return true; // no placement api, first touch decides
+}
+
+uint32_t _mg_numa_node_count(void)
+{
+    return 1;
+}
+
+uint32_t _mg_numa_node_current(void)
+{
+    return 0;
+}
+
+#endif
+
+void* _mg_file_map(const char* path, size_t* size)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+
+    void* ptr = NULL;
+    struct stat info;
+    if (fstat(fd, &info) == 0 && info.st_size > 0)
+    {
+        ptr   = mmap(NULL, (size_t)info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        ptr   = (ptr == MAP_FAILED) ? NULL : ptr;
+        *size = (size_t)info.st_size;
+    }
+
+    close(fd); // the mapping keeps the file alive
+    return ptr;
+}
+
+void _mg_file_unmap(void* ptr, size_t size)
+{
+    munmap(ptr, size);
+}
+
+void* _mg_file_map_shared(_MgFile* file, const char* path, size_t size, bool* created, bool* busy)
+{
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+
+    // taken before the size is looked at, so a second opener never grows or maps a file that is in use
+    if (flock(fd, LOCK_EX | LOCK_NB) != 0)
+    {
+        *busy = (errno == EWOULDBLOCK);
+        close(fd);
+        return NULL;
+    }
+
+    // growing leaves a sparse file, blocks are only allocated for pages that get written
+    struct stat info;
+    bool sized = fstat(fd, &info) == 0;
+    *created   = sized && info.st_size == 0;
+    sized      = sized && (*created ? ftruncate(fd, (off_t)size) == 0 : (size_t)info.st_size == size);
+
+    void* ptr = sized ? mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    if (ptr == MAP_FAILED)
+    {
+        close(fd);
+        return NULL;
+    }
+
+    file->opaque = (intptr_t)fd;
+    return ptr;
+}
+
+bool _mg_file_flush(_MgFile* file, void* ptr, size_t size, bool async)
+{
+    (void)file; // msync reaches the file through the mapping
+    return msync(ptr, size, async ? MS_ASYNC : MS_SYNC) == 0;
+}
+
+void _mg_file_unmap_shared(_MgFile* file, void* ptr, size_t size)
+{
+    munmap(ptr, size);
+    close((int)file->opaque);
+}
+
+bool _mg_file_open_append(_MgFile* file, const char* path, bool truncate)
+{
+    int fd       = open(path, O_WRONLY | O_CREAT | O_APPEND | (truncate ? O_TRUNC : 0), 0644);
+    file->opaque = (intptr_t)fd;
+    return fd >= 0;
+}
+
+bool _mg_file_write(_MgFile* file, const void* data, size_t size)
+{
+    const uint8_t* bytes = (const uint8_t*)data;
+    while (size > 0)
+    {
+        ssize_t written = write((int)file->opaque, bytes, size);
+        if (written < 0)
+        {
+            return false;
+        }
+        bytes += written;
+        size -= (size_t)written;
+    }
+    return true;
+}
+
+bool _mg_file_sync(_MgFile* file)
+{
+#if defined(__linux__)
+    return fdatasync((int)file->opaque) == 0; // the size is metadata it still flushes, timestamps are skipped
+#else
+    return fsync((int)file->opaque) == 0;
+#endif
+}
+
+void _mg_file_close(_MgFile* file)
+{
+    close((int)file->opaque);
+}
+
+bool _mg_file_replace(const char* from, const char* to)
+{
+    if (rename(from, to) != 0)
+    {
+        return false;
+    }
+
+    // the new name is only durable once the directory holding it is synced
+    char dir[4096]    = ".";
+    const char* slash = strrchr(to, '/');
+    size_t length     = slash ? (size_t)(slash - to) : 0;
+    if (length >= sizeof(dir))
+    {
+        return false;
+    }
+    if (slash)
+    {
+        memcpy(dir, length ? to : "/", length ? length : 1); // a file right under the root keeps its slash
+        dir[length ? length : 1] = '\0';
+    }
+
+    int fd      = open(dir, O_RDONLY);
+    bool synced = fd >= 0 && fsync(fd) == 0;
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+    return synced;
+}
+
+bool _mg_stream_write(_MgFile* stream, const void* data, size_t size)
+{
+#if defined(MSG_NOSIGNAL)
+    const uint8_t* bytes = (const uint8_t*)data;
+    while (size > 0)
+    {
+        ssize_t written = send((int)stream->opaque, bytes, size, MSG_NOSIGNAL);
+        if (written < 0 && errno == ENOTSOCK)
+        {
+            break; // a pipe, see below
+        }
+        if (written < 0 && errno != EINTR)
+        {
+            return false;
+        }
+        if (written > 0)
+        {
+            bytes += written;
+            size -= (size_t)written;
+        }
+    }
+    data = bytes;
+    if (size == 0)
+    {
+        return true;
+    }
+#endif
+
+    // pipes have no per call flag, so SIGPIPE is held off by blocking it for the write. a pending SIGPIPE raised
+    // here is consumed before the old mask comes back.
+    sigset_t pipe_set, old_set;
+    sigemptyset(&pipe_set);
+    sigaddset(&pipe_set, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &pipe_set, &old_set);
+
+    _MgFile file = *stream;
+    bool written = _mg_file_write(&file, data, size);
+
+    sigset_t pending;
+    sigpending(&pending);
+    if (sigismember(&pending, SIGPIPE) && !sigismember(&old_set, SIGPIPE))
+    {
+        int signal_number;
+        sigwait(&pipe_set, &signal_number);
+    }
+    pthread_sigmask(SIG_SETMASK, &old_set, NULL);
+
+    return written;
+}
+
+size_t _mg_stream_read(_MgFile* stream, void* data, size_t size)
+{
+    uint8_t* bytes = (uint8_t*)data;
+    size_t total   = 0;
+    while (total < size)
+    {
+        ssize_t received = read((int)stream->opaque, bytes + total, size - total);
+        if (received < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (received <= 0)
+        {
+            break;
+        }
+        total += (size_t)received;
+    }
+    return total;
+}
+
+bool _mg_memfile_create(_MgMemFile* file, size_t size)
+{
+#if defined(__linux__)
+    int fd = memfd_create("magic_mem", MFD_CLOEXEC);
+#else
+    // without memfd a shared memory object that is unlinked right away is just as anonymous
+    static volatile uint32_t next_id;
+    char name[64];
+    snprintf(name, sizeof(name), "/magic_mem_%d_%u", (int)getpid(), _mg_atomic_fetch_add_u32(&next_id, 1));
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd >= 0)
+    {
+        shm_unlink(name);
+    }
+#endif
+    if (fd >= 0 && ftruncate(fd, (off_t)size) != 0)
+    {
+        close(fd);
+        fd = -1;
+    }
+
+    file->opaque = (intptr_t)fd;
+    return fd >= 0;
+}
+
+void* _mg_memfile_map_private(_MgMemFile* file, size_t size)
+{
+    void* view = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, (int)file->opaque, 0);
+    return view == MAP_FAILED ? NULL : view;
+}
+
+void _mg_memfile_unmap(void* view, size_t size)
+{
+    munmap(view, size);
+}
+
+void _mg_memfile_close(_MgMemFile* file)
+{
+    close((int)file->opaque);
+}
+
+static bool _mg_fd_write_at(int fd, const uint8_t* data, size_t size, size_t offset)
+{
+    while (size > 0)
+    {
+        ssize_t written = pwrite(fd, data, size, (off_t)offset);
+        if (written < 0)
+        {
+            return false;
+        }
+        data += written;
+        offset += (size_t)written;
+        size -= (size_t)written;
+    }
+    return true;
+}
+
+#if defined(__linux__)
+// the page map tells duplicated pages (anonymous) apart from pages still shared with the file (bit 61). duplicated
+// pages that were swapped out are not present but set bit 62. reads one entry per page of the view, writes only
+// the duplicated ones. false if the page map cannot be read.
+static bool _mg_memfile_write_modified(int fd, uint8_t* view, size_t size)
+{
+    int page_map = open("/proc/self/pagemap", O_RDONLY);
+    if (page_map < 0)
+    {
+        return false;
+    }
+
+    size_t page_size  = _mg_page_size();
+    size_t page_count = size / page_size;
+    size_t first_page = (uintptr_t)view / page_size;
+    size_t run_begin  = SIZE_MAX; // first page of the modified run being collected
+    bool written      = true;
+
+    uint64_t entries[512];
+    for (size_t batch = 0; batch < page_count && written; batch += 512)
+    {
+        size_t count = page_count - batch < 512 ? page_count - batch : 512;
+        off_t at     = (off_t)((first_page + batch) * sizeof(uint64_t));
+        written      = pread(page_map, entries, count * sizeof(uint64_t), at) == (ssize_t)(count * sizeof(uint64_t));
+
+        for (size_t i = 0; i < count && written; i++)
+        {
+            uint64_t entry = entries[i];
+            bool modified  = ((entry >> 63) & 1 && !((entry >> 61) & 1)) || ((entry >> 62) & 1);
+            size_t page    = batch + i;
+
+            if (modified && run_begin == SIZE_MAX)
+            {
+                run_begin = page;
+            }
+            else if (!modified && run_begin != SIZE_MAX)
+            {
+                size_t offset = run_begin * page_size;
+                written       = _mg_fd_write_at(fd, view + offset, (page - run_begin) * page_size, offset);
+                run_begin     = SIZE_MAX;
+            }
+        }
+    }
+
+    if (written && run_begin != SIZE_MAX)
+    {
+        size_t offset = run_begin * page_size;
+        written       = _mg_fd_write_at(fd, view + offset, (page_count - run_begin) * page_size, offset);
+    }
+
+    close(page_map);
+    return written;
+}
+#endif
+
+bool _mg_memfile_commit(_MgMemFile* file, void* view, size_t size)
+{
+    int fd       = (int)file->opaque;
+    bool written = false;
+#if defined(__linux__)
+    written = _mg_memfile_write_modified(fd, (uint8_t*)view, size);
+#endif
+    written = written || _mg_fd_write_at(fd, (const uint8_t*)view, size, 0); // no page map, write the whole view
+    return written && _mg_memfile_revert(file, view, size);
+}
+
+static void _mg_shm_path(char* path, size_t path_size, const char* name)
+{
+    snprintf(path, path_size, "%s%s", name[0] == '/' ? "" : "/", name); // posix names start with one slash
+}
+
+void* _mg_shm_create(const char* name, size_t size)
+{
+    char path[256];
+    _mg_shm_path(path, sizeof(path), name);
+
+    int fd = shm_open(path, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+
+    void* ptr = MAP_FAILED;
+    if (ftruncate(fd, (off_t)size) == 0)
+    {
+        ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd); // the mapping keeps the object alive
+
+    if (ptr == MAP_FAILED)
+    {
+        shm_unlink(path);
+        return NULL;
+    }
+    return ptr;
+}
+
+void* _mg_shm_open(const char* name, bool readonly, size_t* size)
+{
+    char path[256];
+    _mg_shm_path(path, sizeof(path), name);
+
+    int fd = shm_open(path, readonly ? O_RDONLY : O_RDWR, 0);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+
+    void* ptr = MAP_FAILED;
+    struct stat info;
+    if (fstat(fd, &info) == 0 && info.st_size > 0)
+    {
+        int protection = readonly ? PROT_READ : PROT_READ | PROT_WRITE;
+        ptr            = mmap(NULL, (size_t)info.st_size, protection, MAP_SHARED, fd, 0);
+        *size          = (size_t)info.st_size;
+    }
+    close(fd);
+
+    return ptr == MAP_FAILED ? NULL : ptr;
+}
+
+void _mg_shm_unmap(void* ptr, size_t size)
+{
+    munmap(ptr, size);
+}
+
+void _mg_shm_remove(const char* name)
+{
+    char path[256];
+    _mg_shm_path(path, sizeof(path), name);
+    shm_unlink(path);
+}
+
+bool _mg_memfile_revert(_MgMemFile* file, void* view, size_t size)
+{
+    // mapping the file over the view in place drops the view's duplicated pages in one call
+    void* mapped = mmap(view, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, (int)file->opaque, 0);
+    return mapped == view;
+}
+
+uint32_t _mg_process_id(void)
+{
+    return (uint32_t)getpid();
+}
+
+uint64_t _mg_time_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+}
+
+void _mg_thread_yield(void)
+{
+    sched_yield();
+}
+
+void* _mg_aligned_alloc(size_t size, size_t alignment)
+{
+    void* ptr = NULL;
+    if (posix_memalign(&ptr, alignment, size) != 0)
+    {
+        return NULL;
+    }
+    return ptr;
+}
+
+void _mg_aligned_free(void* ptr)
+{
+    free(ptr);
+}
+
+#endif
@@ -0,0 +1,358 @@
+#ifndef MAGIC_PLATFORM_HEADER
+#define MAGIC_PLATFORM_HEADER
+
+// internal header, not part of the public api (include magic_mem.h instead)
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#define MG_CACHE_LINE_SIZE 64
+
+#define _MG_ALIGN_UP(value, align) (((value) + ((size_t)(align) - 1)) & ~((size_t)(align) - 1))
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define _MG_INLINE static __inline
+#define _MG_ALIGNAS(n) __declspec(align(n))
+#define _MG_THREAD_LOCAL __declspec(thread)
+#else
+#define _MG_INLINE static inline
+#define _MG_ALIGNAS(n) __attribute__((aligned(n)))
+#define _MG_THREAD_LOCAL __thread
+#endif
+
+/////////////////////////////////////////////////
+// Offsets //////////////////////////////////////
+/////////////////////////////////////////////////
+
+// self relative pointer: the distance from the field to its target. a block that only links to itself through
+// offsets can be copied, mapped or shared at any address and stays valid without a fix up pass.
+typedef int64_t _MgOffset;
+
+_MG_INLINE void _mg_offset_set(_MgOffset* field, const void* target)
+{
+    *field = (_MgOffset)((intptr_t)target - (intptr_t)field);
+}
+
+_MG_INLINE void* _mg_offset_get(const _MgOffset* field)
+{
+    return (void*)((intptr_t)field + (intptr_t)*field);
+}
+
+/////////////////////////////////////////////////
+// Atomics //////////////////////////////////////
+/////////////////////////////////////////////////
+
+#if defined(_MSC_VER)
+
+_MG_INLINE uint32_t _mg_atomic_load_u32(volatile uint32_t* ptr)
+{
+    uint32_t value = *ptr;
+    _ReadWriteBarrier();
+    return value;
+}
+
+_MG_INLINE void _mg_atomic_store_u32(volatile uint32_t* ptr, uint32_t value)
+{
+    _ReadWriteBarrier();
+    *ptr = value;
+}
+
+_MG_INLINE bool _mg_atomic_cas_u32(volatile uint32_t* ptr, uint32_t expected, uint32_t desired)
+{
+    return (uint32_t)_InterlockedCompareExchange((volatile long*)ptr, (long)desired, (long)expected) == expected;
+}
+
+_MG_INLINE uint32_t _mg_atomic_fetch_add_u32(volatile uint32_t* ptr, uint32_t value)
+{
+    return (uint32_t)_InterlockedExchangeAdd((volatile long*)ptr, (long)value);
+}
+
+_MG_INLINE uint32_t _mg_atomic_exchange_u32(volatile uint32_t* ptr, uint32_t value)
+{
+    return (uint32_t)_InterlockedExchange((volatile long*)ptr, (long)value);
+}
+
+_MG_INLINE uint64_t _mg_atomic_load_u64(volatile uint64_t* ptr)
+{
+    uint64_t value = *ptr;
+    _ReadWriteBarrier();
+    return value;
+}
+
+_MG_INLINE void _mg_atomic_store_u64(volatile uint64_t* ptr, uint64_t value)
+{
+    _ReadWriteBarrier();
+    *ptr = value;
+}
+
+_MG_INLINE bool _mg_atomic_cas_u64(volatile uint64_t* ptr, uint64_t expected, uint64_t desired)
+{
+    return (uint64_t)_InterlockedCompareExchange64((volatile long long*)ptr, (long long)desired, (long long)expected) ==
+    expected;
+}
+
+_MG_INLINE uint64_t _mg_atomic_fetch_or_u64(volatile uint64_t* ptr, uint64_t value)
+{
+    return (uint64_t)_InterlockedOr64((volatile long long*)ptr, (long long)value);
+}
+
+_MG_INLINE uint64_t _mg_atomic_fetch_and_u64(volatile uint64_t* ptr, uint64_t value)
+{
+    return (uint64_t)_InterlockedAnd64((volatile long long*)ptr, (long long)value);
+}
+
+_MG_INLINE void _mg_cpu_relax(void)
+{
+    _mm_pause();
+}
+
+_MG_INLINE uint32_t _mg_ctz_u64(uint64_t value) // value must not be 0
+{
+    unsigned long index;
+    _BitScanForward64(&index, value);
+    return (uint32_t)index;
+}
+
+_MG_INLINE uint32_t _mg_popcount_u64(uint64_t value)
+{
+    // __popcnt64 needs a cpu with popcnt, the bit trick runs on every x64 one
+    value = value - ((value >> 1) & 0x5555555555555555ull);
+    value = (value & 0x3333333333333333ull) + ((value >> 2) & 0x3333333333333333ull);
+    value = (value + (value >> 4)) & 0x0f0f0f0f0f0f0f0full;
+    return (uint32_t)((value * 0x0101010101010101ull) >> 56);
+}
+
+#else
+
+_MG_INLINE uint32_t _mg_atomic_load_u32(volatile uint32_t* ptr)
+{
+    return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+}
+
+_MG_INLINE void _mg_atomic_store_u32(volatile uint32_t* ptr, uint32_t value)
+{
+    __atomic_store_n(ptr, value, __ATOMIC_RELEASE);
+}
+
+_MG_INLINE bool _mg_atomic_cas_u32(volatile uint32_t* ptr, uint32_t expected, uint32_t desired)
+{
+    return __atomic_compare_exchange_n(ptr, &expected, desired, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED);
+}
+
+_MG_INLINE uint32_t _mg_atomic_fetch_add_u32(volatile uint32_t* ptr, uint32_t value)
+{
+    return __atomic_fetch_add(ptr, value, __ATOMIC_ACQ_REL);
+}
+
+_MG_INLINE uint32_t _mg_atomic_exchange_u32(volatile uint32_t* ptr, uint32_t value)
+{
+    return __atomic_exchange_n(ptr, value, __ATOMIC_ACQ_REL);
+}
+
+_MG_INLINE uint64_t _mg_atomic_load_u64(volatile uint64_t* ptr)
+{
+    return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+}
+
+_MG_INLINE void _mg_atomic_store_u64(volatile uint64_t* ptr, uint64_t value)
+{
+    __atomic_store_n(ptr, value, __ATOMIC_RELEASE);
+}
+
+_MG_INLINE bool _mg_atomic_cas_u64(volatile uint64_t* ptr, uint64_t expected, uint64_t desired)
+{
+    return __atomic_compare_exchange_n(ptr, &expected, desired, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED);
+}
+
+_MG_INLINE uint64_t _mg_atomic_fetch_or_u64(volatile uint64_t* ptr, uint64_t value)
+{
+    return __atomic_fetch_or(ptr, value, __ATOMIC_ACQ_REL);
+}
+
+_MG_INLINE uint64_t _mg_atomic_fetch_and_u64(volatile uint64_t* ptr, uint64_t value)
+{
+    return __atomic_fetch_and(ptr, value, __ATOMIC_ACQ_REL);
+}
+
+_MG_INLINE uint32_t _mg_ctz_u64(uint64_t value) // value must not be 0
+{
+    return (uint32_t)__builtin_ctzll(value);
+}
+
+_MG_INLINE uint32_t _mg_popcount_u64(uint64_t value)
+{
+    return (uint32_t)__builtin_popcountll(value);
+}
+
+_MG_INLINE void _mg_cpu_relax(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+#endif
+
+/////////////////////////////////////////////////
+// Locks ////////////////////////////////////////
+/////////////////////////////////////////////////
+
+// test-and-test-and-set lock, padded to its own cache line so neighbouring locks never false share.
+// counters are only touched by the holder, so they need no atomics.
+typedef struct _MG_ALIGNAS(MG_CACHE_LINE_SIZE) _MgLock {
+    volatile uint32_t state;
+    uint64_t acquire_time_ns;
+    uint64_t acquire_count;
+    uint64_t contended_count;
+    uint64_t hold_time_ns;
+    uint64_t max_hold_time_ns;
+} _MgLock;
+
+extern void _mg_lock_acquire(_MgLock* lock, bool adaptive, bool timing);
+extern void _mg_lock_release(_MgLock* lock, bool timing);
+
+/////////////////////////////////////////////////
+// Threads //////////////////////////////////////
+/////////////////////////////////////////////////
+
+// opaque storage for the native objects, sizes are checked against the os types in magic_platform.c
+typedef struct _MgThread {
+    uint64_t opaque[2];
+} _MgThread;
+
+typedef struct _MgMutex {
+    uint64_t opaque[8];
+} _MgMutex;
+
+typedef struct _MgCond {
+    uint64_t opaque[8];
+} _MgCond;
+
+typedef void (*_MgThreadFn)(void* arg);
+
+extern bool _mg_thread_create(_MgThread* thread, _MgThreadFn fn, void* arg);
+extern void _mg_thread_join(_MgThread* thread);
+
+extern void _mg_mutex_init(_MgMutex* mutex);
+extern void _mg_mutex_destroy(_MgMutex* mutex);
+extern void _mg_mutex_lock(_MgMutex* mutex);
+extern void _mg_mutex_unlock(_MgMutex* mutex);
+
+extern void _mg_cond_init(_MgCond* cond);
+extern void _mg_cond_destroy(_MgCond* cond);
+extern void _mg_cond_wait(_MgCond* cond, _MgMutex* mutex);
+extern void _mg_cond_wait_timeout(_MgCond* cond, _MgMutex* mutex, uint32_t timeout_ms); // may also wake early
+extern void _mg_cond_broadcast(_MgCond* cond);
+
+extern uint32_t _mg_cpu_count(void);
+extern uint32_t _mg_cpu_current(void); // core the calling thread runs on, a stable per-thread id where unsupported
+extern uint32_t _mg_thread_token(void); // nonzero id of the calling thread, never reused within the process
+extern uint32_t _mg_process_id(void);
+
+/////////////////////////////////////////////////
+// Pages ////////////////////////////////////////
+/////////////////////////////////////////////////
+
+typedef enum _MgPagePolicy {
+    _MG_PAGE_POLICY_DEFAULT,    // first touch
+    _MG_PAGE_POLICY_BIND,       // every page on one node
+    _MG_PAGE_POLICY_INTERLEAVE, // pages round robin over all nodes
+} _MgPagePolicy;
+
+// reserved pages read as zero and are not backed until committed (windows) or first touched (posix)
+extern size_t _mg_page_size(void);
+extern void* _mg_pages_reserve(size_t size);
+extern void _mg_pages_release(void* ptr, size_t size);
+
+// makes the range usable and applies the placement policy. placement is best effort, a kernel that refuses the
+// policy still leaves the pages usable. only returns false if the memory itself could not be committed.
+extern bool _mg_pages_commit(void* ptr, size_t size, _MgPagePolicy policy, uint32_t node);
+
+extern uint32_t _mg_numa_node_count(void);
+extern uint32_t _mg_numa_node_current(void);
+
+/////////////////////////////////////////////////
+// Files ////////////////////////////////////////
+/////////////////////////////////////////////////
+
+// private copy on write mapping of a whole file, writes through it never reach the file. NULL if the file
+// cannot be opened or is empty.
+extern void* _mg_file_map(const char* path, size_t* size);
+extern void _mg_file_unmap(void* ptr, size_t size);
+
+typedef struct _MgFile {
+    intptr_t opaque; // fd or HANDLE
+} _MgFile;
+
+// shared mapping of a whole file, writes through it reach the file. an empty or missing file is grown to size and
+// reads as zero (created is set), a file of any other size is refused. the file stays locked until unmap closes it,
+// opening it again meanwhile, from this process or another, fails with busy set.
+extern void* _mg_file_map_shared(_MgFile* file, const char* path, size_t size, bool* created, bool* busy);
+extern bool _mg_file_flush(_MgFile* file, void* ptr, size_t size, bool async); // ptr page aligned
+extern void _mg_file_unmap_shared(_MgFile* file, void* ptr, size_t size);
+
+// append only file for logs, truncate starts it empty
+extern bool _mg_file_open_append(_MgFile* file, const char* path, bool truncate);
+extern bool _mg_file_write(_MgFile* file, const void* data, size_t size);
+extern bool _mg_file_sync(_MgFile* file); // returns once the written data is durable
+extern void _mg_file_close(_MgFile* file);
+// moves from over to in one step, readers see the old file or the new one and never a mix. durable on return.
+extern bool _mg_file_replace(const char* from, const char* to);
+
+// pipes and connected stream sockets, opened and closed by the caller. writing to a stream whose reader is gone
+// fails instead of raising SIGPIPE. read returns fewer bytes than asked only at the end of the stream or on an error.
+extern bool _mg_stream_write(_MgFile* stream, const void* data, size_t size);
+extern size_t _mg_stream_read(_MgFile* stream, void* data, size_t size);
+
+typedef struct _MgMemFile {
+    intptr_t opaque; // fd or section HANDLE
+} _MgMemFile;
+
+// anonymous file in memory (memfd, pagefile backed section on windows). a private view of it is copy on write:
+// pages the view writes are duplicated for the view, every other page stays shared with the file.
+extern bool _mg_memfile_create(_MgMemFile* file, size_t size);
+extern void* _mg_memfile_map_private(_MgMemFile* file, size_t size);
+extern void _mg_memfile_unmap(void* view, size_t size);
+extern void _mg_memfile_close(_MgMemFile* file);
+
+// commit writes the pages the view has duplicated into the file, revert throws them away. either way the view
+// reads the file again afterwards and keeps its address. nothing may touch the view while either runs. commit
+// finds the pages in a region walk on windows and a page map read covering the whole view on linux, elsewhere or
+// without a readable page map it writes the whole view.
+extern bool _mg_memfile_commit(_MgMemFile* file, void* view, size_t size);
+extern bool _mg_memfile_revert(_MgMemFile* file, void* view, size_t size);
+
+// named shared memory, every process that maps the name sees the same zero initialized bytes at its own address.
+// create fails if the name exists. the name lives until it is removed (posix) or the last view is unmapped.
+extern void* _mg_shm_create(const char* name, size_t size);
+extern void* _mg_shm_open(const char* name, bool readonly, size_t* size);
+extern void _mg_shm_unmap(void* ptr, size_t size);
+extern void _mg_shm_remove(const char* name);
+
+/////////////////////////////////////////////////
+// Misc /////////////////////////////////////////
+/////////////////////////////////////////////////
+
+extern uint64_t _mg_time_ns(void);
+extern void _mg_thread_yield(void);
+
+extern void* _mg_aligned_alloc(size_t size, size_t alignment);
+extern void _mg_aligned_free(void* ptr);
+
+// memcpy that bypasses the cache for the destination where the cpu allows it, for copies much larger than the
+// cache that would otherwise evict the caller's working set. ranges must not overlap.
+extern void _mg_memcpy_stream(void* dst, const void* src, size_t size);
+
+#if __cplusplus
+} // end extern "C"
+#endif
+
+#endif // MAGIC_PLATFORM_HEADER
@@ -0,0 +1,249 @@
+#include "magic_pool.h"
+#include "magic_platform.h"
+
+enum {
+    _MG_POOL_MAX_THREADS = 63, // worker threads, the calling thread makes it 64 queues
+};
+
+// each queue holds a contiguous run of chunk indices packed as (front << 32 | back).
+// the owner pops single chunks off the front, thieves split off the back half in one cas.
+typedef struct _MG_ALIGNAS(MG_CACHE_LINE_SIZE) _MgPoolQueue {
+    volatile uint64_t range;
+} _MgPoolQueue;
+
+typedef struct _MgPoolJob {
+    _MgPoolTaskFn task;
+    void* ctx;
+    uint32_t begin;
+    uint32_t end;
+    uint32_t grain;
+} _MgPoolJob;
+
+typedef struct _MgPool {
+    _MgPoolQueue queues[_MG_POOL_MAX_THREADS + 1]; // queue 0 belongs to the calling thread
+    _MgThread threads[_MG_POOL_MAX_THREADS];
+    _MgMutex run_mutex; // one job in flight at a time
+    _MgMutex mutex;
+    _MgCond wake;
+    _MgCond done;
+    _MgPoolJob job;
+    uint32_t thread_count;
+    uint32_t generation;
+    uint32_t busy_threads;
+    volatile uint32_t state;
+} _MgPool;
+
+enum {
+    _MG_POOL_STATE_NONE,
+    _MG_POOL_STATE_STARTING,
+    _MG_POOL_STATE_READY,
+};
+
+static _MgPool _mg_pool;
+static _MG_THREAD_LOCAL bool _mg_pool_in_job;
+
+static bool _mg_pool_start(void);
+static void _mg_pool_thread(void* arg);
+static void _mg_pool_work(uint32_t queue_index);
+static bool _mg_pool_pop(_MgPoolQueue* queue, uint32_t* chunk);
+static bool _mg_pool_steal(_MgPoolQueue* victim, _MgPoolQueue* thief);
+
+#define _MG_POOL_RANGE(front, back) (((uint64_t)(front) << 32) | (uint64_t)(back))
+
+void _mg_pool_run(uint32_t begin, uint32_t end, uint32_t grain, _MgPoolTaskFn task, void* ctx)
+{
+    if (begin >= end)
+    {
+        return;
+    }
+
+    grain                = grain > 0 ? grain : 1;
+    uint32_t chunk_count = (uint32_t)(((uint64_t)end - begin + grain - 1) / grain);
+
+    if (chunk_count <= 1 || _mg_pool_in_job || !_mg_pool_start())
+    {
+        task(ctx, begin, end);
+        return;
+    }
+
+    _MgPool* pool = &_mg_pool;
+    _mg_mutex_lock(&pool->run_mutex);
+
+    uint32_t queue_count = pool->thread_count + 1;
+    for (uint32_t i = 0; i < queue_count; i++)
+    {
+        uint32_t front = (uint32_t)(((uint64_t)chunk_count * i) / queue_count);
+        uint32_t back  = (uint32_t)(((uint64_t)chunk_count * (i + 1)) / queue_count);
+        _mg_atomic_store_u64(&pool->queues[i].range, _MG_POOL_RANGE(front, back));
+    }
+
+    _mg_mutex_lock(&pool->mutex);
+    pool->job          = (_MgPoolJob){ task, ctx, begin, end, grain };
+    pool->busy_threads = pool->thread_count;
+    pool->generation++;
+    _mg_cond_broadcast(&pool->wake);
+    _mg_mutex_unlock(&pool->mutex);
+
+    _mg_pool_in_job = true;
+    _mg_pool_work(0);
+    _mg_pool_in_job = false;
+
+    _mg_mutex_lock(&pool->mutex);
+    while (pool->busy_threads > 0)
+    {
+        _mg_cond_wait(&pool->done, &pool->mutex);
+    }
+    _mg_mutex_unlock(&pool->mutex);
+
+    _mg_mutex_unlock(&pool->run_mutex);
+}
+
+uint32_t _mg_pool_worker_count(void)
+{
+    return _mg_pool_start() ? _mg_pool.thread_count + 1 : 1;
+}
+
+static bool _mg_pool_start(void)
+{
+    _MgPool* pool = &_mg_pool;
+
+    uint32_t state = _mg_atomic_load_u32(&pool->state);
+    if (state == _MG_POOL_STATE_READY)
+    {
+        return pool->thread_count > 0;
+    }
+
+    if (state == _MG_POOL_STATE_NONE && _mg_atomic_cas_u32(&pool->state, _MG_POOL_STATE_NONE, _MG_POOL_STATE_STARTING))
+    {
+        _mg_mutex_init(&pool->run_mutex);
+        _mg_mutex_init(&pool->mutex);
+        _mg_cond_init(&pool->wake);
+        _mg_cond_init(&pool->done);
+
+        uint32_t thread_count = _mg_cpu_count() - 1;
+        thread_count          = thread_count < _MG_POOL_MAX_THREADS ? thread_count : _MG_POOL_MAX_THREADS;
+
+        // workers live for the rest of the process, they sleep on the wake condition between jobs
+        pool->thread_count = 0;
+        for (uint32_t i = 0; i < thread_count; i++)
+        {
+            if (!_mg_thread_create(&pool->threads[i], _mg_pool_thread, (void*)(uintptr_t)(i + 1)))
+            {
+                break;
+            }
+            pool->thread_count++;
+        }
+
+        _mg_atomic_store_u32(&pool->state, _MG_POOL_STATE_READY);
+    }
+
+    while (_mg_atomic_load_u32(&pool->state) != _MG_POOL_STATE_READY)
+    {
+        _mg_thread_yield();
+    }
+
+    return pool->thread_count > 0;
+}
+
+static void _mg_pool_thread(void* arg)
+{
+    _MgPool* pool        = &_mg_pool;
+    uint32_t queue_index = (uint32_t)(uintptr_t)arg;
+    uint32_t generation  = 0;
+
+    _mg_pool_in_job = true;
+
+    _mg_mutex_lock(&pool->mutex);
+    for (;;)
+    {
+        while (pool->generation == generation)
+        {
+            _mg_cond_wait(&pool->wake, &pool->mutex);
+        }
+        generation = pool->generation;
+        _mg_mutex_unlock(&pool->mutex);
+
+        _mg_pool_work(queue_index);
+
+        _mg_mutex_lock(&pool->mutex);
+        if (--pool->busy_threads == 0)
+        {
+            _mg_cond_broadcast(&pool->done);
+        }
+    }
+}
+
+static void _mg_pool_work(uint32_t queue_index)
+{
+    _MgPool* pool        = &_mg_pool;
+    _MgPoolJob job       = pool->job;
+    uint32_t queue_count = pool->thread_count + 1;
+    _MgPoolQueue* own    = &pool->queues[queue_index];
+
+    for (;;)
+    {
+        uint32_t chunk;
+        if (_mg_pool_pop(own, &chunk))
+        {
+            uint32_t chunk_begin = job.begin + chunk * job.grain;
+            uint32_t chunk_end   = (job.end - chunk_begin) > job.grain ? chunk_begin + job.grain : job.end;
+            job.task(job.ctx, chunk_begin, chunk_end);
+            continue;
+        }
+
+        bool stolen = false;
+        for (uint32_t i = 1; i < queue_count && !stolen; i++)
+        {
+            stolen = _mg_pool_steal(&pool->queues[(queue_index + i) % queue_count], own);
+        }
+
+        if (!stolen)
+        {
+            return; // every queue is drained
+        }
+    }
+}
+
+static bool _mg_pool_pop(_MgPoolQueue* queue, uint32_t* chunk)
+{
+    for (;;)
+    {
+        uint64_t range = _mg_atomic_load_u64(&queue->range);
+        uint32_t front = (uint32_t)(range >> 32);
+        uint32_t back  = (uint32_t)range;
+
+        if (front >= back)
+        {
+            return false;
+        }
+
+        if (_mg_atomic_cas_u64(&queue->range, range, _MG_POOL_RANGE(front + 1, back)))
+        {
+            *chunk = front;
+            return true;
+        }
+    }
+}
+
+static bool _mg_pool_steal(_MgPoolQueue* victim, _MgPoolQueue* thief)
+{
+    for (;;)
+    {
+        uint64_t range = _mg_atomic_load_u64(&victim->range);
+        uint32_t front = (uint32_t)(range >> 32);
+        uint32_t back  = (uint32_t)range;
+
+        if (front >= back)
+        {
+            return false;
+        }
+
+        uint32_t split = back - (back - front + 1) / 2;
+        if (_mg_atomic_cas_u64(&victim->range, range, _MG_POOL_RANGE(front, split)))
+        {
+            // the thief's own queue is empty, so nobody else can be popping from it right now
+            _mg_atomic_store_u64(&thief->range, _MG_POOL_RANGE(split, back));
+            return true;
+        }
+    }
+}
@@ -0,0 +1,25 @@
+#ifndef MAGIC_POOL_HEADER
+#define MAGIC_POOL_HEADER
+
+// internal header, not part of the public api (include magic_mem.h instead)
+
+#include <stdint.h>
+
+#if __cplusplus
+extern "C" {
+#endif
+
+typedef void (*_MgPoolTaskFn)(void* ctx, uint32_t begin, uint32_t end);
+
+// splits [begin, end) into chunks of grain and runs them on the built-in work-stealing pool (the calling thread
+// helps out). blocks until every chunk is done. nested calls from inside a task run inline on the calling thread.
+extern void _mg_pool_run(uint32_t begin, uint32_t end, uint32_t grain, _MgPoolTaskFn task, void* ctx);
+
+// number of threads that execute chunks, including the calling thread
+extern uint32_t _mg_pool_worker_count(void);
+
+#if __cplusplus
+} // end extern "C"
+#endif
+
+#endif // MAGIC_POOL_HEADER
@@ -0,0 +1,170 @@
+#include "magic_mem.h"
+#include "magic_platform.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+enum {
+    _MG_SERIAL_COMMIT_PAGES = 16, // pages committed at once when the write marker runs past the committed ones
+};
+
+static bool _mg_serial_arena_commit(MgSerialArena* arena, size_t end);
+
+MgStatus mg_serial_arena_init(MgSerialArena* arena, size_t capacity)
+{
+    _MG_STATUS(arena, MG_ERROR_ARENA_INVALID);
+    _MG_STATUS(capacity > 0, MG_ERROR_DATA_INVALID);
+
+    // only address space so far, a large capacity costs nothing until it is written
+    memset((void*)arena, 0, sizeof(MgSerialArena));
+    size_t reserved = _MG_ALIGN_UP(capacity, _mg_page_size());
+    arena->data     = (uint8_t*)_mg_pages_reserve(reserved);
+    _MG_STATUS(arena->data, MG_ERROR_ARENA_ALLOC_FAILED);
+    arena->end_marker = reserved;
+
+    return MG_SUCCESS;
+}
+
+void mg_serial_arena_destroy(MgSerialArena* arena)
+{
+    _MG_CHECK(arena && arena->data, MG_ERROR_ARENA_INVALID);
+    if (arena && arena->data)
+    {
+        _mg_pages_release(arena->data, arena->end_marker);
+        memset((void*)arena, 0, sizeof(MgSerialArena));
+    }
+}
+
+void* mg_serial_arena_alloc(MgSerialArena* arena, size_t size, size_t alignment)
+{
+    _MG_CHECK(arena && arena->data, MG_ERROR_ARENA_INVALID);
+    _MG_CHECK(alignment != 0 && (alignment & (alignment - 1)) == 0, MG_ERROR_DATA_INVALID);
+    if (!arena || !arena->data || alignment == 0 || (alignment & (alignment - 1)) != 0)
+    {
+        return NULL;
+    }
+
+    // data starts on a page, so aligning the offset aligns the address
+    size_t begin = _MG_ALIGN_UP(arena->write_marker, alignment);
+    bool fits    = begin <= arena->end_marker && size <= arena->end_marker - begin;
+    _MG_CHECK(fits, MG_ERROR_SERIAL_ARENA_FULL);
+    if (!fits || (begin + size > arena->committed && !_mg_serial_arena_commit(arena, begin + size)))
+    {
+        return NULL;
+    }
+
+    arena->write_marker = begin + size;
+    return arena->data + begin;
+}
+
+void* mg_serial_arena_write(MgSerialArena* arena, const void* data, size_t size)
+{
+    _MG_CHECK(data || size == 0, MG_ERROR_DATA_INVALID);
+
+    void* dest = mg_serial_arena_alloc(arena, size, MG_SERIAL_ALIGNMENT);
+    if (dest && size > 0)
+    {
+        memcpy(dest, data, size);
+    }
+    return dest;
+}
+
+void mg_serial_arena_clear(MgSerialArena* arena)
+{
+    _MG_CHECK(arena, MG_ERROR_ARENA_INVALID);
+    if (arena)
+    {
+        arena->write_marker = 0;
+    }
+}
+
+MgSerialMarker mg_serial_arena_mark(MgSerialArena* arena)
+{
+    _MG_CHECK(arena, MG_ERROR_ARENA_INVALID);
+    return arena ? arena->write_marker : 0;
+}
+
+MgStatus mg_serial_arena_restore(MgSerialArena* arena, MgSerialMarker marker)
+{
+    _MG_STATUS(arena, MG_ERROR_ARENA_INVALID);
+    // a marker past the write marker was saved inside a scope that was already rolled back or cleared
+    _MG_STATUS(marker <= arena->write_marker, MG_ERROR_DATA_INVALID);
+
+    arena->write_marker = marker;
+
+    return MG_SUCCESS;
+}
+
+MgStatus mg_frame_arena_init(MgFrameArena* frames, uint32_t region_count, size_t region_capacity)
+{
+    _MG_STATUS(frames, MG_ERROR_ARENA_INVALID);
+    _MG_STATUS(region_count >= 2 && region_count <= MG_FRAME_REGIONS_MAX, MG_ERROR_DATA_INVALID);
+
+    memset((void*)frames, 0, sizeof(MgFrameArena));
+    MgStatus status = MG_SUCCESS;
+    for (uint32_t i = 0; i < region_count && status == MG_SUCCESS; i++)
+    {
+        status = mg_serial_arena_init(&frames->regions[i], region_capacity);
+        frames->region_count += (status == MG_SUCCESS);
+    }
+
+    if (status != MG_SUCCESS)
+    {
+        mg_frame_arena_destroy(frames);
+        return status;
+    }
+
+    return MG_SUCCESS;
+}
+
+void mg_frame_arena_destroy(MgFrameArena* frames)
+{
+    _MG_CHECK(frames, MG_ERROR_ARENA_INVALID);
+    if (frames)
+    {
+        for (uint32_t i = 0; i < frames->region_count; i++)
+        {
+            mg_serial_arena_destroy(&frames->regions[i]);
+        }
+        memset((void*)frames, 0, sizeof(MgFrameArena));
+    }
+}
+
+void mg_frame_begin(MgFrameArena* frames)
+{
+    _MG_CHECK(frames && frames->region_count > 0, MG_ERROR_ARENA_INVALID);
+    if (frames && frames->region_count > 0)
+    {
+        // the region after the current one is the one written longest ago
+        frames->current = (frames->current + 1) % frames->region_count;
+        frames->regions[frames->current].write_marker = 0;
+        frames->frame_index++;
+    }
+}
+
+void* mg_frame_alloc(MgFrameArena* frames, size_t size, size_t alignment)
+{
+    _MG_CHECK(frames && frames->region_count > 0, MG_ERROR_ARENA_INVALID);
+    if (!frames || frames->region_count == 0)
+    {
+        return NULL;
+    }
+    return mg_serial_arena_alloc(&frames->regions[frames->current], size, alignment);
+}
+
+static bool _mg_serial_arena_commit(MgSerialArena* arena, size_t end)
+{
+    // a few pages at a time, so a run of small allocations does not commit page by page
+    size_t committed = _MG_ALIGN_UP(end, _mg_page_size() * _MG_SERIAL_COMMIT_PAGES);
+    committed        = committed < arena->end_marker ? committed : arena->end_marker;
+
+    bool backed = _mg_pages_commit(arena->data + arena->committed, committed - arena->committed,
+    _MG_PAGE_POLICY_DEFAULT, 0);
+    _MG_CHECK(backed, MG_ERROR_ARENA_ALLOC_FAILED);
+    if (backed)
+    {
+        arena->committed = committed;
+    }
+    return backed;
+}
@@ -0,0 +1,998 @@
+#include "magic_simd.h"
+#include "magic_arena.h"
+#include "magic_platform.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define _MG_SIMD_SSE2 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#define _MG_SIMD_AVX2 1
+#define _MG_SIMD_AVX512 1
+#define _MG_TARGET_AVX2
+#define _MG_TARGET_AVX512
+#elif defined(__GNUC__) || defined(__clang__)
+#define _MG_SIMD_AVX2 1
+#define _MG_SIMD_AVX512 1
+#define _MG_TARGET_AVX2 __attribute__((target("avx2"))) // only this function is compiled for avx2
+#define _MG_TARGET_AVX512 __attribute__((target("avx512f")))
+#endif
+#endif
+
+enum {
+    _MG_RELATION_LT = 1, // relations of a row to the value it is compared with, nan has none of them
+    _MG_RELATION_EQ = 2,
+    _MG_RELATION_GT = 4,
+};
+
+typedef struct _MgSimdKernels {
+    const char* level;
+    size_t (*mismatch)(const uint8_t* a, const uint8_t* b, size_t size);
+    // a row matches when it has one of the relations (negated for ne), count is a multiple of 64
+    void (*compare)(MgFieldType type, uint32_t relations, bool negate, const uint8_t* column, const uint8_t* value,
+    size_t count, uint64_t* mask);
+    // every row of the run, which comes in as the identity, count is a multiple of 64
+    void (*aggregate)(MgFieldType type, const uint8_t* column, size_t count, MgAggregate* run);
+} _MgSimdKernels;
+
+static const _MgSimdKernels* _mg_simd(void);
+static uint32_t _mg_simd_levels(const _MgSimdKernels** levels);
+static void _mg_compare_scalar(MgFieldType type, uint32_t relations, bool negate, const uint8_t* column,
+const uint8_t* value, size_t count, uint64_t* mask);
+static void _mg_aggregate_scalar(MgFieldType type, const uint8_t* column, const uint64_t* mask, size_t count,
+MgAggregate* run);
+static void _mg_aggregate_identity(MgFieldType type, MgAggregate* run);
+static void _mg_aggregate_merge(MgFieldType type, MgAggregate* result, MgAggregate* run);
+
+size_t _mg_simd_mismatch(const void* a, const void* b, size_t size)
+{
+    return _mg_simd()->mismatch((const uint8_t*)a, (const uint8_t*)b, size);
+}
+
+uint32_t _mg_simd_match16(const uint8_t* bytes, uint8_t byte)
+{
+#if defined(_MG_SIMD_SSE2)
+    __m128i block = _mm_load_si128((const __m128i*)bytes);
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(block, _mm_set1_epi8((char)byte)));
+#else
+    uint32_t mask = 0;
+    for (uint32_t i = 0; i < 16; i++)
+    {
+        mask |= (uint32_t)(bytes[i] == byte) << i;
+    }
+    return mask;
+#endif
+}
+
+void _mg_simd_compare(MgFieldType type, MgScanOp op, const void* column, const void* value, size_t count,
+uint64_t* mask)
+{
+    static const uint32_t relations[] = {
+        [MG_SCAN_EQ] = _MG_RELATION_EQ,
+        [MG_SCAN_NE] = _MG_RELATION_EQ, // negated
+        [MG_SCAN_LT] = _MG_RELATION_LT,
+        [MG_SCAN_LE] = _MG_RELATION_LT | _MG_RELATION_EQ,
+        [MG_SCAN_GT] = _MG_RELATION_GT,
+        [MG_SCAN_GE] = _MG_RELATION_GT | _MG_RELATION_EQ,
+    };
+    bool negate = (op == MG_SCAN_NE);
+
+    // whole words of rows go through the vectors, the rows of a last partial word one by one
+    const uint8_t* rows = (const uint8_t*)column;
+    size_t whole        = count / 64 * 64;
+    _mg_simd()->compare(type, relations[op], negate, rows, (const uint8_t*)value, whole, mask);
+    if (whole < count)
+    {
+        _mg_compare_scalar(type, relations[op], negate, rows + whole * _mg_field_size(type), (const uint8_t*)value,
+        count - whole, mask + whole / 64);
+    }
+}
+
+void _mg_simd_aggregate(MgFieldType type, const void* column, const uint64_t* mask, size_t count,
+MgAggregate* result)
+{
+    const uint8_t* rows = (const uint8_t*)column;
+    size_t size         = _mg_field_size(type);
+    size_t word_count   = (count + 63) / 64;
+
+    // runs of fully selected words go through the vectors, the words between them row by row
+    for (size_t word = 0; word < word_count;)
+    {
+        size_t end = word;
+        while (end < word_count && mask[end] == UINT64_MAX && (end + 1) * 64 <= count)
+        {
+            end++;
+        }
+
+        MgAggregate run;
+        _mg_aggregate_identity(type, &run);
+        if (end > word)
+        {
+            _mg_simd()->aggregate(type, rows + word * 64 * size, (end - word) * 64, &run);
+        }
+        else
+        {
+            size_t rest = count - word * 64;
+            if (mask[word])
+            {
+                _mg_aggregate_scalar(type, rows + word * 64 * size, &mask[word], rest < 64 ? rest : 64, &run);
+            }
+            end = word + 1;
+        }
+        _mg_aggregate_merge(type, result, &run);
+        word = end;
+    }
+}
+
+const char* _mg_simd_level(void)
+{
+    return _mg_simd()->level;
+}
+
+/////////////////////////////////////////////////
+// Scalar ///////////////////////////////////////
+/////////////////////////////////////////////////
+
+static size_t _mg_mismatch_scalar(const uint8_t* a, const uint8_t* b, size_t size)
+{
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+    {
+        uint64_t word_a, word_b;
+        memcpy(&word_a, a + i, sizeof(uint64_t));
+        memcpy(&word_b, b + i, sizeof(uint64_t));
+        if (word_a != word_b)
+        {
+            break;
+        }
+    }
+
+    while (i < size && a[i] == b[i])
+    {
+        i++;
+    }
+    return i;
+}
+
+#define _MG_COMPARE_ROWS(T)                                                                                            \
+    {                                                                                                                  \
+        const T* rows = (const T*)column;                                                                              \
+        T constant;                                                                                                    \
+        memcpy(&constant, value, sizeof(T));                                                                           \
+        for (size_t i = 0; i < count; i++)                                                                             \
+        {                                                                                                              \
+            uint32_t relation = (rows[i] < constant ? _MG_RELATION_LT : 0) |                                           \
+            (rows[i] == constant ? _MG_RELATION_EQ : 0) | (rows[i] > constant ? _MG_RELATION_GT : 0);                  \
+            mask[i / 64] |= (uint64_t)(((relation & relations) != 0) != negate) << (i % 64);                           \
+        }                                                                                                              \
+    }
+
+static void _mg_compare_scalar(MgFieldType type, uint32_t relations, bool negate, const uint8_t* column,
+const uint8_t* value, size_t count, uint64_t* mask)
+{
+    memset((void*)mask, 0, (count + 63) / 64 * sizeof(uint64_t));
+    switch (type)
+    {
+    case MG_FIELD_U32: _MG_COMPARE_ROWS(uint32_t); break;
+    case MG_FIELD_I32: _MG_COMPARE_ROWS(int32_t); break;
+    case MG_FIELD_U64: _MG_COMPARE_ROWS(uint64_t); break;
+    case MG_FIELD_I64: _MG_COMPARE_ROWS(int64_t); break;
+    case MG_FIELD_F32: _MG_COMPARE_ROWS(float); break;
+    case MG_FIELD_F64: _MG_COMPARE_ROWS(double); break;
+    default: break;
+    }
+}
+
+#undef _MG_COMPARE_ROWS
+
+// rows are widened to the member of MgValue they aggregate in, integer sums add up as uint64_t so they wrap
+#define _MG_AGGREGATE_ROWS(T, V, member, S, sum_member)                                                                \
+    {                                                                                                                  \
+        const T* rows = (const T*)column;                                                                              \
+        for (size_t i = 0; i < count; i++)                                                                             \
+        {                                                                                                              \
+            if (mask && !((mask[i / 64] >> (i % 64)) & 1))                                                             \
+            {                                                                                                          \
+                continue;                                                                                              \
+            }                                                                                                          \
+            V row = (V)rows[i];                                                                                        \
+            run->count++;                                                                                              \
+            run->sum.sum_member += (S)row;                                                                             \
+            run->min.member = row < run->min.member ? row : run->min.member;                                           \
+            run->max.member = row > run->max.member ? row : run->max.member;                                           \
+        }                                                                                                              \
+    }
+
+static void _mg_aggregate_scalar(MgFieldType type, const uint8_t* column, const uint64_t* mask, size_t count,
+MgAggregate* run)
+{
+    switch (type)
+    {
+    case MG_FIELD_U32: _MG_AGGREGATE_ROWS(uint32_t, uint64_t, u64, uint64_t, u64); break;
+    case MG_FIELD_I32: _MG_AGGREGATE_ROWS(int32_t, int64_t, i64, uint64_t, u64); break;
+    case MG_FIELD_U64: _MG_AGGREGATE_ROWS(uint64_t, uint64_t, u64, uint64_t, u64); break;
+    case MG_FIELD_I64: _MG_AGGREGATE_ROWS(int64_t, int64_t, i64, uint64_t, u64); break;
+    case MG_FIELD_F32: _MG_AGGREGATE_ROWS(float, double, f64, double, f64); break;
+    case MG_FIELD_F64: _MG_AGGREGATE_ROWS(double, double, f64, double, f64); break;
+    default: break;
+    }
+}
+
+#undef _MG_AGGREGATE_ROWS
+
+static void _mg_aggregate_rows_scalar(MgFieldType type, const uint8_t* column, size_t count, MgAggregate* run)
+{
+    _mg_aggregate_scalar(type, column, NULL, count, run);
+}
+
+static void _mg_aggregate_identity(MgFieldType type, MgAggregate* run)
+{
+    memset((void*)run, 0, sizeof(MgAggregate));
+    switch (type)
+    {
+    case MG_FIELD_U32:
+    case MG_FIELD_U64: run->min.u64 = UINT64_MAX; break;
+    case MG_FIELD_I32:
+    case MG_FIELD_I64:
+        run->min.i64 = INT64_MAX;
+        run->max.i64 = INT64_MIN;
+        break;
+    default:
+        run->min.f64 = INFINITY;
+        run->max.f64 = -INFINITY;
+        break;
+    }
+}
+
+static void _mg_aggregate_merge(MgFieldType type, MgAggregate* result, MgAggregate* run)
+{
+    bool floating = (type == MG_FIELD_F32 || type == MG_FIELD_F64);
+    if (run->count == 0)
+    {
+        return;
+    }
+    if (floating && run->min.f64 > run->max.f64) // nothing but nans, the run has no min or max
+    {
+        run->min.f64 = NAN;
+        run->max.f64 = NAN;
+    }
+    if (result->count == 0 || (floating && isnan(result->min.f64)))
+    {
+        result->min = run->min;
+        result->max = run->max;
+    }
+
+    result->count += run->count;
+    switch (type)
+    {
+    case MG_FIELD_U32:
+    case MG_FIELD_U64:
+        result->sum.u64 += run->sum.u64;
+        result->min.u64 = run->min.u64 < result->min.u64 ? run->min.u64 : result->min.u64;
+        result->max.u64 = run->max.u64 > result->max.u64 ? run->max.u64 : result->max.u64;
+        break;
+    case MG_FIELD_I32:
+    case MG_FIELD_I64:
+        result->sum.u64 += run->sum.u64;
+        result->min.i64 = run->min.i64 < result->min.i64 ? run->min.i64 : result->min.i64;
+        result->max.i64 = run->max.i64 > result->max.i64 ? run->max.i64 : result->max.i64;
+        break;
+    default:
+        result->sum.f64 += run->sum.f64;
+        result->min.f64 = run->min.f64 < result->min.f64 ? run->min.f64 : result->min.f64; // nan never wins
+        result->max.f64 = run->max.f64 > result->max.f64 ? run->max.f64 : result->max.f64;
+        break;
+    }
+}
+
+static const _MgSimdKernels _mg_simd_scalar = { "scalar", _mg_mismatch_scalar, _mg_compare_scalar,
+_mg_aggregate_rows_scalar };
+
+/////////////////////////////////////////////////
+// SSE2 /////////////////////////////////////////
+/////////////////////////////////////////////////
+
+#if defined(_MG_SIMD_SSE2)
+
+static size_t _mg_mismatch_sse2(const uint8_t* a, const uint8_t* b, size_t size)
+{
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16)
+    {
+        __m128i block_a = _mm_loadu_si128((const __m128i*)(a + i));
+        __m128i block_b = _mm_loadu_si128((const __m128i*)(b + i));
+        uint32_t differ = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(block_a, block_b)) ^ 0xffffu;
+        if (differ)
+        {
+            return i + _mg_ctz_u64(differ);
+        }
+    }
+    return i + _mg_mismatch_scalar(a + i, b + i, size - i);
+}
+
+// sse2 has no unsigned or 64 bit compares and no 32 bit min or max, column kernels stay on the scalar loops
+static const _MgSimdKernels _mg_simd_sse2 = { "sse2", _mg_mismatch_sse2, _mg_compare_scalar,
+_mg_aggregate_rows_scalar };
+
+#endif
+
+/////////////////////////////////////////////////
+// AVX2 /////////////////////////////////////////
+/////////////////////////////////////////////////
+
+#if defined(_MG_SIMD_AVX2)
+
+_MG_TARGET_AVX2 static size_t _mg_mismatch_avx2(const uint8_t* a, const uint8_t* b, size_t size)
+{
+    // two vectors per step, the loop is bound by loads and one combined test per 64 bytes keeps it there
+    size_t i = 0;
+    for (; i + 64 <= size; i += 64)
+    {
+        __m256i low_a  = _mm256_loadu_si256((const __m256i*)(a + i));
+        __m256i low_b  = _mm256_loadu_si256((const __m256i*)(b + i));
+        __m256i high_a = _mm256_loadu_si256((const __m256i*)(a + i + 32));
+        __m256i high_b = _mm256_loadu_si256((const __m256i*)(b + i + 32));
+        __m256i low    = _mm256_cmpeq_epi8(low_a, low_b);
+        __m256i high   = _mm256_cmpeq_epi8(high_a, high_b);
+
+        uint64_t equal = ((uint64_t)(uint32_t)_mm256_movemask_epi8(high) << 32) | (uint32_t)_mm256_movemask_epi8(low);
+        if (equal != UINT64_MAX)
+        {
+            return i + _mg_ctz_u64(~equal);
+        }
+    }
+    return i + _mg_mismatch_sse2(a + i, b + i, size - i);
+}
+
+_MG_TARGET_AVX2 static __m256i _mg_accept_avx2(const __m256i* accept, __m256i lt, __m256i eq, __m256i gt)
+{
+    __m256i match = _mm256_or_si256(_mm256_and_si256(lt, accept[0]), _mm256_and_si256(eq, accept[1]));
+    match         = _mm256_or_si256(match, _mm256_and_si256(gt, accept[2]));
+    return _mm256_xor_si256(match, accept[3]);
+}
+
+_MG_TARGET_AVX2 static void _mg_compare_i32_avx2(const int32_t* rows, const uint8_t* value, int32_t flip,
+const __m256i* accept, size_t count, uint64_t* mask)
+{
+    // there is only a signed compare, unsigned rows compare the same once their sign bits are flipped
+    int32_t constant;
+    memcpy(&constant, value, sizeof(constant));
+    __m256i sign  = _mm256_set1_epi32(flip);
+    __m256i other = _mm256_xor_si256(_mm256_set1_epi32(constant), sign);
+
+    for (size_t i = 0; i < count; i += 64)
+    {
+        uint64_t bits = 0;
+        for (uint32_t j = 0; j < 64; j += 8)
+        {
+            __m256i row   = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(rows + i + j)), sign);
+            __m256i match = _mg_accept_avx2(accept, _mm256_cmpgt_epi32(other, row), _mm256_cmpeq_epi32(row, other),
+            _mm256_cmpgt_epi32(row, other));
+            bits |= (uint64_t)(uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(match)) << j;
+        }
+        mask[i / 64] = bits;
+    }
+}
+
+_MG_TARGET_AVX2 static void _mg_compare_i64_avx2(const int64_t* rows, const uint8_t* value, int64_t flip,
+const __m256i* accept, size_t count, uint64_t* mask)
+{
+    int64_t constant;
+    memcpy(&constant, value, sizeof(constant));
+    __m256i sign  = _mm256_set1_epi64x(flip);
+    __m256i other = _mm256_xor_si256(_mm256_set1_epi64x(constant), sign);
+
+    for (size_t i = 0; i < count; i += 64)
+    {
+        uint64_t bits = 0;
+        for (uint32_t j = 0; j < 64; j += 4)
+        {
+            __m256i row   = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(rows + i + j)), sign);
+            __m256i match = _mg_accept_avx2(accept, _mm256_cmpgt_epi64(other, row), _mm256_cmpeq_epi64(row, other),
+            _mm256_cmpgt_epi64(row, other));
+            bits |= (uint64_t)(uint32_t)_mm256_movemask_pd(_mm256_castsi256_pd(match)) << j;
+        }
+        mask[i / 64] = bits;
+    }
+}
+
+_MG_TARGET_AVX2 static void _mg_compare_f32_avx2(const float* rows, const uint8_t* value, const __m256i* accept,
+size_t count, uint64_t* mask)
+{
+    float constant;
+    memcpy(&constant, value, sizeof(constant));
+    __m256 other = _mm256_set1_ps(constant);
+
+    for (size_t i = 0; i < count; i += 64)
+    {
+        uint64_t bits = 0;
+        for (uint32_t j = 0; j < 64; j += 8)
+        {
+            // ordered compares, a nan on either side is neither below, equal to nor above
+            __m256 row    = _mm256_loadu_ps(rows + i + j);
+            __m256i match = _mg_accept_avx2(accept, _mm256_castps_si256(_mm256_cmp_ps(row, other, _CMP_LT_OQ)),
+            _mm256_castps_si256(_mm256_cmp_ps(row, other, _CMP_EQ_OQ)),
+            _mm256_castps_si256(_mm256_cmp_ps(row, other, _CMP_GT_OQ)));
+            bits |= (uint64_t)(uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(match)) << j;
+        }
+        mask[i / 64] = bits;
+    }
+}
+
+_MG_TARGET_AVX2 static void _mg_compare_f64_avx2(const double* rows, const uint8_t* value, const __m256i* accept,
+size_t count, uint64_t* mask)
+{
+    double constant;
+    memcpy(&constant, value, sizeof(constant));
+    __m256d other = _mm256_set1_pd(constant);
+
+    for (size_t i = 0; i < count; i += 64)
+    {
+        uint64_t bits = 0;
+        for (uint32_t j = 0; j < 64; j += 4)
+        {
+            __m256d row   = _mm256_loadu_pd(rows + i + j);
+            __m256i match = _mg_accept_avx2(accept, _mm256_castpd_si256(_mm256_cmp_pd(row, other, _CMP_LT_OQ)),
+            _mm256_castpd_si256(_mm256_cmp_pd(row, other, _CMP_EQ_OQ)),
+            _mm256_castpd_si256(_mm256_cmp_pd(row, other, _CMP_GT_OQ)));
+            bits |= (uint64_t)(uint32_t)_mm256_movemask_pd(_mm256_castsi256_pd(match)) << j;
+        }
+        mask[i / 64] = bits;
+    }
+}
+
+_MG_TARGET_AVX2 static void _mg_compare_avx2(MgFieldType type, uint32_t relations, bool negate,
+const uint8_t* column, const uint8_t* value, size_t count, uint64_t* mask)
+{
+    // every relation a match accepts is all ones, so a lane matches when any of its accepted compares held
+    __m256i accept[4] = {
+        _mm256_set1_epi32((relations & _MG_RELATION_LT) ? -1 : 0),
+        _mm256_set1_epi32((relations & _MG_RELATION_EQ) ? -1 : 0),
+        _mm256_set1_epi32((relations & _MG_RELATION_GT) ? -1 : 0),
+        _mm256_set1_epi32(negate ? -1 : 0),
+    };
+
+    switch (type)
+    {
+    case MG_FIELD_U32: _mg_compare_i32_avx2((const int32_t*)column, value, INT32_MIN, accept, count, mask); break;
+    case MG_FIELD_I32: _mg_compare_i32_avx2((const int32_t*)column, value, 0, accept, count, mask); break;
+    case MG_FIELD_U64: _mg_compare_i64_avx2((const int64_t*)column, value, INT64_MIN, accept, count, mask); break;
+    case MG_FIELD_I64: _mg_compare_i64_avx2((const int64_t*)column, value, 0, accept, count, mask); break;
+    case MG_FIELD_F32: _mg_compare_f32_avx2((const float*)column, value, accept, count, mask); break;
+    case MG_FIELD_F64: _mg_compare_f64_avx2((const double*)column, value, accept, count, mask); break;
+    default: memset((void*)mask, 0, count / 64 * sizeof(uint64_t)); break;
+    }
+}
+
+_MG_TARGET_AVX2 static void _mg_aggregate_u32_avx2(const uint32_t* rows, size_t count, MgAggregate* run)
+{
+    __m256i sum = _mm256_setzero_si256();
+    __m256i min = _mm256_set1_epi32(-1);
+    __m256i max = _mm256_setzero_si256();
+    for (size_t i = 0; i < count; i += 8)
+    {
+        __m256i row = _mm256_loadu_si256((const __m256i*)(rows + i));
+        sum         = _mm256_add_epi64(sum, _mm256_cvtepu32_epi64(_mm256_castsi256_si128(row)));
+        sum         = _mm256_add_epi64(sum, _mm256_cvtepu32_epi64(_mm256_extracti128_si256(row, 1)));
+        min         = _mm256_min_epu32(min, row);
+        max         = _mm256_max_epu32(max, row);
+    }
+
+    uint64_t sums[4];
+    uint32_t mins[8], maxs[8];
+    _mm256_storeu_si256((__m256i*)sums, sum);
+    _mm256_storeu_si256((__m256i*)mins, min);
+    _mm256_storeu_si256((__m256i*)maxs, max);
+    run->count = count;
+    for (uint32_t lane = 0; lane < 8; lane++)
+    {
+        run->sum.u64 += lane < 4 ? sums[lane] : 0;
+        run->min.u64 = mins[lane] < run->min.u64 ? mins[lane] : run->min.u64;
+        run->max.u64 = maxs[lane] > run->max.u64 ? maxs[lane] : run->max.u64;
+    }
+}
+
+_MG_TARGET_AVX2 static void _mg_aggregate_i32_avx2(const int32_t* rows, size_t count, MgAggregate* run)
+{
+    __m256i sum = _mm256_setzero_si256();
+    __m256i min = _mm256_set1_epi32(INT32_MAX);
+    __m256i max = _mm256_set1_epi32(INT32_MIN);
+    for (size_t i = 0; i < count; i += 8)
+    {
+        __m256i row = _mm256_loadu_si256((const __m256i*)(rows + i));
+        sum         = _mm256_add_epi64(sum, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(row)));
+        sum         = _mm256_add_epi64(sum, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(row, 1)));
+        min         = _mm256_min_epi32(min, row);
+        max         = _mm256_max_epi32(max, row);
+    }
+
+    uint64_t sums[4];
+    int32_t mins[8], maxs[8];
+    _mm256_storeu_si256((__m256i*)sums, sum);
+    _mm256_storeu_si256((__m256i*)mins, min);
+    _mm256_storeu_si256((__m256i*)maxs, max);
+    run->count = count;
+    for (uint32_t lane = 0; lane < 8; lane++)
+    {
+        run->sum.u64 += lane < 4 ? sums[lane] : 0;
+        run->min.i64 = mins[lane] < run->min.i64 ? mins[lane] : run->min.i64;
+        run->max.i64 = maxs[lane] > run->max.i64 ? maxs[lane] : run->max.i64;
+    }
+}
+
+_MG_TARGET_AVX2 static void _mg_aggregate_i64_avx2(const int64_t* rows, int64_t flip, size_t count,
+MgAggregate* run)
+{
+    // no 64 bit min or max before avx512, a compare picks the lanes instead. unsigned rows keep their sign bits
+    // flipped in min and max, which start at the flipped identities
+    __m256i sign = _mm256_set1_epi64x(flip);
+    __m256i sum  = _mm256_setzero_si256();
+    __m256i min  = _mm256_set1_epi64x(INT64_MAX);
+    __m256i max  = _mm256_set1_epi64x(INT64_MIN);
+    for (size_t i = 0; i < count; i += 4)
+    {
+        __m256i row = _mm256_loadu_si256((const __m256i*)(rows + i));
+        __m256i key = _mm256_xor_si256(row, sign);
+        sum         = _mm256_add_epi64(sum, row);
+        min         = _mm256_blendv_epi8(min, key, _mm256_cmpgt_epi64(min, key));
+        max         = _mm256_blendv_epi8(max, key, _mm256_cmpgt_epi64(key, max));
+    }
+
+    uint64_t sums[4];
+    int64_t mins[4], maxs[4];
+    _mm256_storeu_si256((__m256i*)sums, sum);
+    _mm256_storeu_si256((__m256i*)mins, min);
+    _mm256_storeu_si256((__m256i*)maxs, max);
+    int64_t low  = INT64_MAX;
+    int64_t high = INT64_MIN;
+    for (uint32_t lane = 0; lane < 4; lane++)
+    {
+        run->sum.u64 += sums[lane];
+        low  = mins[lane] < low ? mins[lane] : low;
+        high = maxs[lane] > high ? maxs[lane] : high;
+    }
+    run->count   = count;
+    run->min.u64 = (uint64_t)(low ^ flip);
+    run->max.u64 = (uint64_t)(high ^ flip);
+}
+
+_MG_TARGET_AVX2 static void _mg_aggregate_f32_avx2(const float* rows, size_t count, MgAggregate* run)
+{
+    // summed as doubles like the scalar loop does. min and max keep their accumulator as the second operand, which
+    // is what they return when the row is a nan
+    __m256d sum = _mm256_setzero_pd();
+    __m256 min  = _mm256_set1_ps(INFINITY);
+    __m256 max  = _mm256_set1_ps(-INFINITY);
+    for (size_t i = 0; i < count; i += 8)
+    {
+        __m256 row = _mm256_loadu_ps(rows + i);
+        sum        = _mm256_add_pd(sum, _mm256_cvtps_pd(_mm256_castps256_ps128(row)));
+        sum        = _mm256_add_pd(sum, _mm256_cvtps_pd(_mm256_extractf128_ps(row, 1)));
+        min        = _mm256_min_ps(row, min);
+        max        = _mm256_max_ps(row, max);
+    }
+
+    double sums[4];
+    float mins[8], maxs[8];
+    _mm256_storeu_pd(sums, sum);
+    _mm256_storeu_ps(mins, min);
+    _mm256_storeu_ps(maxs, max);
+    run->count = count;
+    for (uint32_t lane = 0; lane < 8; lane++)
+    {
+        run->sum.f64 += lane < 4 ? sums[lane] : 0.0;
+        run->min.f64 = mins[lane] < run->min.f64 ? mins[lane] : run->min.f64;
+        run->max.f64 = maxs[lane] > run->max.f64 ? maxs[lane] : run->max.f64;
+    }
+}
+
+_MG_TARGET_AVX2 static void _mg_aggregate_f64_avx2(const double* rows, size_t count, MgAggregate* run)
+{
+    __m256d sum = _mm256_setzero_pd();
+    __m256d min = _mm256_set1_pd(INFINITY);
+    __m256d max = _mm256_set1_pd(-INFINITY);
+    for (size_t i = 0; i < count; i += 4)
+    {
+        __m256d row = _mm256_loadu_pd(rows + i);
+        sum         = _mm256_add_pd(sum, row);
+        min         = _mm256_min_pd(row, min);
+        max         = _mm256_max_pd(row, max);
+    }
+
+    double sums[4], mins[4], maxs[4];
+    _mm256_storeu_pd(sums, sum);
+    _mm256_storeu_pd(mins, min);
+    _mm256_storeu_pd(maxs, max);
+    run->count = count;
+    for (uint32_t lane = 0; lane < 4; lane++)
+    {
+        run->sum.f64 += sums[lane];
+        run->min.f64 = mins[lane] < run->min.f64 ? mins[lane] : run->min.f64;
+        run->max.f64 = maxs[lane] > run->max.f64 ? maxs[lane] : run->max.f64;
+    }
+}
+
+_MG_TARGET_AVX2 static void _mg_aggregate_avx2(MgFieldType type, const uint8_t* column, size_t count,
+MgAggregate* run)
+{
+    switch (type)
+    {
+    case MG_FIELD_U32: _mg_aggregate_u32_avx2((const uint32_t*)column, count, run); break;
+    case MG_FIELD_I32: _mg_aggregate_i32_avx2((const int32_t*)column, count, run); break;
+    case MG_FIELD_U64: _mg_aggregate_i64_avx2((const int64_t*)column, INT64_MIN, count, run); break;
+    case MG_FIELD_I64: _mg_aggregate_i64_avx2((const int64_t*)column, 0, count, run); break;
+    case MG_FIELD_F32: _mg_aggregate_f32_avx2((const float*)column, count, run); break;
+    case MG_FIELD_F64: _mg_aggregate_f64_avx2((const double*)column, count, run); break;
+    default: break;
+    }
+}
+
+static const _MgSimdKernels _mg_simd_avx2 = { "avx2", _mg_mismatch_avx2, _mg_compare_avx2, _mg_aggregate_avx2 };
+
+static bool _mg_cpu_has_avx2(void)
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+    {
+        return false;
+    }
+
+    __cpuid(info, 1);
+    bool avx = (info[2] & (1 << 28)) && (info[2] & (1 << 27)) && ((_xgetbv(0) & 6) == 6); // and the os saves ymm
+
+    __cpuidex(info, 7, 0);
+    return avx && (info[1] & (1 << 5));
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif
+
+/////////////////////////////////////////////////
+// AVX-512 //////////////////////////////////////
+/////////////////////////////////////////////////
+
+#if defined(_MG_SIMD_AVX512)
+
+static uint32_t _mg_accept_avx512(const uint32_t* accept, uint32_t lt, uint32_t eq, uint32_t gt)
+{
+    return ((lt & accept[0]) | (eq & accept[1]) | (gt & accept[2])) ^ accept[3];
+}
+
+_MG_TARGET_AVX512 static void _mg_compare_i32_avx512(const int32_t* rows, const uint8_t* value, int32_t flip,
+const uint32_t* accept, size_t count, uint64_t* mask)
+{
+    int32_t constant;
+    memcpy(&constant, value, sizeof(constant));
+    __m512i sign  = _mm512_set1_epi32(flip);
+    __m512i other = _mm512_xor_si512(_mm512_set1_epi32(constant), sign);
+
+    for (size_t i = 0; i < count; i += 64)
+    {
+        uint64_t bits = 0;
+        for (uint32_t j = 0; j < 64; j += 16)
+        {
+            __m512i row    = _mm512_xor_si512(_mm512_loadu_si512((const void*)(rows + i + j)), sign);
+            uint32_t match = _mg_accept_avx512(accept, _mm512_cmplt_epi32_mask(row, other),
+            _mm512_cmpeq_epi32_mask(row, other), _mm512_cmpgt_epi32_mask(row, other));
+            bits |= (uint64_t)(match & 0xffffu) << j;
+        }
+        mask[i / 64] = bits;
+    }
+}
+
+_MG_TARGET_AVX512 static void _mg_compare_i64_avx512(const int64_t* rows, const uint8_t* value, int64_t flip,
+const uint32_t* accept, size_t count, uint64_t* mask)
+{
+    int64_t constant;
+    memcpy(&constant, value, sizeof(constant));
+    __m512i sign  = _mm512_set1_epi64(flip);
+    __m512i other = _mm512_xor_si512(_mm512_set1_epi64(constant), sign);
+
+    for (size_t i = 0; i < count; i += 64)
+    {
+        uint64_t bits = 0;
+        for (uint32_t j = 0; j < 64; j += 8)
+        {
+            __m512i row    = _mm512_xor_si512(_mm512_loadu_si512((const void*)(rows + i + j)), sign);
+            uint32_t match = _mg_accept_avx512(accept, _mm512_cmplt_epi64_mask(row, other),
+            _mm512_cmpeq_epi64_mask(row, other), _mm512_cmpgt_epi64_mask(row, other));
+            bits |= (uint64_t)(match & 0xffu) << j;
+        }
+        mask[i / 64] = bits;
+    }
+}
+
+_MG_TARGET_AVX512 static void _mg_compare_f32_avx512(const float* rows, const uint8_t* value, const uint32_t* accept,
+size_t count, uint64_t* mask)
+{
+    float constant;
+    memcpy(&constant, value, sizeof(constant));
+    __m512 other = _mm512_set1_ps(constant);
+
+    for (size_t i = 0; i < count; i += 64)
+    {
+        uint64_t bits = 0;
+        for (uint32_t j = 0; j < 64; j += 16)
+        {
+            __m512 row     = _mm512_loadu_ps(rows + i + j);
+            uint32_t match = _mg_accept_avx512(accept, _mm512_cmp_ps_mask(row, other, _CMP_LT_OQ),
+            _mm512_cmp_ps_mask(row, other, _CMP_EQ_OQ), _mm512_cmp_ps_mask(row, other, _CMP_GT_OQ));
+            bits |= (uint64_t)(match & 0xffffu) << j;
+        }
+        mask[i / 64] = bits;
+    }
+}
+
+_MG_TARGET_AVX512 static void _mg_compare_f64_avx512(const double* rows, const uint8_t* value,
+const uint32_t* accept, size_t count, uint64_t* mask)
+{
+    double constant;
+    memcpy(&constant, value, sizeof(constant));
+    __m512d other = _mm512_set1_pd(constant);
+
+    for (size_t i = 0; i < count; i += 64)
+    {
+        uint64_t bits = 0;
+        for (uint32_t j = 0; j < 64; j += 8)
+        {
+            __m512d row    = _mm512_loadu_pd(rows + i + j);
+            uint32_t match = _mg_accept_avx512(accept, _mm512_cmp_pd_mask(row, other, _CMP_LT_OQ),
+            _mm512_cmp_pd_mask(row, other, _CMP_EQ_OQ), _mm512_cmp_pd_mask(row, other, _CMP_GT_OQ));
+            bits |= (uint64_t)(match & 0xffu) << j;
+        }
+        mask[i / 64] = bits;
+    }
+}
+
+_MG_TARGET_AVX512 static void _mg_compare_avx512(MgFieldType type, uint32_t relations, bool negate,
+const uint8_t* column, const uint8_t* value, size_t count, uint64_t* mask)
+{
+    // compares land in mask registers, one bit per lane, so the accepted relations are plain bit masks
+    uint32_t accept[4] = {
+        (relations & _MG_RELATION_LT) ? UINT32_MAX : 0,
+        (relations & _MG_RELATION_EQ) ? UINT32_MAX : 0,
+        (relations & _MG_RELATION_GT) ? UINT32_MAX : 0,
+        negate ? UINT32_MAX : 0,
+    };
+
+    switch (type)
+    {
+    case MG_FIELD_U32: _mg_compare_i32_avx512((const int32_t*)column, value, INT32_MIN, accept, count, mask); break;
+    case MG_FIELD_I32: _mg_compare_i32_avx512((const int32_t*)column, value, 0, accept, count, mask); break;
+    case MG_FIELD_U64: _mg_compare_i64_avx512((const int64_t*)column, value, INT64_MIN, accept, count, mask); break;
+    case MG_FIELD_I64: _mg_compare_i64_avx512((const int64_t*)column, value, 0, accept, count, mask); break;
+    case MG_FIELD_F32: _mg_compare_f32_avx512((const float*)column, value, accept, count, mask); break;
+    case MG_FIELD_F64: _mg_compare_f64_avx512((const double*)column, value, accept, count, mask); break;
+    default: memset((void*)mask, 0, count / 64 * sizeof(uint64_t)); break;
+    }
+}
+
+_MG_TARGET_AVX512 static uint64_t _mg_reduce_add_avx512(__m512i sum)
+{
+    // _mm512_reduce_add_epi64 adds signed lanes, integer sums have to wrap around instead of overflowing
+    uint64_t sums[8];
+    _mm512_storeu_si512((void*)sums, sum);
+    return sums[0] + sums[1] + sums[2] + sums[3] + sums[4] + sums[5] + sums[6] + sums[7];
+}
+
+_MG_TARGET_AVX512 static void _mg_aggregate_u32_avx512(const uint32_t* rows, size_t count, MgAggregate* run)
+{
+    __m512i sum = _mm512_setzero_si512();
+    __m512i min = _mm512_set1_epi32(-1);
+    __m512i max = _mm512_setzero_si512();
+    for (size_t i = 0; i < count; i += 16)
+    {
+        __m512i row = _mm512_loadu_si512((const void*)(rows + i));
+        sum         = _mm512_add_epi64(sum, _mm512_cvtepu32_epi64(_mm512_castsi512_si256(row)));
+        sum         = _mm512_add_epi64(sum, _mm512_cvtepu32_epi64(_mm512_extracti64x4_epi64(row, 1)));
+        min         = _mm512_min_epu32(min, row);
+        max         = _mm512_max_epu32(max, row);
+    }
+
+    run->count   = count;
+    run->sum.u64 = _mg_reduce_add_avx512(sum);
+    run->min.u64 = _mm512_reduce_min_epu32(min);
+    run->max.u64 = _mm512_reduce_max_epu32(max);
+}
+
+_MG_TARGET_AVX512 static void _mg_aggregate_i32_avx512(const int32_t* rows, size_t count, MgAggregate* run)
+{
+    __m512i sum = _mm512_setzero_si512();
+    __m512i min = _mm512_set1_epi32(INT32_MAX);
+    __m512i max = _mm512_set1_epi32(INT32_MIN);
+    for (size_t i = 0; i < count; i += 16)
+    {
+        __m512i row = _mm512_loadu_si512((const void*)(rows + i));
+        sum         = _mm512_add_epi64(sum, _mm512_cvtepi32_epi64(_mm512_castsi512_si256(row)));
+        sum         = _mm512_add_epi64(sum, _mm512_cvtepi32_epi64(_mm512_extracti64x4_epi64(row, 1)));
+        min         = _mm512_min_epi32(min, row);
+        max         = _mm512_max_epi32(max, row);
+    }
+
+    run->count   = count;
+    run->sum.u64 = _mg_reduce_add_avx512(sum);
+    run->min.i64 = _mm512_reduce_min_epi32(min);
+    run->max.i64 = _mm512_reduce_max_epi32(max);
+}
+
+_MG_TARGET_AVX512 static void _mg_aggregate_u64_avx512(const uint64_t* rows, size_t count, MgAggregate* run)
+{
+    __m512i sum = _mm512_setzero_si512();
+    __m512i min = _mm512_set1_epi64(-1);
+    __m512i max = _mm512_setzero_si512();
+    for (size_t i = 0; i < count; i += 8)
+    {
+        __m512i row = _mm512_loadu_si512((const void*)(rows + i));
+        sum         = _mm512_add_epi64(sum, row);
+        min         = _mm512_min_epu64(min, row);
+        max         = _mm512_max_epu64(max, row);
+    }
+
+    run->count   = count;
+    run->sum.u64 = _mg_reduce_add_avx512(sum);
+    run->min.u64 = _mm512_reduce_min_epu64(min);
+    run->max.u64 = _mm512_reduce_max_epu64(max);
+}
+
+_MG_TARGET_AVX512 static void _mg_aggregate_i64_avx512(const int64_t* rows, size_t count, MgAggregate* run)
+{
+    __m512i sum = _mm512_setzero_si512();
+    __m512i min = _mm512_set1_epi64(INT64_MAX);
+    __m512i max = _mm512_set1_epi64(INT64_MIN);
+    for (size_t i = 0; i < count; i += 8)
+    {
+        __m512i row = _mm512_loadu_si512((const void*)(rows + i));
+        sum         = _mm512_add_epi64(sum, row);
+        min         = _mm512_min_epi64(min, row);
+        max         = _mm512_max_epi64(max, row);
+    }
+
+    run->count   = count;
+    run->sum.u64 = _mg_reduce_add_avx512(sum);
+    run->min.i64 = _mm512_reduce_min_epi64(min);
+    run->max.i64 = _mm512_reduce_max_epi64(max);
+}
+
+_MG_TARGET_AVX512 static void _mg_aggregate_f32_avx512(const float* rows, size_t count, MgAggregate* run)
+{
+    __m512d sum = _mm512_setzero_pd();
+    __m512 min  = _mm512_set1_ps(INFINITY);
+    __m512 max  = _mm512_set1_ps(-INFINITY);
+    for (size_t i = 0; i < count; i += 16)
+    {
+        __m512 row  = _mm512_loadu_ps(rows + i);
+        __m256 high = _mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(row), 1));
+        sum         = _mm512_add_pd(sum, _mm512_cvtps_pd(_mm512_castps512_ps256(row)));
+        sum         = _mm512_add_pd(sum, _mm512_cvtps_pd(high));
+        min         = _mm512_min_ps(row, min); // the accumulator wins against a nan, like with avx2
+        max         = _mm512_max_ps(row, max);
+    }
+
+    run->count   = count;
+    run->sum.f64 = _mm512_reduce_add_pd(sum);
+    run->min.f64 = _mm512_reduce_min_ps(min);
+    run->max.f64 = _mm512_reduce_max_ps(max);
+}
+
+_MG_TARGET_AVX512 static void _mg_aggregate_f64_avx512(const double* rows, size_t count, MgAggregate* run)
+{
+    __m512d sum = _mm512_setzero_pd();
+    __m512d min = _mm512_set1_pd(INFINITY);
+    __m512d max = _mm512_set1_pd(-INFINITY);
+    for (size_t i = 0; i < count; i += 8)
+    {
+        __m512d row = _mm512_loadu_pd(rows + i);
+        sum         = _mm512_add_pd(sum, row);
+        min         = _mm512_min_pd(row, min);
+        max         = _mm512_max_pd(row, max);
+    }
+
+    run->count   = count;
+    run->sum.f64 = _mm512_reduce_add_pd(sum);
+    run->min.f64 = _mm512_reduce_min_pd(min);
+    run->max.f64 = _mm512_reduce_max_pd(max);
+}
+
+_MG_TARGET_AVX512 static void _mg_aggregate_avx512(MgFieldType type, const uint8_t* column, size_t count,
+MgAggregate* run)
+{
+    switch (type)
+    {
+    case MG_FIELD_U32: _mg_aggregate_u32_avx512((const uint32_t*)column, count, run); break;
+    case MG_FIELD_I32: _mg_aggregate_i32_avx512((const int32_t*)column, count, run); break;
+    case MG_FIELD_U64: _mg_aggregate_u64_avx512((const uint64_t*)column, count, run); break;
+    case MG_FIELD_I64: _mg_aggregate_i64_avx512((const int64_t*)column, count, run); break;
+    case MG_FIELD_F32: _mg_aggregate_f32_avx512((const float*)column, count, run); break;
+    case MG_FIELD_F64: _mg_aggregate_f64_avx512((const double*)column, count, run); break;
+    default: break;
+    }
+}
+
+// byte compares gain nothing over avx2 here, mismatch stays on the avx2 loop
+static const _MgSimdKernels _mg_simd_avx512 = { "avx512", _mg_mismatch_avx2, _mg_compare_avx512,
+_mg_aggregate_avx512 };
+
+static bool _mg_cpu_has_avx512(void)
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+    {
+        return false;
+    }
+
+    __cpuid(info, 1);
+    bool saved = (info[2] & (1 << 27)) && ((_xgetbv(0) & 0xe6) == 0xe6); // the os saves zmm and mask registers
+
+    __cpuidex(info, 7, 0);
+    return saved && (info[1] & (1 << 16));
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx512f");
+#endif
+}
+
+#endif
+
+static const _MgSimdKernels* volatile _mg_simd_selected;
+
+static const _MgSimdKernels* _mg_simd(void)
+{
+    const _MgSimdKernels* kernels = _mg_simd_selected;
+    if (!kernels)
+    {
+        const _MgSimdKernels* levels[4];
+        kernels           = levels[_mg_simd_levels(levels) - 1];
+        _mg_simd_selected = kernels; // threads racing through here all pick the same table
+    }
+    return kernels;
+}
+
+bool _mg_simd_force(const char* level)
+{
+    const _MgSimdKernels* levels[4];
+    uint32_t level_count = _mg_simd_levels(levels);
+
+    const _MgSimdKernels* kernels = level ? NULL : levels[level_count - 1];
+    for (uint32_t i = 0; i < level_count && !kernels; i++)
+    {
+        kernels = strcmp(levels[i]->level, level) == 0 ? levels[i] : NULL;
+    }
+    if (kernels)
+    {
+        _mg_simd_selected = kernels;
+    }
+    return kernels != NULL;
+}
+
+static uint32_t _mg_simd_levels(const _MgSimdKernels** levels) // the ones this build and cpu run, widest last
+{
+    uint32_t level_count  = 0;
+    levels[level_count++] = &_mg_simd_scalar;
+#if defined(_MG_SIMD_SSE2)
+    levels[level_count++] = &_mg_simd_sse2;
+#endif
+#if defined(_MG_SIMD_AVX2)
+    if (_mg_cpu_has_avx2())
+    {
+        levels[level_count++] = &_mg_simd_avx2;
+    }
+#endif
+#if defined(_MG_SIMD_AVX512)
+    if (_mg_cpu_has_avx512())
+    {
+        levels[level_count++] = &_mg_simd_avx512;
+    }
+#endif
+    return level_count;
+}
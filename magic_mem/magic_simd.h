@@ -0,0 +1,43 @@
+#ifndef MAGIC_SIMD_HEADER
+#define MAGIC_SIMD_HEADER
+
+// internal header, not part of the public api (include magic_mem.h instead)
+
+#include "magic_mem.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if __cplusplus
+extern "C" {
+#endif
+
+// vector kernels, the widest instruction set the cpu supports (avx512, avx2, sse2, else portable scalar code) is
+// picked on first use
+
+// offset of the first byte where a and b differ, size if the ranges are equal
+extern size_t _mg_simd_mismatch(const void* a, const void* b, size_t size);
+
+// bit i set where bytes[i] == byte, for 16 bytes aligned to 16. sse2 is part of every x64 cpu, so this one is
+// picked when compiling and costs no indirect call on the index probe path
+extern uint32_t _mg_simd_match16(const uint8_t* bytes, uint8_t byte);
+
+// bit i % 64 of mask[i / 64] set where row i of the count rows of a column of type relates to value like op says,
+// all (count + 63) / 64 words of mask are written
+extern void _mg_simd_compare(MgFieldType type, MgScanOp op, const void* column, const void* value, size_t count,
+uint64_t* mask);
+// adds the rows of a column whose bits are set in mask to result, zeroed before the first of a series of calls
+extern void _mg_simd_aggregate(MgFieldType type, const void* column, const uint64_t* mask, size_t count,
+MgAggregate* result);
+
+extern const char* _mg_simd_level(void); // "avx512", "avx2", "sse2" or "scalar"
+// test hook, makes every kernel run at the named level from now on. false (nothing changes) for a level this build
+// or cpu cannot run, NULL goes back to the widest one. not while other threads run kernels.
+extern bool _mg_simd_force(const char* level);
+
+#if __cplusplus
+} // end extern "C"
+#endif
+
+#endif // MAGIC_SIMD_HEADER
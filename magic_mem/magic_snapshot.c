@@ -0,0 +1,538 @@
+#include "magic_arena.h"
+#include "magic_mem.h"
+#include "magic_platform.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define _MG_SNAPSHOT_MAGIC 0x000050414e53474dull // "MGSNAP"
+#define _MG_DELTA_MAGIC 0x00415444474dull        // "MGDTA"
+
+enum {
+    _MG_SNAPSHOT_VERSION     = 1,
+    _MG_SNAPSHOT_HEADER_SIZE = 4096, // the block starts page aligned in the mapping
+};
+
+typedef struct _MgSnapshotHeader {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t header_size;
+    uint64_t block_size;
+    uint64_t checksum;  // over the block only
+    uint32_t layout[4]; // struct sizes of the writer, a build with a different layout cannot map the file
+} _MgSnapshotHeader;
+
+// a delta is this header followed by one record per touched group:
+//     _MgDeltaGroup, _MgShard[shard_count], then per touched slot: _MgDeltaSlot, uint8_t[handle_stride]
+typedef struct _MgDeltaHeader {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t sequence;      // 1 for the first delta after the snapshot
+    uint64_t base_checksum; // checksum of the snapshot the chain starts from
+    uint64_t payload_size;
+    uint64_t checksum; // over the payload
+    uint32_t layout[4];
+} _MgDeltaHeader;
+
+typedef struct _MgDeltaGroup {
+    uint32_t group_index;
+    uint32_t slot_count;
+} _MgDeltaGroup;
+
+typedef struct _MgDeltaSlot {
+    uint32_t slot_index;
+    _MgSlot slot;
+} _MgDeltaSlot;
+
+static void _mg_snapshot_header_init(_MgSnapshotHeader* header, size_t block_size);
+static bool _mg_snapshot_header_valid(const _MgSnapshotHeader* header, size_t file_size);
+static void _mg_snapshot_clear_dirty(_MgArena* arena_internal);
+static void _mg_snapshot_owners(_MgArena* arena_internal, uint32_t* owners, bool restore);
+static size_t _mg_delta_payload_size(_MgArena* arena_internal);
+static void _mg_delta_payload_write(_MgArena* arena_internal, uint8_t* payload);
+static bool _mg_delta_apply(_MgArena* arena_internal, const char* path, uint32_t sequence);
+static bool _mg_snapshot_file_write(const char* path, const void* header, size_t header_size, const void* body,
+size_t body_size);
+
+MgStatus mg_arena_save(MgArena* arena, const char* path)
+{
+    _MG_STATUS(arena, MG_ERROR_ARENA_INVALID);
+    _MG_STATUS(path, MG_ERROR_DATA_INVALID);
+    _MgArena* arena_internal = (_MgArena*)arena;
+
+    uint8_t header_page[_MG_SNAPSHOT_HEADER_SIZE] = { 0 }; // header, zero padded to the block's file offset
+
+    _MgSnapshotHeader* header = (_MgSnapshotHeader*)header_page;
+    _mg_snapshot_header_init(header, arena_internal->alloc_size);
+    header->checksum = _mg_checksum(arena_internal, arena_internal->alloc_size);
+
+    bool written = _mg_snapshot_file_write(path, header_page, sizeof(header_page), (void*)arena_internal,
+    arena_internal->alloc_size);
+    _MG_STATUS(written, MG_ERROR_SNAPSHOT_IO_FAILED);
+
+    // this file is the new base, deltas from here on chain onto it
+    arena_internal->checkpoint_base     = header->checksum;
+    arena_internal->checkpoint_sequence = 0;
+    _mg_snapshot_clear_dirty(arena_internal);
+
+    return MG_SUCCESS;
+}
+
+MgArena* mg_arena_load_mapped(const char* path)
+{
+    _MG_CHECK(path, MG_ERROR_DATA_INVALID);
+
+    size_t file_size = 0;
+    uint8_t* file    = (uint8_t*)_mg_file_map(path, &file_size);
+    _MG_CHECK(file, MG_ERROR_SNAPSHOT_IO_FAILED);
+    if (!file)
+    {
+        return NULL;
+    }
+
+    // header only, the checksum would touch every page and defeat the point of mapping (see mg_arena_verify)
+    bool valid = _mg_snapshot_header_valid((const _MgSnapshotHeader*)file, file_size);
+    _MG_CHECK(valid, MG_ERROR_SNAPSHOT_INVALID);
+    if (!valid)
+    {
+        _mg_file_unmap(file, file_size);
+        return NULL;
+    }
+
+    _MgArena* arena_internal            = (_MgArena*)(file + _MG_SNAPSHOT_HEADER_SIZE);
+    arena_internal->alloc_kind          = _MG_ARENA_ALLOC_MAPPED;
+    arena_internal->checkpoint_base     = ((const _MgSnapshotHeader*)file)->checksum;
+    arena_internal->checkpoint_sequence = 0;
+    _mg_arena_reset_process_state(arena_internal);
+    _mg_snapshot_clear_dirty(arena_internal);
+
+    return (MgArena*)arena_internal;
+}
+
+MgStatus mg_arena_save_delta(MgArena* arena, const char* path)
+{
+    _MG_STATUS(arena, MG_ERROR_ARENA_INVALID);
+    _MG_STATUS(path, MG_ERROR_DATA_INVALID);
+    _MgArena* arena_internal = (_MgArena*)arena;
+    _MG_STATUS(arena_internal->track_dirty, MG_ERROR_ARENA_DESC_INVALID);
+    _MG_STATUS(!_mg_arena_has_blobs(arena_internal), MG_ERROR_ARENA_DESC_INVALID); // deltas carry slots, not blobs
+    _MG_STATUS(arena_internal->checkpoint_base != 0, MG_ERROR_SNAPSHOT_INVALID); // no snapshot to chain onto
+
+    _MgDeltaHeader header = { 0 };
+    header.magic          = _MG_DELTA_MAGIC;
+    header.version        = _MG_SNAPSHOT_VERSION;
+    header.sequence       = arena_internal->checkpoint_sequence + 1;
+    header.base_checksum  = arena_internal->checkpoint_base;
+    header.payload_size   = _mg_delta_payload_size(arena_internal);
+    header.layout[0]      = sizeof(_MgArena);
+    header.layout[1]      = sizeof(_MgGroup);
+    header.layout[2]      = sizeof(_MgShard);
+    header.layout[3]      = sizeof(_MgSlot);
+
+    // built in memory first so the checksum can lead the file, the buffer is as big as the churn
+    uint8_t* payload = (uint8_t*)malloc(header.payload_size > 0 ? header.payload_size : 1);
+    _MG_STATUS(payload, MG_ERROR_ARENA_ALLOC_FAILED);
+    _mg_delta_payload_write(arena_internal, payload);
+    header.checksum = _mg_checksum(payload, header.payload_size);
+
+    bool written = _mg_snapshot_file_write(path, &header, sizeof(header), payload, header.payload_size);
+    free(payload);
+
+    _MG_STATUS(written, MG_ERROR_SNAPSHOT_IO_FAILED);
+
+    arena_internal->checkpoint_sequence = header.sequence;
+    _mg_snapshot_clear_dirty(arena_internal);
+
+    return MG_SUCCESS;
+}
+
+MgArena* mg_arena_load_chain(const char* base_path, const char** delta_paths, uint32_t delta_count)
+{
+    _MG_CHECK(delta_paths || delta_count == 0, MG_ERROR_DATA_INVALID);
+
+    MgArena* arena = mg_arena_load_mapped(base_path);
+    if (!arena)
+    {
+        return NULL;
+    }
+
+    _MgArena* arena_internal = (_MgArena*)arena;
+
+    bool applied = true;
+    for (uint32_t i = 0; i < delta_count && applied; i++)
+    {
+        applied = _mg_delta_apply(arena_internal, delta_paths[i], i + 1);
+    }
+
+    _MG_CHECK(applied, MG_ERROR_SNAPSHOT_INVALID);
+    if (!applied)
+    {
+        mg_arena_destroy(&arena);
+        return NULL;
+    }
+
+    // deltas carry shard state from the saving process. they carry slots but no index, indexes are rebuilt from
+    // the keys the slots ended up with
+    arena_internal->checkpoint_sequence = delta_count;
+    _mg_arena_reset_process_state(arena_internal);
+    for (uint32_t i = 0; i < arena_internal->group_count && delta_count > 0; i++)
+    {
+        if (_mg_group_has_indexes(&_mg_arena_groups(arena_internal)[i]))
+        {
+            _mg_group_rebuild_indexes(arena_internal, &_mg_arena_groups(arena_internal)[i]);
+        }
+    }
+    _mg_snapshot_clear_dirty(arena_internal);
+
+    return arena;
+}
+
+MgStatus mg_arena_verify(const char* path)
+{
+    _MG_STATUS(path, MG_ERROR_DATA_INVALID);
+
+    size_t file_size = 0;
+    uint8_t* file    = (uint8_t*)_mg_file_map(path, &file_size);
+    _MG_STATUS(file, MG_ERROR_SNAPSHOT_IO_FAILED);
+
+    const _MgSnapshotHeader* header = (const _MgSnapshotHeader*)file;
+
+    bool valid = _mg_snapshot_header_valid(header, file_size);
+    valid = valid && (_mg_checksum(file + _MG_SNAPSHOT_HEADER_SIZE, header->block_size) == header->checksum);
+
+    _mg_file_unmap(file, file_size);
+
+    _MG_STATUS(valid, MG_ERROR_SNAPSHOT_INVALID);
+
+    return MG_SUCCESS;
+}
+
+MgStatus mg_arena_snapshot(MgArena* arena)
+{
+    _MG_STATUS(arena, MG_ERROR_ARENA_INVALID);
+    _MgArena* arena_internal = (_MgArena*)arena;
+    _MG_STATUS(arena_internal->alloc_kind == _MG_ARENA_ALLOC_VIEW, MG_ERROR_ARENA_NOT_COW);
+
+    _MgMemFile backing = arena_internal->backing; // lives in the view that gets mapped again
+    bool committed     = _mg_memfile_commit(&backing, arena_internal, arena_internal->alloc_size);
+    _MG_STATUS(committed, MG_ERROR_SNAPSHOT_IO_FAILED);
+
+    return MG_SUCCESS;
+}
+
+MgStatus mg_arena_rollback(MgArena* arena)
+{
+    _MG_STATUS(arena, MG_ERROR_ARENA_INVALID);
+    _MgArena* arena_internal = (_MgArena*)arena;
+    _MG_STATUS(arena_internal->alloc_kind == _MG_ARENA_ALLOC_VIEW, MG_ERROR_ARENA_NOT_COW);
+    _MG_STATUS(!arena_internal->log && !arena_internal->publisher, MG_ERROR_ARENA_LOGGED);
+
+    // thread attachments belong to the running threads, not to the contents, so they survive the rollback
+    uint32_t shard_count = 0;
+    for (uint32_t i = 0; i < arena_internal->group_count; i++)
+    {
+        shard_count += _mg_arena_groups(arena_internal)[i].shard_count;
+    }
+
+    uint32_t* owners = (uint32_t*)malloc(sizeof(uint32_t) * shard_count);
+    _MG_STATUS(owners, MG_ERROR_ARENA_ALLOC_FAILED);
+    _mg_snapshot_owners(arena_internal, owners, false);
+
+    _MgMemFile backing = arena_internal->backing;
+    size_t alloc_size  = arena_internal->alloc_size;
+    bool reverted      = _mg_memfile_revert(&backing, arena_internal, alloc_size);
+    if (reverted)
+    {
+        _mg_snapshot_owners(arena_internal, owners, true);
+        if (arena_internal->log)
+        {
+            arena_internal->log = NULL; // the snapshot was taken while a log that is closed by now was open
+        }
+        if (arena_internal->publisher)
+        {
+            arena_internal->publisher = NULL;
+        }
+    }
+
+    free(owners);
+    _MG_STATUS(reverted, MG_ERROR_SNAPSHOT_IO_FAILED);
+
+    return MG_SUCCESS;
+}
+
+void _mg_snapshot_unmap(_MgArena* arena_internal)
+{
+    uint8_t* file = (uint8_t*)arena_internal - _MG_SNAPSHOT_HEADER_SIZE;
+    _mg_file_unmap(file, arena_internal->alloc_size + _MG_SNAPSHOT_HEADER_SIZE);
+}
+
+static void _mg_snapshot_header_init(_MgSnapshotHeader* header, size_t block_size)
+{
+    header->magic       = _MG_SNAPSHOT_MAGIC;
+    header->version     = _MG_SNAPSHOT_VERSION;
+    header->header_size = _MG_SNAPSHOT_HEADER_SIZE;
+    header->block_size  = block_size;
+    header->layout[0]   = sizeof(_MgArena);
+    header->layout[1]   = sizeof(_MgGroup);
+    header->layout[2]   = sizeof(_MgShard);
+    header->layout[3]   = sizeof(_MgSlot);
+}
+
+static bool _mg_snapshot_header_valid(const _MgSnapshotHeader* header, size_t file_size)
+{
+    _MgSnapshotHeader expected;
+    _mg_snapshot_header_init(&expected, file_size - _MG_SNAPSHOT_HEADER_SIZE);
+
+    bool valid = (file_size > _MG_SNAPSHOT_HEADER_SIZE);
+    valid &= (header->magic == expected.magic);
+    valid &= (header->version == expected.version);
+    valid &= (header->header_size == expected.header_size);
+    valid &= (header->block_size == expected.block_size); // catches truncated files
+    valid &= (memcmp(header->layout, expected.layout, sizeof(expected.layout)) == 0);
+
+    return valid;
+}
+
+uint64_t _mg_checksum(const void* data, size_t size)
+{
+    // four independent multiply-rotate lanes over 64 bit words, fast enough to run at memory bandwidth
+    const uint64_t prime_a = 0x9e3779b185ebca87ull;
+    const uint64_t prime_b = 0xc2b2ae3d27d4eb4full;
+
+    uint64_t lanes[4] = { prime_a, prime_b, ~prime_a, ~prime_b };
+    const uint8_t* bytes = (const uint8_t*)data;
+
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32)
+    {
+        for (int lane = 0; lane < 4; lane++)
+        {
+            uint64_t word;
+            memcpy(&word, bytes + i + lane * 8, sizeof(word));
+            lanes[lane] += word * prime_b;
+            lanes[lane] = (lanes[lane] << 31) | (lanes[lane] >> 33);
+            lanes[lane] *= prime_a;
+        }
+    }
+
+    uint64_t hash = size;
+    for (int lane = 0; lane < 4; lane++)
+    {
+        hash = (hash ^ lanes[lane]) * prime_a;
+    }
+
+    for (; i < size; i++) // tail
+    {
+        hash = (hash ^ bytes[i]) * prime_b;
+    }
+
+    return hash ^ (hash >> 29);
+}
+
+static void _mg_snapshot_clear_dirty(_MgArena* arena_internal)
+{
+    // only words that are set, so clean pages of a mapped arena stay shared with the file
+    for (uint32_t i = 0; i < arena_internal->group_count; i++)
+    {
+        _MgGroup* group = &_mg_arena_groups(arena_internal)[i];
+        uint64_t* dirty = _mg_group_dirty(group);
+        for (uint32_t j = 0; j < _mg_group_dirty_words(group); j++)
+        {
+            if (dirty[j] != 0)
+            {
+                dirty[j] = 0;
+            }
+        }
+    }
+}
+
+static void _mg_snapshot_owners(_MgArena* arena_internal, uint32_t* owners, bool restore)
+{
+    // only written where the value differs, so pages of the view are not duplicated for nothing
+    for (uint32_t i = 0; i < arena_internal->group_count; i++)
+    {
+        _MgGroup* group = &_mg_arena_groups(arena_internal)[i];
+        for (uint32_t j = 0; j < group->shard_count; j++, owners++)
+        {
+            _MgShard* shard = &_mg_group_shards(group)[j];
+            if (!restore)
+            {
+                *owners = shard->owner;
+            }
+            else if (shard->owner != *owners)
+            {
+                shard->owner = *owners;
+            }
+        }
+    }
+}
+
+static size_t _mg_delta_payload_size(_MgArena* arena_internal)
+{
+    size_t size = 0;
+    for (uint32_t i = 0; i < arena_internal->group_count; i++)
+    {
+        _MgGroup* group = &_mg_arena_groups(arena_internal)[i];
+        uint64_t* dirty = _mg_group_dirty(group);
+
+        size_t slot_count = 0;
+        for (uint32_t j = 0; j < _mg_group_dirty_words(group); j++)
+        {
+            for (uint64_t word = dirty[j]; word != 0; word &= word - 1)
+            {
+                slot_count++;
+            }
+        }
+
+        if (slot_count > 0)
+        {
+            size += sizeof(_MgDeltaGroup) + group->shard_count * sizeof(_MgShard);
+            size += slot_count * (sizeof(_MgDeltaSlot) + group->handle_stride);
+        }
+    }
+    return size;
+}
+
+static void _mg_delta_payload_write(_MgArena* arena_internal, uint8_t* payload)
+{
+    for (uint32_t i = 0; i < arena_internal->group_count; i++)
+    {
+        _MgGroup* group = &_mg_arena_groups(arena_internal)[i];
+        uint64_t* dirty = _mg_group_dirty(group);
+
+        _MgDeltaGroup record = { i, 0 };
+        uint8_t* record_at   = payload;
+
+        for (uint32_t j = 0; j < _mg_group_dirty_words(group); j++)
+        {
+            for (uint64_t word = dirty[j]; word != 0; word &= word - 1)
+            {
+                if (record.slot_count++ == 0)
+                {
+                    // first touched slot of the group, free list heads live in the shards
+                    payload += sizeof(_MgDeltaGroup);
+                    memcpy(payload, _mg_group_shards(group), group->shard_count * sizeof(_MgShard));
+                    payload += group->shard_count * sizeof(_MgShard);
+                }
+
+                _MgDeltaSlot slot_record;
+                slot_record.slot_index = j * 64 + _mg_ctz_u64(word);
+                slot_record.slot       = _mg_group_slots(group)[slot_record.slot_index];
+                memcpy(payload, &slot_record, sizeof(slot_record));
+                payload += sizeof(slot_record);
+
+                _mg_group_load(group, slot_record.slot_index, payload);
+                payload += group->handle_stride;
+            }
+        }
+
+        if (record.slot_count > 0)
+        {
+            memcpy(record_at, &record, sizeof(record));
+        }
+    }
+}
+
+static bool _mg_delta_apply(_MgArena* arena_internal, const char* path, uint32_t sequence)
+{
+    size_t file_size = 0;
+    uint8_t* file    = (uint8_t*)_mg_file_map(path, &file_size);
+    if (!file)
+    {
+        return false;
+    }
+
+    _MgDeltaHeader header;
+    memcpy(&header, file, file_size < sizeof(header) ? file_size : sizeof(header));
+
+    bool valid = (file_size >= sizeof(header));
+    valid      = valid && (header.magic == _MG_DELTA_MAGIC) && (header.version == _MG_SNAPSHOT_VERSION);
+    valid      = valid && (header.sequence == sequence) && (header.base_checksum == arena_internal->checkpoint_base);
+    valid      = valid && (header.layout[0] == sizeof(_MgArena)) && (header.layout[1] == sizeof(_MgGroup));
+    valid      = valid && (header.layout[2] == sizeof(_MgShard)) && (header.layout[3] == sizeof(_MgSlot));
+    valid      = valid && (header.payload_size == file_size - sizeof(header));
+    valid      = valid && (_mg_checksum(file + sizeof(header), header.payload_size) == header.checksum);
+
+    // records are trusted once the checksum matches, bounds are still checked so a bad writer cannot scribble
+    const uint8_t* at  = file + sizeof(header);
+    const uint8_t* end = at + (valid ? header.payload_size : 0);
+    while (valid && at < end)
+    {
+        _MgDeltaGroup record;
+        memcpy(&record, at, sizeof(record));
+        at += sizeof(record);
+
+        valid = (record.group_index < arena_internal->group_count);
+        if (!valid)
+        {
+            break;
+        }
+
+        _MgGroup* group    = &_mg_arena_groups(arena_internal)[record.group_index];
+        size_t shards_size = group->shard_count * sizeof(_MgShard);
+        size_t slot_size   = sizeof(_MgDeltaSlot) + group->handle_stride;
+
+        valid = ((size_t)(end - at) >= shards_size + record.slot_count * slot_size);
+        if (!valid)
+        {
+            break;
+        }
+
+        memcpy(_mg_group_shards(group), at, shards_size);
+        at += shards_size;
+
+        for (uint32_t i = 0; i < record.slot_count && valid; i++)
+        {
+            _MgDeltaSlot slot_record;
+            memcpy(&slot_record, at, sizeof(slot_record));
+
+            valid = (slot_record.slot_index < group->slot_count);
+            if (valid)
+            {
+                _mg_group_slots(group)[slot_record.slot_index] = slot_record.slot;
+                _mg_group_store(group, slot_record.slot_index, at + sizeof(slot_record), group->handle_stride);
+                _mg_group_mark_live(arena_internal, group, slot_record.slot_index,
+                slot_record.slot.status == _MG_SLOT_STATUS_VALID_WRITE);
+            }
+            at += slot_size;
+        }
+    }
+
+    _mg_file_unmap(file, file_size);
+    return valid;
+}
+
+static bool _mg_snapshot_file_write(const char* path, const void* header, size_t header_size, const void* body,
+size_t body_size)
+{
+    // written and synced next to path, then moved over it, so a crash or a full disk leaves the last good file
+    size_t path_size = strlen(path);
+    char* temp_path  = (char*)malloc(path_size + sizeof(".tmp"));
+    if (!temp_path)
+    {
+        return false;
+    }
+    memcpy(temp_path, path, path_size);
+    memcpy(temp_path + path_size, ".tmp", sizeof(".tmp"));
+
+    _MgFile file;
+    bool written = _mg_file_open_append(&file, temp_path, true);
+    if (written)
+    {
+        written = _mg_file_write(&file, header, header_size) && _mg_file_write(&file, body, body_size) &&
+                  _mg_file_sync(&file);
+        _mg_file_close(&file);
+    }
+
+    written = written && _mg_file_replace(temp_path, path);
+    if (!written)
+    {
+        remove(temp_path);
+    }
+    free(temp_path);
+
+    return written;
+}
@@ -37,4 +37,6 @@ workspace "magic_mem"
 
     include "examples/premake5.lua"
 
+    include "benchmarks/premake5.lua"
+
     include "tests/premake5.lua"
\ No newline at end of file
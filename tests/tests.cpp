@@ -1,8 +1,26 @@
 #include <magic_mem.h>
+#include <magic_simd.h> // _mg_simd_force, to run the kernels of every level
 
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 #include <doctest.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <new>
+#include <thread>
+#include <vector>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
 #define HANDLE_LIMIT 32
 
 typedef struct UserString {
@@ -240,3 +258,2398 @@ TEST_SUITE("mg_handle_read")
         CHECK(read_data == NULL);
     }*/
 }
+
+TEST_SUITE("mg_group_lock_stats")
+{
+    static MgArenaDescriptor locked_arena_descriptor = {
+        .arena_name               = "USER_LOCKED_ARENA",
+        .handle_descriptors       = handle_descriptors,
+        .handle_descriptors_count = sizeof(handle_descriptors) / sizeof(MgHandleDescriptor),
+        .sync_mode                = MG_ARENA_SYNC_GROUP_SPIN,
+        .lock_timing              = true,
+    };
+
+    static void churn_group(MgArena * arena, uint32_t handle_type, uint32_t stride, int rounds)
+    {
+        uint64_t payload[100] = { 7 };
+        for (int i = 0; i < rounds; ++i)
+        {
+            MgHandle handle = mg_handle_create(arena, handle_type);
+            mg_handle_write(arena, handle, payload, stride);
+            mg_handle_erase(arena, handle);
+        }
+    }
+
+    TEST_CASE("Different handle types never contend")
+    {
+        MgArena* arena = mg_arena_init(&locked_arena_descriptor);
+        REQUIRE(arena);
+
+        std::thread string_thread(churn_group, arena, USER_HANDLE_TYPE_STRING, (uint32_t)sizeof(UserString), 1000);
+        std::thread array_thread(churn_group, arena, USER_HANDLE_TYPE_ARRAY, (uint32_t)sizeof(UserArray), 1000);
+        string_thread.join();
+        array_thread.join();
+
+        MgLockStats string_stats;
+        REQUIRE(mg_group_lock_stats(arena, USER_HANDLE_TYPE_STRING, &string_stats) == MG_SUCCESS);
+        CHECK(string_stats.acquire_count == 3000);
+        CHECK(string_stats.contended_count == 0);
+        CHECK(string_stats.max_hold_time_ns <= string_stats.hold_time_ns);
+
+        MgLockStats array_stats;
+        REQUIRE(mg_group_lock_stats(arena, USER_HANDLE_TYPE_ARRAY, &array_stats) == MG_SUCCESS);
+        CHECK(array_stats.acquire_count == 3000);
+        CHECK(array_stats.contended_count == 0);
+
+        mg_arena_destroy(&arena);
+    }
+
+    TEST_CASE("Shared handle type stays consistent")
+    {
+        MgArena* arena = mg_arena_init(&locked_arena_descriptor);
+        REQUIRE(arena);
+
+        std::thread first_thread(churn_group, arena, USER_HANDLE_TYPE_STRING, (uint32_t)sizeof(UserString), 1000);
+        std::thread second_thread(churn_group, arena, USER_HANDLE_TYPE_STRING, (uint32_t)sizeof(UserString), 1000);
+        first_thread.join();
+        second_thread.join();
+
+        MgLockStats stats;
+        REQUIRE(mg_group_lock_stats(arena, USER_HANDLE_TYPE_STRING, &stats) == MG_SUCCESS);
+        CHECK(stats.acquire_count == 6000);
+
+        // polling the stats leaves them as they were
+        MgLockStats again;
+        REQUIRE(mg_group_lock_stats(arena, USER_HANDLE_TYPE_STRING, &again) == MG_SUCCESS);
+        CHECK(again.acquire_count == stats.acquire_count);
+        CHECK(again.hold_time_ns == stats.hold_time_ns);
+
+        // every slot went back on the free list, so the whole group is available again
+        for (int i = 0; i < HANDLE_LIMIT; ++i)
+        {
+            CHECK(mg_handle_create(arena, USER_HANDLE_TYPE_STRING).slot_handle != MG_HANDLE_INVALID);
+        }
+
+        mg_arena_destroy(&arena);
+    }
+}
+
+TEST_SUITE("mg_group_parallel_foreach")
+{
+    struct Visits
+    {
+        std::atomic<uint64_t> sum;
+        std::atomic<uint64_t> count;
+    };
+
+    static void count_and_bump(MgHandle handle, void* data, void* ctx)
+    {
+        ((Visits*)ctx)->sum.fetch_add(((uint64_t*)data)[0]);
+        ((Visits*)ctx)->count.fetch_add(1);
+        ((uint64_t*)data)[1] += 1;
+    }
+
+    TEST_CASE("Visits every written handle once")
+    {
+        MgArena* arena = mg_arena_init(&arena_descriptor);
+        REQUIRE(arena);
+
+        MgHandle handles[HANDLE_LIMIT];
+        for (int i = 0; i < HANDLE_LIMIT; ++i)
+        {
+            UserArray array = { (uint64_t)i + 1 };
+            handles[i]      = mg_handle_create(arena, USER_HANDLE_TYPE_ARRAY);
+            REQUIRE(mg_handle_write(arena, handles[i], &array, sizeof(UserArray)) == MG_SUCCESS);
+        }
+
+        // erased handles are not visited, nor is a created but never written one in the slot an erase freed
+        mg_handle_erase(arena, handles[0]);
+        mg_handle_erase(arena, handles[1]);
+        MgHandle unwritten = mg_handle_create(arena, USER_HANDLE_TYPE_ARRAY);
+        REQUIRE(unwritten.slot_handle != MG_HANDLE_INVALID);
+
+        Visits visits = { 0, 0 };
+        REQUIRE(mg_group_parallel_foreach(arena, USER_HANDLE_TYPE_ARRAY, count_and_bump, &visits, 1) == MG_SUCCESS);
+        CHECK(visits.sum.load() == (HANDLE_LIMIT * (HANDLE_LIMIT + 1)) / 2 - 3);
+        CHECK(visits.count.load() == HANDLE_LIMIT - 2);
+
+        for (int i = 2; i < HANDLE_LIMIT; ++i)
+        {
+            CHECK(((const uint64_t*)mg_handle_read(arena, handles[i]))[1] == 1);
+        }
+
+        visits.sum   = 0;
+        visits.count = 0;
+        REQUIRE(mg_group_foreach(arena, USER_HANDLE_TYPE_ARRAY, count_and_bump, &visits) == MG_SUCCESS);
+        CHECK(visits.sum.load() == (HANDLE_LIMIT * (HANDLE_LIMIT + 1)) / 2 - 3);
+        CHECK(visits.count.load() == HANDLE_LIMIT - 2);
+
+        // once written it is visited like the others
+        UserArray array = { 100 };
+        REQUIRE(mg_handle_write(arena, unwritten, &array, sizeof(UserArray)) == MG_SUCCESS);
+        visits.sum   = 0;
+        visits.count = 0;
+        REQUIRE(mg_group_foreach(arena, USER_HANDLE_TYPE_ARRAY, count_and_bump, &visits) == MG_SUCCESS);
+        CHECK(visits.sum.load() == (HANDLE_LIMIT * (HANDLE_LIMIT + 1)) / 2 - 3 + 100);
+        CHECK(visits.count.load() == HANDLE_LIMIT - 1);
+
+        mg_arena_destroy(&arena);
+    }
+}
+
+TEST_SUITE("mg_handle_shard")
+{
+    static MgHandleDescriptor sharded_handle_descriptors[] = {
+        { .type = USER_HANDLE_TYPE_STRING, .count = HANDLE_LIMIT, .stride = sizeof(UserString), .shard_count = 4 },
+    };
+
+    static MgArenaDescriptor sharded_arena_descriptor = {
+        .arena_name               = "USER_SHARDED_ARENA",
+        .handle_descriptors       = sharded_handle_descriptors,
+        .handle_descriptors_count = 1,
+        .sync_mode                = MG_ARENA_SYNC_GROUP_SPIN,
+    };
+
+    TEST_CASE("Creates spill over to other shards")
+    {
+        MgArena* arena = mg_arena_init(&sharded_arena_descriptor);
+        REQUIRE(arena);
+
+        UserString string = { "sharded" };
+        bool shard_used[4] = {};
+
+        MgHandle handles[HANDLE_LIMIT];
+        for (int i = 0; i < HANDLE_LIMIT; ++i)
+        {
+            handles[i] = mg_handle_create(arena, USER_HANDLE_TYPE_STRING);
+            REQUIRE(handles[i].slot_handle != MG_HANDLE_INVALID);
+            REQUIRE(mg_handle_write(arena, handles[i], &string, sizeof(UserString)) == MG_SUCCESS);
+
+            uint32_t shard = mg_handle_shard(arena, handles[i]);
+            REQUIRE(shard < 4);
+            shard_used[shard] = true;
+        }
+
+        // one thread fills its home shard first, then falls over to the rest
+        CHECK((shard_used[0] && shard_used[1] && shard_used[2] && shard_used[3]));
+
+        for (int i = 0; i < HANDLE_LIMIT; ++i)
+        {
+            CHECK(strcmp(((const UserString*)mg_handle_read(arena, handles[i]))->data, "sharded") == 0);
+        }
+
+        // an erased slot goes back to its own shard and is handed out again from there
+        uint32_t erased_shard = mg_handle_shard(arena, handles[5]);
+        mg_handle_erase(arena, handles[5]);
+
+        MgHandle recreated = mg_handle_create(arena, USER_HANDLE_TYPE_STRING);
+        REQUIRE(recreated.slot_handle != MG_HANDLE_INVALID);
+        CHECK(mg_handle_shard(arena, recreated) == erased_shard);
+        CHECK(!mg_handle_valid(arena, handles[5]));
+
+        mg_arena_destroy(&arena);
+    }
+}
+
+TEST_SUITE("mg_numa_policy")
+{
+    TEST_CASE("Placed groups behave like default groups")
+    {
+        static MgHandleDescriptor placed_handle_descriptors[] = {
+            { .type = USER_HANDLE_TYPE_STRING, .count = HANDLE_LIMIT, .stride = sizeof(UserString) },
+            { .type        = USER_HANDLE_TYPE_ARRAY,
+              .count       = HANDLE_LIMIT,
+              .stride      = sizeof(UserArray),
+              .shard_count = 2,
+              .numa_policy = MG_NUMA_POLICY_SHARDS },
+        };
+
+        MgArenaDescriptor placed_arena_descriptor = {
+            .arena_name               = "USER_PLACED_ARENA",
+            .handle_descriptors       = placed_handle_descriptors,
+            .handle_descriptors_count = 2,
+        };
+
+        CHECK(mg_numa_node_count() >= 1);
+        CHECK(mg_numa_node_current() < mg_numa_node_count());
+
+        MgArena* arena = mg_arena_init(&placed_arena_descriptor);
+        REQUIRE(arena);
+
+        UserArray array = { 7, 9 };
+        MgHandle handle = mg_handle_create(arena, USER_HANDLE_TYPE_ARRAY);
+        REQUIRE(handle.slot_handle != MG_HANDLE_INVALID);
+        REQUIRE(mg_handle_write(arena, handle, &array, sizeof(UserArray)) == MG_SUCCESS);
+
+        const uint64_t* read = (const uint64_t*)mg_handle_read(arena, handle);
+        REQUIRE(read);
+        CHECK((read[0] == 7 && read[1] == 9));
+
+        mg_arena_destroy(&arena);
+        CHECK(arena == NULL);
+    }
+
+    TEST_CASE("Binding to a missing node fails")
+    {
+        static MgHandleDescriptor bound_handle_descriptors[] = {
+            { .type        = USER_HANDLE_TYPE_STRING,
+              .count       = HANDLE_LIMIT,
+              .stride      = sizeof(UserString),
+              .numa_policy = MG_NUMA_POLICY_BIND,
+              .numa_node   = 1024 },
+        };
+
+        MgArenaDescriptor bound_arena_descriptor = {
+            .arena_name               = "USER_BOUND_ARENA",
+            .handle_descriptors       = bound_handle_descriptors,
+            .handle_descriptors_count = 1,
+        };
+
+        CHECK(mg_arena_init(&bound_arena_descriptor) == NULL);
+    }
+}
+
+TEST_SUITE("mg_arena_thread_attach")
+{
+    static MgHandleDescriptor owned_handle_descriptors[] = {
+        { .type = USER_HANDLE_TYPE_STRING, .count = HANDLE_LIMIT, .stride = sizeof(UserString), .shard_count = 2 },
+    };
+
+    static MgArenaDescriptor owned_arena_descriptor = {
+        .arena_name               = "USER_OWNED_ARENA",
+        .handle_descriptors       = owned_handle_descriptors,
+        .handle_descriptors_count = 1,
+        .sync_mode                = MG_ARENA_SYNC_THREAD_OWNED,
+    };
+
+    TEST_CASE("Remote erases return slots to the owner")
+    {
+        MgArena* arena = mg_arena_init(&owned_arena_descriptor);
+        REQUIRE(arena);
+
+        UserString string = { "owned" };
+        std::vector<MgHandle> handles;
+
+        // producer fills its own shard
+        std::thread producer([&]() {
+            REQUIRE(mg_arena_thread_attach(arena) == MG_SUCCESS);
+            for (;;)
+            {
+                MgHandle handle = mg_handle_create(arena, USER_HANDLE_TYPE_STRING);
+                if (handle.slot_handle == MG_HANDLE_INVALID)
+                {
+                    break;
+                }
+                REQUIRE(mg_handle_write(arena, handle, &string, sizeof(UserString)) == MG_SUCCESS);
+                handles.push_back(handle);
+            }
+            REQUIRE(mg_arena_thread_detach(arena) == MG_SUCCESS);
+        });
+        producer.join();
+        REQUIRE(!handles.empty());
+
+        // consumer is not the owner, its erases go through the remote free queue
+        std::thread consumer([&]() {
+            for (MgHandle handle : handles)
+            {
+                mg_handle_erase(arena, handle);
+            }
+        });
+        consumer.join();
+
+        for (MgHandle handle : handles)
+        {
+            CHECK(!mg_handle_valid(arena, handle));
+        }
+
+        // the next owner drains the queue and gets every slot back
+        size_t recreated = 0;
+        std::thread owner([&]() {
+            REQUIRE(mg_arena_thread_attach(arena) == MG_SUCCESS);
+            while (mg_handle_create(arena, USER_HANDLE_TYPE_STRING).slot_handle != MG_HANDLE_INVALID)
+            {
+                recreated++;
+            }
+        });
+        owner.join();
+        CHECK(recreated == handles.size());
+
+        mg_arena_destroy(&arena);
+    }
+
+    TEST_CASE("Attaching fails once every shard is owned")
+    {
+        MgArena* arena = mg_arena_init(&owned_arena_descriptor);
+        REQUIRE(arena);
+
+        MgStatus first = MG_SUCCESS, second = MG_SUCCESS, third = MG_SUCCESS;
+        std::thread a([&]() { first = mg_arena_thread_attach(arena); });
+        a.join();
+        std::thread b([&]() { second = mg_arena_thread_attach(arena); });
+        b.join();
+        std::thread c([&]() { third = mg_arena_thread_attach(arena); });
+        c.join();
+
+        CHECK(first == MG_SUCCESS);
+        CHECK(second == MG_SUCCESS);
+        CHECK(third == MG_ERROR_THREAD_ATTACH_FAILED);
+
+        mg_arena_destroy(&arena);
+    }
+}
+
+TEST_SUITE("mg_arena_size")
+{
+    TEST_CASE("A copied block is a working arena")
+    {
+        MgArena* arena = mg_arena_init(&arena_descriptor);
+        REQUIRE(arena);
+
+        UserString string = { "relocated" };
+        MgHandle handle   = mg_handle_create(arena, USER_HANDLE_TYPE_STRING);
+        REQUIRE(mg_handle_write(arena, handle, &string, sizeof(UserString)) == MG_SUCCESS);
+
+        size_t size = mg_arena_size(arena);
+        void* block = ::operator new(size, std::align_val_t(64));
+        memcpy(block, (void*)arena, size);
+        mg_arena_destroy(&arena);
+
+        MgArena* copy = (MgArena*)block;
+        CHECK(mg_handle_valid(copy, handle));
+        CHECK(strcmp(((const UserString*)mg_handle_read(copy, handle))->data, "relocated") == 0);
+
+        MgHandle created = mg_handle_create(copy, USER_HANDLE_TYPE_STRING);
+        CHECK(created.slot_handle != MG_HANDLE_INVALID);
+        CHECK(created.slot_handle != handle.slot_handle);
+
+        ::operator delete(block, std::align_val_t(64));
+    }
+}
+
+TEST_SUITE("mg_arena_clone")
+{
+    TEST_CASE("Cloned handles are valid and independent of the source")
+    {
+        MgArena* arena = mg_arena_init(&arena_descriptor);
+        REQUIRE(arena);
+
+        UserString string = { "cloned" };
+        MgHandle handles[8];
+        for (int i = 0; i < 8; ++i)
+        {
+            handles[i] = mg_handle_create(arena, USER_HANDLE_TYPE_STRING);
+            REQUIRE(mg_handle_write(arena, handles[i], &string, sizeof(UserString)) == MG_SUCCESS);
+        }
+        mg_handle_erase(arena, handles[3]);
+
+        MgArena* clone = mg_arena_clone(arena);
+        REQUIRE(clone);
+        CHECK(mg_arena_size(clone) == mg_arena_size(arena));
+
+        for (int i = 0; i < 8; ++i)
+        {
+            CHECK(mg_handle_valid(clone, handles[i]) == (i != 3));
+        }
+        CHECK(strcmp(((const UserString*)mg_handle_read(clone, handles[0]))->data, "cloned") == 0);
+
+        // erasing in one arena leaves the other untouched
+        mg_handle_erase(clone, handles[0]);
+        CHECK(!mg_handle_valid(clone, handles[0]));
+        CHECK(mg_handle_valid(arena, handles[0]));
+
+        mg_arena_destroy(&arena);
+        CHECK(strcmp(((const UserString*)mg_handle_read(clone, handles[1]))->data, "cloned") == 0);
+        mg_arena_destroy(&clone);
+    }
+
+    TEST_CASE("Placed groups are cloned")
+    {
+        static MgHandleDescriptor placed_handle_descriptors[] = {
+            { .type = USER_HANDLE_TYPE_STRING, .count = HANDLE_LIMIT, .stride = sizeof(UserString) },
+            { .type        = USER_HANDLE_TYPE_ARRAY,
+              .count       = HANDLE_LIMIT,
+              .stride      = sizeof(UserArray),
+              .numa_policy = MG_NUMA_POLICY_INTERLEAVE },
+        };
+
+        MgArenaDescriptor placed_arena_descriptor = {
+            .arena_name               = "USER_PLACED_ARENA",
+            .handle_descriptors       = placed_handle_descriptors,
+            .handle_descriptors_count = 2,
+        };
+
+        MgArena* arena = mg_arena_init(&placed_arena_descriptor);
+        REQUIRE(arena);
+
+        UserArray array = { 7, 9 };
+        MgHandle handle = mg_handle_create(arena, USER_HANDLE_TYPE_ARRAY);
+        REQUIRE(mg_handle_write(arena, handle, &array, sizeof(UserArray)) == MG_SUCCESS);
+
+        MgArena* clone = mg_arena_clone(arena);
+        mg_arena_destroy(&arena);
+        REQUIRE(clone);
+
+        const uint64_t* read = (const uint64_t*)mg_handle_read(clone, handle);
+        REQUIRE(read);
+        CHECK((read[0] == 7 && read[1] == 9));
+        mg_arena_destroy(&clone);
+    }
+}
+
+// names are global to the machine, so every run and every case gets its own and none is left from a crashed run
+static void shared_test_name(char* name, size_t name_size)
+{
+    static int counter = 0;
+#if defined(_WIN32)
+    snprintf(name, name_size, "magic_mem_tests_shared_%lu_%d", GetCurrentProcessId(), counter++);
+#else
+    snprintf(name, name_size, "/magic_mem_tests_shared_%d_%d", (int)getpid(), counter++);
+    shm_unlink(name);
+#endif
+}
+
+TEST_SUITE("mg_arena_create_shared")
+{
+    TEST_CASE("Consumers read the producer's handles in place")
+    {
+        char name[64];
+        shared_test_name(name, sizeof(name));
+
+        MgArena* producer = mg_arena_create_shared(name, &arena_descriptor);
+        REQUIRE(producer);
+
+        UserString string = { "shared" };
+        MgHandle handle   = mg_handle_create(producer, USER_HANDLE_TYPE_STRING);
+        REQUIRE(mg_handle_write(producer, handle, &string, sizeof(UserString)) == MG_SUCCESS);
+
+        // a second mapping of the same memory stands in for another process, the handle travels as two integers
+        MgArena* consumer = mg_arena_open_shared(name, true);
+        REQUIRE(consumer);
+        CHECK(consumer != producer);
+
+        MgHandle received = { handle.slot_handle, handle.type };
+        CHECK(mg_handle_valid(consumer, received));
+        CHECK(strcmp(((const UserString*)mg_handle_read(consumer, received))->data, "shared") == 0);
+
+        // later writes show up without any copy
+        MgHandle created = mg_handle_create(producer, USER_HANDLE_TYPE_STRING);
+        REQUIRE(mg_handle_write(producer, created, &string, sizeof(UserString)) == MG_SUCCESS);
+        CHECK(mg_handle_valid(consumer, created));
+
+        mg_handle_erase(producer, handle);
+        CHECK(!mg_handle_valid(consumer, handle));
+
+        mg_arena_destroy(&producer);
+        CHECK(mg_arena_open_shared(name, true) == NULL);
+
+        // the consumer's mapping outlives the name
+        CHECK(mg_handle_valid(consumer, created));
+        mg_arena_destroy(&consumer);
+    }
+
+    TEST_CASE("Shared arenas turn down groups their readers could not follow without a lock")
+    {
+        static MgHandleDescriptor unshared_handle_descriptors[] = {
+            { .type = USER_HANDLE_TYPE_STRING, .count = HANDLE_LIMIT, .stride = sizeof(UserString), .variable = true },
+            { .type = USER_HANDLE_TYPE_STRING, .count = HANDLE_LIMIT, .stride = sizeof(UserString), .indexed = true },
+            { .type       = USER_HANDLE_TYPE_STRING,
+              .count      = HANDLE_LIMIT,
+              .stride     = sizeof(UserString),
+              .order_type = MG_FIELD_U32 },
+        };
+
+        for (MgHandleDescriptor& handle_descriptor : unshared_handle_descriptors)
+        {
+            MgArenaDescriptor unshared_arena_descriptor = {
+                .arena_name               = "USER_UNSHARED_ARENA",
+                .handle_descriptors       = &handle_descriptor,
+                .handle_descriptors_count = 1,
+            };
+
+            char name[64];
+            shared_test_name(name, sizeof(name));
+
+            CHECK(mg_arena_create_shared(name, &unshared_arena_descriptor) == NULL);
+            CHECK(mg_arena_open_shared(name, true) == NULL);
+        }
+    }
+}
+
+TEST_SUITE("mg_arena_load_mapped")
+{
+    TEST_CASE("Saved handles are valid after loading")
+    {
+        MgArena* arena = mg_arena_init(&arena_descriptor);
+        REQUIRE(arena);
+
+        UserString string = { "persisted" };
+        MgHandle handles[8];
+        for (int i = 0; i < 8; ++i)
+        {
+            handles[i] = mg_handle_create(arena, USER_HANDLE_TYPE_STRING);
+            REQUIRE(mg_handle_write(arena, handles[i], &string, sizeof(UserString)) == MG_SUCCESS);
+        }
+        mg_handle_erase(arena, handles[3]);
+
+        REQUIRE(mg_arena_save(arena, "tests_snapshot.mgs") == MG_SUCCESS);
+        mg_arena_destroy(&arena);
+
+        CHECK(mg_arena_verify("tests_snapshot.mgs") == MG_SUCCESS);
+
+        MgArena* loaded = mg_arena_load_mapped("tests_snapshot.mgs");
+        REQUIRE(loaded);
+
+        for (int i = 0; i < 8; ++i)
+        {
+            CHECK(mg_handle_valid(loaded, handles[i]) == (i != 3));
+        }
+        CHECK(strcmp(((const UserString*)mg_handle_read(loaded, handles[0]))->data, "persisted") == 0);
+
+        // the mapping is private, new handles do not change the file
+        MgHandle created = mg_handle_create(loaded, USER_HANDLE_TYPE_STRING);
+        CHECK(created.slot_handle != MG_HANDLE_INVALID);
+        mg_arena_destroy(&loaded);
+        CHECK(mg_arena_verify("tests_snapshot.mgs") == MG_SUCCESS);
+
+        remove("tests_snapshot.mgs");
+    }
+
+    TEST_CASE("Corrupted snapshots are rejected")
+    {
+        MgArena* arena = mg_arena_init(&arena_descriptor);
+        REQUIRE(arena);
+        REQUIRE(mg_arena_save(arena, "tests_corrupt.mgs") == MG_SUCCESS);
+        mg_arena_destroy(&arena);
+
+        FILE* file = fopen("tests_corrupt.mgs", "r+b");
+        REQUIRE(file);
+        fseek(file, -1, SEEK_END);
+        fputc(0x5a, file);
+        fclose(file);
+
+        CHECK(mg_arena_verify("tests_corrupt.mgs") == MG_ERROR_SNAPSHOT_INVALID);
+        CHECK(mg_arena_load_mapped("missing_snapshot.mgs") == NULL);
+
+        remove("tests_corrupt.mgs");
+    }
+
+    TEST_CASE("A failed save keeps the last good snapshot")
+    {
+        MgArena* arena = mg_arena_init(&arena_descriptor);
+        REQUIRE(arena);
+
+        UserString string = { "kept" };
+        MgHandle handle   = mg_handle_create(arena, USER_HANDLE_TYPE_STRING);
+        REQUIRE(mg_handle_write(arena, handle, &string, sizeof(UserString)) == MG_SUCCESS);
+        REQUIRE(mg_arena_save(arena, "tests_kept.mgs") == MG_SUCCESS);
+        CHECK(!std::filesystem::exists("tests_kept.mgs.tmp"));
+
+        // a directory where the temporary file goes makes the next save fail before it touches the snapshot
+        std::filesystem::create_directory("tests_kept.mgs.tmp");
+        mg_handle_erase(arena, handle);
+        CHECK(mg_arena_save(arena, "tests_kept.mgs") == MG_ERROR_SNAPSHOT_IO_FAILED);
+        std::filesystem::remove("tests_kept.mgs.tmp");
+        mg_arena_destroy(&arena);
+
+        CHECK(mg_arena_verify("tests_kept.mgs") == MG_SUCCESS);
+        MgArena* loaded = mg_arena_load_mapped("tests_kept.mgs");
+        REQUIRE(loaded);
+        CHECK(mg_handle_valid(loaded, handle));
+        mg_arena_destroy(&loaded);
+
+        remove("tests_kept.mgs");
+    }
+}
+
+TEST_SUITE("mg_arena_snapshot")
+{
+    TEST_CASE("Rolling back restores the last snapshot")
+    {
+        MgArenaDescriptor cow_arena_descriptor = arena_descriptor;
+        cow_arena_descriptor.copy_on_write     = true;
+
+        MgArena* arena = mg_arena_init(&cow_arena_descriptor);
+        REQUIRE(arena);
+
+        UserString string = { "kept" };
+        MgHandle kept     = mg_handle_create(arena, USER_HANDLE_TYPE_STRING);
+        REQUIRE(mg_handle_write(arena, kept, &string, sizeof(UserString)) == MG_SUCCESS);
+        REQUIRE(mg_arena_snapshot(arena) == MG_SUCCESS);
+
+        UserString undone = { "undone" };
+        MgHandle created  = mg_handle_create(arena, USER_HANDLE_TYPE_STRING);
+        REQUIRE(mg_handle_write(arena, created, &undone, sizeof(UserString)) == MG_SUCCESS);
+        mg_handle_erase(arena, kept);
+        CHECK(!mg_handle_valid(arena, kept));
+
+        REQUIRE(mg_arena_rollback(arena) == MG_SUCCESS);
+        CHECK(mg_handle_valid(arena, kept));
+        CHECK(!mg_handle_valid(arena, created));
+        CHECK(strcmp(((const UserString*)mg_handle_read(arena, kept))->data, "kept") == 0);
+
+        // the rolled back arena keeps working and the same slot comes back out
+        MgHandle again = mg_handle_create(arena, USER_HANDLE_TYPE_STRING);
+        CHECK(again.slot_handle == created.slot_handle);
+
+        mg_arena_destroy(&arena);
+    }
+
+    TEST_CASE("Arenas without copy on write have no snapshots")
+    {
+        MgArena* arena = mg_arena_init(&arena_descriptor);
+        REQUIRE(arena);
+
+        CHECK(mg_arena_snapshot(arena) == MG_ERROR_ARENA_NOT_COW);
+        CHECK(mg_arena_rollback(arena) == MG_ERROR_ARENA_NOT_COW);
+
+        mg_arena_destroy(&arena);
+    }
+}
+
+TEST_SUITE("mg_arena_save_delta")
+{
+    static MgArenaDescriptor tracked_arena_descriptor = {
+        .arena_name               = "USER_TRACKED_ARENA",
+        .handle_descriptors       = handle_descriptors,
+        .handle_descriptors_count = sizeof(handle_descriptors) / sizeof(MgHandleDescriptor),
+        .track_dirty              = true,
+    };
+
+    TEST_CASE("A snapshot plus deltas restores the latest state")
+    {
+        MgArena* arena = mg_arena_init(&tracked_arena_descriptor);
+        REQUIRE(arena);
+
+        UserString first = { "first" }, second = { "second" };
+        MgHandle kept    = mg_handle_create(arena, USER_HANDLE_TYPE_STRING);
+        MgHandle erased  = mg_handle_create(arena, USER_HANDLE_TYPE_STRING);
+        REQUIRE(mg_handle_write(arena, kept, &first, sizeof(UserString)) == MG_SUCCESS);
+        REQUIRE(mg_handle_write(arena, erased, &first, sizeof(UserString)) == MG_SUCCESS);
+        REQUIRE(mg_arena_save(arena, "tests_base.mgs") == MG_SUCCESS);
+
+        // delta 1: one erase, delta 2: one create
+        mg_handle_erase(arena, erased);
+        REQUIRE(mg_arena_save_delta(arena, "tests_delta_1.mgd") == MG_SUCCESS);
+
+        MgHandle added = mg_handle_create(arena, USER_HANDLE_TYPE_STRING);
+        REQUIRE(mg_handle_write(arena, added, &second, sizeof(UserString)) == MG_SUCCESS);
+        REQUIRE(mg_arena_save_delta(arena, "tests_delta_2.mgd") == MG_SUCCESS);
+        mg_arena_destroy(&arena);
+
+        const char* deltas[] = { "tests_delta_1.mgd", "tests_delta_2.mgd" };
+        MgArena* loaded      = mg_arena_load_chain("tests_base.mgs", deltas, 2);
+        REQUIRE(loaded);
+
+        CHECK(mg_handle_valid(loaded, kept));
+        CHECK(!mg_handle_valid(loaded, erased));
+        CHECK(mg_handle_valid(loaded, added));
+        CHECK(strcmp(((const UserString*)mg_handle_read(loaded, added))->data, "second") == 0);
+
+        // the free lists came along, the next create does not hand out a live slot
+        MgHandle next = mg_handle_create(loaded, USER_HANDLE_TYPE_STRING);
+        CHECK(next.slot_handle != kept.slot_handle);
+        CHECK(next.slot_handle != added.slot_handle);
+        mg_arena_destroy(&loaded);
+
+        // out of order deltas do not chain
+        const char* reversed[] = { "tests_delta_2.mgd", "tests_delta_1.mgd" };
+        CHECK(mg_arena_load_chain("tests_base.mgs", reversed, 2) == NULL);
+
+        remove("tests_base.mgs");
+        remove("tests_delta_1.mgd");
+        remove("tests_delta_2.mgd");
+    }
+}
+
+TEST_SUITE("mg_arena_replay")
+{
+    TEST_CASE("Replay restores handles with their generations")
+    {
+        MgArena* arena = mg_arena_init(&arena_descriptor);
+        REQUIRE(arena);
+
+        MgLogDescriptor log_descriptor = { .path = "tests_ops.mgl", .truncate = true, .sync_commit = true };
+        REQUIRE(mg_arena_log_open(arena, &log_descriptor) == MG_SUCCESS);
+
+        UserString string = { "logged" };
+        MgHandle erased   = mg_handle_create(arena, USER_HANDLE_TYPE_STRING);
+        REQUIRE(mg_handle_write(arena, erased, &string, sizeof(UserString)) == MG_SUCCESS);
+        mg_handle_erase(arena, erased);
+
+        // reuses the erased slot one generation later
+        MgHandle kept = mg_handle_create(arena, USER_HANDLE_TYPE_STRING);
+        REQUIRE(mg_handle_write(arena, kept, &string, sizeof(UserString)) == MG_SUCCESS);
+        MgHandle pending = mg_handle_create(arena, USER_HANDLE_TYPE_STRING); // created, never written
+
+        REQUIRE(mg_arena_log_flush(arena) == MG_SUCCESS);
+        mg_arena_destroy(&arena);
+
+        // a crash mid-record leaves a torn tail, replay stops in front of it
+        FILE* file = fopen("tests_ops.mgl", "ab");
+        REQUIRE(file);
+        fputs("torn", file);
+        fclose(file);
+
+        MgArena* replayed = mg_arena_replay(&arena_descriptor, "tests_ops.mgl");
+        REQUIRE(replayed);
+
+        CHECK(mg_handle_valid(replayed, kept));
+        CHECK(!mg_handle_valid(replayed, erased));
+        CHECK(strcmp(((const UserString*)mg_handle_read(replayed, kept))->data, "logged") == 0);
+        CHECK(mg_handle_write(replayed, pending, &string, sizeof(UserString)) == MG_SUCCESS);
+
+        MgHandle created = mg_handle_create(replayed, USER_HANDLE_TYPE_STRING);
+        CHECK(created.slot_handle != kept.slot_handle);
+        CHECK(created.slot_handle != pending.slot_handle);
+
+        mg_arena_destroy(&replayed);
+        remove("tests_ops.mgl");
+    }
+}
+
+static void collect_diff_entry(const MgDiffEntry* entry, void* ctx)
+{
+    ((std::vector<MgDiffEntry>*)ctx)->push_back(*entry);
+}
+
+TEST_SUITE("mg_arena_diff")
+{
+    TEST_CASE("Patching with a diff reproduces the newer arena")
+    {
+        MgArena* primary = mg_arena_init(&arena_descriptor);
+        REQUIRE(primary);
+
+        UserString string = { "replicated" };
+        MgHandle handles[8];
+        for (int i = 0; i < 8; ++i)
+        {
+            handles[i] = mg_handle_create(primary, USER_HANDLE_TYPE_STRING);
+            REQUIRE(mg_handle_write(primary, handles[i], &string, sizeof(UserString)) == MG_SUCCESS);
+        }
+
+        MgArena* standby = mg_arena_clone(primary);
+        MgArena* base    = mg_arena_clone(primary);
+        REQUIRE((standby && base));
+
+        // one of each: an erase, a create that reuses the erased slot, and a payload changed in place
+        mg_handle_erase(primary, handles[2]);
+        MgHandle reused = mg_handle_create(primary, USER_HANDLE_TYPE_STRING);
+        REQUIRE(mg_handle_write(primary, reused, &string, sizeof(UserString)) == MG_SUCCESS);
+        UserString* changed = (UserString*)mg_handle_read(primary, handles[5]);
+        strcpy(changed->data, "changed");
+
+        std::vector<MgDiffEntry> entries;
+        REQUIRE(mg_arena_diff(base, primary, collect_diff_entry, &entries) == MG_SUCCESS);
+        REQUIRE(entries.size() == 3);
+        CHECK(entries[0].kind == MG_DIFF_ERASED);
+        CHECK(entries[1].kind == MG_DIFF_CREATED);
+        CHECK(entries[2].kind == MG_DIFF_MODIFIED);
+
+        REQUIRE(mg_arena_patch(standby, entries.data(), (uint32_t)entries.size()) == MG_SUCCESS);
+        CHECK(!mg_handle_valid(standby, handles[2]));
+        CHECK(mg_handle_valid(standby, reused));
+        CHECK(strcmp(((const UserString*)mg_handle_read(standby, handles[5]))->data, "changed") == 0);
+
+        std::vector<MgDiffEntry> remaining;
+        REQUIRE(mg_arena_diff(standby, primary, collect_diff_entry, &remaining) == MG_SUCCESS);
+        CHECK(remaining.empty());
+
+        // the standby's free lists were rebuilt, it hands out the same slot the primary would
+        MgHandle next_primary = mg_handle_create(primary, USER_HANDLE_TYPE_STRING);
+        MgHandle next_standby = mg_handle_create(standby, USER_HANDLE_TYPE_STRING);
+        CHECK(next_primary.slot_handle == next_standby.slot_handle);
+
+        mg_arena_destroy(&base);
+        mg_arena_destroy(&standby);
+        mg_arena_destroy(&primary);
+    }
+}
+
+static void open_pipe(intptr_t* read_end, intptr_t* write_end)
+{
+#if defined(_WIN32)
+    HANDLE ends[2] = { NULL, NULL };
+    CreatePipe(&ends[0], &ends[1], NULL, 0);
+#else
+    int ends[2] = { -1, -1 };
+    REQUIRE(pipe(ends) == 0);
+#endif
+    *read_end  = (intptr_t)ends[0];
+    *write_end = (intptr_t)ends[1];
+}
+
+static void close_pipe_end(intptr_t end)
+{
+#if defined(_WIN32)
+    CloseHandle((HANDLE)end);
+#else
+    close((int)end);
+#endif
+}
+
+// what the follower process sends back once the stream ended, the parent checks it
+struct FollowerReport {
+    bool followed;
+    bool closed;
+    bool leader_data; // every live string reads "leader"
+    uint64_t batch_count;
+    uint64_t applied_lsn;
+    uint32_t live_count;
+    uint32_t live[HANDLE_LIMIT];
+    uint32_t next_slot_handle;
+};
+
+static void report_live(MgHandle handle, void* data, void* ctx)
+{
+    FollowerReport* report = (FollowerReport*)ctx;
+    report->leader_data &= (strcmp(((const UserString*)data)->data, "leader") == 0);
+    if (report->live_count < HANDLE_LIMIT)
+    {
+        report->live[report->live_count++] = handle.slot_handle;
+    }
+}
+
+static bool reported_live(const FollowerReport* report, MgHandle handle)
+{
+    return std::find(report->live, report->live + report->live_count, handle.slot_handle) !=
+           report->live + report->live_count;
+}
+
+TEST_SUITE("mg_arena_publish_open")
+{
+#if !defined(_WIN32) // the follower is a forked process, there is no fork on windows
+    TEST_CASE("Followers mirror the leader's handles")
+    {
+        MgArena* leader = mg_arena_init(&arena_descriptor);
+        REQUIRE(leader);
+
+        // handles that exist before the publisher opens reach the follower too
+        UserString string = { "leader" };
+        MgHandle early    = mg_handle_create(leader, USER_HANDLE_TYPE_STRING);
+        REQUIRE(mg_handle_write(leader, early, &string, sizeof(UserString)) == MG_SUCCESS);
+
+        intptr_t read_end    = 0;
+        intptr_t write_end   = 0;
+        intptr_t report_read = 0;
+        intptr_t report_end  = 0;
+        open_pipe(&read_end, &write_end);
+        open_pipe(&report_read, &report_end);
+
+        // forked before the publisher starts its thread, the pipes are all the two processes share
+        pid_t follower = fork();
+        REQUIRE(follower >= 0);
+        if (follower == 0)
+        {
+            close_pipe_end(write_end);
+            close_pipe_end(report_read);
+
+            MgArena* mirror       = mg_arena_init(&arena_descriptor);
+            MgReplicaStats stats  = {};
+            FollowerReport report = {};
+            report.followed       = (mirror != NULL);
+            while (report.followed && !stats.closed)
+            {
+                report.followed = (mg_arena_follow(mirror, read_end, &stats) == MG_SUCCESS);
+            }
+            report.closed      = stats.closed;
+            report.batch_count = stats.batch_count;
+            report.applied_lsn = stats.applied_lsn;
+            report.leader_data = true;
+            if (mirror)
+            {
+                mg_group_foreach(mirror, USER_HANDLE_TYPE_STRING, report_live, &report);
+                // once the stream ended the mirror can take over
+                report.next_slot_handle = mg_handle_create(mirror, USER_HANDLE_TYPE_STRING).slot_handle;
+            }
+
+            bool sent = (write((int)report_end, &report, sizeof(report)) == (ssize_t)sizeof(report));
+            _exit(sent ? 0 : 1);
+        }
+        close_pipe_end(read_end);
+        close_pipe_end(report_end);
+
+        REQUIRE(mg_arena_publish_open(leader, write_end, 1) == MG_SUCCESS);
+
+        MgHandle handles[8];
+        for (int i = 0; i < 8; ++i)
+        {
+            handles[i] = mg_handle_create(leader, USER_HANDLE_TYPE_STRING);
+            REQUIRE(mg_handle_write(leader, handles[i], &string, sizeof(UserString)) == MG_SUCCESS);
+        }
+        mg_handle_erase(leader, handles[3]);
+
+        CHECK(mg_arena_publish_close(leader) == MG_SUCCESS);
+        close_pipe_end(write_end);
+
+        FollowerReport report = {};
+        CHECK(read((int)report_read, &report, sizeof(report)) == (ssize_t)sizeof(report));
+        close_pipe_end(report_read);
+
+        int exit_status = -1;
+        REQUIRE(waitpid(follower, &exit_status, 0) == follower);
+        CHECK((WIFEXITED(exit_status) && WEXITSTATUS(exit_status) == 0));
+
+        CHECK(report.followed);
+        CHECK(report.closed);
+        CHECK(report.batch_count > 0);
+        CHECK(report.applied_lsn > 0);
+        CHECK(report.leader_data);
+
+        CHECK(report.live_count == 8);
+        CHECK(reported_live(&report, early));
+        CHECK(!reported_live(&report, handles[3]));
+        for (int i = 0; i < 8; ++i)
+        {
+            if (i != 3)
+            {
+                CHECK(reported_live(&report, handles[i]));
+            }
+        }
+
+        // and hands out the slot the leader would
+        MgHandle next_leader = mg_handle_create(leader, USER_HANDLE_TYPE_STRING);
+        CHECK(next_leader.slot_handle == report.next_slot_handle);
+
+        mg_arena_destroy(&leader);
+    }
+#endif
+}
+
+static bool copy_file(const char* from, const char* to)
+{
+    FILE* source      = fopen(from, "rb");
+    FILE* destination = fopen(to, "wb");
+    bool copied       = source && destination;
+
+    char buffer[4096];
+    size_t size = 0;
+    while (copied && (size = fread(buffer, 1, sizeof(buffer), source)) > 0)
+    {
+        copied = fwrite(buffer, 1, size, destination) == size;
+    }
+
+    if (source)
+    {
+        fclose(source);
+    }
+    if (destination)
+    {
+        fclose(destination);
+    }
+    return copied;
+}
+
+TEST_SUITE("mg_arena_open_file")
+{
+    TEST_CASE("Handles are valid again after reopening the file")
+    {
+        remove("tests_arena.mgf");
+        MgArena* arena = mg_arena_open_file("tests_arena.mgf", &arena_descriptor);
+        REQUIRE(arena);
+
+        UserString string = { "persistent" };
+        MgHandle handles[8];
+        for (int i = 0; i < 8; ++i)
+        {
+            handles[i] = mg_handle_create(arena, USER_HANDLE_TYPE_STRING);
+            REQUIRE(mg_handle_write(arena, handles[i], &string, sizeof(UserString)) == MG_SUCCESS);
+        }
+        mg_handle_erase(arena, handles[6]);
+        CHECK(mg_arena_sync(arena, false) == MG_SUCCESS);
+        mg_arena_destroy(&arena);
+
+        MgArena* reopened = mg_arena_open_file("tests_arena.mgf", &arena_descriptor);
+        REQUIRE(reopened);
+        CHECK(!mg_handle_valid(reopened, handles[6]));
+        CHECK(strcmp(((const UserString*)mg_handle_read(reopened, handles[7]))->data, "persistent") == 0);
+
+        // the erased handle stays erased when its slot is handed out again
+        MgHandle created = mg_handle_create(reopened, USER_HANDLE_TYPE_STRING);
+        CHECK(created.slot_handle != handles[6].slot_handle);
+        CHECK(!mg_handle_valid(reopened, handles[6]));
+        mg_arena_destroy(&reopened);
+
+        // only arenas with a file behind them can sync
+        MgArena* heap = mg_arena_init(&arena_descriptor);
+        CHECK(mg_arena_sync(heap, true) == MG_ERROR_ARENA_NOT_FILE);
+        mg_arena_destroy(&heap);
+
+        remove("tests_arena.mgf");
+    }
+
+    TEST_CASE("A file left open by a crash is recovered")
+    {
+        remove("tests_arena.mgf");
+        remove("tests_crashed.mgf");
+        MgArena* arena = mg_arena_open_file("tests_arena.mgf", &arena_descriptor);
+        REQUIRE(arena);
+
+        UserString string = { "synced" };
+        MgHandle handles[4];
+        for (int i = 0; i < 4; ++i)
+        {
+            handles[i] = mg_handle_create(arena, USER_HANDLE_TYPE_STRING);
+            REQUIRE(mg_handle_write(arena, handles[i], &string, sizeof(UserString)) == MG_SUCCESS);
+        }
+        mg_handle_erase(arena, handles[1]);
+        REQUIRE(mg_arena_sync(arena, false) == MG_SUCCESS);
+
+        // a copy taken while the arena is still open is what a crash leaves behind
+        REQUIRE(copy_file("tests_arena.mgf", "tests_crashed.mgf"));
+        MgHandle expected = mg_handle_create(arena, USER_HANDLE_TYPE_STRING);
+        mg_arena_destroy(&arena);
+
+        MgArena* recovered = mg_arena_open_file("tests_crashed.mgf", &arena_descriptor);
+        REQUIRE(recovered);
+        CHECK(mg_handle_valid(recovered, handles[3]));
+        CHECK(!mg_handle_valid(recovered, handles[1]));
+        CHECK(strcmp(((const UserString*)mg_handle_read(recovered, handles[0]))->data, "synced") == 0);
+
+        MgHandle created = mg_handle_create(recovered, USER_HANDLE_TYPE_STRING);
+        CHECK(created.slot_handle == expected.slot_handle);
+        mg_arena_destroy(&recovered);
+
+        remove("tests_arena.mgf");
+        remove("tests_crashed.mgf");
+    }
+
+    TEST_CASE("A file stays locked while an arena has it open")
+    {
+        remove("tests_arena.mgf");
+        MgArena* arena = mg_arena_open_file("tests_arena.mgf", &arena_descriptor);
+        REQUIRE(arena);
+
+        UserString string = { "locked" };
+        MgHandle handle   = mg_handle_create(arena, USER_HANDLE_TYPE_STRING);
+        REQUIRE(mg_handle_write(arena, handle, &string, sizeof(UserString)) == MG_SUCCESS);
+
+        // a second open would map the same pages with free lists of its own
+        CHECK(mg_arena_open_file("tests_arena.mgf", &arena_descriptor) == NULL);
+        CHECK(strcmp(((const UserString*)mg_handle_read(arena, handle))->data, "locked") == 0);
+        mg_arena_destroy(&arena);
+
+        MgArena* reopened = mg_arena_open_file("tests_arena.mgf", &arena_descriptor);
+        REQUIRE(reopened);
+        CHECK(mg_handle_valid(reopened, handle));
+        mg_arena_destroy(&reopened);
+
+        remove("tests_arena.mgf");
+    }
+}
+
+TEST_SUITE("mg_handle_read_sized")
+{
+    static MgHandleDescriptor variable_handle_descriptors[] = {
+        { .type = USER_HANDLE_TYPE_STRING, .count = HANDLE_LIMIT, .stride = sizeof(UserString) },
+        { .type = USER_HANDLE_TYPE_ARRAY, .count = HANDLE_LIMIT, .stride = sizeof(UserArray), .variable = true },
+    };
+
+    static MgArenaDescriptor variable_arena_descriptor = {
+        .arena_name               = "USER_VARIABLE_ARENA",
+        .handle_descriptors       = variable_handle_descriptors,
+        .handle_descriptors_count = 2,
+    };
+
+    TEST_CASE("Variable size handles keep the size they were written with")
+    {
+        MgArena* arena = mg_arena_init(&variable_arena_descriptor);
+        REQUIRE(arena);
+
+        UserArray values = {};
+        for (int i = 0; i < 100; ++i)
+        {
+            values[i] = (uint64_t)i;
+        }
+
+        MgHandle handles[HANDLE_LIMIT];
+        for (int i = 0; i < HANDLE_LIMIT; ++i)
+        {
+            handles[i] = mg_handle_create(arena, USER_HANDLE_TYPE_ARRAY);
+            REQUIRE(mg_handle_write(arena, handles[i], values, (size_t)(i + 1) * sizeof(uint64_t)) == MG_SUCCESS);
+        }
+
+        for (int i = 0; i < HANDLE_LIMIT; ++i)
+        {
+            size_t size          = 0;
+            const uint64_t* read = (const uint64_t*)mg_handle_read_sized(arena, handles[i], &size);
+            REQUIRE(read);
+            CHECK(size == (size_t)(i + 1) * sizeof(uint64_t));
+            CHECK(read[i] == (uint64_t)i);
+        }
+
+        // growing past the class moves the payload, shrinking back moves it again
+        REQUIRE(mg_handle_write(arena, handles[0], values, sizeof(UserArray)) == MG_SUCCESS);
+        size_t size = 0;
+        CHECK(((const uint64_t*)mg_handle_read_sized(arena, handles[0], &size))[99] == 99);
+        CHECK(size == sizeof(UserArray));
+        REQUIRE(mg_handle_write(arena, handles[0], &values[7], sizeof(uint64_t)) == MG_SUCCESS);
+        CHECK(*(const uint64_t*)mg_handle_read_sized(arena, handles[0], &size) == 7);
+        CHECK(size == sizeof(uint64_t));
+        CHECK(mg_handle_write(arena, handles[0], values, sizeof(UserArray) + 1) != MG_SUCCESS);
+
+        // erasing gives the class slot back, so every handle can be created and filled again
+        for (int i = 0; i < HANDLE_LIMIT; ++i)
+        {
+            mg_handle_erase(arena, handles[i]);
+        }
+        CHECK(!mg_handle_valid(arena, handles[3]));
+        for (int i = 0; i < HANDLE_LIMIT; ++i)
+        {
+            handles[i] = mg_handle_create(arena, USER_HANDLE_TYPE_ARRAY);
+            REQUIRE(mg_handle_write(arena, handles[i], values, sizeof(UserArray)) == MG_SUCCESS);
+        }
+
+        // fixed size types stay write once and report their stride
+        UserString string = { "fixed" };
+        MgHandle fixed    = mg_handle_create(arena, USER_HANDLE_TYPE_STRING);
+        REQUIRE(mg_handle_write(arena, fixed, &string, 6) == MG_SUCCESS);
+        CHECK(mg_handle_write(arena, fixed, &string, 6) != MG_SUCCESS);
+        CHECK(mg_handle_read_sized(arena, fixed, &size));
+        CHECK(size == sizeof(UserString));
+
+        mg_arena_destroy(&arena);
+    }
+
+    TEST_CASE("Diffs carry variable size payloads")
+    {
+        MgArena* primary = mg_arena_init(&variable_arena_descriptor);
+        REQUIRE(primary);
+
+        UserArray values = { 1, 2, 3 };
+        MgHandle kept    = mg_handle_create(primary, USER_HANDLE_TYPE_ARRAY);
+        MgHandle erased  = mg_handle_create(primary, USER_HANDLE_TYPE_ARRAY);
+        REQUIRE(mg_handle_write(primary, kept, values, 3 * sizeof(uint64_t)) == MG_SUCCESS);
+        REQUIRE(mg_handle_write(primary, erased, values, sizeof(uint64_t)) == MG_SUCCESS);
+
+        MgArena* standby = mg_arena_clone(primary);
+        MgArena* base    = mg_arena_clone(primary);
+        REQUIRE((standby && base));
+
+        mg_handle_erase(primary, erased);
+        MgHandle created = mg_handle_create(primary, USER_HANDLE_TYPE_ARRAY);
+        REQUIRE(mg_handle_write(primary, created, values, 2 * sizeof(uint64_t)) == MG_SUCCESS);
+        REQUIRE(mg_handle_write(primary, kept, values, sizeof(UserArray)) == MG_SUCCESS);
+
+        std::vector<MgDiffEntry> entries;
+        REQUIRE(mg_arena_diff(base, primary, collect_diff_entry, &entries) == MG_SUCCESS);
+        REQUIRE(entries.size() == 3);
+        REQUIRE(mg_arena_patch(standby, entries.data(), (uint32_t)entries.size()) == MG_SUCCESS);
+
+        size_t size = 0;
+        CHECK(!mg_handle_valid(standby, erased));
+        CHECK(((const uint64_t*)mg_handle_read_sized(standby, created, &size))[1] == 2);
+        CHECK(size == 2 * sizeof(uint64_t));
+        CHECK(((const uint64_t*)mg_handle_read_sized(standby, kept, &size))[2] == 3);
+        CHECK(size == sizeof(UserArray));
+
+        std::vector<MgDiffEntry> remaining;
+        REQUIRE(mg_arena_diff(standby, primary, collect_diff_entry, &remaining) == MG_SUCCESS);
+        CHECK(remaining.empty());
+
+        mg_arena_destroy(&base);
+        mg_arena_destroy(&standby);
+        mg_arena_destroy(&primary);
+    }
+
+    TEST_CASE("Diffs see payloads rewritten in their class slot")
+    {
+        MgArena* primary = mg_arena_init(&variable_arena_descriptor);
+        REQUIRE(primary);
+
+        UserArray values = { 1, 2, 3, 4, 5 };
+        MgHandle handle  = mg_handle_create(primary, USER_HANDLE_TYPE_ARRAY);
+        REQUIRE(mg_handle_write(primary, handle, values, 5 * sizeof(uint64_t)) == MG_SUCCESS);
+
+        MgArena* standby = mg_arena_clone(primary);
+        REQUIRE(standby);
+
+        // the same size stays in the same class slot, so the ref the handle's record holds does not change
+        UserArray rewritten = { 6, 7, 8, 9, 10 };
+        REQUIRE(mg_handle_write(primary, handle, rewritten, 5 * sizeof(uint64_t)) == MG_SUCCESS);
+
+        std::vector<MgDiffEntry> entries;
+        REQUIRE(mg_arena_diff(standby, primary, collect_diff_entry, &entries) == MG_SUCCESS);
+        REQUIRE(entries.size() == 1);
+        CHECK(entries[0].kind == MG_DIFF_MODIFIED);
+        REQUIRE(mg_arena_patch(standby, entries.data(), (uint32_t)entries.size()) == MG_SUCCESS);
+
+        size_t size = 0;
+        CHECK(((const uint64_t*)mg_handle_read_sized(standby, handle, &size))[4] == 10);
+        CHECK(size == 5 * sizeof(uint64_t));
+
+        mg_arena_destroy(&standby);
+        mg_arena_destroy(&primary);
+    }
+}
+
+TEST_SUITE("mg_handle_blob_write")
+{
+    static MgHandleDescriptor blob_handle_descriptors[] = {
+        { .type = USER_HANDLE_TYPE_STRING, .count = HANDLE_LIMIT, .stride = sizeof(UserString), .blob_capacity = 1024 },
+    };
+
+    static MgArenaDescriptor blob_arena_descriptor = {
+        .arena_name               = "USER_BLOB_ARENA",
+        .handle_descriptors       = blob_handle_descriptors,
+        .handle_descriptors_count = 1,
+        .sync_mode                = MG_ARENA_SYNC_GROUP_SPIN,
+    };
+
+    TEST_CASE("Rewritten blobs are reclaimed by compaction")
+    {
+        MgArena* arena = mg_arena_init(&blob_arena_descriptor);
+        REQUIRE(arena);
+
+        UserString string = { "record" };
+        char bytes[200];
+        MgHandle handles[4];
+        for (int i = 0; i < 4; ++i)
+        {
+            memset(bytes, 'a' + i, sizeof(bytes));
+            handles[i] = mg_handle_create(arena, USER_HANDLE_TYPE_STRING);
+            REQUIRE(mg_handle_write(arena, handles[i], &string, sizeof(UserString)) == MG_SUCCESS);
+            REQUIRE(mg_handle_blob_write(arena, handles[i], bytes, sizeof(bytes)) == MG_SUCCESS);
+        }
+
+        // every rewrite leaves a hole, the region only has room for them because writes compact when full
+        for (int round = 0; round < 16; ++round)
+        {
+            memset(bytes, 'A' + round, sizeof(bytes));
+            REQUIRE(mg_handle_blob_write(arena, handles[round % 4], bytes, 100 + round) == MG_SUCCESS);
+        }
+
+        size_t size       = 0;
+        const char* first = (const char*)mg_handle_blob_read(arena, handles[0], &size);
+        REQUIRE(first);
+        CHECK(size == 112);
+        CHECK((first[0] == 'M' && first[111] == 'M'));
+
+        REQUIRE(mg_group_compact(arena, USER_HANDLE_TYPE_STRING) == MG_SUCCESS);
+        const char* last = (const char*)mg_handle_blob_read(arena, handles[3], &size);
+        CHECK(size == 115);
+        CHECK(last[114] == 'P');
+        CHECK(strcmp(((const UserString*)mg_handle_read(arena, handles[3]))->data, "record") == 0);
+
+        // erasing frees the blob with the handle, a blob bigger than the region never fits
+        mg_handle_erase(arena, handles[1]);
+        CHECK(!mg_handle_blob_read(arena, handles[1], &size));
+        MgHandle created = mg_handle_create(arena, USER_HANDLE_TYPE_STRING);
+        REQUIRE(mg_handle_write(arena, created, &string, sizeof(UserString)) == MG_SUCCESS);
+        CHECK(!mg_handle_blob_read(arena, created, &size));
+        CHECK(size == 0);
+
+        static char large[2048];
+        CHECK(mg_handle_blob_write(arena, created, large, sizeof(large)) == MG_ERROR_BLOB_REGION_FULL);
+
+        mg_arena_destroy(&arena);
+    }
+
+    TEST_CASE("Resetting a group frees every handle and blob at once")
+    {
+        MgArena* arena = mg_arena_init(&blob_arena_descriptor);
+        REQUIRE(arena);
+
+        UserString string = { "scratch" };
+        char bytes[96]    = {};
+        MgHandle handles[8];
+        for (int i = 0; i < 8; ++i)
+        {
+            handles[i] = mg_handle_create(arena, USER_HANDLE_TYPE_STRING);
+            REQUIRE(mg_handle_write(arena, handles[i], &string, sizeof(UserString)) == MG_SUCCESS);
+            REQUIRE(mg_handle_blob_write(arena, handles[i], bytes, sizeof(bytes)) == MG_SUCCESS);
+        }
+
+        REQUIRE(mg_group_reset(arena, USER_HANDLE_TYPE_STRING) == MG_SUCCESS);
+        for (int i = 0; i < 8; ++i)
+        {
+            CHECK(!mg_handle_valid(arena, handles[i]));
+        }
+
+        // the whole region is free again and slots come back lowest first, at a new generation
+        MgHandle created = mg_handle_create(arena, USER_HANDLE_TYPE_STRING);
+        CHECK(created.slot_handle != handles[0].slot_handle);
+        REQUIRE(mg_handle_write(arena, created, &string, sizeof(UserString)) == MG_SUCCESS);
+        static char filling[1000];
+        CHECK(mg_handle_blob_write(arena, created, filling, sizeof(filling)) == MG_SUCCESS);
+
+        // groups without a region have no blobs
+        MgArena* plain = mg_arena_init(&arena_descriptor);
+        MgHandle plain_handle = mg_handle_create(plain, USER_HANDLE_TYPE_STRING);
+        REQUIRE(mg_handle_write(plain, plain_handle, &string, sizeof(UserString)) == MG_SUCCESS);
+        CHECK(mg_handle_blob_write(plain, plain_handle, bytes, sizeof(bytes)) == MG_ERROR_GROUP_NO_BLOBS);
+        mg_arena_destroy(&plain);
+
+        mg_arena_destroy(&arena);
+    }
+}
+
+TEST_SUITE("mg_serial_arena_alloc")
+{
+    TEST_CASE("Markers roll back scoped temporaries")
+    {
+        MgSerialArena arena;
+        REQUIRE(mg_serial_arena_init(&arena, 1 << 20) == MG_SUCCESS);
+
+        UserString string = { "scratch" };
+        UserString* kept  = (UserString*)mg_serial_arena_write(&arena, &string, sizeof(UserString));
+        REQUIRE(kept);
+        CHECK((uintptr_t)kept % MG_SERIAL_ALIGNMENT == 0);
+
+        char* odd = (char*)mg_serial_arena_alloc(&arena, 3, 1);
+        REQUIRE(odd);
+        uint64_t* aligned = (uint64_t*)mg_serial_arena_alloc(&arena, sizeof(uint64_t) * 4, 64);
+        REQUIRE(aligned);
+        CHECK((uintptr_t)aligned % 64 == 0);
+
+        // everything allocated inside the scope is dropped, what came before stays
+        MgSerialMarker scope = mg_serial_arena_mark(&arena);
+        for (int i = 0; i < 1000; ++i)
+        {
+            REQUIRE(mg_serial_arena_alloc(&arena, 100, 8));
+        }
+        REQUIRE(mg_serial_arena_restore(&arena, scope) == MG_SUCCESS);
+        CHECK(arena.write_marker == scope);
+        CHECK(strcmp(kept->data, "scratch") == 0);
+        CHECK(mg_serial_arena_restore(&arena, scope + 1) == MG_ERROR_DATA_INVALID);
+
+        // the capacity is a hard limit, a cleared arena hands out the same memory again
+        CHECK(!mg_serial_arena_alloc(&arena, arena.end_marker, 1));
+        mg_serial_arena_clear(&arena);
+        CHECK(mg_serial_arena_alloc(&arena, arena.end_marker, 1) == (void*)arena.data);
+        CHECK(!mg_serial_arena_alloc(&arena, 1, 1));
+
+        mg_serial_arena_destroy(&arena);
+        CHECK(arena.data == NULL);
+    }
+}
+
+TEST_SUITE("mg_frame_begin")
+{
+    TEST_CASE("Frame data lives until its region comes around again")
+    {
+        MgFrameArena frames;
+        REQUIRE(mg_frame_arena_init(&frames, 2, 1 << 16) == MG_SUCCESS);
+
+        uint64_t* first = (uint64_t*)mg_frame_alloc(&frames, sizeof(uint64_t) * 64, 64);
+        REQUIRE(first);
+        first[63] = 42;
+
+        // the next frame reads what the previous one wrote
+        mg_frame_begin(&frames);
+        uint64_t* second = (uint64_t*)mg_frame_alloc(&frames, sizeof(uint64_t) * 64, 64);
+        REQUIRE(second);
+        CHECK(second != first);
+        CHECK(first[63] == 42);
+
+        // two frames later the first region is handed out again from the start
+        mg_frame_begin(&frames);
+        CHECK(mg_frame_alloc(&frames, sizeof(uint64_t) * 64, 64) == (void*)first);
+        CHECK(frames.frame_index == 2);
+
+        mg_frame_arena_destroy(&frames);
+        CHECK(mg_frame_arena_init(&frames, 1, 1 << 16) == MG_ERROR_DATA_INVALID);
+    }
+}
+
+TEST_SUITE("mg_handle_find")
+{
+    static MgHandleDescriptor indexed_handle_descriptors[] = {
+        { .type = USER_HANDLE_TYPE_ARRAY, .count = 1024, .stride = sizeof(UserArray), .indexed = true, .key_offset = 8 },
+        { .type = USER_HANDLE_TYPE_STRING, .count = HANDLE_LIMIT, .stride = 256, .variable = true, .indexed = true },
+    };
+
+    static MgArenaDescriptor indexed_arena_descriptor = {
+        .arena_name               = "USER_INDEXED_ARENA",
+        .handle_descriptors       = indexed_handle_descriptors,
+        .handle_descriptors_count = 2,
+        .sync_mode                = MG_ARENA_SYNC_GROUP_SPIN,
+    };
+
+    TEST_CASE("Keys find their handles through erase churn")
+    {
+        MgArena* arena = mg_arena_init(&indexed_arena_descriptor);
+        REQUIRE(arena);
+
+        static MgHandle handles[1000];
+        UserArray array = { 0 };
+        for (uint64_t i = 0; i < 1000; ++i)
+        {
+            array[1]   = i * 7919;
+            handles[i] = mg_handle_create(arena, USER_HANDLE_TYPE_ARRAY);
+            REQUIRE(mg_handle_write(arena, handles[i], &array, sizeof(UserArray)) == MG_SUCCESS);
+        }
+
+        // a key another handle holds is refused and the handle stays unwritten
+        MgHandle duplicate = mg_handle_create(arena, USER_HANDLE_TYPE_ARRAY);
+        CHECK(mg_handle_write(arena, duplicate, &array, sizeof(UserArray)) == MG_ERROR_INDEX_KEY_EXISTS);
+        CHECK(!mg_handle_valid(arena, duplicate));
+        mg_handle_erase(arena, duplicate);
+
+        // every round leaves tombstones behind until the table rehashes in place
+        for (uint64_t round = 1; round <= 20; ++round)
+        {
+            for (uint64_t i = round % 2; i < 1000; i += 2)
+            {
+                mg_handle_erase(arena, handles[i]);
+                array[1]   = i * 7919 + round * 1000000;
+                handles[i] = mg_handle_create(arena, USER_HANDLE_TYPE_ARRAY);
+                REQUIRE(mg_handle_write(arena, handles[i], &array, sizeof(UserArray)) == MG_SUCCESS);
+            }
+        }
+
+        for (uint64_t i = 0; i < 1000; ++i)
+        {
+            uint64_t round = i % 2 ? 19 : 20;
+            MgHandle found = mg_handle_find(arena, USER_HANDLE_TYPE_ARRAY, i * 7919 + round * 1000000);
+            CHECK(found.slot_handle == handles[i].slot_handle);
+            CHECK(found.type == USER_HANDLE_TYPE_ARRAY);
+        }
+        CHECK(mg_handle_find(arena, USER_HANDLE_TYPE_ARRAY, 7919).slot_handle == 0);
+
+        // a reset empties the index with the group
+        REQUIRE(mg_group_reset(arena, USER_HANDLE_TYPE_ARRAY) == MG_SUCCESS);
+        CHECK(mg_handle_find(arena, USER_HANDLE_TYPE_ARRAY, 20000000).slot_handle == 0);
+
+        mg_arena_destroy(&arena);
+    }
+
+    TEST_CASE("Rewriting a variable size handle moves its key")
+    {
+        MgArena* arena = mg_arena_init(&indexed_arena_descriptor);
+        REQUIRE(arena);
+
+        uint64_t record[8] = { 42, 1, 2, 3 };
+        MgHandle handle    = mg_handle_create(arena, USER_HANDLE_TYPE_STRING);
+        REQUIRE(mg_handle_write(arena, handle, record, sizeof(uint64_t) * 2) == MG_SUCCESS);
+        CHECK(mg_handle_find(arena, USER_HANDLE_TYPE_STRING, 42).slot_handle == handle.slot_handle);
+
+        // the rewrite grows into the next size class and takes a new key along
+        record[0] = 43;
+        REQUIRE(mg_handle_write(arena, handle, record, sizeof(record)) == MG_SUCCESS);
+        CHECK(mg_handle_find(arena, USER_HANDLE_TYPE_STRING, 42).slot_handle == 0);
+        CHECK(mg_handle_find(arena, USER_HANDLE_TYPE_STRING, 43).slot_handle == handle.slot_handle);
+
+        // a refused rewrite keeps the payload and the key it had
+        MgHandle other = mg_handle_create(arena, USER_HANDLE_TYPE_STRING);
+        record[0]      = 44;
+        REQUIRE(mg_handle_write(arena, other, record, sizeof(uint64_t)) == MG_SUCCESS);
+        CHECK(mg_handle_write(arena, handle, record, sizeof(uint64_t)) == MG_ERROR_INDEX_KEY_EXISTS);
+        CHECK(((const uint64_t*)mg_handle_read(arena, handle))[0] == 43);
+        CHECK(mg_handle_write(arena, handle, record, 4) == MG_ERROR_DATA_INVALID);
+
+        mg_handle_erase(arena, handle);
+        CHECK(mg_handle_find(arena, USER_HANDLE_TYPE_STRING, 43).slot_handle == 0);
+        CHECK(mg_handle_find(arena, USER_HANDLE_TYPE_STRING, 44).slot_handle == other.slot_handle);
+
+        mg_arena_destroy(&arena);
+    }
+
+    TEST_CASE("Keys of every slot a sharded group rounds up to fit the index")
+    {
+        static MgHandleDescriptor sharded_handle_descriptors[] = {
+            { .type = USER_HANDLE_TYPE_STRING, .count = 16, .stride = 8, .shard_count = 8, .indexed = true },
+        };
+
+        MgArenaDescriptor sharded_arena_descriptor = {
+            .arena_name               = "USER_SHARDED_INDEXED_ARENA",
+            .handle_descriptors       = sharded_handle_descriptors,
+            .handle_descriptors_count = 1,
+            .sync_mode                = MG_ARENA_SYNC_GROUP_SPIN,
+        };
+
+        MgArena* arena = mg_arena_init(&sharded_arena_descriptor);
+        REQUIRE(arena);
+
+        // eight shards of a cache line each hold far more than the 16 handles asked for, every one of them is keyed
+        std::vector<MgHandle> handles;
+        for (uint64_t key = 1;; ++key)
+        {
+            MgHandle handle = mg_handle_create(arena, USER_HANDLE_TYPE_STRING);
+            if (handle.slot_handle == MG_HANDLE_INVALID)
+            {
+                break;
+            }
+            REQUIRE(mg_handle_write(arena, handle, &key, sizeof(key)) == MG_SUCCESS);
+            handles.push_back(handle);
+        }
+        CHECK(handles.size() > 32);
+
+        for (size_t i = 0; i < handles.size(); ++i)
+        {
+            MgHandle found = mg_handle_find(arena, USER_HANDLE_TYPE_STRING, (uint64_t)i + 1);
+            CHECK(found.slot_handle == handles[i].slot_handle);
+        }
+        CHECK(mg_handle_find(arena, USER_HANDLE_TYPE_STRING, (uint64_t)handles.size() + 1).slot_handle == 0);
+
+        mg_arena_destroy(&arena);
+    }
+}
+
+TEST_SUITE("mg_group_range")
+{
+    struct Quote
+    {
+        double price;
+        int32_t volume;
+        uint32_t id;
+    };
+
+    static MgHandleDescriptor ordered_handle_descriptors[] = {
+        { .type = USER_HANDLE_TYPE_ARRAY, .count = 4096, .stride = sizeof(Quote), .order_type = MG_FIELD_F64 },
+        { .type = USER_HANDLE_TYPE_STRING, .count = 512, .stride = 16, .order_type = MG_FIELD_I32, .order_offset = 8 },
+    };
+
+    static MgArenaDescriptor ordered_arena_descriptor = {
+        .arena_name               = "USER_ORDERED_ARENA",
+        .handle_descriptors       = ordered_handle_descriptors,
+        .handle_descriptors_count = 2,
+        .sync_mode                = MG_ARENA_SYNC_GROUP_SPIN,
+    };
+
+    struct RangeVisit
+    {
+        double last;
+        uint32_t count;
+        bool ordered;
+    };
+
+    static void visit_quote(MgHandle, void* data, void* ctx)
+    {
+        RangeVisit* visit = (RangeVisit*)ctx;
+        double price      = ((const Quote*)data)->price;
+        visit->ordered &= (visit->count == 0 || price >= visit->last);
+        visit->last = price;
+        visit->count++;
+    }
+
+    TEST_CASE("Ranges visit handles in field order")
+    {
+        MgArena* arena = mg_arena_init(&ordered_arena_descriptor);
+        REQUIRE(arena);
+
+        // prices from -50 to 49.5 in a scattered order, every one twice
+        static MgHandle handles[4000];
+        for (uint32_t i = 0; i < 4000; ++i)
+        {
+            Quote quote = { (double)((i * 37) % 200) / 2.0 - 50.0, 0, i };
+            handles[i]  = mg_handle_create(arena, USER_HANDLE_TYPE_ARRAY);
+            REQUIRE(mg_handle_write(arena, handles[i], &quote, sizeof(Quote)) == MG_SUCCESS);
+        }
+
+        double min       = -10.0;
+        double max       = 10.0;
+        RangeVisit visit = { 0, 0, true };
+        REQUIRE(mg_group_range(arena, USER_HANDLE_TYPE_ARRAY, &min, &max, visit_quote, &visit) == MG_SUCCESS);
+        CHECK(visit.ordered);
+        CHECK(visit.count == 41 * 20);
+
+        // even handles hold the even prices, half of them are erased and half move past the top
+        for (uint32_t i = 0; i < 4000; i += 2)
+        {
+            Quote quote = { 1000.0 + i, 0, i };
+            mg_handle_erase(arena, handles[i]);
+            if (i % 4 == 0)
+            {
+                handles[i] = mg_handle_create(arena, USER_HANDLE_TYPE_ARRAY);
+                REQUIRE(mg_handle_write(arena, handles[i], &quote, sizeof(Quote)) == MG_SUCCESS);
+            }
+        }
+
+        visit = { 0, 0, true };
+        REQUIRE(mg_group_range(arena, USER_HANDLE_TYPE_ARRAY, &min, &max, visit_quote, &visit) == MG_SUCCESS);
+        CHECK(visit.ordered);
+        CHECK(visit.count == 20 * 20);
+
+        visit = { 0, 0, true };
+        REQUIRE(mg_group_range(arena, USER_HANDLE_TYPE_ARRAY, &max, NULL, visit_quote, &visit) == MG_SUCCESS);
+        CHECK(visit.ordered);
+        CHECK(visit.last == 1000.0 + 3996);
+        CHECK(visit.count == 40 * 20 + 1000);
+
+        mg_arena_destroy(&arena);
+    }
+
+    TEST_CASE("Signed fields sort below zero")
+    {
+        MgArena* arena = mg_arena_init(&ordered_arena_descriptor);
+        REQUIRE(arena);
+
+        for (int32_t volume = 500; volume > -500; volume -= 3)
+        {
+            Quote quote     = { (double)volume, volume, 0 };
+            MgHandle handle = mg_handle_create(arena, USER_HANDLE_TYPE_STRING);
+            REQUIRE(mg_handle_write(arena, handle, &quote, sizeof(Quote)) == MG_SUCCESS);
+        }
+
+        int32_t max      = 0;
+        RangeVisit visit = { 0, 0, true };
+        REQUIRE(mg_group_range(arena, USER_HANDLE_TYPE_STRING, NULL, &max, visit_quote, &visit) == MG_SUCCESS);
+        CHECK(visit.ordered);
+        CHECK(visit.count == 167);
+        CHECK(visit.last == -1.0);
+
+        // payloads have to reach past the field, and only ordered groups have ranges
+        Quote quote     = { 0 };
+        MgHandle handle = mg_handle_create(arena, USER_HANDLE_TYPE_STRING);
+        CHECK(mg_handle_write(arena, handle, &quote, 8) == MG_ERROR_DATA_INVALID);
+        CHECK(mg_group_range(arena, USER_HANDLE_TYPE_ARRAY + 100, NULL, NULL, visit_quote, &visit) != MG_SUCCESS);
+
+        mg_arena_destroy(&arena);
+    }
+
+    static void visit_tick(MgHandle, void* data, void* ctx)
+    {
+        RangeVisit* visit = (RangeVisit*)ctx;
+        double tick       = (double)*(const uint32_t*)data;
+        visit->ordered &= (visit->count == 0 || tick >= visit->last);
+        visit->last = tick;
+        visit->count++;
+    }
+
+    TEST_CASE("Every slot a sharded group rounds up to has room in the tree")
+    {
+        static MgHandleDescriptor sharded_handle_descriptors[] = {
+            { .type        = USER_HANDLE_TYPE_STRING,
+              .count       = 1000,
+              .stride      = 8,
+              .shard_count = 8,
+              .numa_policy = MG_NUMA_POLICY_SHARDS,
+              .order_type  = MG_FIELD_U32 },
+        };
+
+        MgArenaDescriptor sharded_arena_descriptor = {
+            .arena_name               = "USER_SHARDED_ORDERED_ARENA",
+            .handle_descriptors       = sharded_handle_descriptors,
+            .handle_descriptors_count = 1,
+            .sync_mode                = MG_ARENA_SYNC_GROUP_SPIN,
+        };
+
+        MgArena* arena = mg_arena_init(&sharded_arena_descriptor);
+        REQUIRE(arena);
+
+        // shards of a page each hold four times the 1000 handles asked for, scattered ticks split nodes all over
+        uint32_t written = 0;
+        for (;;)
+        {
+            MgHandle handle = mg_handle_create(arena, USER_HANDLE_TYPE_STRING);
+            if (handle.slot_handle == MG_HANDLE_INVALID)
+            {
+                break;
+            }
+            uint64_t tick = (uint64_t)(written * 7919u % 65521u);
+            REQUIRE(mg_handle_write(arena, handle, &tick, sizeof(tick)) == MG_SUCCESS);
+            written++;
+        }
+        CHECK(written > 2000);
+
+        RangeVisit visit = { 0, 0, true };
+        REQUIRE(mg_group_range(arena, USER_HANDLE_TYPE_STRING, NULL, NULL, visit_tick, &visit) == MG_SUCCESS);
+        CHECK(visit.ordered);
+        CHECK(visit.count == written);
+
+        mg_arena_destroy(&arena);
+    }
+}
+
+TEST_SUITE("mg_group_column")
+{
+    struct Particle
+    {
+        uint64_t id;
+        float position[3];
+        float mass;
+        uint8_t cold[96];
+    };
+
+    static MgField particle_fields[] = {
+        { offsetof(Particle, id), sizeof(uint64_t) },
+        { offsetof(Particle, position), sizeof(float) * 3 },
+        { offsetof(Particle, mass), sizeof(float) },
+    };
+
+    static MgHandleDescriptor columnar_handle_descriptors[] = {
+        { .type = USER_HANDLE_TYPE_ARRAY, .count = 1000, .stride = sizeof(Particle), .fields = particle_fields,
+        .field_count = 3 },
+    };
+
+    static MgArenaDescriptor columnar_arena_descriptor = {
+        .arena_name               = "USER_COLUMNAR_ARENA",
+        .handle_descriptors       = columnar_handle_descriptors,
+        .handle_descriptors_count = 1,
+        .sync_mode                = MG_ARENA_SYNC_GROUP_SPIN,
+    };
+
+    TEST_CASE("Columns hold one field of every record")
+    {
+        MgArena* arena = mg_arena_init(&columnar_arena_descriptor);
+        REQUIRE(arena);
+
+        static MgHandle handles[1000];
+        for (uint32_t i = 0; i < 1000; ++i)
+        {
+            Particle particle = { i, { (float)i, 0.0f, 0.0f }, 1.0f + (float)(i % 4) };
+            handles[i]        = mg_handle_create(arena, USER_HANDLE_TYPE_ARRAY);
+            REQUIRE(mg_handle_write(arena, handles[i], &particle, sizeof(Particle)) == MG_SUCCESS);
+        }
+
+        // the mass column is every mass back to back, rows of unused slots read as zero
+        size_t row_count = 0;
+        float* masses    = (float*)mg_group_column(arena, USER_HANDLE_TYPE_ARRAY, 2, &row_count);
+        REQUIRE(masses);
+        REQUIRE(row_count > 1000);
+        float total = 0.0f;
+        for (size_t row = 0; row < row_count; ++row)
+        {
+            total += masses[row];
+        }
+        CHECK(total == 2500.0f);
+
+        // a field write lands in the column, and an erase clears the handle's row
+        float mass = 10.0f;
+        REQUIRE(mg_handle_write_field(arena, handles[5], 2, &mass) == MG_SUCCESS);
+        CHECK(masses[mg_handle_row(handles[5])] == 10.0f);
+        CHECK(*(const uint64_t*)mg_handle_read_field(arena, handles[5], 0) == 5);
+        CHECK(((const float*)mg_handle_read_field(arena, handles[5], 1))[0] == 5.0f);
+
+        uint32_t row = mg_handle_row(handles[6]);
+        mg_handle_erase(arena, handles[6]);
+        CHECK(masses[row] == 0.0f);
+        CHECK(!mg_handle_read_field(arena, handles[6], 2));
+        CHECK(mg_handle_write_field(arena, handles[6], 2, &mass) == MG_ERROR_HANDLE_WRITE_FAILED);
+
+        // there is no whole record to point at
+        CHECK(!mg_handle_read(arena, handles[5]));
+        CHECK(!mg_handle_read_field(arena, handles[5], 3));
+
+        mg_arena_destroy(&arena);
+    }
+
+    TEST_CASE("Field writes travel in diffs")
+    {
+        MgArena* arena = mg_arena_init(&columnar_arena_descriptor);
+        REQUIRE(arena);
+
+        Particle particle = { 1, { 1.0f, 2.0f, 3.0f }, 4.0f };
+        MgHandle handle   = mg_handle_create(arena, USER_HANDLE_TYPE_ARRAY);
+        REQUIRE(mg_handle_write(arena, handle, &particle, sizeof(Particle)) == MG_SUCCESS);
+
+        MgArena* standby = mg_arena_clone(arena);
+        REQUIRE(standby);
+
+        float position[3] = { 7.0f, 8.0f, 9.0f };
+        REQUIRE(mg_handle_write_field(arena, handle, 1, position) == MG_SUCCESS);
+
+        // the entry carries the gathered record, bytes outside the fields come back zeroed
+        static Particle modified;
+        static uint32_t entry_count;
+        auto collect = [](const MgDiffEntry* entry, void*) {
+            CHECK(entry->kind == MG_DIFF_MODIFIED);
+            memcpy(&modified, entry->data, sizeof(Particle));
+            entry_count++;
+        };
+        REQUIRE(mg_arena_diff(standby, arena, collect, NULL) == MG_SUCCESS);
+        REQUIRE(entry_count == 1);
+        CHECK(modified.position[2] == 9.0f);
+        CHECK(modified.mass == 4.0f);
+
+        MgDiffEntry entry = { MG_DIFF_MODIFIED, handle, &modified, sizeof(Particle) };
+        REQUIRE(mg_arena_patch(standby, &entry, 1) == MG_SUCCESS);
+        CHECK(((const float*)mg_handle_read_field(standby, handle, 1))[1] == 8.0f);
+
+        // as many columns of the same sizes, but one of them holds another field of the record
+        static MgField moved_fields[] = {
+            { offsetof(Particle, id), sizeof(uint64_t) },
+            { offsetof(Particle, position), sizeof(float) * 3 },
+            { offsetof(Particle, cold), sizeof(float) },
+        };
+        MgHandleDescriptor moved_handle_descriptor = columnar_handle_descriptors[0];
+        moved_handle_descriptor.fields             = moved_fields;
+        MgArenaDescriptor moved_arena_descriptor   = columnar_arena_descriptor;
+        moved_arena_descriptor.handle_descriptors  = &moved_handle_descriptor;
+
+        MgArena* moved = mg_arena_init(&moved_arena_descriptor);
+        REQUIRE(moved);
+        entry_count = 0;
+        CHECK(mg_arena_diff(moved, arena, collect, NULL) == MG_ERROR_ARENA_DESC_INVALID);
+        CHECK(entry_count == 0);
+
+        mg_arena_destroy(&moved);
+        mg_arena_destroy(&standby);
+        mg_arena_destroy(&arena);
+    }
+}
+
+TEST_SUITE("mg_group_scan")
+{
+    struct Order
+    {
+        uint64_t id;
+        double price;
+        int32_t quantity;
+        uint32_t flags;
+    };
+
+    static MgField order_fields[] = {
+        { offsetof(Order, id), sizeof(uint64_t), MG_FIELD_U64 },
+        { offsetof(Order, price), sizeof(double), MG_FIELD_F64 },
+        { offsetof(Order, quantity), sizeof(int32_t), MG_FIELD_I32 },
+        { offsetof(Order, flags), sizeof(uint32_t), MG_FIELD_NONE },
+    };
+
+    static MgHandleDescriptor scan_handle_descriptors[] = {
+        { .type = USER_HANDLE_TYPE_ARRAY, .count = 5000, .stride = sizeof(Order), .fields = order_fields,
+        .field_count = 4 },
+    };
+
+    static MgArenaDescriptor scan_arena_descriptor = {
+        .arena_name               = "USER_SCAN_ARENA",
+        .handle_descriptors       = scan_handle_descriptors,
+        .handle_descriptors_count = 1,
+        .sync_mode                = MG_ARENA_SYNC_GROUP_SPIN,
+    };
+
+    // runs check with the kernels of every level this cpu has, the widest are picked again after the last one
+    static void for_each_simd_level(void (*check)())
+    {
+        struct WidestAgain
+        {
+            ~WidestAgain() { _mg_simd_force(NULL); }
+        } widest_again;
+
+        for (const char* level : { "scalar", "sse2", "avx2", "avx512" })
+        {
+            if (_mg_simd_force(level))
+            {
+                CAPTURE(level);
+                check();
+            }
+        }
+    }
+
+    static void check_scans_select_written_rows()
+    {
+        MgArena* arena = mg_arena_init(&scan_arena_descriptor);
+        REQUIRE(arena);
+
+        // every seventh handle is never written and every fifth erased again, neither may match
+        static MgHandle handles[5000];
+        size_t expected      = 0;
+        int64_t quantity_sum = 0;
+        int32_t quantity_min = INT32_MAX;
+        int32_t quantity_max = INT32_MIN;
+        for (uint32_t i = 0; i < 5000; ++i)
+        {
+            Order order = { i, (double)(i % 100) * 0.5, (int32_t)(i % 23) - 11, 0 };
+            handles[i]  = mg_handle_create(arena, USER_HANDLE_TYPE_ARRAY);
+            if (i % 7 != 0)
+            {
+                REQUIRE(mg_handle_write(arena, handles[i], &order, sizeof(Order)) == MG_SUCCESS);
+            }
+            if (i % 7 != 0 && i % 5 != 0 && order.price >= 40.0)
+            {
+                expected++;
+                quantity_sum += order.quantity;
+                quantity_min = std::min(quantity_min, order.quantity);
+                quantity_max = std::max(quantity_max, order.quantity);
+            }
+        }
+        for (uint32_t i = 0; i < 5000; i += 5)
+        {
+            mg_handle_erase(arena, handles[i]);
+        }
+
+        size_t row_count = 0;
+        REQUIRE(mg_group_column(arena, USER_HANDLE_TYPE_ARRAY, 1, &row_count));
+        std::vector<uint64_t> selection((row_count + 63) / 64);
+        double floor       = 40.0;
+        size_t match_count = 0;
+        REQUIRE(mg_group_scan(arena, USER_HANDLE_TYPE_ARRAY, 1, MG_SCAN_GE, &floor, selection.data(), &match_count) ==
+        MG_SUCCESS);
+        CHECK(match_count == expected);
+        uint32_t row = mg_handle_row(handles[81]); // price 40.5, written and alive
+        CHECK((selection[row / 64] >> (row % 64)) & 1);
+        row = mg_handle_row(handles[80]); // erased
+        CHECK(!((selection[row / 64] >> (row % 64)) & 1));
+
+        MgAggregate quantities;
+        REQUIRE(mg_group_aggregate(arena, USER_HANDLE_TYPE_ARRAY, 2, selection.data(), &quantities) == MG_SUCCESS);
+        CHECK(quantities.count == expected);
+        CHECK(quantities.sum.i64 == quantity_sum);
+        CHECK(quantities.min.i64 == quantity_min);
+        CHECK(quantities.max.i64 == quantity_max);
+
+        // handles come in row order, the count is every match even past the capacity
+        MgHandle found[4];
+        uint64_t id = 4321;
+        REQUIRE(mg_group_scan_handles(arena, USER_HANDLE_TYPE_ARRAY, 0, MG_SCAN_EQ, &id, found, 4, &match_count) ==
+        MG_SUCCESS);
+        REQUIRE(match_count == 1);
+        CHECK(mg_handle_valid(arena, found[0]));
+        CHECK(found[0].slot_handle == handles[4321].slot_handle);
+
+        id = 4990;
+        REQUIRE(mg_group_scan_handles(arena, USER_HANDLE_TYPE_ARRAY, 0, MG_SCAN_GT, &id, found, 4, &match_count) ==
+        MG_SUCCESS);
+        CHECK(match_count == 6); // 4992 to 4999 without 4995 (erased) and 4998 (never written)
+        CHECK(found[0].slot_handle == handles[4992].slot_handle);
+        CHECK(found[3].slot_handle == handles[4996].slot_handle);
+
+        // plain byte fields have nothing to compare by
+        uint32_t flags = 0;
+        CHECK(mg_group_scan(arena, USER_HANDLE_TYPE_ARRAY, 3, MG_SCAN_EQ, &flags, selection.data(), NULL) ==
+        MG_ERROR_DATA_INVALID);
+
+        mg_arena_destroy(&arena);
+    }
+
+    TEST_CASE("Scans select the written rows that match")
+    {
+        for_each_simd_level(check_scans_select_written_rows);
+    }
+
+    static void check_nans_never_match_or_win()
+    {
+        MgArena* arena = mg_arena_init(&scan_arena_descriptor);
+        REQUIRE(arena);
+
+        for (uint32_t i = 0; i < 300; ++i)
+        {
+            double price    = i % 3 == 0 ? std::nan("") : (double)i;
+            Order order     = { i, price, 1, 0 };
+            MgHandle handle = mg_handle_create(arena, USER_HANDLE_TYPE_ARRAY);
+            REQUIRE(mg_handle_write(arena, handle, &order, sizeof(Order)) == MG_SUCCESS);
+        }
+
+        size_t row_count = 0;
+        REQUIRE(mg_group_column(arena, USER_HANDLE_TYPE_ARRAY, 1, &row_count));
+        std::vector<uint64_t> selection((row_count + 63) / 64);
+        double zero        = 0.0;
+        size_t match_count = 0;
+        REQUIRE(mg_group_scan(arena, USER_HANDLE_TYPE_ARRAY, 1, MG_SCAN_GE, &zero, selection.data(), &match_count) ==
+        MG_SUCCESS);
+        CHECK(match_count == 200);
+        REQUIRE(mg_group_scan(arena, USER_HANDLE_TYPE_ARRAY, 1, MG_SCAN_NE, &zero, selection.data(), &match_count) ==
+        MG_SUCCESS);
+        CHECK(match_count == 300);
+
+        // every written row is aggregated, the nans make the sum a nan but are never the min or max
+        MgAggregate prices;
+        REQUIRE(mg_group_aggregate(arena, USER_HANDLE_TYPE_ARRAY, 1, NULL, &prices) == MG_SUCCESS);
+        CHECK(prices.count == 300);
+        CHECK(std::isnan(prices.sum.f64));
+        CHECK(prices.min.f64 == 1.0);
+        CHECK(prices.max.f64 == 299.0);
+
+        mg_arena_destroy(&arena);
+    }
+
+    TEST_CASE("Nans never match or win")
+    {
+        for_each_simd_level(check_nans_never_match_or_win);
+    }
+}
+
+TEST_SUITE("mg_handle_read_hot")
+{
+    struct Body
+    {
+        float position[3];
+        float radius;
+        uint8_t cold[200];
+    };
+
+    static MgHandleDescriptor split_handle_descriptors[] = {
+        { .type = USER_HANDLE_TYPE_ARRAY, .count = 1000, .stride = sizeof(Body), .hot_size = sizeof(float) * 4 },
+        { .type = USER_HANDLE_TYPE_STRING, .count = 10, .stride = 16 },
+    };
+
+    static MgArenaDescriptor split_arena_descriptor = {
+        .arena_name               = "USER_SPLIT_ARENA",
+        .handle_descriptors       = split_handle_descriptors,
+        .handle_descriptors_count = 2,
+        .sync_mode                = MG_ARENA_SYNC_GROUP_SPIN,
+    };
+
+    TEST_CASE("Hot parts sit back to back apart from cold ones")
+    {
+        MgArena* arena = mg_arena_init(&split_arena_descriptor);
+        REQUIRE(arena);
+
+        static MgHandle handles[1000];
+        for (uint32_t i = 0; i < 1000; ++i)
+        {
+            Body body = { { (float)i, 0.0f, 0.0f }, 1.0f };
+            memset(body.cold, (int)(i & 0xff), sizeof(body.cold));
+            handles[i] = mg_handle_create(arena, USER_HANDLE_TYPE_ARRAY);
+            REQUIRE(mg_handle_write(arena, handles[i], &body, sizeof(Body)) == MG_SUCCESS);
+        }
+
+        const float* hot    = (const float*)mg_handle_read_hot(arena, handles[300]);
+        const uint8_t* cold = (const uint8_t*)mg_handle_read_cold(arena, handles[300]);
+        REQUIRE(hot);
+        REQUIRE(cold);
+        CHECK(hot[0] == 300.0f);
+        CHECK(hot[3] == 1.0f);
+        CHECK(cold[0] == (300 & 0xff));
+        CHECK(cold[199] == (300 & 0xff));
+
+        // neighbouring slots' hot parts are 16 bytes apart, four to a cache line
+        const uint8_t* next = (const uint8_t*)mg_handle_read_hot(arena, handles[301]);
+        CHECK(next - (const uint8_t*)hot == sizeof(float) * 4);
+
+        float radius[4] = { 5.0f, 5.0f, 5.0f, 2.0f };
+        REQUIRE(mg_handle_write_field(arena, handles[300], 0, radius) == MG_SUCCESS);
+        CHECK(hot[3] == 2.0f);
+        CHECK(cold[0] == (300 & 0xff));
+
+        // groups without a hot_size keep their payloads whole
+        MgHandle whole = mg_handle_create(arena, USER_HANDLE_TYPE_STRING);
+        REQUIRE(mg_handle_write(arena, whole, "0123456789abcde", 16) == MG_SUCCESS);
+        CHECK(!mg_handle_read_hot(arena, whole));
+        CHECK(mg_handle_read(arena, whole));
+
+        mg_arena_destroy(&arena);
+    }
+}
+
+TEST_SUITE("mg_group_defragment")
+{
+    struct Particle
+    {
+        uint64_t id;
+        float position[3];
+        float mass;
+    };
+
+    static MgHandleDescriptor defragment_handle_descriptors[] = {
+        { .type = USER_HANDLE_TYPE_ARRAY, .count = 1000, .stride = sizeof(Particle), .indexed = true },
+    };
+
+    static MgArenaDescriptor defragment_arena_descriptor = {
+        .arena_name               = "USER_DEFRAGMENT_ARENA",
+        .handle_descriptors       = defragment_handle_descriptors,
+        .handle_descriptors_count = 1,
+        .sync_mode                = MG_ARENA_SYNC_GROUP_SPIN,
+    };
+
+    static void relocate(MgHandle from, MgHandle to, void* ctx)
+    {
+        std::vector<MgHandle>& handles = *(std::vector<MgHandle>*)ctx;
+        auto moved = std::find_if(handles.begin(), handles.end(),
+        [&](const MgHandle& handle) { return handle.slot_handle == from.slot_handle; });
+        REQUIRE(moved != handles.end());
+        *moved = to;
+    }
+
+    // writes a particle to each of count new handles, then erases all but every fourth
+    static std::vector<MgHandle> scatter_particles(MgArena* arena, MgHandleType type, uint64_t count)
+    {
+        std::vector<MgHandle> handles;
+        std::vector<MgHandle> erased;
+        for (uint64_t i = 0; i < count; ++i)
+        {
+            Particle particle = { i, { (float)i, 0.0f, 0.0f }, 1.0f };
+            MgHandle handle   = mg_handle_create(arena, type);
+            CHECK(mg_handle_write(arena, handle, &particle, sizeof(Particle)) == MG_SUCCESS);
+            (i % 4 == 0 ? handles : erased).push_back(handle);
+        }
+        for (MgHandle handle : erased)
+        {
+            mg_handle_erase(arena, handle);
+        }
+        return handles;
+    }
+
+    static void defragment_fully(MgArena* arena, MgHandleType type, size_t byte_budget, std::vector<MgHandle>& handles)
+    {
+        bool packed = false;
+        for (uint32_t calls = 0; !packed && calls < 100000; ++calls)
+        {
+            REQUIRE(mg_group_defragment(arena, type, byte_budget, 0, relocate, &handles, &packed) == MG_SUCCESS);
+        }
+        CHECK(packed);
+    }
+
+    static void check_particles(MgArena* arena, MgHandleType type, const std::vector<MgHandle>& handles)
+    {
+        for (MgHandle handle : handles)
+        {
+            const Particle* particle = (const Particle*)mg_handle_read(arena, handle);
+            REQUIRE(particle);
+            CHECK(particle->position[0] == (float)particle->id);
+            CHECK(mg_handle_find(arena, type, particle->id).slot_handle == handle.slot_handle);
+        }
+    }
+
+    TEST_CASE("Moved handles end up packed at the front")
+    {
+        MgArena* arena = mg_arena_init(&defragment_arena_descriptor);
+        REQUIRE(arena);
+
+        std::vector<MgHandle> handles;
+        std::vector<MgHandle> erased;
+        for (uint64_t i = 0; i < 999; ++i)
+        {
+            Particle particle = { i, { (float)i, 0.0f, 0.0f }, 1.0f };
+            MgHandle handle   = mg_handle_create(arena, USER_HANDLE_TYPE_ARRAY);
+            REQUIRE(mg_handle_write(arena, handle, &particle, sizeof(Particle)) == MG_SUCCESS);
+            (i % 4 == 0 ? handles : erased).push_back(handle);
+        }
+        for (MgHandle handle : erased)
+        {
+            mg_handle_erase(arena, handle);
+        }
+
+        // a few records per call, so it takes many calls to get there
+        std::vector<MgHandle> before = handles;
+        bool packed                  = false;
+        uint32_t calls                = 0;
+        while (!packed)
+        {
+            REQUIRE(mg_group_defragment(arena, USER_HANDLE_TYPE_ARRAY, sizeof(Particle) * 16, 0, relocate, &handles,
+            &packed) == MG_SUCCESS);
+            ++calls;
+        }
+        CHECK(calls > 10);
+
+        std::vector<uint32_t> rows;
+        for (MgHandle handle : handles)
+        {
+            const Particle* particle = (const Particle*)mg_handle_read(arena, handle);
+            REQUIRE(particle);
+            CHECK(particle->position[0] == (float)particle->id);
+            CHECK(mg_handle_find(arena, USER_HANDLE_TYPE_ARRAY, particle->id).slot_handle == handle.slot_handle);
+            rows.push_back(mg_handle_row(handle));
+        }
+        std::sort(rows.begin(), rows.end());
+        CHECK(rows.front() == 1);
+        CHECK(rows.back() == handles.size());
+
+        // the handles from before the move are as dead as erased ones, and the next create fills the front
+        for (size_t i = 0; i < handles.size(); ++i)
+        {
+            CHECK(mg_handle_valid(arena, before[i]) == (before[i].slot_handle == handles[i].slot_handle));
+        }
+        MgHandle next = mg_handle_create(arena, USER_HANDLE_TYPE_ARRAY);
+        CHECK(mg_handle_row(next) == handles.size() + 1);
+
+        // creates go on until one takes the row a moved handle left, the stale handle must not reach the new one
+        size_t stale    = before.size();
+        MgHandle reused = next;
+        for (uint32_t i = 0; i < 1000 && stale == before.size(); ++i)
+        {
+            for (size_t k = 0; k < before.size() && stale == before.size(); ++k)
+            {
+                bool moved = before[k].slot_handle != handles[k].slot_handle;
+                stale      = (moved && mg_handle_row(before[k]) == mg_handle_row(reused)) ? k : stale;
+            }
+            reused = stale == before.size() ? mg_handle_create(arena, USER_HANDLE_TYPE_ARRAY) : reused;
+        }
+        REQUIRE(stale < before.size());
+
+        Particle particle = { 5000, { 5000.0f, 0.0f, 0.0f }, 1.0f };
+        CHECK(mg_handle_write(arena, before[stale], &particle, sizeof(Particle)) != MG_SUCCESS);
+        REQUIRE(mg_handle_write(arena, reused, &particle, sizeof(Particle)) == MG_SUCCESS);
+        CHECK(!mg_handle_read(arena, before[stale]));
+        mg_handle_erase(arena, before[stale]);
+        CHECK(mg_handle_valid(arena, reused));
+        CHECK(((const Particle*)mg_handle_read(arena, reused))->id == 5000);
+        mg_handle_erase(arena, reused);
+
+        REQUIRE(mg_group_defragment(arena, USER_HANDLE_TYPE_ARRAY, 0, 0, relocate, &handles, &packed) == MG_SUCCESS);
+        CHECK(packed);
+
+        mg_arena_destroy(&arena);
+    }
+
+    TEST_CASE("Replaying the log puts moved handles where defragment left them")
+    {
+        MgArena* arena = mg_arena_init(&defragment_arena_descriptor);
+        REQUIRE(arena);
+
+        MgLogDescriptor log_descriptor = { .path = "tests_defragment.mgl", .truncate = true, .sync_commit = true };
+        REQUIRE(mg_arena_log_open(arena, &log_descriptor) == MG_SUCCESS);
+
+        std::vector<MgHandle> handles = scatter_particles(arena, USER_HANDLE_TYPE_ARRAY, 999);
+        std::vector<MgHandle> before  = handles;
+        defragment_fully(arena, USER_HANDLE_TYPE_ARRAY, sizeof(Particle) * 16, handles);
+        REQUIRE(mg_arena_log_close(arena) == MG_SUCCESS);
+
+        MgArena* replayed = mg_arena_replay(&defragment_arena_descriptor, "tests_defragment.mgl");
+        REQUIRE(replayed);
+        check_particles(replayed, USER_HANDLE_TYPE_ARRAY, handles);
+        for (size_t i = 0; i < handles.size(); ++i)
+        {
+            CHECK(mg_handle_valid(replayed, before[i]) == (before[i].slot_handle == handles[i].slot_handle));
+        }
+
+        // both fill the same front slot next
+        MgHandle next = mg_handle_create(arena, USER_HANDLE_TYPE_ARRAY);
+        CHECK(mg_handle_create(replayed, USER_HANDLE_TYPE_ARRAY).slot_handle == next.slot_handle);
+        CHECK(mg_handle_row(next) == handles.size() + 1);
+
+        mg_arena_destroy(&replayed);
+        mg_arena_destroy(&arena);
+        remove("tests_defragment.mgl");
+    }
+
+    TEST_CASE("Blobs and variable size payloads move with their handles")
+    {
+        MgHandleDescriptor handle_descriptors[] = {
+            { .type = USER_HANDLE_TYPE_STRING, .count = 600, .stride = 64, .variable = true },
+            { .type = USER_HANDLE_TYPE_ARRAY, .count = 600, .stride = sizeof(Particle), .blob_capacity = 1 << 14 },
+        };
+        MgArenaDescriptor arena_descriptor = {
+            .arena_name               = "USER_DEFRAGMENT_BLOB_ARENA",
+            .handle_descriptors       = handle_descriptors,
+            .handle_descriptors_count = 2,
+            .sync_mode                = MG_ARENA_SYNC_GROUP_SPIN,
+        };
+        MgArena* arena = mg_arena_init(&arena_descriptor);
+        REQUIRE(arena);
+
+        // payloads of every size class, and blobs on every other particle
+        std::vector<MgHandle> strings;
+        std::vector<MgHandle> particles;
+        std::vector<MgHandle> erased;
+        for (uint32_t i = 0; i < 600; ++i)
+        {
+            uint8_t bytes[64];
+            memset(bytes, (int)(i & 0xff), sizeof(bytes));
+            MgHandle string = mg_handle_create(arena, USER_HANDLE_TYPE_STRING);
+            REQUIRE(mg_handle_write(arena, string, bytes, 1 + i % 64) == MG_SUCCESS);
+
+            Particle particle = { i, { (float)i, 0.0f, 0.0f }, 1.0f };
+            MgHandle handle   = mg_handle_create(arena, USER_HANDLE_TYPE_ARRAY);
+            REQUIRE(mg_handle_write(arena, handle, &particle, sizeof(Particle)) == MG_SUCCESS);
+            if (i % 2 == 0)
+            {
+                REQUIRE(mg_handle_blob_write(arena, handle, bytes, 1 + i % 23) == MG_SUCCESS);
+            }
+
+            if (i % 3 == 0)
+            {
+                strings.push_back(string);
+                particles.push_back(handle);
+            }
+            else
+            {
+                erased.push_back(string);
+                erased.push_back(handle);
+            }
+        }
+        for (MgHandle handle : erased)
+        {
+            mg_handle_erase(arena, handle);
+        }
+
+        defragment_fully(arena, USER_HANDLE_TYPE_STRING, 64 * 8, strings);
+        defragment_fully(arena, USER_HANDLE_TYPE_ARRAY, sizeof(Particle) * 8, particles);
+
+        for (size_t k = 0; k < strings.size(); ++k)
+        {
+            uint32_t i = (uint32_t)k * 3;
+            CHECK(mg_handle_row(strings[k]) <= strings.size());
+            CHECK(mg_handle_row(particles[k]) <= particles.size());
+
+            size_t size         = 0;
+            const uint8_t* data = (const uint8_t*)mg_handle_read_sized(arena, strings[k], &size);
+            REQUIRE(data);
+            CHECK(size == 1 + i % 64);
+            CHECK(data[size - 1] == (i & 0xff));
+
+            const Particle* particle = (const Particle*)mg_handle_read(arena, particles[k]);
+            REQUIRE(particle);
+            CHECK(particle->id == i);
+
+            const uint8_t* blob = (const uint8_t*)mg_handle_blob_read(arena, particles[k], &size);
+            CHECK((blob != NULL) == (i % 2 == 0));
+            if (blob)
+            {
+                CHECK(size == 1 + i % 23);
+                CHECK(blob[size - 1] == (i & 0xff));
+            }
+        }
+
+        mg_arena_destroy(&arena);
+    }
+
+    TEST_CASE("Each shard of a sharded group is packed at its own front")
+    {
+        MgHandleDescriptor handle_descriptors[] = {
+            { .type = USER_HANDLE_TYPE_ARRAY, .count = 1000, .stride = sizeof(Particle), .shard_count = 4,
+              .indexed = true },
+        };
+        MgArenaDescriptor arena_descriptor = {
+            .arena_name               = "USER_DEFRAGMENT_SHARDED_ARENA",
+            .handle_descriptors       = handle_descriptors,
+            .handle_descriptors_count = 1,
+            .sync_mode                = MG_ARENA_SYNC_GROUP_SPIN,
+        };
+        MgArena* arena = mg_arena_init(&arena_descriptor);
+        REQUIRE(arena);
+
+        // creates fall over to the next shard once one is full, so filling the group fills all four
+        uint64_t count = 0;
+        for (MgHandle handle = mg_handle_create(arena, USER_HANDLE_TYPE_ARRAY); handle.slot_handle;
+        handle = mg_handle_create(arena, USER_HANDLE_TYPE_ARRAY))
+        {
+            ++count;
+        }
+        REQUIRE(count >= 1000);
+        mg_arena_destroy(&arena);
+        arena = mg_arena_init(&arena_descriptor);
+        REQUIRE(arena);
+
+        std::vector<MgHandle> handles = scatter_particles(arena, USER_HANDLE_TYPE_ARRAY, count);
+        defragment_fully(arena, USER_HANDLE_TYPE_ARRAY, sizeof(Particle) * 16, handles);
+        check_particles(arena, USER_HANDLE_TYPE_ARRAY, handles);
+
+        // one run of rows per shard, the first one right after the invalid slot 0
+        std::vector<uint32_t> rows;
+        for (MgHandle handle : handles)
+        {
+            rows.push_back(mg_handle_row(handle));
+        }
+        std::sort(rows.begin(), rows.end());
+        uint32_t runs = 1;
+        for (size_t i = 1; i < rows.size(); ++i)
+        {
+            runs += rows[i] != rows[i - 1] + 1;
+        }
+        CHECK(rows.front() == 1);
+        CHECK(runs == 4);
+
+        mg_arena_destroy(&arena);
+    }
+
+    TEST_CASE("A time budget ends a call early")
+    {
+        MgArena* arena = mg_arena_init(&defragment_arena_descriptor);
+        REQUIRE(arena);
+
+        std::vector<MgHandle> handles = scatter_particles(arena, USER_HANDLE_TYPE_ARRAY, 999);
+        std::vector<MgHandle> before  = handles;
+
+        // a single nanosecond still moves one handle, but not all of them
+        bool packed = false;
+        REQUIRE(mg_group_defragment(arena, USER_HANDLE_TYPE_ARRAY, 0, 1, relocate, &handles, &packed) ==
+        MG_SUCCESS);
+        size_t moved = 0;
+        for (size_t i = 0; i < handles.size(); ++i)
+        {
+            moved += before[i].slot_handle != handles[i].slot_handle;
+        }
+        CHECK(moved >= 1);
+        CHECK(moved < handles.size() / 2);
+        CHECK(!packed);
+
+        // ten seconds are plenty for the rest
+        REQUIRE(mg_group_defragment(arena, USER_HANDLE_TYPE_ARRAY, 0, 10000000000ull, relocate, &handles, &packed) ==
+        MG_SUCCESS);
+        CHECK(packed);
+        check_particles(arena, USER_HANDLE_TYPE_ARRAY, handles);
+
+        mg_arena_destroy(&arena);
+    }
+}